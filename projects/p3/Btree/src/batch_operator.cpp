@@ -0,0 +1,672 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "batch_operator.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "exceptions/bad_scan_param_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Returns the type of a column holding an attribute of the given type; a
+ * STRING attribute needs a length.
+ */
+ColumnType columnType(const Datatype type, const std::size_t length) {
+  ColumnType column;
+  column.type = type;
+  switch (type) {
+    case INTEGER:
+      column.length = sizeof(int);
+      break;
+    case DOUBLE:
+      column.length = sizeof(double);
+      break;
+    default:
+      if (length == 0) {
+        throw BadScanParamException();
+      }
+      column.length = static_cast<std::uint16_t>(length);
+      break;
+  }
+  return column;
+}
+
+/**
+ * Returns the bytes of a constant compared with a column, padding a string
+ * with NULs like a ScanPredicate does.
+ */
+std::string columnValue(const ColumnType& column, const void* value) {
+  std::string bytes(column.length, '\0');
+  if (column.type == STRING) {
+    strncpy(&bytes[0], static_cast<const char*>(value), column.length);
+  } else {
+    std::memcpy(&bytes[0], value, column.length);
+  }
+  return bytes;
+}
+
+/**
+ * Narrows the selection of a batch to the selected rows for which keep(row)
+ * holds.  The selection is rewritten in place: a row is stored
+ * unconditionally and only counted if kept, so the loop has no branch on the
+ * comparison.
+ *
+ * @return  Number of rows kept.
+ */
+template <typename Keep>
+std::size_t selectRows(ColumnBatch& batch, Keep keep) {
+  std::uint16_t* out = batch.selection();
+  std::size_t kept = 0;
+  if (!batch.selective()) {
+    const std::size_t size = batch.size();
+    for (std::size_t i = 0; i < size; ++i) {
+      out[kept] = static_cast<std::uint16_t>(i);
+      kept += keep(i);
+    }
+  } else {
+    const std::size_t count = batch.count();
+    for (std::size_t k = 0; k < count; ++k) {
+      const std::uint16_t row = out[k];
+      out[kept] = row;
+      kept += keep(row);
+    }
+  }
+  return kept;
+}
+
+/**
+ * Narrows the selection to the rows whose number satisfies
+ * <value> <op> <constant>.
+ */
+template <typename T>
+std::size_t selectNumbers(ColumnBatch& batch, const T* values,
+                          const Operator op, const T constant) {
+  switch (op) {
+    case LT:
+      return selectRows(batch, [=](std::size_t r) { return values[r] < constant; });
+    case LTE:
+      return selectRows(batch, [=](std::size_t r) { return values[r] <= constant; });
+    case GTE:
+      return selectRows(batch, [=](std::size_t r) { return values[r] >= constant; });
+    case GT:
+      return selectRows(batch, [=](std::size_t r) { return values[r] > constant; });
+    case EQ:
+      return selectRows(batch, [=](std::size_t r) { return values[r] == constant; });
+    default:
+      return selectRows(batch, [=](std::size_t r) { return values[r] != constant; });
+  }
+}
+
+/**
+ * Narrows the selection to the rows whose string satisfies
+ * <value> <op> <constant>.
+ */
+std::size_t selectStrings(ColumnBatch& batch, const char* values,
+                          const std::size_t length, const Operator op,
+                          const char* constant) {
+  return selectRows(batch, [=](std::size_t r) {
+    const int cmp = strncmp(values + r * length, constant, length);
+    switch (op) {
+      case LT:
+        return cmp < 0;
+      case LTE:
+        return cmp <= 0;
+      case GTE:
+        return cmp >= 0;
+      case GT:
+        return cmp > 0;
+      case EQ:
+        return cmp == 0;
+      default:
+        return cmp != 0;
+    }
+  });
+}
+
+/**
+ * Returns the sum of the selected values of a numeric column, accumulated in
+ * type Sum.
+ */
+template <typename T, typename Sum>
+Sum sumRows(const ColumnBatch& batch, const T* values) {
+  Sum sum = 0;
+  if (!batch.selective()) {
+    const std::size_t size = batch.size();
+    for (std::size_t i = 0; i < size; ++i) {
+      sum += values[i];
+    }
+  } else {
+    const std::uint16_t* selection = batch.selection();
+    const std::size_t count = batch.count();
+    for (std::size_t k = 0; k < count; ++k) {
+      sum += values[selection[k]];
+    }
+  }
+  return sum;
+}
+
+/**
+ * Returns the row holding the smallest (or, if largest is set, the largest)
+ * selected value of a column, which must have a row selected.
+ */
+std::size_t extremeRow(const ColumnBatch& batch, const std::size_t column,
+                       const bool largest) {
+  const ColumnType& type = batch.schema()[column];
+  std::size_t best = batch.row(0);
+  for (std::size_t k = 1; k < batch.count(); ++k) {
+    const std::size_t row = batch.row(k);
+    const int cmp = ScanPredicate::compare(type.type, batch.value(column, row),
+                                           batch.value(column, best),
+                                           type.length);
+    if (largest ? cmp > 0 : cmp < 0) {
+      best = row;
+    }
+  }
+  return best;
+}
+
+/**
+ * Returns the row holding the smallest (or largest) selected number of a
+ * column, which must have a row selected.
+ */
+template <typename T>
+std::size_t extremeNumberRow(const ColumnBatch& batch, const T* values,
+                             const bool largest) {
+  std::size_t best = batch.row(0);
+  T bestValue = values[best];
+  for (std::size_t k = 1; k < batch.count(); ++k) {
+    const std::size_t row = batch.row(k);
+    if (largest ? values[row] > bestValue : values[row] < bestValue) {
+      best = row;
+      bestValue = values[row];
+    }
+  }
+  return best;
+}
+
+/**
+ * Copies attributes of the records with the given IDs into a batch: attribute
+ * c of record r goes to row r of column first_column + c.  An attribute past
+ * the end of its record is zeroed.  The page of a record stays pinned while
+ * the following records lie on it.
+ */
+void fetchAttributes(PageFile* file, BufMgr* bufMgr,
+                     const std::vector<PaxAttribute>& attributes,
+                     const RecordId* rids, const std::size_t count,
+                     ColumnBatch& batch, const std::size_t first_column) {
+  Page* page = NULL;
+  PageId pinned = 0;
+  bool pax = false;
+  std::string record;
+  try {
+    for (std::size_t r = 0; r < count; ++r) {
+      // Neighbouring record IDs often point to the same page.
+      if (page == NULL || rids[r].page_number != pinned) {
+        if (page != NULL) {
+          bufMgr->unPinPage(file, pinned, false);
+          page = NULL;
+        }
+        bufMgr->readPage(file, rids[r].page_number, page);
+        pinned = rids[r].page_number;
+        pax = PaxPage::isFormatted(*page);
+      }
+
+      RecordView view = {NULL, 0};
+      if (!pax) {
+        view = page->getRecordView(rids[r]);
+      }
+      for (std::size_t c = 0; c < attributes.size(); ++c) {
+        const PaxAttribute& wanted = attributes[c];
+        const char* value = NULL;
+        if (pax) {
+          value = PaxPage(page).getField(rids[r], wanted.offset, wanted.length);
+          if (value == NULL) {
+            record = PaxPage(page).getRecord(rids[r]);
+            view.data = record.data();
+            view.length = record.size();
+          }
+        }
+        if (value == NULL && wanted.offset + wanted.length <= view.length) {
+          value = view.data + wanted.offset;
+        }
+        char* field = batch.column(first_column + c) + r * wanted.length;
+        if (value != NULL) {
+          std::memcpy(field, value, wanted.length);
+        } else {
+          std::memset(field, 0, wanted.length);
+        }
+      }
+    }
+  } catch (...) {
+    if (page != NULL) {
+      bufMgr->unPinPage(file, pinned, false);
+    }
+    throw;
+  }
+  if (page != NULL) {
+    bufMgr->unPinPage(file, pinned, false);
+  }
+}
+
+}
+
+ScanOperator::ScanOperator(const std::string& relation, BufMgr* bufMgr)
+    : scan_(relation, bufMgr),
+      started_(false) {}
+
+ScanOperator::ScanOperator(const std::string& relation, BufMgr* bufMgr,
+                           const ScanPredicate& predicate)
+    : scan_(relation, bufMgr, predicate),
+      started_(false) {}
+
+void ScanOperator::addColumn(const std::size_t offset, const Datatype type,
+                             const std::size_t length) {
+  const ColumnType column = columnType(type, length);
+  const PaxAttribute attribute = {static_cast<std::uint16_t>(offset),
+                                  column.length};
+  attributes_.push_back(attribute);
+  schema_.push_back(column);
+}
+
+bool ScanOperator::next(ColumnBatch& batch) {
+  if (!started_) {
+    scan_.setProjection(attributes_);
+    started_ = true;
+  }
+
+  // A scan batch never spans pages; fill the column batch from as many
+  // pages as it takes.
+  std::vector<char*> columns(schema_.size());
+  std::size_t size = 0;
+  while (size < ColumnBatch::CAPACITY) {
+    for (std::size_t c = 0; c < schema_.size(); ++c) {
+      columns[c] = batch.column(c) + size * schema_[c].length;
+    }
+    const std::size_t count = scan_.scanNextColumns(
+        batch.rids() + size, columns.data(), ColumnBatch::CAPACITY - size);
+    if (count == 0) {
+      break;
+    }
+    size += count;
+  }
+  batch.setSize(size);
+  return size > 0;
+}
+
+IndexScanOperator::IndexScanOperator(BTreeIndex* index,
+                                     const std::string& relation,
+                                     BufMgr* bufMgr, const void* lowVal,
+                                     const Operator lowOp,
+                                     const void* highVal,
+                                     const Operator highOp)
+    : index_(index),
+      file_(NULL),
+      buf_mgr_(bufMgr),
+      done_(false) {
+  index_->startScan(lowVal, lowOp, highVal, highOp);
+  try {
+    file_ = new PageFile(relation, false /* create_new */);
+  } catch (...) {
+    index_->endScan();
+    throw;
+  }
+}
+
+IndexScanOperator::~IndexScanOperator() {
+  try {
+    index_->endScan();
+    buf_mgr_->flushFile(file_);
+  } catch (...) {
+  }
+  delete file_;
+}
+
+void IndexScanOperator::addColumn(const std::size_t offset,
+                                  const Datatype type,
+                                  const std::size_t length) {
+  const ColumnType column = columnType(type, length);
+  const PaxAttribute attribute = {static_cast<std::uint16_t>(offset),
+                                  column.length};
+  attributes_.push_back(attribute);
+  schema_.push_back(column);
+}
+
+bool IndexScanOperator::next(ColumnBatch& batch) {
+  batch.clear();
+  if (done_) {
+    return false;
+  }
+
+  RecordId* rids = batch.rids();
+  std::size_t size = 0;
+  try {
+    while (size < ColumnBatch::CAPACITY) {
+      index_->scanNext(rids[size]);
+      ++size;
+    }
+  } catch (const IndexScanCompletedException&) {
+    done_ = true;
+  }
+  batch.setSize(size);
+  fetchAttributes(file_, buf_mgr_, attributes_, rids, size, batch, 0);
+  return size > 0;
+}
+
+IndexJoinOperator::IndexJoinOperator(std::unique_ptr<BatchOperator> outer,
+                                     const std::size_t outer_key,
+                                     BTreeIndex* index,
+                                     const std::string& relation,
+                                     BufMgr* bufMgr)
+    : outer_(std::move(outer)),
+      outer_key_(outer_key),
+      outer_batch_(outer_->schema()),
+      index_(index),
+      file_(new PageFile(relation, false /* create_new */)),
+      buf_mgr_(bufMgr),
+      schema_(outer_->schema()),
+      next_match_(0),
+      outer_done_(false) {}
+
+IndexJoinOperator::~IndexJoinOperator() {
+  try {
+    index_->endProbe();
+    buf_mgr_->flushFile(file_);
+  } catch (...) {
+  }
+  delete file_;
+}
+
+void IndexJoinOperator::addColumn(const std::size_t offset,
+                                  const Datatype type,
+                                  const std::size_t length) {
+  const ColumnType column = columnType(type, length);
+  const PaxAttribute attribute = {static_cast<std::uint16_t>(offset),
+                                  column.length};
+  attributes_.push_back(attribute);
+  schema_.push_back(column);
+}
+
+void IndexJoinOperator::probeBatch() {
+  const ColumnType& key = outer_->schema()[outer_key_];
+  const std::size_t count = outer_batch_.count();
+  std::vector<std::uint16_t> rows(count);
+  for (std::size_t k = 0; k < count; ++k) {
+    rows[k] = static_cast<std::uint16_t>(outer_batch_.row(k));
+  }
+  std::stable_sort(rows.begin(), rows.end(),
+                   [this, &key](const std::uint16_t a, const std::uint16_t b) {
+                     return ScanPredicate::compare(
+                                key.type, outer_batch_.value(outer_key_, a),
+                                outer_batch_.value(outer_key_, b),
+                                key.length) < 0;
+                   });
+
+  matches_.clear();
+  next_match_ = 0;
+  std::vector<RecordId> found;
+  for (std::size_t k = 0; k < count; ++k) {
+    const char* value = outer_batch_.value(outer_key_, rows[k]);
+    if (k == 0 ||
+        ScanPredicate::compare(key.type,
+                               outer_batch_.value(outer_key_, rows[k - 1]),
+                               value, key.length) != 0) {
+      found.clear();
+      index_->probe(value, found);
+    }
+    for (std::size_t f = 0; f < found.size(); ++f) {
+      const Match match = {rows[k], found[f]};
+      matches_.push_back(match);
+    }
+  }
+}
+
+bool IndexJoinOperator::next(ColumnBatch& batch) {
+  const std::size_t outerColumns = outer_batch_.schema().size();
+  RecordId* rids = batch.rids();
+  std::size_t size = 0;
+  while (size < ColumnBatch::CAPACITY) {
+    if (next_match_ == matches_.size()) {
+      if (outer_done_) {
+        break;
+      }
+      if (!outer_->next(outer_batch_)) {
+        outer_done_ = true;
+        index_->endProbe();
+        break;
+      }
+      probeBatch();
+      continue;
+    }
+
+    const std::size_t count =
+        std::min(ColumnBatch::CAPACITY - size, matches_.size() - next_match_);
+    const Match* first = &matches_[next_match_];
+    for (std::size_t c = 0; c < outerColumns; ++c) {
+      const std::size_t length = schema_[c].length;
+      char* out = batch.column(c) + size * length;
+      for (std::size_t k = 0; k < count; ++k) {
+        std::memcpy(out + k * length, outer_batch_.value(c, first[k].row),
+                    length);
+      }
+    }
+    for (std::size_t k = 0; k < count; ++k) {
+      rids[size + k] = first[k].rid;
+    }
+    size += count;
+    next_match_ += count;
+  }
+  batch.setSize(size);
+  fetchAttributes(file_, buf_mgr_, attributes_, rids, size, batch,
+                  outerColumns);
+  return size > 0;
+}
+
+FilterOperator::FilterOperator(std::unique_ptr<BatchOperator> input,
+                               const std::size_t column, const Operator op,
+                               const void* value)
+    : input_(std::move(input)),
+      column_(column),
+      op_(op),
+      value_(columnValue(input_->schema()[column], value)) {}
+
+bool FilterOperator::next(ColumnBatch& batch) {
+  const ColumnType& type = schema()[column_];
+  while (input_->next(batch)) {
+    std::size_t kept;
+    switch (type.type) {
+      case INTEGER: {
+        int constant;
+        std::memcpy(&constant, value_.data(), sizeof(int));
+        kept = selectNumbers(batch, batch.values<int>(column_), op_, constant);
+        break;
+      }
+      case DOUBLE: {
+        double constant;
+        std::memcpy(&constant, value_.data(), sizeof(double));
+        kept = selectNumbers(batch, batch.values<double>(column_), op_,
+                             constant);
+        break;
+      }
+      default:
+        kept = selectStrings(batch, batch.column(column_), type.length, op_,
+                             value_.data());
+        break;
+    }
+    batch.setSelection(kept);
+    if (kept > 0) {
+      return true;
+    }
+  }
+  batch.clear();
+  return false;
+}
+
+ProjectOperator::ProjectOperator(std::unique_ptr<BatchOperator> input,
+                                 const std::vector<std::size_t>& columns)
+    : input_(std::move(input)),
+      input_batch_(input_->schema()),
+      columns_(columns) {
+  for (std::size_t k = 0; k < columns_.size(); ++k) {
+    schema_.push_back(input_->schema()[columns_[k]]);
+  }
+}
+
+bool ProjectOperator::next(ColumnBatch& batch) {
+  if (!input_->next(input_batch_)) {
+    batch.clear();
+    return false;
+  }
+  batch.take(input_batch_, columns_);
+  return true;
+}
+
+AggregateOperator::AggregateOperator(std::unique_ptr<BatchOperator> input,
+                                     const std::vector<Aggregate>& aggregates)
+    : input_(std::move(input)),
+      input_batch_(input_->schema()),
+      aggregates_(aggregates),
+      done_(false) {
+  for (std::size_t a = 0; a < aggregates_.size(); ++a) {
+    switch (aggregates_[a].function) {
+      case COUNT:
+        schema_.push_back(columnType(INTEGER, 0));
+        break;
+      case SUM:
+      case AVG:
+        schema_.push_back(columnType(DOUBLE, 0));
+        break;
+      default:
+        schema_.push_back(input_->schema()[aggregates_[a].column]);
+        break;
+    }
+  }
+}
+
+bool AggregateOperator::next(ColumnBatch& batch) {
+  batch.clear();
+  if (done_) {
+    return false;
+  }
+  done_ = true;
+
+  std::size_t rows = 0;
+  std::vector<double> sums(aggregates_.size(), 0);
+  // Smallest or largest value so far, as bytes; empty before the first row.
+  std::vector<std::string> extremes(aggregates_.size());
+
+  while (input_->next(input_batch_)) {
+    rows += input_batch_.count();
+    for (std::size_t a = 0; a < aggregates_.size(); ++a) {
+      const Aggregate& aggregate = aggregates_[a];
+      if (aggregate.function == COUNT) {
+        continue;
+      }
+      const std::size_t column = aggregate.column;
+      const ColumnType& type = input_batch_.schema()[column];
+
+      if (aggregate.function == SUM || aggregate.function == AVG) {
+        if (type.type == INTEGER) {
+          sums[a] += static_cast<double>(sumRows<int, std::int64_t>(
+              input_batch_, input_batch_.values<int>(column)));
+        } else if (type.type == DOUBLE) {
+          sums[a] += sumRows<double, double>(
+              input_batch_, input_batch_.values<double>(column));
+        }
+        continue;
+      }
+
+      const bool largest = aggregate.function == MAX;
+      std::size_t row;
+      switch (type.type) {
+        case INTEGER:
+          row = extremeNumberRow(input_batch_, input_batch_.values<int>(column),
+                                 largest);
+          break;
+        case DOUBLE:
+          row = extremeNumberRow(input_batch_,
+                                 input_batch_.values<double>(column), largest);
+          break;
+        default:
+          row = extremeRow(input_batch_, column, largest);
+          break;
+      }
+      const char* value = input_batch_.value(column, row);
+      const int cmp = extremes[a].empty()
+          ? 0
+          : ScanPredicate::compare(type.type, value, extremes[a].data(),
+                                   type.length);
+      if (extremes[a].empty() || (largest ? cmp > 0 : cmp < 0)) {
+        extremes[a].assign(value, type.length);
+      }
+    }
+  }
+
+  batch.setSize(1);
+  batch.rids()[0] = RecordId();
+  for (std::size_t a = 0; a < aggregates_.size(); ++a) {
+    char* out = batch.column(a);
+    switch (aggregates_[a].function) {
+      case COUNT: {
+        const int count = static_cast<int>(rows);
+        std::memcpy(out, &count, sizeof(int));
+        break;
+      }
+      case SUM:
+        std::memcpy(out, &sums[a], sizeof(double));
+        break;
+      case AVG: {
+        const double mean = rows == 0 ? 0 : sums[a] / rows;
+        std::memcpy(out, &mean, sizeof(double));
+        break;
+      }
+      default:
+        if (extremes[a].empty()) {
+          std::memset(out, 0, schema_[a].length);
+        } else {
+          std::memcpy(out, extremes[a].data(), schema_[a].length);
+        }
+        break;
+    }
+  }
+  return true;
+}
+
+LimitOperator::LimitOperator(std::unique_ptr<BatchOperator> input,
+                             const std::size_t limit,
+                             const std::size_t offset)
+    : input_(std::move(input)),
+      remaining_(limit),
+      skip_(offset) {}
+
+bool LimitOperator::next(ColumnBatch& batch) {
+  // Once the limit is reached the input is not read any further.
+  while (remaining_ > 0 && input_->next(batch)) {
+    const std::size_t count = batch.count();
+    if (skip_ >= count) {
+      skip_ -= count;
+      continue;
+    }
+    const std::size_t first = skip_;
+    const std::size_t kept = std::min(count - first, remaining_);
+    skip_ = 0;
+    if (first > 0 || kept < count) {
+      batch.keep(first, kept);
+    }
+    remaining_ -= kept;
+    return true;
+  }
+  batch.clear();
+  return false;
+}
+
+}
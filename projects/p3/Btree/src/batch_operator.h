@@ -0,0 +1,466 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "btree.h"
+#include "buffer.h"
+#include "column_batch.h"
+#include "file.h"
+#include "filescan.h"
+#include "pax_page.h"
+#include "scan_predicate.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An operator of a query plan that produces its result a batch at a
+ *        time.
+ *
+ * A plan is a tree of operators, each owning its inputs.  The consumer calls
+ * next() with a ColumnBatch of the operator's schema until it returns false;
+ * every call costs one virtual call per operator for up to
+ * ColumnBatch::CAPACITY rows, and each operator works on whole columns.
+ */
+class BatchOperator {
+ public:
+  virtual ~BatchOperator() {}
+
+  /**
+   * Returns the types of the columns the operator produces.
+   */
+  virtual const BatchSchema& schema() const = 0;
+
+  /**
+   * Fills the given batch with the next rows of the result.
+   *
+   * @param batch   Batch of the operator's schema; its contents are replaced.
+   * @return  False, with the batch empty, once the result is exhausted;
+   *          otherwise true with at least one row selected.
+   */
+  virtual bool next(ColumnBatch& batch) = 0;
+};
+
+/**
+ * @brief Produces attributes of the records of a relation, read with a
+ *        FileScan.
+ *
+ * The columns are added with addColumn() before the first call to next().
+ * A ScanPredicate given to the constructor is tested while the records are
+ * on their page, so records that fail it are never copied.
+ */
+class ScanOperator : public BatchOperator {
+ public:
+  /**
+   * Constructs a scan of every record of a relation.
+   *
+   * @param relation  Name of relation file.
+   * @param bufMgr    Buffer manager to read pages through.
+   */
+  ScanOperator(const std::string& relation, BufMgr* bufMgr);
+
+  /**
+   * Constructs a scan of the records of a relation satisfying a predicate.
+   *
+   * @param relation  Name of relation file.
+   * @param bufMgr    Buffer manager to read pages through.
+   * @param predicate Predicate the records satisfy.
+   */
+  ScanOperator(const std::string& relation, BufMgr* bufMgr,
+               const ScanPredicate& predicate);
+
+  /**
+   * Adds a column holding an attribute of the records.
+   *
+   * @param offset  Byte offset of the attribute in the record.
+   * @param type    Type of the attribute.
+   * @param length  Length of a STRING attribute; ignored for other types.
+   * @throws  BadScanParamException If type is STRING and length is 0.
+   */
+  void addColumn(const std::size_t offset, const Datatype type,
+                 const std::size_t length = 0);
+
+  virtual const BatchSchema& schema() const { return schema_; }
+
+  virtual bool next(ColumnBatch& batch);
+
+ private:
+  /**
+   * Scan the records come from.
+   */
+  FileScan scan_;
+
+  /**
+   * Attributes of the columns and their types.
+   */
+  std::vector<PaxAttribute> attributes_;
+  BatchSchema schema_;
+
+  /**
+   * True once the scan's projection is set.
+   */
+  bool started_;
+};
+
+/**
+ * @brief Produces attributes of the records of a relation found by a range
+ *        scan of a BTreeIndex, in key order.
+ *
+ * Record IDs are collected from the index a batch at a time, then the
+ * attributes are copied from the relation's pages, keeping a page pinned
+ * while consecutive records lie on it.  The index must not run another scan
+ * while the operator is in use.
+ */
+class IndexScanOperator : public BatchOperator {
+ public:
+  /**
+   * Constructs a scan of the index entries in the given range, as taken by
+   * BTreeIndex::startScan().
+   *
+   * @param index     Index of the relation.
+   * @param relation  Name of relation file the index is built on.
+   * @param bufMgr    Buffer manager to read pages through.
+   * @param lowVal    Low value of range.
+   * @param lowOp     Low operator (GT/GTE).
+   * @param highVal   High value of range.
+   * @param highOp    High operator (LT/LTE).
+   */
+  IndexScanOperator(BTreeIndex* index, const std::string& relation,
+                    BufMgr* bufMgr, const void* lowVal, const Operator lowOp,
+                    const void* highVal, const Operator highOp);
+
+  /**
+   * Ends the index scan and closes the relation.
+   */
+  virtual ~IndexScanOperator();
+
+  /**
+   * Adds a column holding an attribute of the records.
+   *
+   * @param offset  Byte offset of the attribute in the record.
+   * @param type    Type of the attribute.
+   * @param length  Length of a STRING attribute; ignored for other types.
+   * @throws  BadScanParamException If type is STRING and length is 0.
+   */
+  void addColumn(const std::size_t offset, const Datatype type,
+                 const std::size_t length = 0);
+
+  virtual const BatchSchema& schema() const { return schema_; }
+
+  virtual bool next(ColumnBatch& batch);
+
+ private:
+  IndexScanOperator(const IndexScanOperator&) = delete;
+  IndexScanOperator& operator=(const IndexScanOperator&) = delete;
+
+  /**
+   * Index scanned and relation the records are read from.
+   */
+  BTreeIndex* index_;
+  PageFile* file_;
+  BufMgr* buf_mgr_;
+
+  /**
+   * Range of the scan; strings are kept as their bytes.
+   */
+  std::string low_;
+  Operator low_op_;
+  std::string high_;
+  Operator high_op_;
+
+  /**
+   * Attributes of the columns and their types.
+   */
+  std::vector<PaxAttribute> attributes_;
+  BatchSchema schema_;
+
+  /**
+   * True once the index scan is started, and true once it is exhausted.
+   */
+  bool started_;
+  bool done_;
+};
+
+/**
+ * @brief Joins the rows of an outer input with the records of a relation
+ *        whose indexed attribute equals the outer row's key (an index
+ *        nested-loop join).
+ *
+ * Each outer batch is sorted by key, so the index is probed in ascending key
+ * order and most probes find their entries on the leaf the previous probe
+ * ended on or the next one, instead of descending from the root; equal
+ * outer keys share one probe.  The inner attributes are then copied from the
+ * relation's pages a batch of record IDs at a time.
+ *
+ * The output has the outer columns followed by the inner columns added with
+ * addColumn(), one row per match with the inner record's ID, in key order
+ * within each outer batch.  The key column must have the index's type;
+ * string keys match on their first STRINGSIZE bytes, as the index keeps
+ * them.
+ */
+class IndexJoinOperator : public BatchOperator {
+ public:
+  /**
+   * Constructs a join of an input with an indexed relation.
+   *
+   * @param outer     Operator producing the outer rows.
+   * @param outer_key Column of the outer rows looked up in the index.
+   * @param index     Index of the inner relation.
+   * @param relation  Name of relation file the index is built on.
+   * @param bufMgr    Buffer manager to read pages through.
+   */
+  IndexJoinOperator(std::unique_ptr<BatchOperator> outer,
+                    const std::size_t outer_key, BTreeIndex* index,
+                    const std::string& relation, BufMgr* bufMgr);
+
+  /**
+   * Releases the index's probe leaf and closes the relation.
+   */
+  virtual ~IndexJoinOperator();
+
+  /**
+   * Adds a column holding an attribute of the inner records.
+   *
+   * @param offset  Byte offset of the attribute in the record.
+   * @param type    Type of the attribute.
+   * @param length  Length of a STRING attribute; ignored for other types.
+   * @throws  BadScanParamException If type is STRING and length is 0.
+   */
+  void addColumn(const std::size_t offset, const Datatype type,
+                 const std::size_t length = 0);
+
+  virtual const BatchSchema& schema() const { return schema_; }
+
+  virtual bool next(ColumnBatch& batch);
+
+ private:
+  IndexJoinOperator(const IndexJoinOperator&) = delete;
+  IndexJoinOperator& operator=(const IndexJoinOperator&) = delete;
+
+  /**
+   * An outer row of the current outer batch and an inner record matching it.
+   */
+  struct Match {
+    std::uint16_t row;
+    RecordId rid;
+  };
+
+  /**
+   * Probes the index for the keys of the current outer batch.
+   */
+  void probeBatch();
+
+  /**
+   * Outer input, its key column and its current batch.
+   */
+  std::unique_ptr<BatchOperator> outer_;
+  std::size_t outer_key_;
+  ColumnBatch outer_batch_;
+
+  /**
+   * Index probed and relation the inner records are read from.
+   */
+  BTreeIndex* index_;
+  PageFile* file_;
+  BufMgr* buf_mgr_;
+
+  /**
+   * Attributes of the inner columns, and the types of all the columns.
+   */
+  std::vector<PaxAttribute> attributes_;
+  BatchSchema schema_;
+
+  /**
+   * Matches of the current outer batch, the next one to return, and true
+   * once the outer input is exhausted.
+   */
+  std::vector<Match> matches_;
+  std::size_t next_match_;
+  bool outer_done_;
+};
+
+/**
+ * @brief Selects the rows of its input whose column satisfies a comparison
+ *        with a constant.
+ *
+ * The comparison runs over the column's values array with the operator and
+ * type fixed, writing the surviving rows into the batch's selection vector.
+ */
+class FilterOperator : public BatchOperator {
+ public:
+  /**
+   * Constructs a filter keeping rows where <column> <op> <value>.
+   *
+   * @param input   Operator producing the rows.
+   * @param column  Column compared.
+   * @param op      Comparison.
+   * @param value   Constant compared with; an int, a double or a string,
+   *                depending on the column's type.
+   */
+  FilterOperator(std::unique_ptr<BatchOperator> input,
+                 const std::size_t column, const Operator op,
+                 const void* value);
+
+  virtual const BatchSchema& schema() const { return input_->schema(); }
+
+  virtual bool next(ColumnBatch& batch);
+
+ private:
+  /**
+   * Operator producing the rows.
+   */
+  std::unique_ptr<BatchOperator> input_;
+
+  /**
+   * Column compared, comparison and bytes of the constant.
+   */
+  std::size_t column_;
+  Operator op_;
+  std::string value_;
+};
+
+/**
+ * @brief Produces some of the columns of its input, in a given order.
+ *
+ * The columns are moved from the input's batch rather than copied.
+ */
+class ProjectOperator : public BatchOperator {
+ public:
+  /**
+   * Constructs a projection.
+   *
+   * @param input     Operator producing the rows.
+   * @param columns   Input column of each output column.
+   */
+  ProjectOperator(std::unique_ptr<BatchOperator> input,
+                  const std::vector<std::size_t>& columns);
+
+  virtual const BatchSchema& schema() const { return schema_; }
+
+  virtual bool next(ColumnBatch& batch);
+
+ private:
+  /**
+   * Operator producing the rows, and the batch they are read into.
+   */
+  std::unique_ptr<BatchOperator> input_;
+  ColumnBatch input_batch_;
+
+  /**
+   * Input column of each output column.
+   */
+  std::vector<std::size_t> columns_;
+  BatchSchema schema_;
+};
+
+/**
+ * Aggregate functions of an AggregateOperator.
+ */
+enum AggregateFunction {
+  COUNT,  /* Number of rows */
+  SUM,    /* Sum of a numeric column */
+  MIN,    /* Smallest value of a column */
+  MAX,    /* Largest value of a column */
+  AVG     /* Mean of a numeric column */
+};
+
+/**
+ * @brief An aggregate computed by an AggregateOperator.
+ */
+struct Aggregate {
+  /**
+   * Function computed.
+   */
+  AggregateFunction function;
+
+  /**
+   * Input column aggregated; ignored by COUNT.
+   */
+  std::size_t column;
+};
+
+/**
+ * @brief Aggregates all the rows of its input into one row.
+ *
+ * COUNT produces an INTEGER, SUM and AVG a DOUBLE and MIN and MAX a value of
+ * the input column's type.  Over no rows every aggregate is zero.
+ */
+class AggregateOperator : public BatchOperator {
+ public:
+  /**
+   * Constructs an aggregation.
+   *
+   * @param input       Operator producing the rows.
+   * @param aggregates  Aggregates to compute, one output column each.
+   */
+  AggregateOperator(std::unique_ptr<BatchOperator> input,
+                    const std::vector<Aggregate>& aggregates);
+
+  virtual const BatchSchema& schema() const { return schema_; }
+
+  virtual bool next(ColumnBatch& batch);
+
+ private:
+  /**
+   * Operator producing the rows, and the batch they are read into.
+   */
+  std::unique_ptr<BatchOperator> input_;
+  ColumnBatch input_batch_;
+
+  /**
+   * Aggregates computed.
+   */
+  std::vector<Aggregate> aggregates_;
+  BatchSchema schema_;
+
+  /**
+   * True once the result row is produced.
+   */
+  bool done_;
+};
+
+/**
+ * @brief Produces at most a given number of rows of its input, after
+ *        skipping some.
+ */
+class LimitOperator : public BatchOperator {
+ public:
+  /**
+   * Constructs a limit.
+   *
+   * @param input   Operator producing the rows.
+   * @param limit   Most rows to produce.
+   * @param offset  Number of rows to skip first.
+   */
+  LimitOperator(std::unique_ptr<BatchOperator> input, const std::size_t limit,
+                const std::size_t offset = 0);
+
+  virtual const BatchSchema& schema() const { return input_->schema(); }
+
+  virtual bool next(ColumnBatch& batch);
+
+ private:
+  /**
+   * Operator producing the rows.
+   */
+  std::unique_ptr<BatchOperator> input_;
+
+  /**
+   * Rows still to produce and to skip.
+   */
+  std::size_t remaining_;
+  std::size_t skip_;
+};
+
+}
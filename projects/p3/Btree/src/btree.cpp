@@ -27,8 +27,15 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "btree.h"
 #include "filescan.h"
+#include "parallel_filescan.h"
+#include "striped_file.h"
 #include "exceptions/bad_index_info_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/bad_scanrange_exception.h"
@@ -80,6 +87,55 @@ const void copyKey<char[STRINGSIZE]>( char (&a)[STRINGSIZE], char (&b)[STRINGSIZ
 }
 
 
+/**
+ * Compare two keys exactly: negative, zero or positive as a is smaller than,
+ * equal to or larger than b.  Unlike compare(), the difference of two doubles
+ * is not truncated to an int.
+ */
+template<class T>
+const int compareKeys(const T a, const T b)
+{
+  return (a > b) - (a < b);
+}
+
+template<> // explicit specialization for T = char[STRINGSIZE]
+const int compareKeys<char[STRINGSIZE]>( const char a[STRINGSIZE], const char b[STRINGSIZE])
+{
+  return strncmp(a,b,STRINGSIZE);
+}
+
+
+/**
+ * Call the member template helper<PAGE_SIZE> args, with PAGE_SIZE matching the
+ * page size of the index file. Node layouts depend on the page size, so every
+ * public method that touches nodes goes through here.
+ */
+#define DISPATCH_ON_PAGE_SIZE(helper, args)                                   \
+  switch ( file->page_size() ) {                                              \
+    case 512:   helper<512> args;   break;                                    \
+    case 1024:  helper<1024> args;  break;                                    \
+    case 2048:  helper<2048> args;  break;                                    \
+    case 4096:  helper<4096> args;  break;                                    \
+    case 8192:  helper<8192> args;  break;                                    \
+    case 16384: helper<16384> args; break;                                    \
+    case 32768: helper<32768> args; break;                                    \
+    default:    helper<Page::SIZE> args;                                      \
+  }
+
+
+/**
+ * Inside a helper templated on PAGE_SIZE, make the plain node type names refer
+ * to the node layouts of that page size.
+ */
+#define NODE_TYPES_OF_PAGE_SIZE                                               \
+  typedef NonLeafNodeIntOf<PAGE_SIZE>    NonLeafNodeInt;                      \
+  typedef NonLeafNodeDoubleOf<PAGE_SIZE> NonLeafNodeDouble;                   \
+  typedef NonLeafNodeStringOf<PAGE_SIZE> NonLeafNodeString;                   \
+  typedef LeafNodeIntOf<PAGE_SIZE>       LeafNodeInt;                         \
+  typedef LeafNodeDoubleOf<PAGE_SIZE>    LeafNodeDouble;                      \
+  typedef LeafNodeStringOf<PAGE_SIZE>    LeafNodeString
+
+
 /**
  * Return the index of the first key in the given page that is larger than or
  * equal to the param key.
@@ -158,7 +214,10 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 		std::string & outIndexName,
 		BufMgr *bufMgrIn,
 		const int attrByteOffset,
-		const Datatype attrType)
+		const Datatype attrType,
+		const std::size_t pageSize,
+		const bool compressed,
+		const std::vector<std::string> & stripes)
       : bufMgr(bufMgrIn),               // initialized data field
         attributeType(attrType),
         attrByteOffset(attrByteOffset)
@@ -174,41 +233,28 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 #endif
 
   // 1. set up the BTreeIndex data field
-  switch  (attributeType ) {
-    case INTEGER:
-      leafOccupancy = INTARRAYLEAFSIZE;
-      nodeOccupancy = INTARRAYNONLEAFSIZE;
-      break;
-    case DOUBLE:
-      leafOccupancy = DOUBLEARRAYLEAFSIZE;
-      nodeOccupancy = DOUBLEARRAYNONLEAFSIZE;
-      break;
-    case STRING:
-      leafOccupancy = STRINGARRAYLEAFSIZE;
-      nodeOccupancy = STRINGARRAYNONLEAFSIZE;
-      break;
-    default:
-      std::cout<<"Unsupported data type\n";
-  }
-
-#ifdef DEBUG
-    std::cout<<"Leaf Size: " << leafOccupancy<< std::endl;
-    std::cout<<"NonLeaf Size: " << nodeOccupancy<< std::endl;
-#endif
-
+  //    occupancy depends on the page size of the index file, set it below
     scanExecuting = false;
     nextEntry = -1;
     currentPageNum = 0;
+    probePageNum = 0;
+    probePageData = NULL;
+    probeDescents = 0;
 
 
   // 2. check if the index file exits. open or create new
   //   if it is new, create metanode, create the root node
   try { // try read old file
-    file = new BlobFile(outIndexName,false);
+    if ( StripedFile::stripeFilenames(outIndexName).empty() ) {
+      file = new BlobFile(outIndexName,false);
+    } else {
+      file = new StripedFile(outIndexName,false);
+    }
 #ifdef DEBUG
 std::cout<<"Reading old index file!!!\n";
 #endif
     Page *tempPage;
+    DISPATCH_ON_PAGE_SIZE(setOccupancy, ());
     headerPageNum = file->getFirstPageNo();
     bufMgr->readPage(file, headerPageNum, tempPage);
 //     IndexMetaInfo *metaInfo = (IndexMetaInfo*) tempPage;
@@ -234,6 +280,9 @@ std::cout<<"Reading old index file!!!\n";
       // meta info does not match in index file, clear and return;
 //       delete file;
       std::cout<<"Meta info does not match the index!\n";
+      // drop the header page from the buffer pool, or a later file at the
+      // same address would find it there
+      bufMgr->flushFile(file);
       delete file;
       file = NULL;
       return;
@@ -245,7 +294,12 @@ std::cout<<"Reading old index file!!!\n";
 std::cout<<"Creating new index file!!!\n";
 #endif
     Page *tempPage;
-    file = new BlobFile(outIndexName, true);
+    if ( stripes.empty() ) {
+      file = new BlobFile(outIndexName, true, pageSize, compressed);
+    } else {
+      file = new StripedFile(outIndexName, true, stripes, 1, pageSize);
+    }
+    DISPATCH_ON_PAGE_SIZE(setOccupancy, ());
 
     bufMgr->allocPage(file, headerPageNum, tempPage);
 //     IndexMetaInfo *metaInfo = (IndexMetaInfo *) tempPage;
@@ -263,21 +317,7 @@ std::cout<<"Creating new index file!!!\n";
 #endif
 
     // construct root page
-    if ( attributeType == INTEGER ) {
-      LeafNodeInt* intRootPage = reinterpret_cast<LeafNodeInt*>(tempPage);
-      intRootPage->size = 0;
-      intRootPage->rightSibPageNo = 0;
-    } else if ( attributeType == DOUBLE ) {
-      LeafNodeDouble* doubleRootPage = reinterpret_cast<LeafNodeDouble*>(tempPage);
-      doubleRootPage->size = 0;
-      doubleRootPage->rightSibPageNo = 0;
-    } else if ( attributeType == STRING ) {
-      LeafNodeString* stringRootPage = reinterpret_cast<LeafNodeString*>(tempPage);
-      stringRootPage->size = 0;
-      stringRootPage->rightSibPageNo = 0;
-    } else {
-      std::cout<<"Unsupported data type\n";
-    }
+    DISPATCH_ON_PAGE_SIZE(initRootNode, (tempPage));
     // done with meta page and root page
     bufMgr->unPinPage(file, rootPageNum, true);
     bufMgr->unPinPage(file, headerPageNum, true);
@@ -294,8 +334,23 @@ std::cout<<"Creating new index file!!!\n";
   std::cout<<"rootPageNum: "<<rootPageNum<<std::endl;
 #endif
 
-    // build B-Tree: insert the record into the B-Tree
-    buildBTree(relationName);
+    // build B-Tree: insert the record into the B-Tree.  A half-built index
+    // would be taken for a valid one when opened again, so drop the file.
+    try {
+      buildBTree(relationName);
+    } catch (...) {
+      try {
+        bufMgr->flushFile(file);
+      } catch (...) {
+      }
+      delete file;
+      file = NULL;
+      try {
+        File::remove(outIndexName);
+      } catch (...) {
+      }
+      throw;
+    }
 
   }
 
@@ -306,19 +361,70 @@ std::cout<<"Creating new index file!!!\n";
 #endif
 
 #ifdef DEBUGPRINTTREE
+    printTree();
+#endif
+
+}
+
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::setOccupancy
+// -----------------------------------------------------------------------------
+
+template <std::size_t PAGE_SIZE>
+const void BTreeIndex::setOccupancy()
+{
+  switch  (attributeType ) {
+    case INTEGER:
+      leafOccupancy = NodeSize<PAGE_SIZE>::INTLEAF;
+      nodeOccupancy = NodeSize<PAGE_SIZE>::INTNONLEAF;
+      break;
+    case DOUBLE:
+      leafOccupancy = NodeSize<PAGE_SIZE>::DOUBLELEAF;
+      nodeOccupancy = NodeSize<PAGE_SIZE>::DOUBLENONLEAF;
+      break;
+    case STRING:
+      leafOccupancy = NodeSize<PAGE_SIZE>::STRINGLEAF;
+      nodeOccupancy = NodeSize<PAGE_SIZE>::STRINGNONLEAF;
+      break;
+    default:
+      std::cout<<"Unsupported data type\n";
+  }
+
+#ifdef DEBUG
+    std::cout<<"Page Size: " << PAGE_SIZE<< std::endl;
+    std::cout<<"Leaf Size: " << leafOccupancy<< std::endl;
+    std::cout<<"NonLeaf Size: " << nodeOccupancy<< std::endl;
+#endif
+}
+
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::initRootNode
+// -----------------------------------------------------------------------------
+
+template <std::size_t PAGE_SIZE>
+const void BTreeIndex::initRootNode(Page *rootPage)
+{
+    static_assert(sizeof(LeafNodeStringOf<PAGE_SIZE>) <= PAGE_SIZE
+               && sizeof(NonLeafNodeDoubleOf<PAGE_SIZE>) <= PAGE_SIZE,
+                  "B+Tree nodes must fit in a page.");
+
     if ( attributeType == INTEGER ) {
-      printTree<int, struct NonLeafNodeInt, struct LeafNodeInt>();
-    }
-    else if ( attributeType == DOUBLE ) {
-      printTree<double, struct NonLeafNodeDouble, struct LeafNodeDouble>();
-    }
-    else if ( attributeType == STRING ) {
-      printTree<char[STRINGSIZE], struct NonLeafNodeString, struct LeafNodeString>();
+      LeafNodeIntOf<PAGE_SIZE>* intRootPage = reinterpret_cast<LeafNodeIntOf<PAGE_SIZE>*>(rootPage);
+      intRootPage->size = 0;
+      intRootPage->rightSibPageNo = 0;
+    } else if ( attributeType == DOUBLE ) {
+      LeafNodeDoubleOf<PAGE_SIZE>* doubleRootPage = reinterpret_cast<LeafNodeDoubleOf<PAGE_SIZE>*>(rootPage);
+      doubleRootPage->size = 0;
+      doubleRootPage->rightSibPageNo = 0;
+    } else if ( attributeType == STRING ) {
+      LeafNodeStringOf<PAGE_SIZE>* stringRootPage = reinterpret_cast<LeafNodeStringOf<PAGE_SIZE>*>(rootPage);
+      stringRootPage->size = 0;
+      stringRootPage->rightSibPageNo = 0;
     } else {
       std::cout<<"Unsupported data type\n";
     }
-#endif
-
 }
 
 
@@ -328,18 +434,103 @@ std::cout<<"Creating new index file!!!\n";
 
 const void BTreeIndex::buildBTree(const std::string & relationName)
 {
-    FileScan fscan(relationName, bufMgr);
-    try {
-      RecordId scanRid;
-      while(1)
+    const std::size_t keyLength = attributeType == INTEGER ? sizeof(int)
+        : attributeType == DOUBLE ? sizeof(double) : STRINGSIZE;
+
+    std::vector<PaxAttribute> keyAttribute(1);
+    keyAttribute[0].offset = attrByteOffset;
+    keyAttribute[0].length = keyLength;
+
+    // Extract just the keys, packed side by side, with one scan worker per
+    // core, keeping each morsel's keys apart.  The tree itself is built by
+    // this thread, morsel by morsel, so the keys go in in the order a
+    // sequential scan returns them.  A morsel is inserted as soon as it and
+    // every earlier one are extracted, and its keys are dropped; a worker
+    // that gets more than BUILD_WINDOW morsels ahead of the inserts waits,
+    // so the keys held stay bounded whatever the size of the relation.  Once
+    // a morsel fails to scan, nothing more is inserted.
+    const std::size_t BUILD_WINDOW = 16;
+    struct MorselKeys
+    {
+      std::vector<char> keys;
+      std::vector<RecordId> rids;
+      bool done;
+    };
+    ParallelFileScan pscan(relationName, bufMgr);
+    const std::size_t morsels = pscan.num_morsels();
+    std::vector<MorselKeys> morselKeys(morsels);
+    for (std::size_t morsel = 0; morsel < morsels; morsel++)
+    {
+      morselKeys[morsel].done = false;
+    }
+
+    std::mutex latch;
+    std::condition_variable changed;
+    std::size_t inserted = 0;       // morsels inserted
+    bool stopped = false;           // inserting failed
+    bool failed = false;            // scanning a morsel failed
+    bool scanned = false;           // the scan has returned
+    std::exception_ptr scanError;
+
+    std::thread scanner([&]() {
+      try {
+        pscan.run(0 /* one per core */,
+                  [&](const std::size_t morsel, PageRecords& records) {
+          MorselKeys& extracted = morselKeys[morsel];
+          const std::size_t first = extracted.rids.size();
+          extracted.keys.resize((first + records.size()) * keyLength);
+          records.project(0, records.size(), keyAttribute,
+                          &extracted.keys[first * keyLength]);
+          for (std::size_t i = 0; i < records.size(); i++)
+          {
+            extracted.rids.push_back(records.recordId(i));
+          }
+        },
+                  [&](const std::size_t morsel, const bool completed) {
+          std::unique_lock<std::mutex> lock(latch);
+          if (completed)
+          {
+            morselKeys[morsel].done = true;
+          }
+          else
+          {
+            failed = true;
+          }
+          changed.notify_all();
+          changed.wait(lock, [&]() {
+            return stopped || morsel < inserted + BUILD_WINDOW;
+          });
+        });
+      } catch (...) {
+        scanError = std::current_exception();
+      }
+      std::lock_guard<std::mutex> lock(latch);
+      scanned = true;
+      changed.notify_all();
+    });
+
+    try
+    {
+      for (std::size_t morsel = 0; morsel < morsels; morsel++)
       {
-        fscan.scanNext(scanRid);
-        //Assuming RECORD.i is our key, lets extract the key, which we know is
-        //INTEGER and whose byte offset is also know inside the record. 
-        std::string recordStr = fscan.getRecord();
-        const char *record = recordStr.c_str();
-        void *key = (void *)(record + attrByteOffset);
-        insertEntry(key, scanRid);
+        {
+          std::unique_lock<std::mutex> lock(latch);
+          changed.wait(lock, [&]() {
+            return morselKeys[morsel].done || failed || scanned;
+          });
+          if (!morselKeys[morsel].done || failed)
+          {
+            break; // the scan failed; the index is dropped
+          }
+        }
+
+        MorselKeys& extracted = morselKeys[morsel];
+        for (std::size_t k = 0; k < extracted.rids.size(); k++)
+        {
+          //Assuming RECORD.i is our key, lets extract the key, which we know is
+          //INTEGER and whose byte offset is also know inside the record. 
+          void *key = (void *)&extracted.keys[k * keyLength];
+          insertEntry(key, extracted.rids[k]);
 #ifdef DEBUGMORE
     if ( attributeType == INTEGER ) {
       std::cout << "Extracted : " << *((int*)key) << std::endl;
@@ -353,16 +544,34 @@ const void BTreeIndex::buildBTree(const std::string & relationName)
       std::cout<<"Unsupported data type\n";
     }
 #endif
+        }
+
+        std::lock_guard<std::mutex> lock(latch);
+        std::vector<char>().swap(extracted.keys);
+        std::vector<RecordId>().swap(extracted.rids);
+        inserted = morsel + 1;
+        changed.notify_all();
       }
-    } catch(EndOfFileException e) {
-#ifdef DEBUG
-      std::cout << "Read all records" << std::endl;
-      std::cout << "BTree initialized" << std::endl;
-#endif
-    } 
-#ifdef DEBUGle
-    catch ( InvalidRecordException e) {
     }
+    catch (...)
+    {
+      {
+        std::lock_guard<std::mutex> lock(latch);
+        stopped = true;
+        pscan.stop();
+        changed.notify_all();
+      }
+      scanner.join();
+      throw;
+    }
+    scanner.join();
+    if (scanError)
+    {
+      std::rethrow_exception(scanError);
+    }
+#ifdef DEBUG
+    std::cout << "Read all records" << std::endl;
+    std::cout << "BTree initialized" << std::endl;
 #endif
 
 }
@@ -398,6 +607,11 @@ BTreeIndex::~BTreeIndex()
     }
 
     scanExecuting = false;
+
+    try {
+      endProbe();
+    } catch ( const PageNotPinnedException& e ) {
+    }
 #ifdef DEBUG
   std::cout<<" try to delete file object "<<std::endl;
 #endif
@@ -434,6 +648,16 @@ BTreeIndex::~BTreeIndex()
 
 const void BTreeIndex::insertEntry(const void *key, const RecordId rid) 
 {
+    // an insert may split the probe leaf
+    endProbe();
+    DISPATCH_ON_PAGE_SIZE(insertEntrySized, (key, rid));
+}
+
+template <std::size_t PAGE_SIZE>
+const void BTreeIndex::insertEntrySized(const void *key, const RecordId rid) 
+{
+    NODE_TYPES_OF_PAGE_SIZE;
+
     // determine the type, find the leaf node to insert, and insert
     if ( attributeType == INTEGER ) {
         RIDKeyPair<int> rkpair;
@@ -447,15 +671,15 @@ const void BTreeIndex::insertEntry(const void *key, const RecordId rid)
 #endif
 
         PageId leafToInsert = 
-          findLeafNode<int, struct NonLeafNodeInt>(rootPageNum, intKey);
-        insertLeafNode<int, struct NonLeafNodeInt, struct LeafNodeInt>(leafToInsert, rkpair);
+          findLeafNode<int, NonLeafNodeInt>(rootPageNum, intKey);
+        insertLeafNode<int, NonLeafNodeInt, LeafNodeInt>(leafToInsert, rkpair);
     } else if ( attributeType == DOUBLE ) {
         RIDKeyPair<double> rkpair;
         double doubleKey = *(double*)key;
         rkpair.set(rid, doubleKey);
         PageId leafToInsert =
-          findLeafNode<double, struct NonLeafNodeDouble>(rootPageNum,doubleKey);
-        insertLeafNode<double, struct NonLeafNodeDouble, struct LeafNodeDouble>(leafToInsert, rkpair);
+          findLeafNode<double, NonLeafNodeDouble>(rootPageNum,doubleKey);
+        insertLeafNode<double, NonLeafNodeDouble, LeafNodeDouble>(leafToInsert, rkpair);
     } else if ( attributeType == STRING ) {
         RIDKeyPair<char[STRINGSIZE]> rkpair;
         strncpy(rkpair.key, (char*)key, STRINGSIZE);
@@ -468,8 +692,8 @@ std::cout<< " when inserting, rid.page_number is "<< rid.page_number<<std::endl;
 #endif
         rkpair.rid = rid;
         PageId leafToInsert = 
-          findLeafNode<char[STRINGSIZE], struct NonLeafNodeString>(rootPageNum,rkpair.key);
-        insertLeafNode<char[STRINGSIZE], struct NonLeafNodeString, struct LeafNodeString>(leafToInsert, rkpair);
+          findLeafNode<char[STRINGSIZE], NonLeafNodeString>(rootPageNum,rkpair.key);
+        insertLeafNode<char[STRINGSIZE], NonLeafNodeString, LeafNodeString>(leafToInsert, rkpair);
     } else {
         std::cout<<"Unsupported data type\n";
     }
@@ -673,6 +897,12 @@ const PageId BTreeIndex::splitLeafNode(PageId pageNo)
 
     T copyUpKey;
     copyKey((copyUpKey), ((firstPage->keyArray[midIndex])));
+
+    // clear the moved half so the stale entries don't end up on disk
+    memset((void*)(&(firstPage->keyArray[midIndex])), 0,
+           sizeof(T)*(leafOccupancy-midIndex));
+    memset((void*)(&(firstPage->ridArray[midIndex])), 0,
+           sizeof(RecordId)*(leafOccupancy-midIndex));
 #ifdef DEBUGCOPY
   std::cout<<"After copy key, the new value of copyUpKey is ";
   std::cout<<copyUpKey<<" and it should be "<<firstPage->keyArray[midIndex]<<std::endl;
@@ -871,6 +1101,12 @@ const PageId BTreeIndex::splitNonLeafNode(PageId pageNo, int midIndex)
 
     T pushUpKey;
     copyKey(pushUpKey, firstPage->keyArray[midIndex]);
+
+    // clear the moved half so the stale entries don't end up on disk
+    memset((void*)(&(firstPage->keyArray[midIndex])), 0,
+           sizeof(T)*(nodeOccupancy-midIndex));
+    memset((void*)(&(firstPage->pageNoArray[midIndex+1])), 0,
+           sizeof(PageId)*(nodeOccupancy-midIndex));
 #ifdef DEBUGCOPY
   std::cout<<"After copy key, the new value of pushUpKey is ";
   std::cout<<pushUpKey<<" and it should be "<<firstPage->keyArray[midIndex]<<std::endl;
@@ -974,15 +1210,23 @@ const PageId BTreeIndex::findParentOf(PageId childPageNo, T &key)
 
 const void BTreeIndex::printTree()
 {
+  DISPATCH_ON_PAGE_SIZE(printTreeSized, ());
+}
+
+template <std::size_t PAGE_SIZE>
+const void BTreeIndex::printTreeSized()
+{
+  NODE_TYPES_OF_PAGE_SIZE;
+
   switch  (attributeType ) {
     case INTEGER:
-      printTree<int, struct NonLeafNodeInt, struct LeafNodeInt>();
+      printTree<int, NonLeafNodeInt, LeafNodeInt>();
       break;
     case DOUBLE:
-      printTree<double, struct NonLeafNodeDouble, struct LeafNodeDouble>();
+      printTree<double, NonLeafNodeDouble, LeafNodeDouble>();
       break;
     case STRING:
-      printTree<char[STRINGSIZE], struct NonLeafNodeString, struct LeafNodeString>();
+      printTree<char[STRINGSIZE], NonLeafNodeString, LeafNodeString>();
       break;
     default:
       std::cout<<"Unsupported data type\n";
@@ -1075,6 +1319,15 @@ std::cout<<std::endl<<" PageId: "<<currNo<<std::endl;
 
 const void BTreeIndex::deleteEntry(const void* key)
 {
+  // a delete may merge away the probe leaf
+  endProbe();
+  DISPATCH_ON_PAGE_SIZE(deleteEntrySized, (key));
+}
+
+template <std::size_t PAGE_SIZE>
+const void BTreeIndex::deleteEntrySized(const void* key)
+{
+  NODE_TYPES_OF_PAGE_SIZE;
 
 #ifdef DEBUGDELETE
   std::cout<<"Deleting entry\n";
@@ -1084,22 +1337,22 @@ const void BTreeIndex::deleteEntry(const void* key)
     // determine the type
     if ( attributeType == INTEGER ) {
         int intKey = *(int*)key;
-        PageId leafToDelete = findLeafNode<int, struct NonLeafNodeInt>
+        PageId leafToDelete = findLeafNode<int, NonLeafNodeInt>
           (rootPageNum, intKey);
-        deleteLeafNode<int, struct NonLeafNodeInt, struct LeafNodeInt>
+        deleteLeafNode<int, NonLeafNodeInt, LeafNodeInt>
           (leafToDelete, intKey);
     } else if ( attributeType == DOUBLE ) {
         double doubleKey = *(double*)key;
-        PageId leafToDelete = findLeafNode<double, struct NonLeafNodeDouble>
+        PageId leafToDelete = findLeafNode<double, NonLeafNodeDouble>
           (rootPageNum, doubleKey);
-        deleteLeafNode<double, struct NonLeafNodeDouble, struct LeafNodeDouble>
+        deleteLeafNode<double, NonLeafNodeDouble, LeafNodeDouble>
           (leafToDelete, doubleKey);
     } else if ( attributeType == STRING ) {
         char stringKey[STRINGSIZE];
         strncpy(stringKey, (char*)key, STRINGSIZE);
-        PageId leafToDelete = findLeafNode<char[STRINGSIZE], struct NonLeafNodeString>
+        PageId leafToDelete = findLeafNode<char[STRINGSIZE], NonLeafNodeString>
           (rootPageNum, stringKey);
-        deleteLeafNode<char[STRINGSIZE], struct NonLeafNodeString, struct LeafNodeString>
+        deleteLeafNode<char[STRINGSIZE], NonLeafNodeString, LeafNodeString>
           (leafToDelete, stringKey);
     }
 }
@@ -1311,7 +1564,7 @@ const void BTreeIndex::deleteLeafNode(PageId pageNo, T& key)
       // delete the second page
       firstPage->rightSibPageNo = secondPage->rightSibPageNo;
       bufMgr->unPinPage(file, secondPageNo, false);
-//       bufMgr->disposePage(file, secondPageNo); // TODO
+      bufMgr->disposePage(file, secondPageNo);
 
       // delete parent entry
       T key;
@@ -1359,7 +1612,7 @@ const void BTreeIndex::mergeLeafNode(PageId firstPageNo, PageId secondPageNo)
   // delete the second page
   firstPage->rightSibPageNo = secondPage->rightSibPageNo;
   bufMgr->unPinPage(file, secondPageNo, false);
-//   bufMgr->disposePage(file, secondPageNo); // TODO lead to invaildpagee
+  bufMgr->disposePage(file, secondPageNo);
 
   // delete parent entry
   PageId parentPageNo = findParentOf<T, T_NonLeafNode, T_LeafNode>
@@ -1415,7 +1668,7 @@ const void BTreeIndex::deleteNonLeafNode(PageId pageNo, T& key)
     
     // delete current page
     bufMgr->unPinPage(file, pageNo, false);
-//     bufMgr->disposePage(file, pageNo);
+    bufMgr->disposePage(file, pageNo);
     return;
   }
 
@@ -1569,7 +1822,7 @@ const void BTreeIndex::mergeNonLeafNode(PageId firstPageNo, PageId secondPageNo)
 
   // delete the second page
   bufMgr->unPinPage(file, secondPageNo, false);
-//   bufMgr->disposePage(file, secondPageNo);
+  bufMgr->disposePage(file, secondPageNo);
 
   // delete parent entry
   T key;
@@ -1610,13 +1863,9 @@ const void BTreeIndex::startScan(const void*    lowValParm,
       // store the low and high val
       lowValInt = *((int*)lowValParm);
       highValInt = *((int*)highValParm);
-      startScanHelper<int, struct NonLeafNodeInt, struct LeafNodeInt>
-          (lowValInt, highValInt);
     } else if ( attributeType == DOUBLE ) {
       lowValDouble = *((double*)lowValParm);
       highValDouble = *((double*)highValParm);
-      startScanHelper<double, struct NonLeafNodeDouble, struct LeafNodeDouble>
-          (lowValDouble, highValDouble);
     } else if ( attributeType == STRING ) {
 //       char lowStringKey[STRINGSIZE];
 //       char highStringKey[STRINGSIZE];
@@ -1629,14 +1878,30 @@ const void BTreeIndex::startScan(const void*    lowValParm,
  lowStringKey[STRINGSIZE-1] ='\0';
  highStringKey[STRINGSIZE-1] ='\0';
 #endif
-      startScanHelper<char[STRINGSIZE], struct NonLeafNodeString, struct LeafNodeString>
-          (lowStringKey, highStringKey);
 
     } else {
        std::cout<<"Unsupported data type\n";
        exit(1);  // dangerous exit, need to clean the memory ??
     }
 
+    DISPATCH_ON_PAGE_SIZE(startScanSized, ());
+}
+
+template <std::size_t PAGE_SIZE>
+const void BTreeIndex::startScanSized()
+{
+    NODE_TYPES_OF_PAGE_SIZE;
+
+    if ( attributeType == INTEGER ) {
+      startScanHelper<int, NonLeafNodeInt, LeafNodeInt>
+          (lowValInt, highValInt);
+    } else if ( attributeType == DOUBLE ) {
+      startScanHelper<double, NonLeafNodeDouble, LeafNodeDouble>
+          (lowValDouble, highValDouble);
+    } else if ( attributeType == STRING ) {
+      startScanHelper<char[STRINGSIZE], NonLeafNodeString, LeafNodeString>
+          (lowStringKey, highStringKey);
+    }
 }
 
 
@@ -1715,15 +1980,21 @@ const void BTreeIndex::scanNext(RecordId& outRid)
       throw ScanNotInitializedException();
     }
 
+    DISPATCH_ON_PAGE_SIZE(scanNextSized, (outRid));
+}
+
+template <std::size_t PAGE_SIZE>
+const void BTreeIndex::scanNextSized(RecordId& outRid) 
+{
     if ( attributeType == INTEGER ) {
-      scanNextHelper<int, struct LeafNodeInt>(outRid, lowValInt, highValInt);
+      scanNextHelper<int, LeafNodeIntOf<PAGE_SIZE> >(outRid, lowValInt, highValInt);
     } else if ( attributeType == DOUBLE ) {
-      scanNextHelper<double, struct LeafNodeDouble>(outRid, lowValDouble, highValDouble);
+      scanNextHelper<double, LeafNodeDoubleOf<PAGE_SIZE> >(outRid, lowValDouble, highValDouble);
     } else if ( attributeType == STRING ) {
 #ifdef DEBUGSTRING
 //   std::cout<<"highVal |"<<highVal<<"| at "<<__LINE__<<std::endl;
 #endif
-      scanNextHelper<char[STRINGSIZE], struct LeafNodeString>(outRid, lowStringKey, highStringKey);
+      scanNextHelper<char[STRINGSIZE], LeafNodeStringOf<PAGE_SIZE> >(outRid, lowStringKey, highStringKey);
 #ifdef DEBUGSCAN
   std::cout<<"outRid.page_number is "<<outRid.page_number<<std::endl;
 #endif
@@ -1805,5 +2076,114 @@ const void BTreeIndex::endScan()
 
 }
 
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::probe
+// -----------------------------------------------------------------------------
+
+const std::size_t BTreeIndex::probe(const void* key, std::vector<RecordId>& outRids)
+{
+    const std::size_t before = outRids.size();
+    DISPATCH_ON_PAGE_SIZE(probeSized, (key, outRids));
+    return outRids.size() - before;
+}
+
+template <std::size_t PAGE_SIZE>
+const void BTreeIndex::probeSized(const void* key, std::vector<RecordId>& outRids)
+{
+    NODE_TYPES_OF_PAGE_SIZE;
+
+    if ( attributeType == INTEGER ) {
+      int intKey = *((int*)key);
+      probeHelper<int, NonLeafNodeInt, LeafNodeInt>(intKey, outRids);
+    } else if ( attributeType == DOUBLE ) {
+      double doubleKey = *((double*)key);
+      probeHelper<double, NonLeafNodeDouble, LeafNodeDouble>(doubleKey, outRids);
+    } else if ( attributeType == STRING ) {
+      char stringKey[STRINGSIZE];
+      strncpy(stringKey, (char*)key, STRINGSIZE);
+      probeHelper<char[STRINGSIZE], NonLeafNodeString, LeafNodeString>(stringKey, outRids);
+    } else {
+      std::cout<<"Unsupported data type\n";
+    }
+}
+
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::probeHelper
+// -----------------------------------------------------------------------------
+
+template<class T, class T_NonLeafNode, class T_LeafNode>
+const void BTreeIndex::probeHelper(T &key, std::vector<RecordId>& outRids)
+{
+    // Every entry left of a leaf is at most the leaf's first key, so when that
+    // is smaller than key, the entries equal to key are in this leaf or to its
+    // right.  An ascending key that is past this leaf is most often in the
+    // next one.
+    bool reuse = false;
+    if ( probePageNum != 0 ) {
+      T_LeafNode* thisPage = reinterpret_cast<T_LeafNode*>(probePageData);
+      if ( thisPage->size > 0
+          && compareKeys<T>(thisPage->keyArray[0], key) < 0 ) {
+        reuse = compareKeys<T>(key, thisPage->keyArray[thisPage->size-1]) <= 0
+          || thisPage->rightSibPageNo == 0;
+        if ( !reuse ) {
+          moveProbeLeaf(thisPage->rightSibPageNo);
+          thisPage = reinterpret_cast<T_LeafNode*>(probePageData);
+          reuse = thisPage->size > 0
+            && compareKeys<T>(key, thisPage->keyArray[thisPage->size-1]) <= 0;
+        }
+      }
+    }
+    if ( !reuse ) {
+      probeDescents++;
+      moveProbeLeaf(findLeafNode<T, T_NonLeafNode>(rootPageNum, key));
+    }
+
+    // collect the entries equal to key, which may run on into the right
+    // siblings; findLeafNode may also return the leaf before the first one
+    T_LeafNode* thisPage = reinterpret_cast<T_LeafNode*>(probePageData);
+    int entry = thisPage->size > 0 ? getIndex<T, T_LeafNode>(thisPage, key) : 0;
+    for (;;) {
+      for ( ; entry < thisPage->size; entry++ ) {
+        const int cmp = compareKeys<T>(thisPage->keyArray[entry], key);
+        if ( cmp > 0 ) {
+          return;
+        }
+        if ( cmp == 0 ) {
+          outRids.push_back(thisPage->ridArray[entry]);
+        }
+      }
+      if ( thisPage->rightSibPageNo == 0 ) {
+        return;
+      }
+      moveProbeLeaf(thisPage->rightSibPageNo);
+      thisPage = reinterpret_cast<T_LeafNode*>(probePageData);
+      entry = 0;
+    }
+}
+
+
+const void BTreeIndex::moveProbeLeaf(PageId pageNo)
+{
+    endProbe();
+    bufMgr->readPage(file, pageNo, probePageData);
+    probePageNum = pageNo;
+}
+
+
+// -----------------------------------------------------------------------------
+// BTreeIndex::endProbe
+// -----------------------------------------------------------------------------
+
+const void BTreeIndex::endProbe()
+{
+    if ( probePageNum != 0 ) {
+      PageId pageNo = probePageNum;
+      probePageNum = 0;
+      probePageData = NULL;
+      bufMgr->unPinPage(file, pageNo, false);
+    }
 }
 
+}
@@ -11,6 +11,7 @@
 #include <string>
 #include "string.h"
 #include <sstream>
+#include <vector>
 
 #include "types.h"
 #include "page.h"
@@ -21,66 +22,83 @@ namespace badgerdb
 {
 
 /**
- * @brief Datatype enumeration type.
+ * @brief Size of String key.
  */
-enum Datatype
-{
-	INTEGER = 0,
-	DOUBLE = 1,
-	STRING = 2
-};
+const  int STRINGSIZE = 10;
 
 /**
- * @brief Scan operations enumeration. Passed to BTreeIndex::startScan() method.
+ * @brief Number of key slots in B+Tree nodes of each key type, for an index
+ * file whose pages are PAGE_SIZE bytes.
  */
-enum Operator
-{ 
-	LT, 	/* Less Than */
-	LTE,	/* Less Than or Equal to */
-	GTE,	/* Greater Than or Equal to */
-	GT		/* Greater Than */
-};
+template <std::size_t PAGE_SIZE>
+struct NodeSize
+{
+  /**
+   * @brief Number of key slots in B+Tree leaf for INTEGER key.
+   */
+  //                                         sibling,parent ptr     size               key               rid
+  static const int INTLEAF = ( PAGE_SIZE - 2*sizeof( PageId )  - sizeof(int )) / ( sizeof( int ) + sizeof( RecordId ) );
 
-/**
- * @brief Size of String key.
- */
-const  int STRINGSIZE = 10;
+  /**
+   * @brief Number of key slots in B+Tree leaf for DOUBLE key.
+   */
+  //                                            parent,sibling ptr    size                 key               rid
+  static const int DOUBLELEAF = ( PAGE_SIZE - 2*sizeof( PageId ) - sizeof(int) ) / ( sizeof( double ) + sizeof( RecordId ) );
+
+  /**
+   * @brief Number of key slots in B+Tree leaf for STRING key.
+   */
+  //                                           parent,sibling ptr      size                   key                      rid
+  static const int STRINGLEAF = ( PAGE_SIZE - 2*sizeof( PageId ) - sizeof(int) ) / ( STRINGSIZE * sizeof(char) + sizeof( RecordId ) );
+
+  /**
+   * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
+   */
+  //                                                level     parent pageNo        parent            size          key       pageNo
+  static const int INTNONLEAF = ( PAGE_SIZE - sizeof( int ) /*- sizeof( PageId )*/ - sizeof(PageId) - sizeof(int) ) / ( sizeof( int ) + sizeof( PageId ) );
+
+  /**
+   * @brief Number of key slots in B+Tree non-leaf for DOUBLE key.
+   */
+  //                                                   level        parent pageNo     parent            size                   key            pageNo   -1 due to structure padding
+  static const int DOUBLENONLEAF = (( PAGE_SIZE - sizeof( int ) /*- sizeof( PageId )*/- sizeof(PageId) - sizeof(int)) / ( sizeof( double ) + sizeof( PageId ) )) - 1;
+
+  /**
+   * @brief Number of key slots in B+Tree non-leaf for STRING key.
+   */
+  //                                                   level        parent pageNo    parent            size                key                   pageNo
+  static const int STRINGNONLEAF = ( PAGE_SIZE - sizeof( int ) /*- sizeof( PageId )*/- sizeof(PageId) - sizeof(int)) / ( STRINGSIZE * sizeof(char) + sizeof( PageId ) );
+};
 
 /**
  * @brief Number of key slots in B+Tree leaf for INTEGER key.
  */
-//                                          sibling,parent ptr     size               key               rid
-const  int INTARRAYLEAFSIZE = ( Page::SIZE - 2*sizeof( PageId )  - sizeof(int )) / ( sizeof( int ) + sizeof( RecordId ) );
+const  int INTARRAYLEAFSIZE = NodeSize<Page::DEFAULT_SIZE>::INTLEAF;
 
 /**
  * @brief Number of key slots in B+Tree leaf for DOUBLE key.
  */
-//                                              parent,sibling ptr    size                 key               rid
-const  int DOUBLEARRAYLEAFSIZE = ( Page::SIZE - 2*sizeof( PageId ) - sizeof(int) ) / ( sizeof( double ) + sizeof( RecordId ) );
+const  int DOUBLEARRAYLEAFSIZE = NodeSize<Page::DEFAULT_SIZE>::DOUBLELEAF;
 
 /**
  * @brief Number of key slots in B+Tree leaf for STRING key.
  */
-//                                             parent,sibling ptr      size                   key                      rid
-const  int STRINGARRAYLEAFSIZE = ( Page::SIZE - 2*sizeof( PageId ) - sizeof(int) ) / ( STRINGSIZE * sizeof(char) + sizeof( RecordId ) );
+const  int STRINGARRAYLEAFSIZE = NodeSize<Page::DEFAULT_SIZE>::STRINGLEAF;
 
 /**
  * @brief Number of key slots in B+Tree non-leaf for INTEGER key.
  */
-//                                                     level     parent pageNo        parent            size          key       pageNo
-const  int INTARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) /*- sizeof( PageId )*/ - sizeof(PageId) - sizeof(int) ) / ( sizeof( int ) + sizeof( PageId ) );
+const  int INTARRAYNONLEAFSIZE = NodeSize<Page::DEFAULT_SIZE>::INTNONLEAF;
 
 /**
  * @brief Number of key slots in B+Tree leaf for DOUBLE key.
  */
-//                                                        level        parent pageNo     parent            size                   key            pageNo   -1 due to structure padding
-const  int DOUBLEARRAYNONLEAFSIZE = (( Page::SIZE - sizeof( int ) /*- sizeof( PageId )*/- sizeof(PageId) - sizeof(int)) / ( sizeof( double ) + sizeof( PageId ) )) - 1;
+const  int DOUBLEARRAYNONLEAFSIZE = NodeSize<Page::DEFAULT_SIZE>::DOUBLENONLEAF;
 
 /**
  * @brief Number of key slots in B+Tree leaf for STRING key.
  */
-//                                                        level        parent pageNo    parent            size                key                   pageNo
-const  int STRINGARRAYNONLEAFSIZE = ( Page::SIZE - sizeof( int ) /*- sizeof( PageId )*/- sizeof(PageId) - sizeof(int)) / ( STRINGSIZE * sizeof(char) + sizeof( PageId ) );
+const  int STRINGARRAYNONLEAFSIZE = NodeSize<Page::DEFAULT_SIZE>::STRINGNONLEAF;
 
 /**
  * @brief Structure to store a key-rid pair. It is used to pass the pair to 
@@ -174,7 +192,8 @@ level are just above the leaf nodes. Otherwise set to 0.
 /**
  * @brief Structure for all non-leaf nodes when the key is of INTEGER type.
 */
-struct NonLeafNodeInt{
+template <std::size_t PAGE_SIZE>
+struct NonLeafNodeIntOf{
   /**
    * Level of the node in the tree.
    */
@@ -188,19 +207,21 @@ struct NonLeafNodeInt{
   /**
    * Stores keys.
    */
-	int keyArray[ INTARRAYNONLEAFSIZE ];
+	int keyArray[ NodeSize<PAGE_SIZE>::INTNONLEAF ];
 
   /**
    * Stores page numbers of child pages which themselves are other non-leaf/leaf
    * nodes in the tree.
    */
-	PageId pageNoArray[ INTARRAYNONLEAFSIZE + 1 ];
+	PageId pageNoArray[ NodeSize<PAGE_SIZE>::INTNONLEAF + 1 ];
 };
+typedef NonLeafNodeIntOf<Page::DEFAULT_SIZE> NonLeafNodeInt;
 
 /**
  * @brief Structure for all non-leaf nodes when the key is of DOUBLE type.
 */
-struct NonLeafNodeDouble{
+template <std::size_t PAGE_SIZE>
+struct NonLeafNodeDoubleOf{
   /**
    * Level of the node in the tree.
    */
@@ -214,19 +235,21 @@ struct NonLeafNodeDouble{
   /**
    * Stores keys.
    */
-	double keyArray[ DOUBLEARRAYNONLEAFSIZE ];
+	double keyArray[ NodeSize<PAGE_SIZE>::DOUBLENONLEAF ];
 
   /**
    * Stores page numbers of child pages which themselves are other non-leaf/leaf
    * nodes in the tree.
    */
-	PageId pageNoArray[ DOUBLEARRAYNONLEAFSIZE + 1 ];
+	PageId pageNoArray[ NodeSize<PAGE_SIZE>::DOUBLENONLEAF + 1 ];
 };
+typedef NonLeafNodeDoubleOf<Page::DEFAULT_SIZE> NonLeafNodeDouble;
 
 /**
  * @brief Structure for all non-leaf nodes when the key is of STRING type.
 */
-struct NonLeafNodeString{
+template <std::size_t PAGE_SIZE>
+struct NonLeafNodeStringOf{
   /**
    * Level of the node in the tree.
    */
@@ -240,19 +263,21 @@ struct NonLeafNodeString{
   /**
    * Stores keys.
    */
-	char keyArray[ STRINGARRAYNONLEAFSIZE ][ STRINGSIZE ];
+	char keyArray[ NodeSize<PAGE_SIZE>::STRINGNONLEAF ][ STRINGSIZE ];
 
   /**
    * Stores page numbers of child pages which themselves are other non-leaf/leaf
    * nodes in the tree.
    */
-	PageId pageNoArray[ STRINGARRAYNONLEAFSIZE + 1 ];
+	PageId pageNoArray[ NodeSize<PAGE_SIZE>::STRINGNONLEAF + 1 ];
 };
+typedef NonLeafNodeStringOf<Page::DEFAULT_SIZE> NonLeafNodeString;
 
 /**
  * @brief Structure for all leaf nodes when the key is of INTEGER type.
 */
-struct LeafNodeInt{
+template <std::size_t PAGE_SIZE>
+struct LeafNodeIntOf{
 
   /**
    * Number of entries in this node
@@ -263,12 +288,12 @@ struct LeafNodeInt{
   /**
    * Stores keys.
    */
-	int keyArray[ INTARRAYLEAFSIZE ];
+	int keyArray[ NodeSize<PAGE_SIZE>::INTLEAF ];
 
   /**
    * Stores RecordIds.
    */
-	RecordId ridArray[ INTARRAYLEAFSIZE ];
+	RecordId ridArray[ NodeSize<PAGE_SIZE>::INTLEAF ];
 
   /**
    * Page number of the leaf on the right side.
@@ -277,11 +302,13 @@ struct LeafNodeInt{
    */
 	PageId rightSibPageNo;
 };
+typedef LeafNodeIntOf<Page::DEFAULT_SIZE> LeafNodeInt;
 
 /**
  * @brief Structure for all leaf nodes when the key is of DOUBLE type.
 */
-struct LeafNodeDouble{
+template <std::size_t PAGE_SIZE>
+struct LeafNodeDoubleOf{
 
   /**
    * Number of entries in this node
@@ -291,12 +318,12 @@ struct LeafNodeDouble{
   /**
    * Stores keys.
    */
-	double keyArray[ DOUBLEARRAYLEAFSIZE ];
+	double keyArray[ NodeSize<PAGE_SIZE>::DOUBLELEAF ];
 
   /**
    * Stores RecordIds.
    */
-	RecordId ridArray[ DOUBLEARRAYLEAFSIZE ];
+	RecordId ridArray[ NodeSize<PAGE_SIZE>::DOUBLELEAF ];
 
   /**
    * Page number of the leaf on the right side.
@@ -305,11 +332,13 @@ struct LeafNodeDouble{
    */
 	PageId rightSibPageNo;
 };
+typedef LeafNodeDoubleOf<Page::DEFAULT_SIZE> LeafNodeDouble;
 
 /**
  * @brief Structure for all leaf nodes when the key is of STRING type.
 */
-struct LeafNodeString{
+template <std::size_t PAGE_SIZE>
+struct LeafNodeStringOf{
 
   /**
    * Number of entries in this node
@@ -319,12 +348,12 @@ struct LeafNodeString{
   /**
    * Stores keys.
    */
-	char keyArray[ STRINGARRAYLEAFSIZE ][ STRINGSIZE ];
+	char keyArray[ NodeSize<PAGE_SIZE>::STRINGLEAF ][ STRINGSIZE ];
 
   /**
    * Stores RecordIds.
    */
-	RecordId ridArray[ STRINGARRAYLEAFSIZE ];
+	RecordId ridArray[ NodeSize<PAGE_SIZE>::STRINGLEAF ];
 
   /**
    * Page number of the leaf on the right side.
@@ -333,6 +362,7 @@ struct LeafNodeString{
    */
 	PageId rightSibPageNo;
 };
+typedef LeafNodeStringOf<Page::DEFAULT_SIZE> LeafNodeString;
 
 /**
  * @brief BTreeIndex class. It implements a B+ Tree index on a single attribute
@@ -449,6 +479,24 @@ class BTreeIndex {
     Operator	highOp;
 
 
+	// MEMBERS SPECIFIC TO PROBING
+
+  /**
+   * Page number of the leaf the last probe ended on, kept pinned; 0 if none.
+   */
+	PageId	probePageNum;
+
+  /**
+   * The leaf the last probe ended on.
+   */
+	Page		*probePageData;
+
+  /**
+   * Number of probes that descended from the root.
+   */
+	std::size_t	probeDescents;
+
+
     /**
      * Build the intial BTree from given relation
      * @param relationName Name of the file that stores the relation
@@ -456,6 +504,85 @@ class BTreeIndex {
     const void buildBTree(const std::string & relationName);
 
 
+    /**
+     * Set leafOccupancy and nodeOccupancy for the key type, using the node
+     * layouts of an index file with PAGE_SIZE byte pages.
+     */
+    template <std::size_t PAGE_SIZE>
+      const void setOccupancy();
+
+
+    /**
+     * Construct an empty root leaf node on the given page, using the node
+     * layouts of an index file with PAGE_SIZE byte pages.
+     *
+     * @param rootPage page to construct the root on
+     */
+    template <std::size_t PAGE_SIZE>
+      const void initRootNode(Page *rootPage);
+
+
+    /**
+     * insertEntry for an index file with PAGE_SIZE byte pages.
+     */
+    template <std::size_t PAGE_SIZE>
+      const void insertEntrySized(const void* key, const RecordId rid);
+
+
+    /**
+     * deleteEntry for an index file with PAGE_SIZE byte pages.
+     */
+    template <std::size_t PAGE_SIZE>
+      const void deleteEntrySized(const void* key);
+
+
+    /**
+     * printTree for an index file with PAGE_SIZE byte pages.
+     */
+    template <std::size_t PAGE_SIZE>
+      const void printTreeSized();
+
+
+    /**
+     * startScan for an index file with PAGE_SIZE byte pages, after the scan
+     * range has been validated and stored.
+     */
+    template <std::size_t PAGE_SIZE>
+      const void startScanSized();
+
+
+    /**
+     * scanNext for an index file with PAGE_SIZE byte pages.
+     */
+    template <std::size_t PAGE_SIZE>
+      const void scanNextSized(RecordId& outRid);
+
+
+    /**
+     * probe for an index file with PAGE_SIZE byte pages.
+     */
+    template <std::size_t PAGE_SIZE>
+      const void probeSized(const void* key, std::vector<RecordId>& outRids);
+
+
+    /**
+     * generic probe, use c++ template
+     *
+     * @param key     key to look up
+     * @param outRids record ids of the entries equal to key are appended here
+     */
+    template<class T, class T_NonLeafNode, class T_LeafNode>
+      const void probeHelper(T & key, std::vector<RecordId>& outRids);
+
+
+    /**
+     * Unpin the probe leaf, if any, and pin the given leaf in its place.
+     *
+     * @param pageNo page number of the leaf
+     */
+    const void moveProbeLeaf(PageId pageNo);
+
+
     /**
      * print the whole tree
      */
@@ -646,10 +773,25 @@ class BTreeIndex {
      * @param bufMgrIn		Buffer Manager Instance
      * @param attrByteOffset  Offset of attribute, over which index is to be built, in the record
      * @param attrType		Datatype of attribute over which index is built
+     * @param pageSize		Page size of the index file if it is created. Smaller
+     *                    pages give a smaller fanout, larger ones longer runs
+     *                    of keys for range scans. Ignored when the index
+     *                    file already exists; its own page size is used.
+     * @param compressed	Whether to store the pages of the index file compressed
+     *                    if it is created (see BlobFile).  Ignored when the index
+     *                    file already exists.
+     * @param stripes		Names of stripe files to deal the pages of the index
+     *                    file out over if it is created, one page at a time
+     *                    (see StripedFile); none to keep them in one file.
+     *                    Striped pages are not compressed.  Ignored when the
+     *                    index file already exists.
      * @throws  BadIndexInfoException     If the index file already exists for the corresponding attribute, but values in metapage(relationName, attribute byte offset, attribute type etc.) do not match with values received through constructor parameters.
+     * @throws  BadPageSizeException      If pageSize is not a supported page size.
      */
     BTreeIndex(const std::string & relationName, std::string & outIndexName,
-        BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType);
+        BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType,
+        const std::size_t pageSize = Page::DEFAULT_SIZE, const bool compressed = false,
+        const std::vector<std::string> & stripes = std::vector<std::string>());
 
 
     /**
@@ -733,6 +875,33 @@ class BTreeIndex {
 	 * @throws ScanNotInitializedException If no scan has been initialized.
 	**/
 	const void endScan();
+
+
+  /**
+	 * Look up the entries whose key equals the given key.
+	 * The leaf a probe ends on stays pinned, so a probe for a larger key first
+	 * tries that leaf and its right sibling before descending from the root;
+	 * probing keys in ascending order usually reads one leaf per probe.
+	 * Probing does not affect a running scan.  The index may be changed
+	 * between probes, which releases the leaf.
+   * @param key	Key to look up, pointer to integer / double / char string
+   * @param outRids	Record ids of the entries found are appended to this
+   * @return	Number of entries found
+	**/
+	const std::size_t probe(const void* key, std::vector<RecordId>& outRids);
+
+
+  /**
+	 * Unpin the leaf kept by the last probe, if any.
+	**/
+	const void endProbe();
+
+
+  /**
+	 * Return the number of probes so far that descended from the root rather
+	 * than reusing the last leaf.
+	**/
+	const std::size_t getProbeDescents() const { return probeDescents; }
 	
 };
 
@@ -5,8 +5,10 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <cstring>
 #include <memory>
 #include <iostream>
+#include <set>
 #include "buffer.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
@@ -21,7 +23,7 @@ namespace badgerdb {
 //----------------------------------------
 
 BufMgr::BufMgr(std::uint32_t bufs)
-	: numBufs(bufs) {
+	: numBufs(bufs), log(NULL) {
 	bufDescTable = new BufDesc[bufs];
 
   for (FrameId i = 0; i < bufs; i++) 
@@ -30,7 +32,8 @@ BufMgr::BufMgr(std::uint32_t bufs)
   	bufDescTable[i].valid = false;
   }
 
-  bufPool = new Page[bufs];
+  bufPool = new PageBuffer[bufs];
+  frameSizes = new std::size_t[bufs]();
 
   int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
   hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
@@ -46,12 +49,13 @@ BufMgr::~BufMgr() {
   	BufDesc* tmpbuf = &bufDescTable[i];
   	if (tmpbuf->valid == true && tmpbuf->dirty == true)
 		{
-			tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
+			writeFrame(i);
   	}
   }
 
   delete [] bufDescTable;
   delete [] bufPool;
+  delete [] frameSizes;
 }
 
 void BufMgr::allocBuf(FrameId & frame) 
@@ -105,8 +109,7 @@ void BufMgr::allocBuf(FrameId & frame)
   if (bufDescTable[clockHand].dirty)
   {
     bufStats.diskwrites++;
-    //status = bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo,
-    bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo, bufPool[clockHand]);
+    writeFrame(clockHand);
   }
 
 	//Reset all the BufDesc entry for the frame before returning the frame
@@ -116,44 +119,102 @@ void BufMgr::allocBuf(FrameId & frame)
   frame = clockHand;
 } // end allocBuf
 
+
+Page* BufMgr::frameFor(const FrameId frameNo, const File* file)
+{
+  const std::size_t pageSize = file->page_size();
+  if (frameSizes[frameNo] != pageSize)
+  {
+    bufPool[frameNo] = Page::allocate(pageSize);
+    frameSizes[frameNo] = pageSize;
+  }
+  return bufPool[frameNo].get();
+}
+
+void BufMgr::writeFrame(const FrameId frameNo)
+{
+  BufDesc* tmpbuf = &bufDescTable[frameNo];
+
+  // write-ahead rule: the log records of the page's changes reach the disk
+  // before the page does
+  if (log != NULL && tmpbuf->lsn != LogManager::INVALID_LSN)
+  {
+    log->flush(tmpbuf->lsn);
+  }
+  tmpbuf->file->writePage(tmpbuf->pageNo, *bufPool[frameNo]);
+}
+
 	
 void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 {
+  std::unique_lock<std::mutex> lock(latch);
+
   // check to see if it is already in the buffer pool
   // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
   FrameId frameNo = 0;
-	try
-	{
-  	hashTable->lookup(file, pageNo, frameNo);
+  for (;;)
+  {
+    try
+    {
+      hashTable->lookup(file, pageNo, frameNo);
+    }
+    catch(HashNotFoundException e) //not in the buffer pool, must allocate a new page
+    {
+      break;
+    }
+
+    // another thread is reading the page in; once it is done the frame may
+    // hold the page or, if the read failed, be gone from the hash table
+    if (bufDescTable[frameNo].loading)
+    {
+      loaded.wait(lock);
+      continue;
+    }
 
     // set the referenced bit
     bufDescTable[frameNo].refbit = true;
     bufDescTable[frameNo].pinCnt++;
-    page = &bufPool[frameNo];
+    page = bufPool[frameNo].get();
+    return;
   }
-  catch(HashNotFoundException e) //not in the buffer pool, must allocate a new page
-  {
-    // alloc a new frame
-    allocBuf(frameNo);
 
-    // read the page into the new frame
-    bufStats.diskreads++;
-    //status = file->readPage(pageNo, &bufPool[frameNo]);
-    bufPool[frameNo] = file->readPage(pageNo);
+  // alloc a new frame
+  allocBuf(frameNo);
 
-    // set up the entry properly
-    bufDescTable[frameNo].Set(file, pageNo);
-    page = &bufPool[frameNo];
+  // set up the entry properly; the frame is pinned, so it stays ours while
+  // the page is read without the latch
+  Page* frame = frameFor(frameNo, file);
+  bufDescTable[frameNo].Set(file, pageNo);
+  bufDescTable[frameNo].loading = true;
+  hashTable->insert(file, pageNo, frameNo);
+  bufStats.diskreads++;
 
-    // insert in the hash table
-    hashTable->insert(file, pageNo, frameNo);
+  // read the page straight into the new frame
+  lock.unlock();
+  try
+  {
+    file->readPageInto(pageNo, frame);
   }
+  catch (...)
+  {
+    lock.lock();
+    hashTable->remove(file, pageNo);
+    bufDescTable[frameNo].Clear();
+    loaded.notify_all();
+    throw;
+  }
+  lock.lock();
+  bufDescTable[frameNo].loading = false;
+  loaded.notify_all();
+  page = frame;
 }
 
 
 void BufMgr::unPinPage(File* file, const PageId pageNo, 
 			     const bool dirty) 
 {
+  std::lock_guard<std::mutex> guard(latch);
+
   // lookup in hashtable
   FrameId frameNo = 0;
   hashTable->lookup(file, pageNo, frameNo);
@@ -170,6 +231,8 @@ void BufMgr::unPinPage(File* file, const PageId pageNo,
 
 void BufMgr::flushFile(const File* file) 
 {
+  std::lock_guard<std::mutex> guard(latch);
+
   for (std::uint32_t i = 0; i < numBufs; i++)
 	{
   	BufDesc* tmpbuf = &(bufDescTable[i]);
@@ -180,8 +243,7 @@ void BufMgr::flushFile(const File* file)
 
 	    if (tmpbuf->dirty == true)
 			{
-				//if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
-				tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
+				writeFrame(i);
 				tmpbuf->dirty = false;
     	}
 
@@ -193,17 +255,91 @@ void BufMgr::flushFile(const File* file)
   }
 }
 
+LogSequenceNumber BufMgr::logUpdate(File* file, const PageId pageNo,
+                                    const std::size_t offset,
+                                    const std::size_t length)
+{
+  std::lock_guard<std::mutex> guard(latch);
+
+  FrameId frameNo = 0;
+  hashTable->lookup(file, pageNo, frameNo);
+
+  BufDesc* tmpbuf = &bufDescTable[frameNo];
+  if (tmpbuf->pinCnt == 0)
+  {
+  	throw PageNotPinnedException(file->filename(), pageNo, frameNo);
+  }
+
+  tmpbuf->dirty = true;
+  if (log != NULL)
+  {
+    const char* image = reinterpret_cast<const char*>(bufPool[frameNo].get());
+    tmpbuf->lsn = log->appendChange(file->filename(), pageNo, offset,
+                                    image + offset, length);
+  }
+  return tmpbuf->lsn;
+}
+
+void BufMgr::commit()
+{
+  if (log != NULL)
+  {
+    log->flush();
+  }
+}
+
+void BufMgr::checkpoint()
+{
+  std::lock_guard<std::mutex> guard(latch);
+
+  std::set<File*> written;
+  for (std::uint32_t i = 0; i < numBufs; i++)
+	{
+  	BufDesc* tmpbuf = &(bufDescTable[i]);
+  	if (tmpbuf->valid == true && tmpbuf->dirty == true)
+		{
+      bufStats.diskwrites++;
+			writeFrame(i);
+			tmpbuf->dirty = false;
+			tmpbuf->lsn = LogManager::INVALID_LSN;
+      written.insert(tmpbuf->file);
+  	}
+  }
+
+  // the pages must be on disk before the log records that could redo them
+  // are dropped
+  for (std::set<File*>::iterator it = written.begin(); it != written.end(); ++it)
+  {
+    (*it)->sync();
+  }
+  if (log != NULL)
+  {
+    log->truncate();
+  }
+}
+
 void BufMgr::disposePage(File* file, const PageId pageNo) 
 {
+  std::lock_guard<std::mutex> guard(latch);
+
 	//Deallocate from file altogether
   //See if it is in the buffer pool
   FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  try
+  {
+    hashTable->lookup(file, pageNo, frameNo);
 
-	// clear the page
-	bufDescTable[frameNo].Clear();
+    if (bufDescTable[frameNo].pinCnt > 0)
+      throw PagePinnedException(file->filename(), pageNo, frameNo);
 
-	hashTable->remove(file, pageNo);
+    // clear the page; its contents are discarded even if dirty
+    bufDescTable[frameNo].Clear();
+    hashTable->remove(file, pageNo);
+  }
+  catch (const HashNotFoundException&)
+  {
+    // not in the buffer pool, nothing to drop
+  }
 
   // deallocate it in the file	
   file->deletePage(pageNo);
@@ -212,17 +348,17 @@ void BufMgr::disposePage(File* file, const PageId pageNo)
 
 void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
 {
+  std::lock_guard<std::mutex> guard(latch);
+
   FrameId frameNo;
 
   // alloc a new frame
   allocBuf(frameNo);
 
-  // allocate a new page in the file
-	//std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
-  bufPool[frameNo] = file->allocatePage(pageNo);
-
-
-  page = &bufPool[frameNo];
+  // allocate a new page in the file; only its page size bytes are copied
+  page = frameFor(frameNo, file);
+  const Page newPage = file->allocatePage(pageNo);
+  memcpy(page, &newPage, file->page_size());
 
   // set up the entry properly
   bufDescTable[frameNo].Set(file, pageNo);
@@ -233,6 +369,8 @@ void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page)
 
 void BufMgr::printSelf(void) 
 {
+  std::lock_guard<std::mutex> guard(latch);
+
   BufDesc* tmpbuf;
 	int validFrames = 0;
   
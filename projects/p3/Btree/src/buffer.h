@@ -9,7 +9,10 @@
 
 #include "file.h"
 #include "bufHashTbl.h"
+#include "log_manager.h"
+#include <condition_variable>
 #include <iostream>
+#include <mutex>
 
 namespace badgerdb {
 
@@ -61,6 +64,17 @@ class BufDesc {
 	 */
   bool refbit;
 
+	/**
+   * LSN of the last logged change to the page; the log must be durable up to
+   * it before the page is written back
+	 */
+  LogSequenceNumber lsn;
+
+	/**
+   * True while the page is being read into the frame
+	 */
+  bool loading;
+
 	/**
    * Initialize buffer frame for a new user
 	 */
@@ -72,6 +86,8 @@ class BufDesc {
     dirty = false;
     refbit = false;
 		valid = false;
+    lsn = LogManager::INVALID_LSN;
+    loading = false;
   };
 
 	/**
@@ -89,6 +105,8 @@ class BufDesc {
     dirty = false;
     valid = true;
     refbit = true;
+    lsn = LogManager::INVALID_LSN;
+    loading = false;
   }
 
   void Print()
@@ -157,6 +175,10 @@ struct BufStats
 
 /**
 * @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+*
+* The buffer manager may be shared by several threads.  A latch guards the frame table and hash table;
+* it is released while a page is read from disk, and threads asking for the page meanwhile wait for the
+* read to finish rather than reading it again.
 */
 class BufMgr 
 {
@@ -187,6 +209,21 @@ class BufMgr
   BufStats bufStats;
 
 	/**
+   * Write-ahead log the changes to pages are logged in; NULL if none
+	 */
+  LogManager* log;
+
+	/**
+   * Guards the frame table, the hash table and the statistics
+	 */
+  std::mutex latch;
+
+	/**
+   * Signalled when a page has been read into its frame
+	 */
+  std::condition_variable loaded;
+
+	/**
 	 * Allocate a free frame.  
 	 *
 	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
@@ -195,6 +232,29 @@ class BufMgr
   void allocBuf(FrameId & frame);
 
 	/**
+	 * Bytes of storage of each frame in 'bufPool'; 0 if it has none yet
+	 */
+  std::size_t* frameSizes;
+
+	/**
+	 * Returns the page of a frame about to hold a page of the given file,
+	 * first giving the frame storage for the file's page size if it has a
+	 * different size.
+	 *
+	 * @param frameNo		Frame to hold the page
+	 * @param file			File the page belongs to
+	 */
+  Page* frameFor(const FrameId frameNo, const File* file);
+
+	/**
+	 * Writes the page in the given frame back to its file.  If changes to the page
+	 * were logged, the log is first made durable up to the page's LSN.
+	 *
+	 * @param frameNo		Frame holding a dirty page
+	 */
+  void writeFrame(const FrameId frameNo);
+
+	/**
    * Advance clock to next frame in the buffer pool
 	 */
   void advanceClock()
@@ -205,9 +265,10 @@ class BufMgr
 
  public:
 	/**
-   * Actual buffer pool from which frames are allocated
+   * Actual buffer pool from which frames are allocated.  A frame only has
+   * storage for the page size of the file it last held, none at first.
 	 */
-  Page* bufPool;
+  PageBuffer* bufPool;
 
 	/**
    * Constructor of BufMgr class
@@ -267,10 +328,59 @@ class BufMgr
 	 *
 	 * @param file   	File object
 	 * @param PageNo  Page number
+   * @throws  PagePinnedException If the page is pinned in the buffer pool
 	 */
   void disposePage(File* file, const PageId PageNo);
 
 	/**
+	 * Attaches a write-ahead log to the buffer pool.  Changes to pinned pages
+	 * recorded through logUpdate() go to the log, and a page with logged changes is
+	 * only written back once the log is durable up to its last change.  The log must
+	 * outlive the buffer manager.
+	 *
+	 * @param logMgr	Log to attach, or NULL to detach the current one
+	 */
+  void attachLog(LogManager* logMgr)
+  {
+		log = logMgr;
+  }
+
+	/**
+	 * Logs a change made to a pinned page and marks the page dirty.  The bytes
+	 * logged are read from the page in the buffer pool, so the change must already
+	 * have been made.  Without an attached log the page is only marked dirty.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 * @param offset	Offset of the changed bytes in the page
+	 * @param length	Number of changed bytes
+	 * @return	LSN of the change record
+   * @throws  PageNotPinnedException If the page is not pinned
+	 */
+  LogSequenceNumber logUpdate(File* file, const PageId PageNo,
+                              const std::size_t offset, const std::size_t length);
+
+	/**
+	 * Makes every change logged so far durable.  Calls from several threads are
+	 * batched into one log write (see LogManager::flush()).
+	 */
+  void commit();
+
+	/**
+	 * Writes every dirty page back to its file, forces the files to disk and
+	 * truncates the log.  Pinned pages stay in the buffer pool.
+	 */
+  void checkpoint();
+
+	/**
+   * Get the number of frames in the buffer pool
+	 */
+  std::uint32_t getNumBufs() const
+  {
+		return numBufs;
+  }
+
+	/**
    * Print member variable values. 
 	 */
   void  printSelf();
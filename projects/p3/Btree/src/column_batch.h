@@ -0,0 +1,252 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Type of a column of a ColumnBatch.
+ */
+struct ColumnType {
+  /**
+   * Type of the values.
+   */
+  Datatype type;
+
+  /**
+   * Length in bytes of a value.
+   */
+  std::uint16_t length;
+};
+
+/**
+ * Types of the columns of a ColumnBatch, in order.
+ */
+typedef std::vector<ColumnType> BatchSchema;
+
+/**
+ * @brief Up to CAPACITY rows of fixed-length values, stored by column.
+ *
+ * The values of a column lie side by side in one array, so an operator
+ * works on a column with a tight loop over an array instead of a call per
+ * record.  Each row also keeps the RecordId of the record it came from.
+ *
+ * A batch may carry a selection vector: the indexes of the rows that are
+ * still part of the result, in increasing order.  A filter narrows the
+ * selection instead of moving the surviving values, so later operators see
+ * count() rows, the k-th of which is row(k).
+ */
+class ColumnBatch {
+ public:
+  /**
+   * Most rows a batch holds.
+   */
+  static const std::size_t CAPACITY = 1024;
+
+  /**
+   * Constructs an empty batch with columns of the given types.
+   *
+   * @param schema  Types of the columns.
+   */
+  explicit ColumnBatch(const BatchSchema& schema)
+      : schema_(schema),
+        columns_(schema.size()),
+        rids_(CAPACITY),
+        selection_(CAPACITY),
+        size_(0),
+        selected_(0),
+        selective_(false) {
+    for (std::size_t c = 0; c < schema_.size(); ++c) {
+      columns_[c].resize(CAPACITY * schema_[c].length);
+    }
+  }
+
+  /**
+   * Returns the types of the columns.
+   */
+  const BatchSchema& schema() const { return schema_; }
+
+  /**
+   * Returns the number of columns.
+   */
+  std::size_t num_columns() const { return schema_.size(); }
+
+  /**
+   * Returns the number of rows filled, selected or not.
+   */
+  std::size_t size() const { return size_; }
+
+  /**
+   * Sets the number of rows filled and selects all of them.
+   */
+  void setSize(const std::size_t size) {
+    size_ = size;
+    selective_ = false;
+  }
+
+  /**
+   * Empties the batch.
+   */
+  void clear() { setSize(0); }
+
+  /**
+   * Returns the number of rows selected.
+   */
+  std::size_t count() const { return selective_ ? selected_ : size_; }
+
+  /**
+   * Returns the index of the k-th selected row.
+   */
+  std::size_t row(const std::size_t k) const {
+    return selective_ ? selection_[k] : k;
+  }
+
+  /**
+   * Returns true if only the rows of the selection vector are selected.
+   */
+  bool selective() const { return selective_; }
+
+  /**
+   * Returns the selection vector, which has room for CAPACITY rows.  It is
+   * only meaningful once set with setSelection().
+   */
+  std::uint16_t* selection() { return selection_.data(); }
+  const std::uint16_t* selection() const { return selection_.data(); }
+
+  /**
+   * Selects the first <count> rows of the selection vector.
+   */
+  void setSelection(const std::size_t count) {
+    selected_ = count;
+    selective_ = true;
+  }
+
+  /**
+   * Keeps <count> of the selected rows, starting at the first-th.
+   */
+  void keep(const std::size_t first, const std::size_t count) {
+    if (!selective_) {
+      for (std::size_t k = 0; k < count; ++k) {
+        selection_[k] = static_cast<std::uint16_t>(first + k);
+      }
+    } else if (first > 0) {
+      std::memmove(&selection_[0], &selection_[first],
+                   count * sizeof(std::uint16_t));
+    }
+    setSelection(count);
+  }
+
+  /**
+   * Returns the values of a column; value i starts length() * i bytes in.
+   */
+  char* column(const std::size_t c) { return columns_[c].data(); }
+  const char* column(const std::size_t c) const { return columns_[c].data(); }
+
+  /**
+   * Returns the values of a column as an array of T.
+   */
+  template <typename T>
+  T* values(const std::size_t c) {
+    return reinterpret_cast<T*>(column(c));
+  }
+  template <typename T>
+  const T* values(const std::size_t c) const {
+    return reinterpret_cast<const T*>(column(c));
+  }
+
+  /**
+   * Returns the first byte of the value of a column in a row.
+   */
+  const char* value(const std::size_t c, const std::size_t row) const {
+    return column(c) + row * schema_[c].length;
+  }
+
+  /**
+   * Returns the record IDs of the rows.
+   */
+  RecordId* rids() { return rids_.data(); }
+  const RecordId* rids() const { return rids_.data(); }
+
+  /**
+   * Moves the rows of another batch into this one without copying values:
+   * column k of this batch takes over column columns[k] of the other, whose
+   * type must match.  The other batch is left with scratch columns.
+   *
+   * @param from      Batch to take the rows from.
+   * @param columns   Column of from that each column of this batch takes.
+   */
+  void take(ColumnBatch& from, const std::vector<std::size_t>& columns) {
+    std::vector<bool> taken(from.num_columns(), false);
+    for (std::size_t k = 0; k < columns.size(); ++k) {
+      const std::size_t c = columns[k];
+      if (!taken[c]) {
+        columns_[k].swap(from.columns_[c]);
+        taken[c] = true;
+        continue;
+      }
+      // Already moved into an earlier column of this batch; copy it.
+      for (std::size_t j = 0; j < k; ++j) {
+        if (columns[j] == c) {
+          std::memcpy(column(k), column(j), from.size_ * schema_[k].length);
+          break;
+        }
+      }
+    }
+    rids_.swap(from.rids_);
+    selection_.swap(from.selection_);
+    size_ = from.size_;
+    selected_ = from.selected_;
+    selective_ = from.selective_;
+    from.clear();
+  }
+
+ private:
+  /**
+   * Types of the columns.
+   */
+  BatchSchema schema_;
+
+  /**
+   * Values of each column.
+   */
+  std::vector<std::vector<char> > columns_;
+
+  /**
+   * Record IDs of the rows.
+   */
+  std::vector<RecordId> rids_;
+
+  /**
+   * Indexes of the selected rows when selective_ is set.
+   */
+  std::vector<std::uint16_t> selection_;
+
+  /**
+   * Number of rows filled.
+   */
+  std::size_t size_;
+
+  /**
+   * Number of entries of selection_ in use.
+   */
+  std::size_t selected_;
+
+  /**
+   * True if only the rows in selection_ are selected.
+   */
+  bool selective_;
+};
+
+}
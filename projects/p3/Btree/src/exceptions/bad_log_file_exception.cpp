@@ -0,0 +1,24 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "bad_log_file_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+BadLogFileException::BadLogFileException(const std::string& file,
+                                         const std::string& reason)
+    : BadgerDbException(""),
+      filename_(file) {
+  std::stringstream ss;
+  ss << "Bad log file " << filename_ << ": " << reason;
+  message_.assign(ss.str());
+}
+
+}
@@ -0,0 +1,48 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a file opened as a write-ahead log
+ *        is not a log.
+ */
+class BadLogFileException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a bad log file exception for the given file.
+   *
+   * @param file    Name of the file.
+   * @param reason  Description of what is wrong with the file.
+   */
+  BadLogFileException(const std::string& file, const std::string& reason);
+
+  /**
+   * Destroys the exception.  Does nothing special; just included to make the
+   * compiler happy.
+   */
+  virtual ~BadLogFileException() throw() {}
+
+  /**
+   * Returns name of the file that caused this exception.
+   */
+  virtual const std::string& filename() const { return filename_; }
+
+ protected:
+  /**
+   * Name of file which caused this exception.
+   */
+  const std::string filename_;
+};
+
+}
@@ -0,0 +1,24 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "bad_page_format_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+BadPageFormatException::BadPageFormatException(const PageId page_num,
+                                               const std::string& reason)
+    : BadgerDbException(""),
+      page_number_(page_num) {
+  std::stringstream ss;
+  ss << "Bad format for page " << page_number_ << ": " << reason;
+  message_.assign(ss.str());
+}
+
+}
@@ -0,0 +1,26 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "bad_page_size_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+BadPageSizeException::BadPageSizeException(const std::string& file,
+                                           const std::size_t page_size)
+    : BadgerDbException(""),
+      filename_(file),
+      page_size_(page_size) {
+  std::stringstream ss;
+  ss << "Unsupported page size " << page_size_
+     << " for file '" << filename_ << "'";
+  message_.assign(ss.str());
+}
+
+}
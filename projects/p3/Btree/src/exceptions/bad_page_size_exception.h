@@ -0,0 +1,61 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a file is created with, or found to
+ *        have, a page size that this build cannot handle.
+ *
+ * Page sizes must be a power of two between Page::MIN_SIZE and Page::SIZE.
+ */
+class BadPageSizeException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a bad page size exception for the given file and page size.
+   *
+   * @param file        Name of file that the page size was requested for.
+   * @param page_size   Requested page size in bytes.
+   */
+  BadPageSizeException(const std::string& file, const std::size_t page_size);
+
+  /**
+   * Destroys the exception.  Does nothing special; just included to make the
+   * compiler happy.
+   */
+  virtual ~BadPageSizeException() throw() {}
+
+  /**
+   * Returns name of the file that caused this exception.
+   */
+  virtual const std::string& filename() const { return filename_; }
+
+  /**
+   * Returns the page size that caused this exception.
+   */
+  virtual std::size_t page_size() const { return page_size_; }
+
+ protected:
+  /**
+   * Name of file which caused this exception.
+   */
+  const std::string filename_;
+
+  /**
+   * Page size which caused this exception.
+   */
+  const std::size_t page_size_;
+};
+
+}
@@ -0,0 +1,24 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "bad_statistics_file_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+BadStatisticsFileException::BadStatisticsFileException(
+    const std::string& file, const std::string& reason)
+    : BadgerDbException(""),
+      filename_(file) {
+  std::stringstream ss;
+  ss << "Bad statistics file " << filename_ << ": " << reason;
+  message_.assign(ss.str());
+}
+
+}
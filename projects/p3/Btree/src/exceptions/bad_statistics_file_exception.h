@@ -0,0 +1,49 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a file read as table statistics
+ *        does not hold them.
+ */
+class BadStatisticsFileException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a bad statistics file exception for the given file.
+   *
+   * @param file    Name of the file.
+   * @param reason  Description of what is wrong with the file.
+   */
+  BadStatisticsFileException(const std::string& file,
+                             const std::string& reason);
+
+  /**
+   * Destroys the exception.  Does nothing special; just included to make the
+   * compiler happy.
+   */
+  virtual ~BadStatisticsFileException() throw() {}
+
+  /**
+   * Returns name of the file that caused this exception.
+   */
+  virtual const std::string& filename() const { return filename_; }
+
+ protected:
+  /**
+   * Name of file which caused this exception.
+   */
+  const std::string filename_;
+};
+
+}
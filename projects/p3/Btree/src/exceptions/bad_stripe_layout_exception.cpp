@@ -0,0 +1,24 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "bad_stripe_layout_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+BadStripeLayoutException::BadStripeLayoutException(const std::string& file,
+                                                   const std::string& reason)
+    : BadgerDbException(""),
+      filename_(file) {
+  std::stringstream ss;
+  ss << "Bad stripe layout for file '" << filename_ << "': " << reason;
+  message_.assign(ss.str());
+}
+
+}
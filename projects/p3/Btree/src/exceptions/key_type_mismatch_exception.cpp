@@ -0,0 +1,27 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "key_type_mismatch_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+KeyTypeMismatchException::KeyTypeMismatchException(const int first_type,
+                                                   const int first_length,
+                                                   const int second_type,
+                                                   const int second_length)
+    : BadgerDbException("") {
+  std::stringstream ss;
+  ss << "Join keys differ: type " << first_type << " of " << first_length
+     << " bytes against type " << second_type << " of " << second_length
+     << " bytes.";
+  message_.assign(ss.str());
+}
+
+}
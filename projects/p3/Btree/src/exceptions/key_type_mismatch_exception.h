@@ -0,0 +1,34 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when the key columns of a join do not
+ *        have the same type and length.
+ */
+class KeyTypeMismatchException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a key type mismatch exception for the given key columns.
+   *
+   * @param first_type    Type of the first key.
+   * @param first_length  Length in bytes of the first key.
+   * @param second_type   Type of the second key.
+   * @param second_length Length in bytes of the second key.
+   */
+  KeyTypeMismatchException(const int first_type, const int first_length,
+                           const int second_type, const int second_length);
+};
+
+}
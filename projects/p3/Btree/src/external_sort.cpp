@@ -0,0 +1,361 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "external_sort.h"
+
+#include <algorithm>
+#include <deque>
+#include <future>
+#include <sstream>
+#include <thread>
+
+#include "exceptions/file_exists_exception.h"
+#include "file.h"
+#include "filescan.h"
+#include "page.h"
+#include "relation_loader.h"
+#include "scan_predicate.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Records a scan returns at once.
+ */
+const std::size_t SCAN_BATCH = 64;
+
+/**
+ * Reads the records of a run in order, a page at a time.
+ */
+class RunReader {
+ public:
+  RunReader(const std::string& name, BufMgr* bufMgr)
+      : scan_(name, bufMgr),
+        count_(0),
+        position_(0) {
+    fill();
+  }
+
+  /**
+   * Returns true once every record has been read.
+   */
+  bool done() const { return position_ >= count_; }
+
+  /**
+   * Returns the current record; valid until advance() moves off its page.
+   */
+  const RecordView& current() const { return views_[position_]; }
+
+  /**
+   * Moves to the next record.
+   */
+  void advance() {
+    if (++position_ >= count_) {
+      fill();
+    }
+  }
+
+ private:
+  void fill() {
+    count_ = scan_.scanNextBatch(rids_, views_, SCAN_BATCH);
+    position_ = 0;
+  }
+
+  FileScan scan_;
+  RecordId rids_[SCAN_BATCH];
+  RecordView views_[SCAN_BATCH];
+  std::size_t count_;
+  std::size_t position_;
+};
+
+/**
+ * Tournament tree of k sources keeping the loser of each match.  Leaves
+ * k to 2k - 1 stand for the sources and every inner node holds the source that
+ * lost the match played there, so after the winner's source advances only the
+ * matches on its path to the root are replayed.
+ *
+ * less(a, b) must be true if source a's current item goes before source b's.
+ */
+template <typename Less>
+class LoserTree {
+ public:
+  LoserTree(const std::size_t k, const Less& less)
+      : k_(k),
+        less_(less),
+        losers_(k),
+        winner_(0) {
+    if (k_ > 0) {
+      winner_ = build(1);
+    }
+  }
+
+  /**
+   * Returns the source whose current item goes first.
+   */
+  std::size_t winner() const { return winner_; }
+
+  /**
+   * Plays the winner's path again once its source has advanced.
+   */
+  void replay() {
+    std::size_t source = winner_;
+    for (std::size_t node = (source + k_) / 2; node >= 1; node /= 2) {
+      if (less_(losers_[node], source)) {
+        std::swap(losers_[node], source);
+      }
+    }
+    winner_ = source;
+  }
+
+ private:
+  /**
+   * Plays the matches of the subtree at node and returns its winner.
+   */
+  std::size_t build(const std::size_t node) {
+    if (node >= k_) {
+      return node - k_;
+    }
+    const std::size_t a = build(2 * node);
+    const std::size_t b = build(2 * node + 1);
+    if (less_(b, a)) {
+      losers_[node] = a;
+      return b;
+    }
+    losers_[node] = b;
+    return a;
+  }
+
+  std::size_t k_;
+  Less less_;
+  std::vector<std::size_t> losers_;
+  std::size_t winner_;
+};
+
+/**
+ * Returns the name of the n-th run of a sort.
+ */
+std::string runName(const std::string& output, const std::size_t n) {
+  std::ostringstream name;
+  name << output << ".run." << n;
+  return name.str();
+}
+
+}
+
+const std::size_t ExternalSort::DEFAULT_MEMORY;
+
+ExternalSort::ExternalSort(BufMgr* bufMgr, const std::size_t key_offset,
+                           const Datatype key_type,
+                           const std::size_t key_length,
+                           const std::size_t memory_bytes,
+                           const std::size_t num_threads,
+                           const std::size_t max_frames)
+    : buf_mgr_(bufMgr),
+      key_offset_(key_offset),
+      key_type_(key_type),
+      memory_bytes_(std::max(memory_bytes, 2 * Page::DEFAULT_SIZE)),
+      num_threads_(num_threads),
+      num_runs_(0),
+      num_passes_(0) {
+  switch (key_type_) {
+    case INTEGER:
+      key_length_ = sizeof(int);
+      break;
+    case DOUBLE:
+      key_length_ = sizeof(double);
+      break;
+    default:
+      key_length_ = key_length;
+      break;
+  }
+  zero_key_.assign(key_length_, '\0');
+  if (num_threads_ == 0) {
+    num_threads_ = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  // One page of the budget and one pinned frame for each run being merged,
+  // one of each for the output.
+  const std::size_t frames =
+      max_frames == 0 ? buf_mgr_->getNumBufs() : max_frames;
+  const std::size_t pages =
+      std::min(memory_bytes_ / Page::DEFAULT_SIZE, frames);
+  fan_in_ = pages > 3 ? pages - 1 : 2;
+}
+
+bool ExternalSort::less(const char* a, const std::size_t a_length,
+                        const char* b, const std::size_t b_length) const {
+  return ScanPredicate::compare(key_type_, key(a, a_length), key(b, b_length),
+                                key_length_) < 0;
+}
+
+void ExternalSort::writeRun(const std::shared_ptr<Chunk>& chunk,
+                            const std::string& name) const {
+  const char* data = chunk->data.data();
+  std::stable_sort(chunk->entries.begin(), chunk->entries.end(),
+                   [this, data](const Chunk::Entry& a, const Chunk::Entry& b) {
+                     return less(data + a.offset, a.length, data + b.offset,
+                                 b.length);
+                   });
+  PageFile run(name, true /* create_new */);
+  RelationLoader loader(&run);
+  for (std::size_t i = 0; i < chunk->entries.size(); ++i) {
+    const Chunk::Entry& entry = chunk->entries[i];
+    loader.insertRecord(std::string(data + entry.offset, entry.length));
+  }
+  loader.flush();
+}
+
+void ExternalSort::merge(const std::vector<std::string>& runs,
+                         const std::string& output) const {
+  PageFile out(output, true /* create_new */);
+  RelationLoader loader(&out);
+  std::vector<std::unique_ptr<RunReader> > readers;
+  for (std::size_t i = 0; i < runs.size(); ++i) {
+    readers.push_back(
+        std::unique_ptr<RunReader>(new RunReader(runs[i], buf_mgr_)));
+  }
+
+  // An exhausted run loses every match; equal keys go to the earlier run, so
+  // records keep the order of the runs.
+  auto before = [this, &readers](const std::size_t a, const std::size_t b) {
+    if (readers[a]->done() || readers[b]->done()) {
+      return !readers[a]->done();
+    }
+    const RecordView& x = readers[a]->current();
+    const RecordView& y = readers[b]->current();
+    if (less(x.data, x.length, y.data, y.length)) {
+      return true;
+    }
+    return a < b && !less(y.data, y.length, x.data, x.length);
+  };
+  LoserTree<decltype(before)> tree(readers.size(), before);
+  while (!readers.empty() && !readers[tree.winner()]->done()) {
+    RunReader& reader = *readers[tree.winner()];
+    const RecordView& record = reader.current();
+    loader.insertRecord(std::string(record.data, record.length));
+    reader.advance();
+    tree.replay();
+  }
+  loader.flush();
+}
+
+void ExternalSort::sort(const std::string& input, const std::string& output) {
+  if (File::exists(output)) {
+    throw FileExistsException(output);
+  }
+  num_runs_ = 0;
+  num_passes_ = 0;
+
+  std::vector<std::string> runs;
+  std::size_t runsNamed = 0;
+  std::deque<std::future<void> > pending;
+  bool merging = false;
+  try {
+    // Run generation: up to num_threads_ chunks are being sorted and
+    // written while the next one is read, so each of them and the one being
+    // read gets a share of the budget.
+    const std::size_t chunkBytes = std::max<std::size_t>(
+        memory_bytes_ / (num_threads_ + 1), std::size_t(Page::DEFAULT_SIZE));
+    std::shared_ptr<Chunk> chunk(new Chunk);
+    chunk->data.reserve(chunkBytes);
+    auto writeChunk = [&]() {
+      if (pending.size() >= num_threads_) {
+        pending.front().get();
+        pending.pop_front();
+      }
+      const std::string name = runName(output, runsNamed++);
+      runs.push_back(name);
+      const std::shared_ptr<Chunk> full = chunk;
+      pending.push_back(std::async(std::launch::async, [this, full, name]() {
+        writeRun(full, name);
+      }));
+      chunk.reset(new Chunk);
+      chunk->data.reserve(chunkBytes);
+    };
+
+    {
+      FileScan scan(input, buf_mgr_);
+      RecordId rids[SCAN_BATCH];
+      RecordView views[SCAN_BATCH];
+      std::size_t count;
+      while ((count = scan.scanNextBatch(rids, views, SCAN_BATCH)) > 0) {
+        for (std::size_t k = 0; k < count; ++k) {
+          const std::size_t used = chunk->data.size() +
+              (chunk->entries.size() + 1) * sizeof(Chunk::Entry);
+          if (!chunk->entries.empty() &&
+              used + views[k].length > chunkBytes) {
+            writeChunk();
+          }
+          const Chunk::Entry entry = {
+              static_cast<std::uint32_t>(chunk->data.size()),
+              static_cast<std::uint32_t>(views[k].length)};
+          chunk->data.insert(chunk->data.end(), views[k].data,
+                             views[k].data + views[k].length);
+          chunk->entries.push_back(entry);
+        }
+      }
+    }
+    if (!chunk->entries.empty()) {
+      writeChunk();
+    }
+    while (!pending.empty()) {
+      pending.front().get();
+      pending.pop_front();
+    }
+    num_runs_ = runs.size();
+
+    // Merge groups of fan_in_ runs into longer ones until one pass can
+    // merge them all into the output.
+    while (runs.size() > fan_in_) {
+      std::vector<std::string> merged;
+      for (std::size_t i = 0; i < runs.size(); i += fan_in_) {
+        const std::vector<std::string> group(
+            runs.begin() + i,
+            runs.begin() + std::min(i + fan_in_, runs.size()));
+        if (group.size() == 1) {
+          merged.push_back(group[0]);
+          continue;
+        }
+        const std::string name = runName(output, runsNamed++);
+        merge(group, name);
+        merged.push_back(name);
+        for (std::size_t g = 0; g < group.size(); ++g) {
+          File::remove(group[g]);
+        }
+      }
+      runs.swap(merged);
+      ++num_passes_;
+    }
+    merging = true;
+    merge(runs, output);
+    merging = false;
+    ++num_passes_;
+    for (std::size_t i = 0; i < runs.size(); ++i) {
+      File::remove(runs[i]);
+    }
+  } catch (...) {
+    for (std::size_t i = 0; i < pending.size(); ++i) {
+      try {
+        pending[i].get();
+      } catch (...) {
+      }
+    }
+    for (std::size_t n = 0; n < runsNamed; ++n) {
+      const std::string name = runName(output, n);
+      if (File::exists(name)) {
+        File::remove(name);
+      }
+    }
+    // The output did not exist before the sort, so a partial one is ours.
+    if (merging && File::exists(output)) {
+      File::remove(output);
+    }
+    throw;
+  }
+}
+
+}
@@ -0,0 +1,161 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "buffer.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Sorts a relation of any size by one attribute within a fixed memory
+ *        budget.
+ *
+ * The relation is read in order through the buffer manager and cut into
+ * chunks that fit in a share of the budget.  Each full chunk is sorted and
+ * written as a run to a temporary PageFile by a thread of its own while the
+ * next chunk is read, so up to num_threads chunks are being sorted at once
+ * and the budget is split num_threads + 1 ways.
+ * The runs are then merged with a loser (tournament) tree: every record
+ * taken from the tree costs one comparison per level, log2(k) for k runs.
+ * A merge keeps one page of each of its runs pinned in the buffer pool, so
+ * it takes at most as many runs as there are pages in the budget and frames
+ * to spare; when there are more, groups of runs are merged into longer runs
+ * first.  Runs and output are read and written sequentially.
+ *
+ * The sort is stable: records with equal keys keep the order a FileScan of
+ * the input returns them in.  A record too short to hold the key sorts as if
+ * its key were all zero bytes.
+ */
+class ExternalSort {
+ public:
+  /**
+   * Memory budget used by default.
+   */
+  static const std::size_t DEFAULT_MEMORY = 16 * 1024 * 1024;
+
+  /**
+   * Constructs a sort of relations by the given key.
+   *
+   * @param bufMgr        Buffer manager to read relations through.
+   * @param key_offset    Byte offset of the key in a record.
+   * @param key_type      Type of the key.
+   * @param key_length    Length of a STRING key; ignored for other types.
+   * @param memory_bytes  Bytes of records held in memory at once; at least
+   *                      two pages' worth is used.
+   * @param num_threads   Most runs sorted at once; 0 for one per core.
+   * @param max_frames    Most buffer frames the sort may keep pinned; 0 for
+   *                      every frame of bufMgr.  One is left for the output.
+   */
+  ExternalSort(BufMgr* bufMgr, const std::size_t key_offset,
+               const Datatype key_type, const std::size_t key_length = 0,
+               const std::size_t memory_bytes = DEFAULT_MEMORY,
+               const std::size_t num_threads = 0,
+               const std::size_t max_frames = 0);
+
+  /**
+   * Writes the records of a relation, sorted by the key, to a new relation.
+   * Runs are kept in files named <output>.run.<n> while sorting.  If the
+   * sort fails, the runs and any partial output are removed.
+   *
+   * @param input   Name of relation file to sort.
+   * @param output  Name of relation file to create.
+   * @throws  FileNotFoundException If the input does not exist.
+   * @throws  FileExistsException   If the output already exists.
+   */
+  void sort(const std::string& input, const std::string& output);
+
+  /**
+   * Returns the number of runs the last sort wrote from the input.
+   */
+  std::size_t num_runs() const { return num_runs_; }
+
+  /**
+   * Returns the number of merge passes the last sort made, counting the one
+   * writing the output.
+   */
+  std::size_t num_passes() const { return num_passes_; }
+
+  /**
+   * Returns the most runs merged at once.
+   */
+  std::size_t fan_in() const { return fan_in_; }
+
+ private:
+  /**
+   * Records read into memory: their bytes, and where each one lies.
+   */
+  struct Chunk {
+    struct Entry {
+      std::uint32_t offset;
+      std::uint32_t length;
+    };
+    std::vector<char> data;
+    std::vector<Entry> entries;
+  };
+
+  /**
+   * Returns the key of a record.
+   */
+  const char* key(const char* record, const std::size_t length) const {
+    return length >= key_offset_ + key_length_ ? record + key_offset_
+                                               : zero_key_.data();
+  }
+
+  /**
+   * Returns true if record a sorts before record b.
+   */
+  bool less(const char* a, const std::size_t a_length, const char* b,
+            const std::size_t b_length) const;
+
+  /**
+   * Sorts a chunk and writes it to a new run file.
+   */
+  void writeRun(const std::shared_ptr<Chunk>& chunk,
+                const std::string& name) const;
+
+  /**
+   * Merges runs into a new relation file.
+   */
+  void merge(const std::vector<std::string>& runs,
+             const std::string& output) const;
+
+  /**
+   * Buffer manager the relations are read through.
+   */
+  BufMgr* buf_mgr_;
+
+  /**
+   * Key sorted by.
+   */
+  std::size_t key_offset_;
+  Datatype key_type_;
+  std::size_t key_length_;
+  std::string zero_key_;
+
+  /**
+   * Memory budget, threads, and most runs merged at once.
+   */
+  std::size_t memory_bytes_;
+  std::size_t num_threads_;
+  std::size_t fan_in_;
+
+  /**
+   * Runs written and merge passes made by the last sort.
+   */
+  std::size_t num_runs_;
+  std::size_t num_passes_;
+};
+
+}
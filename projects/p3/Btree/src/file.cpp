@@ -7,24 +7,34 @@
 
 #include "file.h"
 
-#include <fstream>
+#include <algorithm>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
 #include <cstdio>
 #include <cassert>
+#include <cstring>
+#include <sys/stat.h>
 
+#include "exceptions/bad_page_size_exception.h"
+#include "exceptions/bad_stripe_layout_exception.h"
 #include "exceptions/file_exists_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
 #include "exceptions/invalid_page_exception.h"
 #include "file_iterator.h"
 #include "page.h"
+#include "page_codec.h"
+#include "striped_file.h"
 
 namespace badgerdb {
 
-File::StreamMap File::open_streams_;
-File::CountMap File::open_counts_;
+static_assert(sizeof(FileHeader) <= BlobFile::GRANULE,
+              "the file header must fit in the first granule");
+
+const std::size_t File::BLOCK_SIZE;
 
 void File::remove(const std::string& filename) {
   if (!exists(filename)) {
@@ -33,25 +43,34 @@ void File::remove(const std::string& filename) {
   if (isOpen(filename)) {
     throw FileOpenException(filename);
   }
+  // Striped files keep their pages in the stripe files named in their header.
+  std::vector<std::string> stripes;
+  try {
+    stripes = StripedFile::stripeFilenames(filename);
+  } catch (const BadStripeLayoutException&) {
+    // The stripes can't be found any more; still remove the file itself.
+  }
+  for (std::size_t i = 0; i < stripes.size(); ++i) {
+    std::remove(stripes[i].c_str());
+  }
   std::remove(filename.c_str());
+  // Compressed blob files keep their mapping table alongside.
+  const std::string map_name = BlobFile::mapFilename(filename);
+  if (exists(map_name)) {
+    std::remove(map_name.c_str());
+  }
 }
 
 bool File::isOpen(const std::string& filename) {
   if (!exists(filename)) {
     return false;
   }
-  return open_counts_.find(filename) != open_counts_.end();
+  return FileHandle::isOpen(filename);
 }
 
 bool File::exists(const std::string& filename) {
-	std::fstream file(filename);
-	if(file)
-	{
-		file.close();
-		return true;
-	}
-
-	return false;
+  struct stat info;
+  return ::stat(filename.c_str(), &info) == 0;
 }
 
 File::~File() {
@@ -59,89 +78,140 @@ File::~File() {
 }
 
 
+Page File::readPage(const PageId page_number) const {
+  Page page;
+  readPageInto(page_number, &page);
+  return page;
+}
+
+void File::sync() {
+  handle_->sync();
+}
+
 PageId File::getFirstPageNo() {
   const FileHeader& header = readHeader();
   return header.first_used_page;
 }
 
-File::File(const std::string& name, const bool create_new) : filename_(name) {
+PageId File::getNumPages() const {
+  return readHeader().num_pages;
+}
+
+File::File(const std::string& name, const bool create_new,
+           const std::size_t page_size)
+    : filename_(name),
+      page_size_(page_size) {
+  if (create_new && !Page::isValidSize(page_size)) {
+    throw BadPageSizeException(filename_, page_size);
+  }
   openIfNeeded(create_new);
 
   if (create_new) {
     // File starts with 1 page (the header).
     FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
-                         0 /* num_free_pages */, 0 /* first_free_page */};
+                         0 /* num_free_pages */, 0 /* first_free_page */,
+                         static_cast<std::uint32_t>(page_size_),
+                         0 /* flags */};
     writeHeader(header);
+  } else {
+    page_size_ = readHeader().page_size;
+    if (!Page::isValidSize(page_size_)) {
+      close();
+      throw BadPageSizeException(filename_, page_size_);
+    }
   }
 }
 
 void File::openIfNeeded(const bool create_new) {
-  if (open_counts_.find(filename_) != open_counts_.end()) {	//exists an entry already
-    ++open_counts_[filename_];
-    stream_ = open_streams_[filename_];
-  } else {
-    std::ios_base::openmode mode =
-        std::fstream::in | std::fstream::out | std::fstream::binary;
-    const bool already_exists = exists(filename_);
-    if (create_new) {
-      // Error if we try to overwrite an existing file.
-      if (already_exists) {
-        throw FileExistsException(filename_);
-      }
-      // New files have to be truncated on open.
-      mode = mode | std::fstream::trunc;
-    } else {
-      // Error if we try to open a file that doesn't exist.
-      if (!already_exists) {
-        throw FileNotFoundException(filename_);
-      }
-    }
-    stream_.reset(new std::fstream(filename_, mode));
-    open_streams_[filename_] = stream_;
-    open_counts_[filename_] = 1;
-  }
+  handle_ = FileHandle::open(filename_, create_new);
 }
 
 void File::close() {
-	if(open_counts_[filename_] > 0)
-  	--open_counts_[filename_];
+  handle_.reset();
+}
 
-  stream_.reset();
-	assert(open_counts_[filename_] >= 0);
+void File::reclaimPage(const PageId page_number, const std::size_t keep) {
+  handle_->punchHole(pagePosition(page_number) + keep, page_size_ - keep);
+}
 
-  if (open_counts_[filename_] == 0) {
-    open_streams_.erase(filename_);
-    open_counts_.erase(filename_);
+void File::releaseFreeTail(FileHeader& header) {
+  std::vector<PageId> free_pages;
+  std::vector<bool> is_free(header.num_pages, false);
+  PageId page_number = header.first_free_page;
+  for (PageId i = 0; i < header.num_free_pages; ++i) {
+    free_pages.push_back(page_number);
+    is_free[page_number] = true;
+    page_number = nextFreePage(page_number);
   }
+
+  PageId num_pages = header.num_pages;
+  while (num_pages > 1 && is_free[num_pages - 1]) {
+    --num_pages;
+  }
+  if (num_pages == header.num_pages) {
+    return;
+  }
+
+  // Relink the surviving free pages, rewriting only the links that skipped
+  // over a truncated page.
+  PageId previous = Page::INVALID_NUMBER;
+  bool previous_linked = true;
+  header.first_free_page = Page::INVALID_NUMBER;
+  header.num_free_pages = 0;
+  for (std::size_t i = 0; i < free_pages.size(); ++i) {
+    if (free_pages[i] >= num_pages) {
+      previous_linked = false;
+      continue;
+    }
+    if (previous == Page::INVALID_NUMBER) {
+      header.first_free_page = free_pages[i];
+    } else if (!previous_linked) {
+      setNextFreePage(previous, free_pages[i]);
+    }
+    previous = free_pages[i];
+    previous_linked = true;
+    ++header.num_free_pages;
+  }
+  if (previous != Page::INVALID_NUMBER && !previous_linked) {
+    setNextFreePage(previous, Page::INVALID_NUMBER);
+  }
+
+  header.num_pages = num_pages;
+  truncatePages(num_pages);
+}
+
+void File::truncatePages(const PageId num_pages) {
+  handle_->truncate(pagePosition(num_pages));
 }
 
 FileHeader File::readHeader() const {
   FileHeader header;
-  stream_->seekg(0 /* pos */, std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
+  handle_->read(reinterpret_cast<char*>(&header), sizeof(FileHeader),
+                0 /* offset */);
   return header;
 }
 
 void File::writeHeader(const FileHeader& header) {
-  stream_->seekp(0 /* pos */, std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
-  stream_->flush();
+  handle_->write(reinterpret_cast<const char*>(&header), sizeof(FileHeader),
+                 0 /* offset */);
 }
 
 
 
 
 
-PageFile PageFile::create(const std::string& filename) {
-  return PageFile(filename, true /* create_new */);
+PageFile PageFile::create(const std::string& filename,
+                          const std::size_t page_size) {
+  return PageFile(filename, true /* create_new */, page_size);
 }
 
 PageFile PageFile::open(const std::string& filename) {
   return PageFile(filename, false /* create_new */);
 }
 
-PageFile::PageFile(const std::string& name, const bool create_new)
-: File(name, create_new)
+PageFile::PageFile(const std::string& name, const bool create_new,
+                   const std::size_t page_size)
+: File(name, create_new, page_size)
 {
 }
 
@@ -158,11 +228,13 @@ PageFile& PageFile::operator=(const PageFile& rhs) {
   // same file.
   close();	//close my file and associate me with the new one
   filename_ = rhs.filename_;
+  page_size_ = rhs.page_size_;
   openIfNeeded(false /* create_new */);
   return *this;
 }
 
 Page PageFile::allocatePage(PageId &new_page_number) {
+  std::lock_guard<FileHandle> guard(*handle_);
   FileHeader header = readHeader();
   Page new_page;
   Page existing_page;
@@ -202,6 +274,7 @@ Page PageFile::allocatePage(PageId &new_page_number) {
   }
 	else
 	{
+    new_page.initialize(page_size_);
     new_page.set_page_number(header.num_pages);
 		new_page_number = new_page.page_number();
 
@@ -212,14 +285,10 @@ Page PageFile::allocatePage(PageId &new_page_number) {
 		else
 		{
       // If we have pages allocated, we need to add the new page to the tail
-      // of the linked list.
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        if ((*iter).next_page_number() == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      assert(existing_page.isUsed());
+      // of the linked list.  The used list is kept in page number order and,
+      // with no free pages, holds every page, so the tail is the last page.
+      existing_page = readPage(header.num_pages - 1, false /* allow_free */);
+      assert(existing_page.next_page_number() == Page::INVALID_NUMBER);
       existing_page.set_next_page_number(new_page.page_number());
     }
     ++header.num_pages;
@@ -235,21 +304,28 @@ Page PageFile::allocatePage(PageId &new_page_number) {
   return new_page;
 }
 
-Page PageFile::readPage(const PageId page_number) const {
-  FileHeader header = readHeader();
-
-	if (page_number >= header.num_pages)
+void PageFile::readPageInto(const PageId page_number, Page* page) const {
+	// Page 0 holds the file header.  Pages past the end of the file read back
+	// as zeros and so are rejected as free pages below, which saves reading
+	// the file header on every page read.
+	if (page_number == Page::INVALID_NUMBER)
+	{
+		throw InvalidPageException(page_number, filename_);
+	}
+	// Header and data are contiguous both on disk and in the page.
+	handle_->read(reinterpret_cast<char*>(page), page_size_,
+	              pagePosition(page_number));
+	if (!page->isUsed())
 	{
 		throw InvalidPageException(page_number, filename_);
 	}
-	return readPage(page_number, false /* allow_free */);
 }
 
 Page PageFile::readPage(const PageId page_number, const bool allow_free) const {
   Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&page.header_), sizeof(PageHeader));
-  stream_->read(reinterpret_cast<char*>(&page.data_[0]), Page::DATA_SIZE);
+  // Header and data are contiguous both on disk and in the page.
+  handle_->read(reinterpret_cast<char*>(&page), page_size_,
+                pagePosition(page_number));
   if (!allow_free && !page.isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
@@ -258,6 +334,9 @@ Page PageFile::readPage(const PageId page_number, const bool allow_free) const {
 }
 
 void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
+	// Holding the latch keeps a concurrent allocation or deletion from relinking
+	// this page between reading its next page pointer and writing it back.
+	std::lock_guard<FileHandle> guard(*handle_);
 	PageHeader header = readPageHeader(new_page_number);
 	if (header.current_page_number == Page::INVALID_NUMBER)
 	{
@@ -274,6 +353,7 @@ void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
 }
 
 void PageFile::deletePage(const PageId page_number) {
+  std::lock_guard<FileHandle> guard(*handle_);
   FileHeader header = readHeader();
 
   Page existing_page = readPage(page_number);
@@ -293,7 +373,7 @@ void PageFile::deletePage(const PageId page_number) {
     }
   }
   // Clear the page and add it to the head of the free list.
-  existing_page.initialize();
+  existing_page.initialize(page_size_);
   existing_page.set_next_page_number(header.first_free_page);
   header.first_free_page = page_number;
   ++header.num_free_pages;
@@ -301,6 +381,11 @@ void PageFile::deletePage(const PageId page_number) {
     writePage(previous_page.page_number(), previous_page.header_, previous_page);
   }
   writePage(page_number, existing_page.header_, existing_page);
+  // Only the header carrying the free list link has to stay on disk.
+  reclaimPage(page_number, sizeof(PageHeader));
+  if (page_number == header.num_pages - 1) {
+    releaseFreeTail(header);
+  }
   writeHeader(header);
 }
 
@@ -315,87 +400,360 @@ FileIterator PageFile::end() {
 
 void PageFile::writePage(const PageId page_number, const PageHeader& header,
                      const Page& new_page) {
-  stream_->seekp(pagePosition(page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(PageHeader));
-  stream_->write(reinterpret_cast<const char*>(&new_page.data_[0]),
-                 Page::DATA_SIZE);
-  stream_->flush();
+  const std::uint64_t position = pagePosition(page_number);
+  handle_->write(reinterpret_cast<const char*>(&header), sizeof(PageHeader),
+                 position);
+  handle_->write(reinterpret_cast<const char*>(&new_page.data_[0]),
+                 page_size_ - sizeof(PageHeader),
+                 position + sizeof(PageHeader));
 }
 
 PageHeader PageFile::readPageHeader(PageId page_number) const {
   PageHeader header;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(PageHeader));
+  handle_->read(reinterpret_cast<char*>(&header), sizeof(PageHeader),
+                pagePosition(page_number));
   return header;
 }
 
+PageId PageFile::nextFreePage(const PageId page_number) const {
+  return readPageHeader(page_number).next_page_number;
+}
+
+void PageFile::setNextFreePage(const PageId page_number, const PageId next) {
+  PageHeader header = readPageHeader(page_number);
+  header.next_page_number = next;
+  handle_->write(reinterpret_cast<const char*>(&header), sizeof(PageHeader),
+                 pagePosition(page_number));
+}
+
 
 
 
-BlobFile BlobFile::create(const std::string& filename) {
-  return BlobFile(filename, true /* create_new */);
+BlobFile::FreeRegistry BlobFile::free_registry_;
+std::mutex BlobFile::free_registry_mutex_;
+
+BlobFile BlobFile::create(const std::string& filename,
+                          const std::size_t page_size,
+                          const bool compressed) {
+  return BlobFile(filename, true /* create_new */, page_size, compressed);
 }
 
 BlobFile BlobFile::open(const std::string& filename) {
   return BlobFile(filename, false /* create_new */);
 }
 
-BlobFile::BlobFile(const std::string& name, const bool create_new)
-: File(name, create_new) {
+BlobFile::BlobFile(const std::string& name, const bool create_new,
+                   const std::size_t page_size, const bool compressed)
+: File(name, create_new, page_size),
+  compressed_(false) {
+  if (create_new && compressed) {
+    FileHeader header = readHeader();
+    header.flags |= FileHeader::COMPRESSED;
+    writeHeader(header);
+  }
+  openMap(create_new);
 }
 
 BlobFile::~BlobFile() {
 }
 
 BlobFile::BlobFile(const BlobFile& other)
-: File(other.filename_, false /* create_new */)
+: File(other.filename_, false /* create_new */),
+  compressed_(false)
 {
+  openMap(false /* create_new */);
 }
 
 BlobFile& BlobFile::operator=(const BlobFile& rhs) {
   // This accounts for self-assignment and assignment of a File object for the
   // same file.
   close();	//close my file and associate me with the new one
+  map_handle_.reset();
   filename_ = rhs.filename_;
+  page_size_ = rhs.page_size_;
   openIfNeeded(false /* create_new */);
+  openMap(false /* create_new */);
   return *this;
 }
 
+void BlobFile::sync() {
+  File::sync();
+  if (map_handle_) {
+    map_handle_->sync();
+  }
+}
+
+void BlobFile::openMap(const bool create_new) {
+  compressed_ = (readHeader().flags & FileHeader::COMPRESSED) != 0;
+  free_granules_.reset();
+  if (!compressed_) {
+    return;
+  }
+  map_handle_ = FileHandle::open(mapFilename(filename_), create_new);
+
+  std::lock_guard<std::mutex> guard(free_registry_mutex_);
+  free_granules_ = free_registry_[filename_].lock();
+  if (!free_granules_) {
+    free_granules_ = std::make_shared<FreeGranules>();
+    if (!create_new) {
+      findFreeGranules();
+    }
+    // Drop the entries of files no longer open while registering this one.
+    for (FreeRegistry::iterator entry = free_registry_.begin();
+         entry != free_registry_.end();) {
+      if (entry->second.expired()) {
+        entry = free_registry_.erase(entry);
+      } else {
+        ++entry;
+      }
+    }
+    free_registry_[filename_] = free_granules_;
+  }
+}
+
+void BlobFile::findFreeGranules() {
+  const PageId num_pages = readHeader().num_pages;
+  std::vector<Slot> slots(num_pages);
+  map_handle_->read(reinterpret_cast<char*>(&slots[0]),
+                    num_pages * sizeof(Slot), 0 /* offset */);
+
+  // Slots of used pages, as (first granule, granules); page 0 is the header.
+  std::vector<std::pair<std::uint64_t, std::uint64_t> > used;
+  for (PageId page_number = 1; page_number < num_pages; ++page_number) {
+    if (slots[page_number].length != 0) {
+      used.push_back(std::make_pair(
+          slots[page_number].granule,
+          (slots[page_number].length + GRANULE - 1) / GRANULE));
+    }
+  }
+  std::sort(used.begin(), used.end());
+
+  // The file header takes the first granule.
+  std::uint64_t next = 1;
+  for (std::size_t i = 0; i < used.size(); ++i) {
+    if (used[i].first > next) {
+      (*free_granules_)[next] = used[i].first - next;
+    }
+    next = std::max(next, used[i].first + used[i].second);
+  }
+  const std::uint64_t end = (handle_->size() + GRANULE - 1) / GRANULE;
+  if (end > next) {
+    (*free_granules_)[next] = end - next;
+  }
+}
+
 Page BlobFile::allocatePage(PageId &new_page_number) {
+  std::lock_guard<FileHandle> guard(*handle_);
   FileHeader header = readHeader();
 	Page new_page;
 
-	new_page_number = header.num_pages;
+	if (header.num_free_pages > 0) {
+		// Reuse the most recently deleted page.
+		new_page_number = header.first_free_page;
+		header.first_free_page = nextFreePage(new_page_number);
+		--header.num_free_pages;
+	} else {
+		new_page_number = header.num_pages;
+		++header.num_pages;
+	}
+	new_page.initialize(page_size_);
 
 	if (header.first_used_page == Page::INVALID_NUMBER) {
-		header.first_used_page = header.num_pages;
+		header.first_used_page = new_page_number;
 	}
 
-	++header.num_pages;
 	//Fix set the 'new_page's page number to new_page_number before writing it to the disk
 	new_page.set_page_number(new_page_number);
-	writePage(new_page_number, new_page);
+	storePage(new_page_number, new_page);
 	writeHeader(header);
 
 	return new_page;
 }
 
-Page BlobFile::readPage(const PageId page_number) const {
-	Page page;
-	stream_->seekg(pagePosition(page_number), std::ios::beg);
-	stream_->read(reinterpret_cast<char*>(&page), Page::SIZE);
-	return page;
+void BlobFile::readPageInto(const PageId page_number, Page* page) const {
+	char* const data = reinterpret_cast<char*>(page);
+	if (!compressed_) {
+		handle_->read(data, page_size_, pagePosition(page_number));
+		return;
+	}
+
+	std::lock_guard<FileHandle> guard(*handle_);
+	const Slot slot = readSlot(page_number);
+	const std::uint64_t position = static_cast<std::uint64_t>(slot.granule) * GRANULE;
+	if (slot.length == 0) {
+		// Never written or free; reads as zeroes like a hole in a plain file.
+		std::memset(data, 0, page_size_);
+	} else if (slot.length == page_size_) {
+		handle_->read(data, page_size_, position);
+	} else {
+		char buffer[Page::SIZE];
+		handle_->read(buffer, slot.length, position);
+		if (!PageCodec::decompress(buffer, slot.length, data, page_size_)) {
+			throw InvalidPageException(page_number, filename_);
+		}
+	}
 }
 
 void BlobFile::writePage(const PageId new_page_number, const Page& new_page) {
-	stream_->seekp(pagePosition(new_page_number), std::ios::beg);
-	stream_->write(reinterpret_cast<const char*>(&new_page), Page::SIZE);
-	stream_->flush();
+	if (!compressed_) {
+		storePage(new_page_number, new_page);
+		return;
+	}
+	std::lock_guard<FileHandle> guard(*handle_);
+	storePage(new_page_number, new_page);
+}
+
+void BlobFile::storePage(const PageId page_number, const Page& new_page) {
+	const char* data = reinterpret_cast<const char*>(&new_page);
+	if (!compressed_) {
+		handle_->write(data, page_size_, pagePosition(page_number));
+		return;
+	}
+
+	// Only keep the compressed form if it saves at least one byte.
+	char buffer[Page::SIZE];
+	std::size_t length = PageCodec::compress(data, page_size_, buffer,
+	                                         page_size_ - 1);
+	if (length == 0) {
+		length = page_size_;
+	} else {
+		data = buffer;
+	}
+
+	Slot slot = readSlot(page_number);
+	const std::uint64_t granules = (length + GRANULE - 1) / GRANULE;
+	const std::uint64_t old_granules = (slot.length + GRANULE - 1) / GRANULE;
+	if (granules > old_granules) {
+		// Move to a new slot; the old one, merged with the free granules next to
+		// it, may be taken again.
+		releaseGranules(slot.granule, old_granules);
+		slot.granule = static_cast<std::uint32_t>(allocateGranules(granules));
+	} else {
+		// Rewrite in place, giving back the granules no longer needed.
+		releaseGranules(slot.granule + granules, old_granules - granules);
+	}
+	slot.length = static_cast<std::uint32_t>(length);
+	handle_->write(data, length, static_cast<std::uint64_t>(slot.granule) * GRANULE);
+	writeSlot(page_number, slot);
 }
 
-//delePage should not be called for a blob_file, not supported
 void BlobFile::deletePage(const PageId page_number) {
-	throw InvalidPageException(page_number, filename_);
+	std::lock_guard<FileHandle> guard(*handle_);
+	FileHeader header = readHeader();
+	if (page_number == Page::INVALID_NUMBER || page_number >= header.num_pages) {
+		throw InvalidPageException(page_number, filename_);
+	}
+
+	if (compressed_) {
+		const Slot slot = readSlot(page_number);
+		releaseGranules(slot.granule, (slot.length + GRANULE - 1) / GRANULE);
+	}
+	// Push the page onto the free list and drop everything but the link.
+	setNextFreePage(page_number, header.first_free_page);
+	header.first_free_page = page_number;
+	++header.num_free_pages;
+	if (!compressed_) {
+		reclaimPage(page_number, sizeof(PageId));
+	}
+	if (page_number == header.num_pages - 1) {
+		releaseFreeTail(header);
+	}
+	writeHeader(header);
+}
+
+BlobFile::Slot BlobFile::readSlot(const PageId page_number) const {
+	Slot slot;
+	map_handle_->read(reinterpret_cast<char*>(&slot), sizeof(Slot),
+	                  static_cast<std::uint64_t>(page_number) * sizeof(Slot));
+	return slot;
+}
+
+void BlobFile::writeSlot(const PageId page_number, const Slot& slot) {
+	map_handle_->write(reinterpret_cast<const char*>(&slot), sizeof(Slot),
+	                   static_cast<std::uint64_t>(page_number) * sizeof(Slot));
+}
+
+std::uint64_t BlobFile::allocateGranules(const std::uint64_t count) {
+	for (FreeGranules::iterator run = free_granules_->begin();
+	     run != free_granules_->end(); ++run) {
+		if (run->second >= count) {
+			const std::uint64_t granule = run->first;
+			if (run->second > count) {
+				(*free_granules_)[granule + count] = run->second - count;
+			}
+			free_granules_->erase(run);
+			return granule;
+		}
+	}
+	return (handle_->size() + GRANULE - 1) / GRANULE;
+}
+
+void BlobFile::releaseGranules(const std::uint64_t granule,
+                               const std::uint64_t count) {
+	if (count == 0) {
+		return;
+	}
+	std::uint64_t first = granule;
+	std::uint64_t last = granule + count;
+	FreeGranules::iterator next = free_granules_->lower_bound(granule);
+	if (next != free_granules_->end() && next->first == last) {
+		last += next->second;
+		next = free_granules_->erase(next);
+	}
+	if (next != free_granules_->begin()) {
+		FreeGranules::iterator previous = next;
+		--previous;
+		if (previous->first + previous->second == first) {
+			first = previous->first;
+			free_granules_->erase(previous);
+		}
+	}
+
+	if (last * GRANULE >= handle_->size()) {
+		// Last slot in the file; give the space back by shrinking the file.
+		handle_->truncate(first * GRANULE);
+		return;
+	}
+	(*free_granules_)[first] = last - first;
+	// Punch the blocks that the released granules touch and that lie wholly in
+	// the free run.
+	const std::uint64_t begin = std::max(
+	    (first * GRANULE + BLOCK_SIZE - 1) / BLOCK_SIZE,
+	    granule * GRANULE / BLOCK_SIZE) * BLOCK_SIZE;
+	const std::uint64_t end = std::min(
+	    last * GRANULE / BLOCK_SIZE,
+	    ((granule + count) * GRANULE + BLOCK_SIZE - 1) / BLOCK_SIZE) * BLOCK_SIZE;
+	if (begin < end) {
+		handle_->punchHole(begin, end - begin);
+	}
+}
+
+PageId BlobFile::nextFreePage(const PageId page_number) const {
+	if (compressed_) {
+		return readSlot(page_number).granule;
+	}
+	PageId next;
+	handle_->read(reinterpret_cast<char*>(&next), sizeof(PageId),
+	              pagePosition(page_number));
+	return next;
+}
+
+void BlobFile::setNextFreePage(const PageId page_number, const PageId next) {
+	if (compressed_) {
+		const Slot slot = {next, 0 /* length */};
+		writeSlot(page_number, slot);
+		return;
+	}
+	handle_->write(reinterpret_cast<const char*>(&next), sizeof(PageId),
+	               pagePosition(page_number));
+}
+
+void BlobFile::truncatePages(const PageId num_pages) {
+	if (compressed_) {
+		map_handle_->truncate(static_cast<std::uint64_t>(num_pages) * sizeof(Slot));
+		return;
+	}
+	File::truncatePages(num_pages);
 }
 
 }
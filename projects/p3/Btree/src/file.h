@@ -7,11 +7,12 @@
 
 #pragma once
 
-#include <fstream>
-#include <string>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <string>
 
+#include "file_handle.h"
 #include "page.h"
 
 namespace badgerdb {
@@ -42,6 +43,27 @@ struct FileHeader {
    */
   PageId first_free_page;
 
+  /**
+   * Size in bytes of every page in the file, chosen when the file is created.
+   */
+  std::uint32_t page_size;
+
+  /**
+   * Storage options of the file (see COMPRESSED and STRIPED), chosen when it
+   * is created.
+   */
+  std::uint32_t flags;
+
+  /**
+   * Flag marking a BlobFile whose pages are stored compressed.
+   */
+  static const std::uint32_t COMPRESSED = 0x1;
+
+  /**
+   * Flag marking a StripedFile, whose pages live in separate stripe files.
+   */
+  static const std::uint32_t STRIPED = 0x2;
+
   /**
    * Returns true if this file header is equal to the other.
    *
@@ -52,7 +74,9 @@ struct FileHeader {
     return num_pages == rhs.num_pages &&
         num_free_pages == rhs.num_free_pages &&
         first_used_page == rhs.first_used_page &&
-        first_free_page == rhs.first_free_page;
+        first_free_page == rhs.first_free_page &&
+        page_size == rhs.page_size &&
+        flags == rhs.flags;
   }
 };
 
@@ -60,32 +84,50 @@ struct FileHeader {
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
  *
- * The File class wraps a stream to an underlying file on disk.  Files contain
- * fixed-sized pages, and they never deallocate space (though they do reuse
- * deleted pages if possible).  If multiple File objects refer to the same
- * underlying file, they will share the stream in memory.
- * If a file that has already been opened (possibly by another query), then the File class
- * detects this (by looking in the open_streams_ map) and just returns a file object with
- * the already created stream for the file without actually opening the UNIX file again. 
+ * The File class wraps a handle to an underlying file on disk.  Files contain
+ * fixed-sized pages.  Deleted pages are kept on a free list for reuse; their
+ * storage is released by punching a hole over everything but the free list
+ * link, and free pages at the end of the file are truncated away.  The pages
+ * follow a header area padded to a block boundary, so only the block holding
+ * the link stays allocated.  The page size is chosen per file when it is
+ * created and may be any power of two between Page::MIN_SIZE and Page::SIZE,
+ * Page::DEFAULT_SIZE unless chosen otherwise; pages of a smaller file still
+ * occupy a full Page in memory, of which only
+ * the first page_size() bytes are stored.  If multiple File objects refer to the same
+ * underlying file, they will share one FileHandle.
+ * If a file that has already been opened (possibly by another query or thread), then
+ * FileHandle::open() finds its handle in the registry and the File object reuses it
+ * without actually opening the UNIX file again.
  *
- * @warning This class is not threadsafe.
+ * Distinct File objects may be used from different threads at once: reads and
+ * writes are positional, and allocating or deleting pages is serialized on the
+ * shared handle.  A single File object should not be shared between threads
+ * while it is being reassigned.
  */
 
 
 class File {
  public:
+  /**
+   * Size in bytes of the filesystem blocks that pages are aligned to.
+   */
+  static const std::size_t BLOCK_SIZE = 4096;
 
   /**
    * Constructs a file object representing a file on the filesystem.
    *
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param page_size   Page size of the file if it is created; the size of an
+   *                    existing file is read from its header.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
+   * @throws  BadPageSizeException    If the page size is not supported.
    */
-  File(const std::string& name, const bool create_new);
+  File(const std::string& name, const bool create_new,
+       const std::size_t page_size = Page::DEFAULT_SIZE);
 
   /**
    * Deletes an existing file.
@@ -132,7 +174,19 @@ class File {
    * @throws  InvalidPageException  If the page doesn't exist in the file or is
    *                                not currently used.
    */
-  virtual Page readPage(const PageId page_number) const = 0;
+  Page readPage(const PageId page_number) const;
+
+  /**
+   * Reads an existing page from the file straight into the first page_size()
+   * bytes of the given page, such as a buffer pool frame; the rest of it is
+   * left untouched.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page to read into.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  virtual void readPageInto(const PageId page_number, Page* page) const = 0;
 
   /**
    * Writes a page into the file at the given page number.
@@ -150,6 +204,11 @@ class File {
    */
   virtual void deletePage(const PageId page_number) = 0;
 
+  /**
+   * Forces the pages written to the file to stable storage.
+   */
+  virtual void sync();
+
   /**
    * Returns the name of the file this object represents.
    *
@@ -157,6 +216,13 @@ class File {
    */
   const std::string& filename() const { return filename_; }
 
+  /**
+   * Returns the size in bytes of the pages stored in this file.
+   *
+   * @return Page size of file.
+   */
+  std::size_t page_size() const { return page_size_; }
+
  	/**
    * Returns pageid of first page in the file.
    *
@@ -164,6 +230,14 @@ class File {
    */
 	PageId getFirstPageNo();
 
+  /**
+   * Returns the number of pages in the file, counting the header page; pages
+   * are numbered from 1 to one less than this.
+   *
+   * @return  Number of pages of file.
+   */
+  PageId getNumPages() const;
+
  protected:
   /**
    * Returns the position of the page with the given number in the file (as an
@@ -172,14 +246,26 @@ class File {
    * @param page_number   Number of page.
    * @return  Position of page in file.
    */
-  static std::streampos pagePosition(const PageId page_number) {
-    return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
+  std::uint64_t pagePosition(const PageId page_number) const {
+    return headerSize() +
+        (static_cast<std::uint64_t>(page_number - 1) * page_size_);
+  }
+
+  /**
+   * Returns the number of bytes reserved for the file header in front of the
+   * first page: a whole page, and at least one BLOCK_SIZE block.  Every page
+   * then starts at a multiple of its size or of BLOCK_SIZE, so pages never
+   * straddle a block and a hole punched over a free page releases whole
+   * blocks.
+   */
+  std::uint64_t headerSize() const {
+    return page_size_ > BLOCK_SIZE ? page_size_ : BLOCK_SIZE;
   }
 
   /**
    * Opens the underlying file named in filename_.
    * This method only opens the file if no other File objects exist that access
-   * the same filesystem file; otherwise, it reuses the existing stream.
+   * the same filesystem file; otherwise, it reuses the existing handle.
    *
    * @param create_new  Whether to create a new file.
    * @throws  FileExistsException     If the underlying file exists and
@@ -190,38 +276,65 @@ class File {
   void openIfNeeded(const bool create_new);
 
   /**
-   * Closes the underlying file stream in <stream_>.
-   * This method only closes the file if no other File objects exist that access
-   * the same file.
+   * Releases the underlying file handle in <handle_>.
+   * The file is only closed if no other File objects exist that access the
+   * same file.
    */
   void close();
 
   /**
-   * Reads the header for this file from disk.
+   * Releases the storage of a free page, except for its first <keep> bytes
+   * which hold the free list link.
    *
-   * @return  The file header.
+   * @param page_number   Number of free page.
+   * @param keep          Number of leading bytes of the page to keep.
    */
-  FileHeader readHeader() const;
+  void reclaimPage(const PageId page_number, const std::size_t keep);
 
   /**
-   * Writes the given header to the disk as the header for this file.
+   * Truncates free pages off the end of the file, unlinking them from the
+   * free list.  The caller writes the updated header.
    *
-   * @param header  File header to write.
+   * @param header  File header to update.
    */
-  void writeHeader(const FileHeader& header);
+  void releaseFreeTail(FileHeader& header);
 
-  typedef std::map<std::string, std::shared_ptr<std::fstream> > StreamMap;
-  typedef std::map<std::string, int> CountMap;
+  /**
+   * Returns the page following the given page on the free list.
+   *
+   * @param page_number   Number of free page.
+   * @return  Number of next free page.
+   */
+  virtual PageId nextFreePage(const PageId page_number) const = 0;
 
   /**
-   * Streams for opened files.
+   * Links the given free page to the next page on the free list.
+   *
+   * @param page_number   Number of free page.
+   * @param next          Number of next free page.
+   */
+  virtual void setNextFreePage(const PageId page_number, const PageId next) = 0;
+
+  /**
+   * Cuts the file off after the given number of pages.
+   *
+   * @param num_pages   Number of pages (including the header) to keep.
+   */
+  virtual void truncatePages(const PageId num_pages);
+
+  /**
+   * Reads the header for this file from disk.
+   *
+   * @return  The file header.
    */
-  static StreamMap open_streams_;
+  FileHeader readHeader() const;
 
   /**
-   * Counts for opened files.
+   * Writes the given header to the disk as the header for this file.
+   *
+   * @param header  File header to write.
    */
-  static CountMap open_counts_;
+  void writeHeader(const FileHeader& header);
 
   /**
    * Name of the file this object represents.
@@ -229,9 +342,14 @@ class File {
   std::string filename_;
 
   /**
-   * Stream for underlying filesystem object.
+   * Size in bytes of the pages stored in this file.
+   */
+  std::size_t page_size_;
+
+  /**
+   * Handle for underlying filesystem object.
    */
-  std::shared_ptr<std::fstream> stream_;
+  std::shared_ptr<FileHandle> handle_;
 
   friend class FileIterator;
 };
@@ -243,16 +361,18 @@ class PageFile : public File {
    * Creates a new file.
    *
    * @param filename  Name of the file.
+   * @param page_size Size in bytes of the pages of the file.
    * @throws  FileExistsException     If the requested file already exists.
+   * @throws  BadPageSizeException    If the page size is not supported.
    */
-  static PageFile create(const std::string& filename);
+  static PageFile create(const std::string& filename,
+                         const std::size_t page_size = Page::DEFAULT_SIZE);
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
-	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * It first checks if the file is already open. If so, then the new File object created shares the FileHandle of
+	 * that already open file; the handle is reference counted and closed when its last File object goes away.
+	 * Otherwise the UNIX file is actually opened and its handle is registered under fileName (see FileHandle::open()).
    *
    * @param filename  Name of the file.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
@@ -264,12 +384,14 @@ class PageFile : public File {
    *
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param page_size   Page size of the file if it is created.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  PageFile(const std::string& name, const bool create_new);
+  PageFile(const std::string& name, const bool create_new,
+           const std::size_t page_size = Page::DEFAULT_SIZE);
 
   /**
    * Copy constructor.
@@ -300,15 +422,17 @@ class PageFile : public File {
    */
   Page allocatePage(PageId &new_page_number);
 
+  using File::readPage;
+
   /**
-   * Reads an existing page from the file.
+   * Reads an existing page from the file straight into the given page.
    *
    * @param page_number   Number of page to read.
-   * @return  The page.
+   * @param page          Page to read into.
    * @throws  InvalidPageException  If the page doesn't exist in the file or is
    *                                not currently used.
    */
-  Page readPage(const PageId page_number) const;
+  void readPageInto(const PageId page_number, Page* page) const;
 
   /**
    * Writes a page into the file at the given page number.
@@ -347,8 +471,8 @@ class PageFile : public File {
    * Reads a page from the file.  If <allow_free> is not set, an exception
    * will be thrown if the page read from disk is not currently in use.
    *
-   * No bounds checking is performed; the underlying file stream will throw
-   * an exception if the page is past the end of the file.
+   * No bounds checking is performed; a page past the end of the file reads
+   * as zeroes, i.e. as a free page.
    *
    * @param page_number   Number of page to read.
    * @param allow_free    Whether to allow reading a free (unused) page.
@@ -379,26 +503,58 @@ class PageFile : public File {
    */
   PageHeader readPageHeader(const PageId page_number) const;
 
+  /**
+   * Free pages link to each other through the next page number in their
+   * header.
+   */
+  PageId nextFreePage(const PageId page_number) const;
+  void setNextFreePage(const PageId page_number, const PageId next);
+
   friend class FileIterator;
 };
 
+/**
+ * @brief File of raw page images, used for index files.
+ *
+ * A BlobFile may be created in compressed mode.  Each page image is then
+ * compressed with PageCodec and stored in a variable-size slot, a run of
+ * GRANULE byte granules appended to the file; a page that does not compress
+ * is stored as is.  The slot of every page is recorded in a mapping table
+ * kept next to the file in <filename>.cmap.  A rewritten page stays in its
+ * slot if it still fits, otherwise it moves to the first run of free
+ * granules large enough for it, and only to the end of the file if there is
+ * none.  Freed granules are coalesced with their free neighbours, and the
+ * blocks a free run covers are hole-punched.  The free runs are rebuilt from
+ * the mapping table when the file is opened and shared by every BlobFile
+ * open on it.  Reads and writes of a compressed file are serialized on the
+ * file handle, as a page may move while it is written.
+ */
 class BlobFile : public File {
  public:
 
+  /**
+   * Size in bytes of the units in which compressed slots are allocated.
+   */
+  static const std::size_t GRANULE = 64;
+
   /**
    * Creates a new BlobFile.
    *
-   * @param filename  Name of the file.
+   * @param filename    Name of the file.
+   * @param page_size   Size in bytes of the pages of the file.
+   * @param compressed  Whether to store the pages compressed.
    * @throws  FileExistsException     If the requested file already exists.
+   * @throws  BadPageSizeException    If the page size is not supported.
    */
-  static BlobFile create(const std::string& filename);
+  static BlobFile create(const std::string& filename,
+                         const std::size_t page_size = Page::DEFAULT_SIZE,
+                         const bool compressed = false);
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
-	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * It first checks if the file is already open. If so, then the new File object created shares the FileHandle of
+	 * that already open file; the handle is reference counted and closed when its last File object goes away.
+	 * Otherwise the UNIX file is actually opened and its handle is registered under fileName (see FileHandle::open()).
    *
    * @param filename  Name of the file.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
@@ -412,12 +568,17 @@ class BlobFile : public File {
    * @see File::open()
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param page_size   Page size of the file if it is created.
+   * @param compressed  Whether to store the pages compressed if the file is
+   *                    created; an existing file keeps its own mode.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  BlobFile(const std::string& name, const bool create_new);
+  BlobFile(const std::string& name, const bool create_new,
+           const std::size_t page_size = Page::DEFAULT_SIZE,
+           const bool compressed = false);
 
   /**
    * Copy constructor.
@@ -449,14 +610,14 @@ class BlobFile : public File {
   Page allocatePage(PageId &new_page_number);
 
   /**
-   * Reads an existing page from the file.
+   * Reads an existing page from the file straight into the given page.
    *
    * @param page_number   Number of page to read.
-   * @return  The page.
+   * @param page          Page to read into.
    * @throws  InvalidPageException  If the page doesn't exist in the file or is
    *                                not currently used.
    */
-  Page readPage(const PageId page_number) const;
+  void readPageInto(const PageId page_number, Page* page) const;
 
   /**
    * Writes a page into the file at the given page number.
@@ -468,11 +629,145 @@ class BlobFile : public File {
   void writePage(const PageId page_number, const Page& new_page);
 
   /**
-   * Deletes a page from the file.
+   * Deletes a page from the file.  The page number is reused by a later
+   * allocatePage().
    *
    * @param page_number   Number of page to delete.
+   * @throws  InvalidPageException  If the page doesn't exist in the file.
    */
   void deletePage(const PageId page_number);
+
+  /**
+   * Forces the pages and the mapping table of the file to stable storage.
+   */
+  void sync();
+
+  /**
+   * Returns true if the pages of this file are stored compressed.
+   */
+  bool compressed() const { return compressed_; }
+
+  /**
+   * Returns the name of the mapping table kept for a compressed file.
+   *
+   * @param filename  Name of the file.
+   * @return  Name of its mapping table.
+   */
+  static std::string mapFilename(const std::string& filename) {
+    return filename + ".cmap";
+  }
+
+ private:
+  /**
+   * @brief Entry of the mapping table of a compressed file.
+   */
+  struct Slot {
+    /**
+     * First granule of the slot; for a free page, the next free page.
+     */
+    std::uint32_t granule;
+
+    /**
+     * Number of bytes stored in the slot; 0 if the page has no slot, and the
+     * page size if the page is stored uncompressed.
+     */
+    std::uint32_t length;
+  };
+
+  /**
+   * Runs of free granules in a compressed file, keyed by their first granule
+   * and mapped to their length.  Guarded by the handle latch.
+   */
+  typedef std::map<std::uint64_t, std::uint64_t> FreeGranules;
+
+  typedef std::map<std::string, std::weak_ptr<FreeGranules> > FreeRegistry;
+
+  /**
+   * Opens the mapping table if the file is compressed, along with the free
+   * granules of the file.
+   *
+   * @param create_new  Whether to create a new mapping table.
+   */
+  void openMap(const bool create_new);
+
+  /**
+   * Finds the free runs of an existing compressed file: the gaps between the
+   * slots recorded in its mapping table.
+   */
+  void findFreeGranules();
+
+  /**
+   * Takes granules for a slot from the first free run large enough, or from
+   * the end of the file.
+   *
+   * @param count   Number of granules needed.
+   * @return  First granule of the slot.
+   */
+  std::uint64_t allocateGranules(const std::uint64_t count);
+
+  /**
+   * Writes a page; the caller holds the handle latch if the file is
+   * compressed.
+   *
+   * @param page_number Number of page whose contents to replace.
+   * @param new_page    Page to write.
+   */
+  void storePage(const PageId page_number, const Page& new_page);
+
+  /**
+   * Reads the mapping table entry of a page.
+   */
+  Slot readSlot(const PageId page_number) const;
+
+  /**
+   * Writes the mapping table entry of a page.
+   */
+  void writeSlot(const PageId page_number, const Slot& slot);
+
+  /**
+   * Returns granules of a compressed file to the free runs, merging them
+   * with the adjacent runs.  The blocks the merged run covers are
+   * hole-punched, and a run at the end of the file is truncated away.
+   *
+   * @param granule     First granule to release.
+   * @param count       Number of granules to release.
+   */
+  void releaseGranules(const std::uint64_t granule, const std::uint64_t count);
+
+  /**
+   * Free pages store the number of the next free page in their first bytes,
+   * or in their mapping table entry if the file is compressed.
+   */
+  PageId nextFreePage(const PageId page_number) const;
+  void setNextFreePage(const PageId page_number, const PageId next);
+  void truncatePages(const PageId num_pages);
+
+  /**
+   * Whether the pages of this file are stored compressed.
+   */
+  bool compressed_;
+
+  /**
+   * Handle for the mapping table of a compressed file.
+   */
+  std::shared_ptr<FileHandle> map_handle_;
+
+  /**
+   * Free granules of a compressed file, shared with the other BlobFile
+   * objects open on it.
+   */
+  std::shared_ptr<FreeGranules> free_granules_;
+
+  /**
+   * Free granules of the compressed files currently open, keyed by file
+   * name.
+   */
+  static FreeRegistry free_registry_;
+
+  /**
+   * Guards free_registry_.
+   */
+  static std::mutex free_registry_mutex_;
 };
 
 }
@@ -0,0 +1,154 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "file_handle.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "exceptions/file_exists_exception.h"
+#include "exceptions/file_io_exception.h"
+#include "exceptions/file_not_found_exception.h"
+
+namespace badgerdb {
+
+FileHandle::Registry FileHandle::registry_;
+std::mutex FileHandle::registry_mutex_;
+
+std::shared_ptr<FileHandle> FileHandle::open(const std::string& filename,
+                                             const bool create_new) {
+  std::lock_guard<std::mutex> guard(registry_mutex_);
+  Registry::iterator found = registry_.find(filename);
+  if (found != registry_.end()) {
+    std::shared_ptr<FileHandle> handle = found->second.lock();
+    if (handle) {
+      if (create_new) {
+        throw FileExistsException(filename);
+      }
+      return handle;
+    }
+  }
+
+  int flags = O_RDWR;
+  if (create_new) {
+    // Error if we try to overwrite an existing file.
+    flags |= O_CREAT | O_EXCL;
+  }
+  const int fd = ::open(filename.c_str(), flags, 0644);
+  if (fd < 0) {
+    if (create_new && errno == EEXIST) {
+      throw FileExistsException(filename);
+    }
+    if (!create_new && errno == ENOENT) {
+      throw FileNotFoundException(filename);
+    }
+    throw FileIOException(filename, "open", errno);
+  }
+
+  std::shared_ptr<FileHandle> handle(new FileHandle(filename, fd));
+  registry_[filename] = handle;
+  return handle;
+}
+
+bool FileHandle::isOpen(const std::string& filename) {
+  std::lock_guard<std::mutex> guard(registry_mutex_);
+  Registry::const_iterator found = registry_.find(filename);
+  return found != registry_.end() && !found->second.expired();
+}
+
+FileHandle::FileHandle(const std::string& filename, const int fd)
+    : filename_(filename),
+      fd_(fd) {
+}
+
+FileHandle::~FileHandle() {
+  ::close(fd_);
+  std::lock_guard<std::mutex> guard(registry_mutex_);
+  // The name may already have been reopened by another thread after our last
+  // reference was dropped; only remove the entry if it is still ours.
+  Registry::iterator found = registry_.find(filename_);
+  if (found != registry_.end() && found->second.expired()) {
+    registry_.erase(found);
+  }
+}
+
+void FileHandle::read(char* data, const std::size_t length,
+                      const std::uint64_t offset) const {
+  std::size_t done = 0;
+  while (done < length) {
+    const ssize_t count = ::pread(fd_, data + done, length - done,
+                                  static_cast<off_t>(offset + done));
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIOException(filename_, "read", errno);
+    }
+    if (count == 0) {
+      // Past the end of the file.
+      std::memset(data + done, 0, length - done);
+      break;
+    }
+    done += count;
+  }
+}
+
+void FileHandle::write(const char* data, const std::size_t length,
+                       const std::uint64_t offset) {
+  std::size_t done = 0;
+  while (done < length) {
+    const ssize_t count = ::pwrite(fd_, data + done, length - done,
+                                   static_cast<off_t>(offset + done));
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw FileIOException(filename_, "write", errno);
+    }
+    done += count;
+  }
+}
+
+void FileHandle::punchHole(const std::uint64_t offset,
+                           const std::uint64_t length) {
+#ifdef FALLOC_FL_PUNCH_HOLE
+  if (::fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  static_cast<off_t>(offset),
+                  static_cast<off_t>(length)) != 0 &&
+      errno != EOPNOTSUPP && errno != ENOSYS) {
+    throw FileIOException(filename_, "punch a hole in", errno);
+  }
+#else
+  (void)offset;
+  (void)length;
+#endif
+}
+
+void FileHandle::truncate(const std::uint64_t length) {
+  if (::ftruncate(fd_, static_cast<off_t>(length)) != 0) {
+    throw FileIOException(filename_, "truncate", errno);
+  }
+}
+
+std::uint64_t FileHandle::size() const {
+  struct stat info;
+  if (::fstat(fd_, &info) != 0) {
+    throw FileIOException(filename_, "stat", errno);
+  }
+  return info.st_size;
+}
+
+void FileHandle::sync() {
+  if (::fsync(fd_) != 0) {
+    throw FileIOException(filename_, "sync", errno);
+  }
+}
+
+}
@@ -0,0 +1,175 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace badgerdb {
+
+/**
+ * @brief An open operating system file shared by every File object that
+ *        refers to the same name.
+ *
+ * Handles are handed out by the process-wide registry in open(); while any
+ * File holds a handle for a name, opening that name again returns the same
+ * handle.  The descriptor is closed when the last holder releases it.
+ *
+ * All reads and writes are positional, so threads sharing a handle never
+ * contend for a seek position and may read concurrently.  Callers that
+ * perform a read-modify-write of file metadata (such as page allocation)
+ * serialize on the handle itself, which satisfies the standard Lockable
+ * requirements.
+ */
+class FileHandle {
+ public:
+  /**
+   * Returns the handle for the given file, opening the file if no handle is
+   * currently registered for it.
+   *
+   * @param filename    Name of file.
+   * @param create_new  Whether to create (and truncate) a new file.
+   * @return  Shared handle for the file.
+   * @throws  FileExistsException     If the file exists and create_new is
+   *                                  true.
+   * @throws  FileNotFoundException   If the file doesn't exist and create_new
+   *                                  is false.
+   * @throws  FileIOException         If the operating system refuses to open
+   *                                  the file.
+   */
+  static std::shared_ptr<FileHandle> open(const std::string& filename,
+                                          const bool create_new);
+
+  /**
+   * Returns true if a handle for the given file is currently registered.
+   *
+   * @param filename  Name of the file.
+   */
+  static bool isOpen(const std::string& filename);
+
+  /**
+   * Closes the underlying descriptor and unregisters the handle.
+   */
+  ~FileHandle();
+
+  /**
+   * Reads bytes from the file at the given offset.  Bytes past the end of the
+   * file read as zero.
+   *
+   * @param data    Buffer to fill.
+   * @param length  Number of bytes to read.
+   * @param offset  Offset from the beginning of the file.
+   * @throws  FileIOException   If the read fails.
+   */
+  void read(char* data, const std::size_t length,
+            const std::uint64_t offset) const;
+
+  /**
+   * Writes bytes to the file at the given offset.
+   *
+   * @param data    Bytes to write.
+   * @param length  Number of bytes to write.
+   * @param offset  Offset from the beginning of the file.
+   * @throws  FileIOException   If the write fails.
+   */
+  void write(const char* data, const std::size_t length,
+             const std::uint64_t offset);
+
+  /**
+   * Releases the storage behind a range of the file without changing its
+   * size; the range reads as zeroes afterwards.  Filesystems that cannot
+   * punch holes keep the storage, which is not an error.
+   *
+   * @param offset  Offset from the beginning of the file.
+   * @param length  Number of bytes to release.
+   * @throws  FileIOException   If the operation fails.
+   */
+  void punchHole(const std::uint64_t offset, const std::uint64_t length);
+
+  /**
+   * Cuts the file off at the given size.
+   *
+   * @param length  New size of the file in bytes.
+   * @throws  FileIOException   If the operation fails.
+   */
+  void truncate(const std::uint64_t length);
+
+  /**
+   * Returns the current size of the file in bytes.
+   *
+   * @throws  FileIOException   If the size cannot be determined.
+   */
+  std::uint64_t size() const;
+
+  /**
+   * Forces written data to stable storage.
+   *
+   * @throws  FileIOException   If the sync fails.
+   */
+  void sync();
+
+  /**
+   * Acquires the latch guarding read-modify-write updates of the file.
+   */
+  void lock() { latch_.lock(); }
+
+  /**
+   * Releases the latch acquired by lock().
+   */
+  void unlock() { latch_.unlock(); }
+
+  /**
+   * Returns the name of the file this handle refers to.
+   */
+  const std::string& filename() const { return filename_; }
+
+ private:
+  typedef std::map<std::string, std::weak_ptr<FileHandle> > Registry;
+
+  /**
+   * Constructs a handle around an open descriptor.
+   *
+   * @param filename  Name of file.
+   * @param fd        Open descriptor for the file.
+   */
+  FileHandle(const std::string& filename, const int fd);
+
+  FileHandle(const FileHandle&) = delete;
+  FileHandle& operator=(const FileHandle&) = delete;
+
+  /**
+   * Handles of currently open files, keyed by file name.
+   */
+  static Registry registry_;
+
+  /**
+   * Guards registry_.
+   */
+  static std::mutex registry_mutex_;
+
+  /**
+   * Name of the file.
+   */
+  const std::string filename_;
+
+  /**
+   * Descriptor of the underlying file.
+   */
+  const int fd_;
+
+  /**
+   * Latch taken by lock() and unlock().
+   */
+  std::mutex latch_;
+};
+
+}
@@ -66,6 +66,22 @@ class FileIterator {
 		return *this;
 	}
 
+  /**
+   * Advances the iterator to the page following the current one, using the
+   * next page link of the current page as the caller already holds it (e.g.
+   * pinned in the buffer pool) instead of reading the page header from disk.
+   * The caller's copy must be up to date, i.e. read after the page was last
+   * linked into the file.
+   *
+   * @param current_page  Current page of the iterator.
+   */
+	inline FileIterator& advance(const Page& current_page) {
+    assert(current_page.page_number() == current_page_number_);
+    current_page_number_ = current_page.next_page_number();
+
+		return *this;
+	}
+
 	//postfix
 	inline FileIterator operator++(int)
 	{
@@ -103,6 +119,13 @@ class FileIterator {
 	inline Page operator*() const
   { return file_->readPage(current_page_number_); }
 
+  /**
+   * Returns the number of the current page without reading it.
+   *
+   * @return  Number of current page in file.
+   */
+	inline PageId page_number() const { return current_page_number_; }
+
  private:
   /**
    * File we're iterating over.
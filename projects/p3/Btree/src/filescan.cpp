@@ -6,16 +6,240 @@
  */
 
 #include "filescan.h"
+
+#include <algorithm>
+#include <cstring>
+
 #include "exceptions/end_of_file_exception.h"
 
-namespace badgerdb { 
+namespace badgerdb {
+
+PageRecords::PageRecords(const ScanPredicate *predicate)
+    : predicate_(predicate),
+      page_(NULL),
+      pax_(false)
+{
+}
+
+// collects the used slots of the page in one call; the slot list keeps its
+// capacity from page to page
+void PageRecords::load(Page *page)
+{
+  page_ = page;
+  pax_ = PaxPage::isFormatted(*page_);
+  if (pax_)
+  {
+    PaxPage(page_).getUsedSlots(slots_);
+  }
+  else
+  {
+    page_->getUsedSlots(slots_);
+  }
+  if (predicate_ != NULL)
+  {
+    filter();
+  }
+}
+
+std::string PageRecords::record(const std::size_t i) const
+{
+  if (pax_)
+  {
+    return PaxPage(page_).getRecord(recordId(i));
+  }
+  return page_->getRecord(recordId(i));
+}
+
+RecordView PageRecords::view(const std::size_t i)
+{
+  if (pax_)
+  {
+    PaxPage paxPage(page_);
+    record_.resize(paxPage.record_length());
+    paxPage.getRecord(recordId(i), &record_[0]);
+    const RecordView view = {record_.data(), record_.size()};
+    return view;
+  }
+  return page_->getRecordView(recordId(i));
+}
+
+void PageRecords::views(const std::size_t i, const std::size_t count,
+                        RecordView *out)
+{
+  if (!pax_)
+  {
+    for (std::size_t k = 0; k < count; k++)
+    {
+      out[k] = page_->getRecordView(recordId(i + k));
+    }
+    return;
+  }
+
+  PaxPage paxPage(page_);
+  const std::size_t length = paxPage.record_length();
+  record_.resize(count * length);
+  for (std::size_t k = 0; k < count; k++)
+  {
+    char* data = &record_[k * length];
+    paxPage.getRecord(recordId(i + k), data);
+    out[k].data = data;
+    out[k].length = length;
+  }
+}
+
+void PageRecords::project(const std::size_t i, const std::size_t count,
+                          const std::vector<PaxAttribute> &attributes,
+                          char *out)
+{
+  std::size_t width = 0;
+  for (std::size_t a = 0; a < attributes.size(); a++)
+  {
+    width += attributes[a].length;
+  }
+
+  // one attribute at a time, so a PAX attribute is copied from a single
+  // mini-page
+  std::size_t position = 0;
+  for (std::size_t a = 0; a < attributes.size(); a++)
+  {
+    copyAttribute(i, count, attributes[a], out + position, width);
+    position += attributes[a].length;
+  }
+}
+
+void PageRecords::projectColumns(const std::size_t i, const std::size_t count,
+                                 const std::vector<PaxAttribute> &attributes,
+                                 char *const *columns)
+{
+  for (std::size_t a = 0; a < attributes.size(); a++)
+  {
+    copyAttribute(i, count, attributes[a], columns[a], attributes[a].length);
+  }
+}
+
+void PageRecords::copyAttribute(const std::size_t i, const std::size_t count,
+                                const PaxAttribute &wanted, char *out,
+                                const std::size_t stride)
+{
+  const char* values = NULL;
+  std::size_t valueStride = 0;
+  if (pax_)
+  {
+    PaxPage paxPage(page_);
+    const int attr = paxPage.findAttribute(wanted.offset, wanted.length);
+    if (attr >= 0)
+    {
+      valueStride = paxPage.attribute(attr).length;
+      values = paxPage.column(attr) +
+          (wanted.offset - paxPage.attribute(attr).offset);
+    }
+  }
+
+  for (std::size_t k = 0; k < count; k++)
+  {
+    char* field = out + k * stride;
+    const char* value = values != NULL
+        ? values + (slots_[i + k] - 1) * valueStride
+        : attribute(i + k, wanted.offset, wanted.length);
+    if (value != NULL)
+    {
+      std::memcpy(field, value, wanted.length);
+    }
+    else
+    {
+      std::memset(field, 0, wanted.length);
+    }
+  }
+}
+
+// on PAX pages the bytes are read straight from the attribute's mini-page
+const char* PageRecords::attribute(const std::size_t i,
+                                   const std::size_t offset,
+                                   const std::size_t length)
+{
+  if (pax_)
+  {
+    const char* field = PaxPage(page_).getField(recordId(i), offset, length);
+    if (field != NULL)
+    {
+      return field;
+    }
+  }
+  const RecordView record = view(i);
+  if (offset + length > record.length)
+  {
+    return NULL;
+  }
+  return record.data + offset;
+}
+
+// tests the predicate on every record of the page at once, keeping the slots
+// that pass in order
+void PageRecords::filter()
+{
+  const std::size_t offset = predicate_->offset();
+  const std::size_t length = predicate_->length();
+  std::size_t kept = 0;
+
+  if (pax_)
+  {
+    PaxPage paxPage(page_);
+    const int attr = paxPage.findAttribute(offset, length);
+    if (attr >= 0)
+    {
+      // the attribute's values lie side by side in its mini-page
+      const std::size_t stride = paxPage.attribute(attr).length;
+      const char* values =
+          paxPage.column(attr) + (offset - paxPage.attribute(attr).offset);
+      for (std::size_t i = 0; i < slots_.size(); i++)
+      {
+        const SlotId slot = slots_[i];
+        if (predicate_->matches(values + (slot - 1) * stride))
+        {
+          slots_[kept++] = slot;
+        }
+      }
+      slots_.resize(kept);
+      return;
+    }
+  }
+
+  for (std::size_t i = 0; i < slots_.size(); i++)
+  {
+    const RecordView record = view(i);
+    if (offset + length <= record.length &&
+        predicate_->matches(record.data + offset))
+    {
+      slots_[kept++] = slots_[i];
+    }
+  }
+  slots_.resize(kept);
+}
 
 FileScan::FileScan(const std::string &name, BufMgr *bufferMgr)
+    : predicate(NULL),
+      pageRecords(NULL)
 {
   file = new PageFile(name, false);	//dont create new file
 	bufMgr = bufferMgr;
 	curDirtyFlag = false;
   curPage = NULL;
+  recordIndex = 0;
+  projectionLength = 0;
+	filePageIter = file->begin();
+}
+
+FileScan::FileScan(const std::string &name, BufMgr *bufferMgr,
+                   const ScanPredicate &scanPredicate)
+    : predicate(new ScanPredicate(scanPredicate)),
+      pageRecords(predicate)
+{
+  file = new PageFile(name, false);	//dont create new file
+	bufMgr = bufferMgr;
+	curDirtyFlag = false;
+  curPage = NULL;
+  recordIndex = 0;
+  projectionLength = 0;
 	filePageIter = file->begin();
 }
 
@@ -24,22 +248,91 @@ FileScan::~FileScan()
   // generally must unpin last page of the scan
   if (curPage != NULL)
   {
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
+    bufMgr->unPinPage(file, filePageIter.page_number(), curDirtyFlag);
     curPage = NULL;
 		curDirtyFlag = false;
     filePageIter = file->begin();
   }
   bufMgr->flushFile(file);
   delete file;
+  delete predicate;
 }
 
 void FileScan::scanNext(RecordId& outRid)
 {
-  std::string rec;
+  if (!advance())
+  {
+		throw EndOfFileException();
+  }
+	outRid = pageRecords.recordId(recordIndex);
+}
+
+std::size_t FileScan::scanNextBatch(RecordId *rids, RecordView *views,
+                                    const std::size_t max)
+{
+  const std::size_t count = nextBatch(rids, max);
+  if (count > 0 && views != NULL)
+  {
+    pageRecords.views(recordIndex + 1 - count, count, views);
+  }
+  return count;
+}
+
+void FileScan::setProjection(const std::vector<PaxAttribute> &attributes)
+{
+  projection = attributes;
+  projectionLength = 0;
+  for (std::size_t a = 0; a < projection.size(); a++)
+  {
+    projectionLength += projection[a].length;
+  }
+}
+
+std::size_t FileScan::scanNextProjected(RecordId *rids, char *out,
+                                        const std::size_t max)
+{
+  const std::size_t count = nextBatch(rids, max);
+  if (count > 0)
+  {
+    pageRecords.project(recordIndex + 1 - count, count, projection, out);
+  }
+  return count;
+}
+
+std::size_t FileScan::scanNextColumns(RecordId *rids, char *const *columns,
+                                      const std::size_t max)
+{
+  const std::size_t count = nextBatch(rids, max);
+  if (count > 0)
+  {
+    pageRecords.projectColumns(recordIndex + 1 - count, count, projection,
+                               columns);
+  }
+  return count;
+}
+
+std::size_t FileScan::nextBatch(RecordId *rids, const std::size_t max)
+{
+  if (max == 0 || !advance())
+  {
+    return 0;
+  }
 
+  // the rest of the current page, up to max records
+  const std::size_t count = std::min(max, pageRecords.size() - recordIndex);
+  for (std::size_t k = 0; k < count; k++)
+  {
+    rids[k] = pageRecords.recordId(recordIndex + k);
+  }
+  recordIndex += count - 1;
+  return count;
+}
+
+bool FileScan::advance()
+{
   if (filePageIter == file->end())
 	{
-		throw EndOfFileException();
+		return false;
 	}
 
   // special case of the first record of the first page of the file
@@ -49,66 +342,70 @@ void FileScan::scanNext(RecordId& outRid)
 		filePageIter = file->begin();
     if(filePageIter == file->end())
 		{
-			throw EndOfFileException();
+			return false;
 		}
-	 
+
 		// read the first page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage); 
+    bufMgr->readPage(file, filePageIter.page_number(), curPage);
 		curDirtyFlag = false;
 
 		// get the first record off the page
-    pageRecordIter = curPage->begin(); 
-
-		if(pageRecordIter != curPage->end()) 
-		{
-		  // get pointer to record
-		  rec = *pageRecordIter;
-
-			outRid = pageRecordIter.getCurrentRecord();
-			return;
-		}
+    pageRecords.load(curPage);
+    recordIndex = 0;
+  }
+  else
+  {
+    // try and get the next record off the current page
+    recordIndex++;
   }
 
-	// Loop, looking for a record that satisfied the predicate.
-	// First try and get the next record off the current page
-	pageRecordIter++;
-
-  while (pageRecordIter == curPage->end())
+  while (recordIndex >= pageRecords.size())
   {
-    // unpin the current page
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
+    // follow the link of the pinned page, then unpin it; the scan's file is
+    // only read through the buffer pool, so the link is current and the next
+    // page costs a single read
+    const PageId pageNo = filePageIter.page_number();
+    filePageIter.advance(*curPage);
+    bufMgr->unPinPage(file, pageNo, curDirtyFlag);
     curPage = NULL;
     curDirtyFlag = false;
 
-    filePageIter++;
     if (filePageIter == file->end())
     {
-      curPage = NULL;
-			throw EndOfFileException();
+			return false;
     }
 
     // read the next page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage);
+    bufMgr->readPage(file, filePageIter.page_number(), curPage);
 
     // get the first record off the page
-    pageRecordIter = curPage->begin(); 
+    pageRecords.load(curPage);
+    recordIndex = 0;
   }
-
-  // curRec points at a valid record
-  // see if the record satisfies the scan's predicate 
-  // get a pointer to the record
-  rec = *pageRecordIter;
-
-	// return rid of the record
-	outRid = pageRecordIter.getCurrentRecord();
-	return;
+  return true;
 }
 
 // returns pointer to the current record.  page is left pinned
-// and the scan logic is required to unpin the page 
+// and the scan logic is required to unpin the page
 std::string FileScan::getRecord()
 {
-  return *pageRecordIter;
+  return pageRecords.record(recordIndex);
+}
+
+// returns a view of the current record; it points into the pinned page
+// (or, for PAX pages, into a buffer the record is reassembled in) and is
+// valid until the scan moves on
+RecordView FileScan::getRecordView()
+{
+  return pageRecords.view(recordIndex);
+}
+
+// returns the bytes at the given offset of the current record; on PAX pages
+// they are read straight from the attribute's mini-page
+const char* FileScan::getAttribute(const std::size_t offset,
+                                   const std::size_t length)
+{
+  return pageRecords.attribute(recordIndex, offset, length);
 }
 
 // mark current page of scan dirty
@@ -9,16 +9,179 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include "types.h"
 #include "page.h"
 #include "buffer.h"
 #include "file_iterator.h"
 #include "page_iterator.h"
+#include "pax_page.h"
+#include "scan_predicate.h"
 
 namespace badgerdb {
 
+/**
+ * @brief The records a scan returns from one pinned page.
+ *
+ * load() collects the used slots of a page in one call and, if there is a
+ * predicate, drops the slots whose records fail it.  The predicate is tested
+ * on the record bytes in the page (on PAX pages, on the attribute's
+ * mini-page), so records that fail it are never copied.  Both slotted pages
+ * and PAX pages (see PaxPage) are handled.
+ *
+ * Each scan, and each worker of a parallel scan, has its own PageRecords.
+ */
+class PageRecords
+{
+ public:
+  /**
+   * Constructs an empty set of records.
+   *
+   * @param predicate   Predicate the records satisfy, or NULL for all of
+   *                    them.  It must outlive this object.
+   */
+  explicit PageRecords(const ScanPredicate *predicate = NULL);
+
+  /**
+   * Collects the records of the given page that satisfy the predicate.
+   *
+   * @param page  Pinned page.
+   */
+  void load(Page *page);
+
+  /**
+   * Returns the page the records are on.
+   */
+  Page* page() const { return page_; }
+
+  /**
+   * Returns the number of records.
+   */
+  std::size_t size() const { return slots_.size(); }
+
+  /**
+   * Returns the ID of the i-th record.
+   */
+  RecordId recordId(const std::size_t i) const
+  {
+    const RecordId rid = {page_->page_number(), slots_[i]};
+    return rid;
+  }
+
+  /**
+   * Returns a copy of the i-th record.
+   */
+  std::string record(const std::size_t i) const;
+
+  /**
+   * Returns a view of the i-th record.  It points into the page or, for PAX
+   * pages, into a buffer the record is reassembled in, and is valid until the
+   * next call to view() or load().
+   */
+  RecordView view(const std::size_t i);
+
+  /**
+   * Fills <out> with views of <count> records starting at the i-th.  PAX
+   * records are reassembled side by side in one buffer, so the views stay
+   * valid together until the next call to view(), views() or load().
+   *
+   * @param i       Index of first record.
+   * @param count   Number of records.
+   * @param out     Array of at least count views.
+   */
+  void views(const std::size_t i, const std::size_t count, RecordView *out);
+
+  /**
+   * Copies the given attributes of <count> records starting at the i-th into
+   * <out>, one row of attributes after another with no padding.  On PAX
+   * pages the values are copied straight from the attributes' mini-pages.
+   * Bytes past the end of a short record are zero-filled.
+   *
+   * @param i           Index of first record.
+   * @param count       Number of records.
+   * @param attributes  Attributes to copy, in the order they are wanted.
+   * @param out         Buffer of at least count rows of the attributes.
+   */
+  void project(const std::size_t i, const std::size_t count,
+               const std::vector<PaxAttribute> &attributes, char *out);
+
+  /**
+   * Like project(), but copies each attribute into its own array: the values
+   * of attribute a of the <count> records go side by side in columns[a].
+   *
+   * @param i           Index of first record.
+   * @param count       Number of records.
+   * @param attributes  Attributes to copy.
+   * @param columns     For each attribute, an array of at least count values.
+   */
+  void projectColumns(const std::size_t i, const std::size_t count,
+                      const std::vector<PaxAttribute> &attributes,
+                      char *const *columns);
+
+  /**
+   * Returns the <length> bytes at <offset> of the i-th record, read in place
+   * where possible, or NULL if the record is shorter than that.  Valid until
+   * the next call to view(), attribute() or load().
+   */
+  const char* attribute(const std::size_t i, const std::size_t offset,
+                        const std::size_t length);
+
+ private:
+  /**
+   * Drops the slots whose records fail the predicate.
+   */
+  void filter();
+
+  /**
+   * Copies one attribute of <count> records starting at the i-th to <out>,
+   * one value every <stride> bytes.
+   */
+  void copyAttribute(const std::size_t i, const std::size_t count,
+                     const PaxAttribute &wanted, char *out,
+                     const std::size_t stride);
+
+  /**
+   * Predicate the records satisfy; NULL for all of them.
+   */
+  const ScanPredicate *predicate_;
+
+  /**
+   * Page the records are on.
+   */
+  Page *page_;
+
+  /**
+   * True if the page is a PAX page.
+   */
+  bool pax_;
+
+  /**
+   * Slots of the records, in page order.
+   */
+  std::vector<SlotId> slots_;
+
+  /**
+   * Buffer PAX records are reassembled in by view() and views().
+   */
+  std::string record_;
+};
+
 /**
  * @brief This class is used to sequentially scan records in a relation.
+ *
+ * Pages are only read through the buffer manager and the scan follows the
+ * page links of the pages it has pinned, so each page of the relation costs
+ * at most one disk read.  Both slotted pages and PAX pages (see PaxPage) are
+ * scanned.
+ *
+ * A scan built with a ScanPredicate only returns the records that satisfy
+ * it; see PageRecords.
+ *
+ * scanNextBatch() returns the records of a page in batches, without the
+ * per-record call of scanNext() or an exception at the end of the relation.
+ * With a projection set, scanNextProjected() returns batches of just the
+ * attributes asked for, packed into a caller's buffer, instead of records;
+ * scanNextColumns() returns them one array per attribute.
  */
 class FileScan
 {
@@ -26,18 +189,104 @@ class FileScan
 
   FileScan(const std::string &name, BufMgr *bufMgr);
 
+  FileScan(const std::string &name, BufMgr *bufMgr,
+           const ScanPredicate &predicate);
+
   ~FileScan();
 
-  //return RecordId of next record that satisfies the scan 
+  //return RecordId of next record that satisfies the scan
   void scanNext(RecordId& outRid);
 
-  //read current record, returning pointer and length
+  /**
+   * Returns up to <max> of the next records that satisfy the scan.  A batch
+   * never spans pages, so it may hold fewer than max records even before the
+   * end of the relation.  The last record of the batch becomes the current
+   * record.
+   *
+   * @param rids    Array of at least max record IDs to fill.
+   * @param views   Array of at least max views to fill, or NULL.  The views
+   *                are valid until the scan moves on or the current record
+   *                is read.
+   * @param max     Most records to return.
+   * @return  Number of records returned; 0 once the scan is at the end of the
+   *          relation.
+   */
+  std::size_t scanNextBatch(RecordId *rids, RecordView *views,
+                            const std::size_t max);
+
+  /**
+   * Sets the attributes scanNextProjected() extracts from each record.
+   *
+   * @param attributes  Attributes to extract, in the order they are wanted.
+   */
+  void setProjection(const std::vector<PaxAttribute> &attributes);
+
+  /**
+   * Returns the length of a row of the projected attributes.
+   */
+  std::size_t projectedLength() const { return projectionLength; }
+
+  /**
+   * Like scanNextBatch(), but instead of views of the records copies their
+   * projected attributes into <out>, one row of projectedLength() bytes per
+   * record.
+   *
+   * @param rids    Array of at least max record IDs to fill.
+   * @param out     Buffer of at least max rows to fill.
+   * @param max     Most records to return.
+   * @return  Number of records returned; 0 once the scan is at the end of the
+   *          relation.
+   */
+  std::size_t scanNextProjected(RecordId *rids, char *out,
+                                const std::size_t max);
+
+  /**
+   * Like scanNextProjected(), but copies projected attribute a of the
+   * records into columns[a], the values side by side.
+   *
+   * @param rids      Array of at least max record IDs to fill.
+   * @param columns   For each projected attribute, an array of at least max
+   *                  values to fill.
+   * @param max       Most records to return.
+   * @return  Number of records returned; 0 once the scan is at the end of the
+   *          relation.
+   */
+  std::size_t scanNextColumns(RecordId *rids, char *const *columns,
+                              const std::size_t max);
+
+  //read current record, returning a copy of it
   std::string getRecord();
 
+  //view current record without copying; valid until the next scanNext
+  RecordView getRecordView();
+
+  //read <length> bytes at <offset> of current record without copying; valid
+  //until the next scanNext.  NULL if the record is shorter than that
+  const char* getAttribute(const std::size_t offset, const std::size_t length);
+
   //marks current page of scan dirty
   void markDirty();
 
  private:
+  FileScan(const FileScan&) = delete;
+  FileScan& operator=(const FileScan&) = delete;
+
+  /**
+   * Moves the scan to the next record, pinning the next page of the relation
+   * once the current one is used up.
+   *
+   * @return  False if there are no records left.
+   */
+  bool advance();
+
+  /**
+   * Advances to the next batch of up to <max> records on one page and fills
+   * in their IDs.  The scan is left at the last record of the batch.
+   *
+   * @return  Number of records in the batch; 0 at the end of the relation.
+   */
+  std::size_t nextBatch(RecordId *rids, const std::size_t max);
+
   /**
    * File which is being scanned.
    */
@@ -54,7 +303,23 @@ class FileScan
   Page*         curPage;
 
   FileIterator  filePageIter;
-  PageIterator  pageRecordIter;
+
+  /**
+   * Predicate the returned records satisfy; NULL to return every record.
+   */
+  ScanPredicate *predicate;
+
+  /**
+   * Records of the current page and the position of the scan in them.
+   */
+  PageRecords   pageRecords;
+  std::size_t   recordIndex;
+
+  /**
+   * Attributes scanNextProjected() and scanNextColumns() extract and the length of their row.
+   */
+  std::vector<PaxAttribute> projection;
+  std::size_t   projectionLength;
 
   /**
    * True if page has been updated
@@ -0,0 +1,191 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "page.h"
+#include "pax_page.h"
+#include "types.h"
+#include "exceptions/bad_page_format_exception.h"
+#include "exceptions/insufficient_space_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief View of a page holding records of exactly RECORD_SIZE bytes.
+ *
+ * Records are stored back to back in an array, so a record is found by
+ * multiplying its slot number by the compile-time record size; occupancy is
+ * kept in a bitmap of one bit per record.  There is no per-record slot
+ * entry, so a page holds nearly DATA_SIZE / RECORD_SIZE records.
+ *
+ * The layout is that of a PaxPage with a single attribute spanning the whole
+ * record, so fixed-length pages can be read by anything that handles PAX
+ * pages (FileScan, RelationLoader).  A FixedPage only points to the page it
+ * was made from; it does not own it.
+ *
+ * @warning This class is not threadsafe.
+ */
+template <std::size_t RECORD_SIZE>
+class FixedPage {
+  static_assert(RECORD_SIZE > 0 && RECORD_SIZE <= UINT16_MAX,
+                "Record size must fit the page's record length field.");
+
+ public:
+  /**
+   * Lays out an empty page as a fixed-length page for RECORD_SIZE records.
+   *
+   * @param page  Page to format; it must hold no records.
+   * @return  View of the formatted page.
+   * @throws  BadPageFormatException  If the page holds records or no record
+   *                                  fits.
+   */
+  static FixedPage format(Page* page) {
+    std::vector<PaxAttribute> attributes(1);
+    attributes[0].offset = 0;
+    attributes[0].length = RECORD_SIZE;
+    PaxPage::format(page, RECORD_SIZE, attributes);
+    return FixedPage(page);
+  }
+
+  /**
+   * Returns true if the page is a fixed-length page for RECORD_SIZE records.
+   *
+   * @param page  Page to check.
+   * @return  Whether the page has this layout.
+   */
+  static bool isFormatted(const Page& page) {
+    if (!PaxPage::isFormatted(page)) {
+      return false;
+    }
+    const PaxPage pax(const_cast<Page*>(&page));
+    return pax.record_length() == RECORD_SIZE && pax.num_attributes() == 1 &&
+        pax.attribute(0).offset == 0 && pax.attribute(0).length == RECORD_SIZE;
+  }
+
+  /**
+   * Constructs a view of a page already formatted for RECORD_SIZE records.
+   *
+   * @param page  Fixed-length page.
+   * @throws  BadPageFormatException  If the page has another layout.
+   */
+  explicit FixedPage(Page* page)
+      : pax_(page) {
+    if (!isFormatted(*page)) {
+      throw BadPageFormatException(page->page_number(),
+                                   "not a fixed-length page of this size");
+    }
+    records_ = pax_.columnData(0);
+  }
+
+  /**
+   * Inserts a new record into the page.
+   *
+   * @param record_data  RECORD_SIZE bytes that compose the record.
+   * @return  ID of the newly inserted record.
+   * @throws  InsufficientSpaceException  If the page is full.
+   */
+  RecordId insertRecord(const void* record_data) {
+    if (!hasSpaceForRecord()) {
+      throw InsufficientSpaceException(pax_.page_->page_number(), RECORD_SIZE,
+                                       0);
+    }
+    const SlotId slot_number = pax_.takeSlot();
+    memcpy(record(slot_number), record_data, RECORD_SIZE);
+    return {pax_.page_->page_number(), slot_number};
+  }
+
+  /**
+   * Returns the record with the given ID.  The pointer refers to the page
+   * itself and stays valid while the page is in memory and the record is
+   * not deleted.
+   *
+   * @param record_id  ID of the record to return.
+   * @return  First byte of the record.
+   * @throws  InvalidRecordException  If the ID has a bad page or slot number.
+   */
+  const char* getRecord(const RecordId& record_id) const {
+    pax_.validateRecordId(record_id);
+    return record(record_id.slot_number);
+  }
+
+  /**
+   * Replaces the data of the record with the given ID.
+   *
+   * @param record_id    ID of record to update.
+   * @param record_data  RECORD_SIZE bytes that compose the record.
+   * @throws  InvalidRecordException  If the ID has a bad page or slot number.
+   */
+  void updateRecord(const RecordId& record_id, const void* record_data) {
+    pax_.validateRecordId(record_id);
+    memcpy(record(record_id.slot_number), record_data, RECORD_SIZE);
+  }
+
+  /**
+   * Deletes the record with the given ID.  The other records do not move.
+   *
+   * @param record_id  ID of the record to delete.
+   * @throws  InvalidRecordException  If the ID has a bad page or slot number.
+   */
+  void deleteRecord(const RecordId& record_id) {
+    pax_.validateRecordId(record_id);
+    memset(record(record_id.slot_number), '\0', RECORD_SIZE);
+    pax_.releaseSlot(record_id.slot_number);
+  }
+
+  /**
+   * Returns true if the page has room for another record.
+   */
+  bool hasSpaceForRecord() const { return pax_.hasSpaceForRecord(); }
+
+  /**
+   * Returns the next used slot in the page after the given slot or
+   * Page::INVALID_SLOT if no slots are used after the given slot.
+   *
+   * @param start   Slot to start search at; Page::INVALID_SLOT starts at the
+   *                first slot.
+   * @return  Next used slot after given slot or Page::INVALID_SLOT.
+   */
+  SlotId getNextUsedSlot(const SlotId start) const {
+    return pax_.getNextUsedSlot(start);
+  }
+
+  /**
+   * Returns the number of records the page can hold.
+   */
+  std::uint16_t capacity() const { return pax_.capacity(); }
+
+  /**
+   * Returns the number of records in the page.
+   */
+  std::uint16_t num_records() const { return pax_.num_records(); }
+
+ private:
+  /**
+   * Returns the storage of the record in the given slot.
+   */
+  char* record(const SlotId slot_number) const {
+    return records_ + (slot_number - 1) * RECORD_SIZE;
+  }
+
+  /**
+   * PAX view of the page, which keeps the occupancy bitmap.
+   */
+  PaxPage pax_;
+
+  /**
+   * Start of the record array.
+   */
+  char* records_;
+};
+
+}
@@ -0,0 +1,424 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "hash_aggregate.h"
+
+#include <cstring>
+#include <sstream>
+
+#include "file.h"
+#include "filescan.h"
+#include "scan_predicate.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Group index of an empty slot.
+ */
+const std::uint32_t EMPTY_SLOT = 0xffffffff;
+
+/**
+ * Slots of a table before it first grows.
+ */
+const std::size_t INITIAL_SLOTS = 16;
+
+/**
+ * Hash bits that pick the spill file of a row at each level, and the levels
+ * there are bits for.
+ */
+const std::size_t SPILL_BITS = 4;
+const std::size_t SPILL_LEVELS = 64 / SPILL_BITS;
+
+/**
+ * Records read from a spill file at once.
+ */
+const std::size_t SPILL_BATCH = 64;
+
+/**
+ * Rewrites a value so that values comparing equal have equal bytes: a
+ * string is cleared past its first NUL and -0.0 becomes 0.0.
+ */
+void normalize(const ColumnType& column, char* value) {
+  if (column.type == STRING) {
+    char* end = static_cast<char*>(std::memchr(value, '\0', column.length));
+    if (end != NULL) {
+      std::memset(end, 0, value + column.length - end);
+    }
+  } else if (column.type == DOUBLE) {
+    double v;
+    std::memcpy(&v, value, sizeof(double));
+    if (v == 0) {
+      v = 0;
+      std::memcpy(value, &v, sizeof(double));
+    }
+  }
+}
+
+/**
+ * Returns a numeric value as a double.
+ */
+double toDouble(const Datatype type, const char* value) {
+  if (type == INTEGER) {
+    int v;
+    std::memcpy(&v, value, sizeof(int));
+    return v;
+  }
+  double v;
+  std::memcpy(&v, value, sizeof(double));
+  return v;
+}
+
+}
+
+const std::size_t HashAggregateOperator::DEFAULT_MEMORY;
+const std::size_t HashAggregateOperator::SPILL_PARTITIONS;
+
+HashAggregateOperator::HashAggregateOperator(
+    std::unique_ptr<BatchOperator> input,
+    const std::vector<std::size_t>& groups,
+    const std::vector<Aggregate>& aggregates, BufMgr* bufMgr,
+    const std::string& spill_prefix, const std::size_t memory_bytes)
+    : input_(std::move(input)),
+      groups_(groups),
+      aggregates_(aggregates),
+      key_width_(0),
+      buf_mgr_(bufMgr),
+      spill_prefix_(spill_prefix),
+      memory_bytes_(memory_bytes),
+      spills_written_(0),
+      level_(0),
+      input_done_(false),
+      table_ready_(false),
+      next_group_(0) {
+  const BatchSchema& inputSchema = input_->schema();
+  for (std::size_t g = 0; g < groups_.size(); ++g) {
+    schema_.push_back(inputSchema[groups_[g]]);
+    key_width_ += inputSchema[groups_[g]].length;
+  }
+
+  row_width_ = key_width_;
+  group_width_ = key_width_ + sizeof(std::int64_t);
+  for (std::size_t a = 0; a < aggregates_.size(); ++a) {
+    const Aggregate& aggregate = aggregates_[a];
+    ColumnType output;
+    value_offsets_.push_back(row_width_);
+    state_offsets_.push_back(group_width_);
+    switch (aggregate.function) {
+      case COUNT:
+        output.type = INTEGER;
+        output.length = sizeof(int);
+        break;
+      case SUM:
+      case AVG:
+        output.type = DOUBLE;
+        output.length = sizeof(double);
+        row_width_ += inputSchema[aggregate.column].length;
+        group_width_ += sizeof(double);
+        break;
+      default:
+        output = inputSchema[aggregate.column];
+        row_width_ += output.length;
+        group_width_ += output.length;
+        break;
+    }
+    schema_.push_back(output);
+  }
+  slots_.assign(INITIAL_SLOTS, Slot{0, EMPTY_SLOT});
+}
+
+HashAggregateOperator::~HashAggregateOperator() {
+  // The files are removed anyway, so the loaders may drop their last page;
+  // close the files before removing them.
+  spill_loaders_.clear();
+  spill_files_.clear();
+  for (std::size_t i = 0; i < on_disk_.size(); ++i) {
+    try {
+      File::remove(on_disk_[i]);
+    } catch (...) {
+    }
+  }
+}
+
+std::uint64_t HashAggregateOperator::hashKey(const char* key) const {
+  std::uint64_t hash = 0x9e3779b97f4a7c15ULL;
+  for (std::size_t g = 0; g < groups_.size(); ++g) {
+    const ColumnType& column = schema_[g];
+    hash = (hash << 5 | hash >> 59) ^
+        ScanPredicate::hash(column.type, key, column.length);
+    hash *= 0x9e3779b97f4a7c15ULL;
+    key += column.length;
+  }
+  return hash;
+}
+
+void HashAggregateOperator::consume(const char* row,
+                                    const std::uint64_t hash) {
+  const std::uint32_t tag = static_cast<std::uint32_t>(hash >> 32);
+  const std::size_t mask = slots_.size() - 1;
+  std::size_t i = hash & mask;
+  while (slots_[i].group != EMPTY_SLOT &&
+         (slots_[i].tag != tag ||
+          std::memcmp(&arena_[slots_[i].group * group_width_], row,
+                      key_width_) != 0)) {
+    i = (i + 1) & mask;
+  }
+
+  std::uint32_t group = slots_[i].group;
+  if (group == EMPTY_SLOT) {
+    // A new group.  Past the budget it is spilled instead, unless the
+    // table is empty (so every table makes progress) or the hash bits for
+    // spilling are used up.
+    const std::size_t groups = group_hashes_.size();
+    const bool grows = 2 * (groups + 1) > slots_.size();
+    const std::size_t bytes = (groups + 1) *
+        (group_width_ + sizeof(std::uint64_t)) +
+        slots_.size() * sizeof(Slot) * (grows ? 2 : 1);
+    if (bytes > memory_bytes_ && groups > 0 && level_ < SPILL_LEVELS) {
+      spill(row, hash);
+      return;
+    }
+
+    group = static_cast<std::uint32_t>(groups);
+    arena_.resize((groups + 1) * group_width_);
+    char* state = &arena_[groups * group_width_];
+    std::memcpy(state, row, key_width_);
+    const std::int64_t none = 0;
+    std::memcpy(state + key_width_, &none, sizeof(none));
+    for (std::size_t a = 0; a < aggregates_.size(); ++a) {
+      const Aggregate& aggregate = aggregates_[a];
+      const double zero = 0;
+      switch (aggregate.function) {
+        case COUNT:
+          break;
+        case SUM:
+        case AVG:
+          std::memcpy(state + state_offsets_[a], &zero, sizeof(zero));
+          break;
+        default:
+          std::memcpy(state + state_offsets_[a], row + value_offsets_[a],
+                      schema_[groups_.size() + a].length);
+          break;
+      }
+    }
+    group_hashes_.push_back(hash);
+    slots_[i].tag = tag;
+    slots_[i].group = group;
+    if (grows) {
+      grow();
+    }
+  }
+
+  char* state = &arena_[group * group_width_];
+  std::int64_t count;
+  std::memcpy(&count, state + key_width_, sizeof(count));
+  ++count;
+  std::memcpy(state + key_width_, &count, sizeof(count));
+  const BatchSchema& inputSchema = input_->schema();
+  for (std::size_t a = 0; a < aggregates_.size(); ++a) {
+    const Aggregate& aggregate = aggregates_[a];
+    if (aggregate.function == COUNT) {
+      continue;
+    }
+    const ColumnType& column = inputSchema[aggregate.column];
+    const char* value = row + value_offsets_[a];
+    char* current = state + state_offsets_[a];
+    if (aggregate.function == SUM || aggregate.function == AVG) {
+      double sum;
+      std::memcpy(&sum, current, sizeof(sum));
+      sum += toDouble(column.type, value);
+      std::memcpy(current, &sum, sizeof(sum));
+      continue;
+    }
+    const int cmp =
+        ScanPredicate::compare(column.type, value, current, column.length);
+    if (aggregate.function == MIN ? cmp < 0 : cmp > 0) {
+      std::memcpy(current, value, column.length);
+    }
+  }
+}
+
+void HashAggregateOperator::grow() {
+  std::vector<Slot> slots(slots_.size() * 2, Slot{0, EMPTY_SLOT});
+  const std::size_t mask = slots.size() - 1;
+  for (std::size_t g = 0; g < group_hashes_.size(); ++g) {
+    std::size_t i = group_hashes_[g] & mask;
+    while (slots[i].group != EMPTY_SLOT) {
+      i = (i + 1) & mask;
+    }
+    slots[i].tag = static_cast<std::uint32_t>(group_hashes_[g] >> 32);
+    slots[i].group = static_cast<std::uint32_t>(g);
+  }
+  slots_.swap(slots);
+}
+
+void HashAggregateOperator::spill(const char* row, const std::uint64_t hash) {
+  if (spill_loaders_.empty()) {
+    for (std::size_t p = 0; p < SPILL_PARTITIONS; ++p) {
+      std::ostringstream name;
+      name << spill_prefix_ << ".spill." << spills_written_++;
+      spill_files_.push_back(
+          std::unique_ptr<PageFile>(new PageFile(name.str(), true)));
+      spill_loaders_.push_back(std::unique_ptr<RelationLoader>(
+          new RelationLoader(spill_files_.back().get())));
+      spill_names_.push_back(name.str());
+      on_disk_.push_back(name.str());
+    }
+  }
+  // Each level takes the next bits down from the top of the hash; the
+  // table's slots use the bottom bits.
+  const std::size_t shift = 64 - SPILL_BITS * (level_ + 1);
+  const std::size_t p = (hash >> shift) & (SPILL_PARTITIONS - 1);
+  spill_loaders_[p]->insertRecord(std::string(row, row_width_));
+}
+
+void HashAggregateOperator::clearTable() {
+  arena_.clear();
+  group_hashes_.clear();
+  slots_.assign(INITIAL_SLOTS, Slot{0, EMPTY_SLOT});
+  next_group_ = 0;
+}
+
+void HashAggregateOperator::buildTable() {
+  clearTable();
+  if (!input_done_) {
+    level_ = 0;
+    const BatchSchema& inputSchema = input_->schema();
+    ColumnBatch batch(inputSchema);
+    std::vector<char> rows(ColumnBatch::CAPACITY * row_width_);
+    while (input_->next(batch)) {
+      const std::size_t count = batch.count();
+
+      // Gather each row's key and aggregate values, a column at a time.
+      std::size_t position = 0;
+      for (std::size_t g = 0; g < groups_.size(); ++g) {
+        const ColumnType& column = inputSchema[groups_[g]];
+        for (std::size_t k = 0; k < count; ++k) {
+          char* value = &rows[k * row_width_ + position];
+          std::memcpy(value, batch.value(groups_[g], batch.row(k)),
+                      column.length);
+          normalize(column, value);
+        }
+        position += column.length;
+      }
+      for (std::size_t a = 0; a < aggregates_.size(); ++a) {
+        if (aggregates_[a].function == COUNT) {
+          continue;
+        }
+        const std::size_t c = aggregates_[a].column;
+        const std::size_t length = inputSchema[c].length;
+        for (std::size_t k = 0; k < count; ++k) {
+          std::memcpy(&rows[k * row_width_ + value_offsets_[a]],
+                      batch.value(c, batch.row(k)), length);
+        }
+      }
+
+      for (std::size_t k = 0; k < count; ++k) {
+        const char* row = &rows[k * row_width_];
+        consume(row, hashKey(row));
+      }
+    }
+    input_done_ = true;
+  } else {
+    const Spill next = pending_.back();
+    pending_.pop_back();
+    level_ = next.level;
+    {
+      FileScan scan(next.name, buf_mgr_);
+      RecordId rids[SPILL_BATCH];
+      RecordView views[SPILL_BATCH];
+      std::size_t count;
+      while ((count = scan.scanNextBatch(rids, views, SPILL_BATCH)) > 0) {
+        for (std::size_t k = 0; k < count; ++k) {
+          consume(views[k].data, hashKey(views[k].data));
+        }
+      }
+    }
+    File::remove(next.name);
+    for (std::size_t i = 0; i < on_disk_.size(); ++i) {
+      if (on_disk_[i] == next.name) {
+        on_disk_.erase(on_disk_.begin() + i);
+        break;
+      }
+    }
+  }
+
+  // The spill files of this table are read by tables of the next level.
+  for (std::size_t p = 0; p < spill_loaders_.size(); ++p) {
+    spill_loaders_[p]->flush();
+  }
+  spill_loaders_.clear();
+  spill_files_.clear();
+  for (std::size_t p = 0; p < spill_names_.size(); ++p) {
+    const Spill spilled = {spill_names_[p], level_ + 1};
+    pending_.push_back(spilled);
+  }
+  spill_names_.clear();
+  table_ready_ = true;
+}
+
+bool HashAggregateOperator::next(ColumnBatch& batch) {
+  for (;;) {
+    if (!table_ready_) {
+      if (input_done_ && pending_.empty()) {
+        batch.clear();
+        return false;
+      }
+      buildTable();
+    }
+
+    const std::size_t groups = group_hashes_.size();
+    if (next_group_ < groups) {
+      const std::size_t capacity = ColumnBatch::CAPACITY;
+      const std::size_t count = std::min(capacity, groups - next_group_);
+      for (std::size_t k = 0; k < count; ++k) {
+        const char* state = &arena_[(next_group_ + k) * group_width_];
+        std::int64_t rows;
+        std::memcpy(&rows, state + key_width_, sizeof(rows));
+
+        const char* key = state;
+        for (std::size_t g = 0; g < groups_.size(); ++g) {
+          const std::size_t length = schema_[g].length;
+          std::memcpy(batch.column(g) + k * length, key, length);
+          key += length;
+        }
+        for (std::size_t a = 0; a < aggregates_.size(); ++a) {
+          const std::size_t c = groups_.size() + a;
+          char* out = batch.column(c) + k * schema_[c].length;
+          const char* current = state + state_offsets_[a];
+          switch (aggregates_[a].function) {
+            case COUNT: {
+              const int value = static_cast<int>(rows);
+              std::memcpy(out, &value, sizeof(value));
+              break;
+            }
+            case AVG: {
+              double sum;
+              std::memcpy(&sum, current, sizeof(sum));
+              const double mean = sum / rows;
+              std::memcpy(out, &mean, sizeof(mean));
+              break;
+            }
+            default:
+              std::memcpy(out, current, schema_[c].length);
+              break;
+          }
+        }
+        batch.rids()[k] = RecordId();
+      }
+      batch.setSize(count);
+      next_group_ += count;
+      return true;
+    }
+
+    table_ready_ = false;
+    clearTable();
+  }
+}
+
+}
@@ -0,0 +1,207 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "batch_operator.h"
+#include "buffer.h"
+#include "column_batch.h"
+#include "relation_loader.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Groups the rows of its input by some columns and computes
+ *        aggregates of each group.
+ *
+ * Groups live in an open-addressing table: a power-of-two array of 8-byte
+ * slots, each holding part of a group's hash and its index, probed linearly,
+ * so a lookup usually touches one cache line of slots and then the group
+ * itself.  The groups are packed one after another in an arena.
+ *
+ * When a new group would take the table past its memory budget, the group's
+ * rows are spilled instead: rows of groups already in the table are still
+ * aggregated in memory, while rows of other groups are written to one of
+ * SPILL_PARTITIONS temporary page files chosen by bits of the group hash.
+ * Every row of a group thus goes to the same place.  Once the in-memory
+ * groups are returned, each spill file is aggregated the same way, with the
+ * next hash bits choosing partitions if it spills again.
+ *
+ * The output has the group columns followed by one column per aggregate,
+ * typed as for AggregateOperator.  Groups come out in no particular order.
+ */
+class HashAggregateOperator : public BatchOperator {
+ public:
+  /**
+   * Bytes of groups held in memory by default.
+   */
+  static const std::size_t DEFAULT_MEMORY = 16 * 1024 * 1024;
+
+  /**
+   * Number of files a table spills to.
+   */
+  static const std::size_t SPILL_PARTITIONS = 16;
+
+  /**
+   * Constructs a grouped aggregation.
+   *
+   * @param input         Operator producing the rows.
+   * @param groups        Input columns the rows are grouped by; none for a
+   *                      single group of every row.
+   * @param aggregates    Aggregates to compute for each group.
+   * @param bufMgr        Buffer manager spill files are read through.
+   * @param spill_prefix  Spill files are named <spill_prefix>.spill.<n>.
+   * @param memory_bytes  Bytes of groups and table slots held in memory; a
+   *                      spilling table also keeps a page per spill file.
+   */
+  HashAggregateOperator(std::unique_ptr<BatchOperator> input,
+                        const std::vector<std::size_t>& groups,
+                        const std::vector<Aggregate>& aggregates,
+                        BufMgr* bufMgr, const std::string& spill_prefix,
+                        const std::size_t memory_bytes = DEFAULT_MEMORY);
+
+  /**
+   * Removes any spill files left.
+   */
+  virtual ~HashAggregateOperator();
+
+  virtual const BatchSchema& schema() const { return schema_; }
+
+  virtual bool next(ColumnBatch& batch);
+
+  /**
+   * Returns the number of spill files written so far.
+   */
+  std::size_t num_spill_files() const { return spills_written_; }
+
+ private:
+  HashAggregateOperator(const HashAggregateOperator&) = delete;
+  HashAggregateOperator& operator=(const HashAggregateOperator&) = delete;
+
+  /**
+   * A table slot: the high half of a group's hash and the group's index.
+   */
+  struct Slot {
+    std::uint32_t tag;
+    std::uint32_t group;
+  };
+
+  /**
+   * A spill file not yet aggregated, and the level of the table that reads
+   * it, which picks the hash bits it spills by in turn.
+   */
+  struct Spill {
+    std::string name;
+    std::size_t level;
+  };
+
+  /**
+   * Aggregates all the rows of the input (or, past the first table, of the
+   * next spill file) into the table.
+   */
+  void buildTable();
+
+  /**
+   * Adds a row to its group, or spills it; a row holds the group key and
+   * then the value of each aggregate.
+   */
+  void consume(const char* row, const std::uint64_t hash);
+
+  /**
+   * Returns the hash of a group key.
+   */
+  std::uint64_t hashKey(const char* key) const;
+
+  /**
+   * Writes a row to the spill file of its hash.
+   */
+  void spill(const char* row, const std::uint64_t hash);
+
+  /**
+   * Doubles the slots, placing the groups again.
+   */
+  void grow();
+
+  /**
+   * Drops the groups of the table.
+   */
+  void clearTable();
+
+  /**
+   * Input and the columns and aggregates computed from it.
+   */
+  std::unique_ptr<BatchOperator> input_;
+  std::vector<std::size_t> groups_;
+  std::vector<Aggregate> aggregates_;
+  BatchSchema schema_;
+
+  /**
+   * Row layout: group key, then each aggregate's input value (none for
+   * COUNT).  key_width_ and row_width_ are the bytes of the key and row.
+   */
+  std::size_t key_width_;
+  std::size_t row_width_;
+  std::vector<std::size_t> value_offsets_;
+
+  /**
+   * Group layout: group key, row count, then each aggregate's state (a sum
+   * or the smallest or largest value).
+   */
+  std::size_t group_width_;
+  std::vector<std::size_t> state_offsets_;
+
+  /**
+   * Groups and their hashes, and the slots indexing them.
+   */
+  std::vector<char> arena_;
+  std::vector<std::uint64_t> group_hashes_;
+  std::vector<Slot> slots_;
+
+  /**
+   * Spill files being written by the current table, opened on the first
+   * spill.
+   */
+  std::vector<std::unique_ptr<PageFile> > spill_files_;
+  std::vector<std::unique_ptr<RelationLoader> > spill_loaders_;
+  std::vector<std::string> spill_names_;
+
+  /**
+   * Spill files waiting to be aggregated, and every spill file still on
+   * disk.
+   */
+  std::vector<Spill> pending_;
+  std::vector<std::string> on_disk_;
+
+  /**
+   * Buffer manager, file prefix and memory budget for spilling.
+   */
+  BufMgr* buf_mgr_;
+  std::string spill_prefix_;
+  std::size_t memory_bytes_;
+  std::size_t spills_written_;
+
+  /**
+   * Level of the current table; 0 for the one reading the input.
+   */
+  std::size_t level_;
+
+  /**
+   * True once the input is read, true while the table holds groups to
+   * return, and the next group to return.
+   */
+  bool input_done_;
+  bool table_ready_;
+  std::size_t next_group_;
+};
+
+}
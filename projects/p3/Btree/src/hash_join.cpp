@@ -0,0 +1,400 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "hash_join.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "exceptions/key_type_mismatch_exception.h"
+#include "scan_predicate.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Marks the end of a hash table chain.
+ */
+const std::uint32_t NO_ROW = 0xffffffff;
+
+}
+
+const std::size_t HashJoinOperator::PARTITION_BYTES;
+const int HashJoinOperator::MAX_RADIX_BITS;
+const std::size_t HashJoinOperator::CHUNKS_PER_THREAD;
+
+HashJoinOperator::HashJoinOperator(std::unique_ptr<BatchOperator> build,
+                                   std::unique_ptr<BatchOperator> probe,
+                                   const std::size_t build_key,
+                                   const std::size_t probe_key,
+                                   const std::size_t num_threads,
+                                   const std::size_t partition_bytes)
+    : build_(std::move(build)),
+      probe_(std::move(probe)),
+      num_threads_(num_threads),
+      partition_bytes_(std::max<std::size_t>(partition_bytes, 1)),
+      radix_bits_(0),
+      executed_(false),
+      next_partition_(0),
+      running_(0),
+      stopping_(false),
+      result_row_(0) {
+  if (num_threads_ == 0) {
+    num_threads_ = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  const ColumnType& buildKey = build_->schema()[build_key];
+  const ColumnType& probeKey = probe_->schema()[probe_key];
+  if (buildKey.type != probeKey.type || buildKey.length != probeKey.length) {
+    throw KeyTypeMismatchException(buildKey.type, buildKey.length,
+                                   probeKey.type, probeKey.length);
+  }
+  layout(build_->schema(), build_key, build_rows_);
+  layout(probe_->schema(), probe_key, probe_rows_);
+  schema_ = build_rows_.schema;
+  schema_.insert(schema_.end(), probe_rows_.schema.begin(),
+                 probe_rows_.schema.end());
+}
+
+HashJoinOperator::~HashJoinOperator() {
+  stop();
+}
+
+void HashJoinOperator::layout(const BatchSchema& schema,
+                              const std::size_t key, Rows& rows) {
+  rows.schema = schema;
+  rows.key = key;
+  rows.width = 0;
+  for (std::size_t c = 0; c < schema.size(); ++c) {
+    rows.offsets.push_back(rows.width);
+    rows.width += schema[c].length;
+  }
+  rows.width += sizeof(RecordId);
+}
+
+void HashJoinOperator::materialize(BatchOperator& input, Rows& rows) {
+  const ColumnType& key = rows.schema[rows.key];
+  const std::size_t ridOffset = rows.width - sizeof(RecordId);
+  ColumnBatch batch(rows.schema);
+  while (input.next(batch)) {
+    const std::size_t first = rows.size();
+    const std::size_t count = batch.count();
+    rows.data.resize((first + count) * rows.width);
+    rows.hashes.resize(first + count);
+
+    // A column at a time, into the rows' slots.
+    for (std::size_t c = 0; c < rows.schema.size(); ++c) {
+      const std::size_t length = rows.schema[c].length;
+      char* out = &rows.data[first * rows.width + rows.offsets[c]];
+      for (std::size_t k = 0; k < count; ++k) {
+        std::memcpy(out + k * rows.width, batch.value(c, batch.row(k)),
+                    length);
+      }
+    }
+    for (std::size_t k = 0; k < count; ++k) {
+      const std::size_t row = batch.row(k);
+      std::memcpy(&rows.data[(first + k) * rows.width + ridOffset],
+                  &batch.rids()[row], sizeof(RecordId));
+      rows.hashes[first + k] =
+          ScanPredicate::hash(key.type, batch.value(rows.key, row), key.length);
+    }
+  }
+}
+
+void HashJoinOperator::runThreads(
+    const std::function<void(std::size_t)>& work) {
+  if (num_threads_ == 1) {
+    work(0);
+    return;
+  }
+  std::vector<std::exception_ptr> errors(num_threads_);
+  std::vector<std::thread> workers;
+  for (std::size_t i = 0; i < num_threads_; ++i) {
+    workers.push_back(std::thread([&work, &errors, i]() {
+      try {
+        work(i);
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    }));
+  }
+  for (std::size_t i = 0; i < workers.size(); ++i) {
+    workers[i].join();
+  }
+  for (std::size_t i = 0; i < errors.size(); ++i) {
+    if (errors[i]) {
+      std::rethrow_exception(errors[i]);
+    }
+  }
+}
+
+void HashJoinOperator::partition(Rows& rows) {
+  const std::size_t partitions = std::size_t(1) << radix_bits_;
+  const std::size_t mask = partitions - 1;
+  const std::size_t n = rows.size();
+  rows.starts.assign(partitions + 1, 0);
+  rows.starts[partitions] = n;
+  if (partitions == 1) {
+    return;
+  }
+
+  // Each thread takes a contiguous share of the rows.
+  const std::size_t share = (n + num_threads_ - 1) / num_threads_;
+
+  // Pass 1: count the rows of each share per partition.
+  std::vector<std::vector<std::size_t> > cursors(
+      num_threads_, std::vector<std::size_t>(partitions, 0));
+  runThreads([&](const std::size_t t) {
+    std::vector<std::size_t>& counts = cursors[t];
+    const std::size_t end = std::min(n, (t + 1) * share);
+    for (std::size_t i = t * share; i < end; ++i) {
+      counts[rows.hashes[i] & mask]++;
+    }
+  });
+
+  // Partition p gets the rows of share 0, then share 1, and so on, so each
+  // thread writes its rows of a partition to a range of its own.
+  std::size_t position = 0;
+  for (std::size_t p = 0; p < partitions; ++p) {
+    rows.starts[p] = position;
+    for (std::size_t t = 0; t < num_threads_; ++t) {
+      const std::size_t count = cursors[t][p];
+      cursors[t][p] = position;
+      position += count;
+    }
+  }
+
+  // Pass 2: copy each row to its place.
+  std::vector<char> data(rows.data.size());
+  std::vector<std::uint64_t> hashes(n);
+  runThreads([&](const std::size_t t) {
+    std::vector<std::size_t>& cursor = cursors[t];
+    const std::size_t end = std::min(n, (t + 1) * share);
+    for (std::size_t i = t * share; i < end; ++i) {
+      const std::size_t j = cursor[rows.hashes[i] & mask]++;
+      std::memcpy(&data[j * rows.width], rows.row(i), rows.width);
+      hashes[j] = rows.hashes[i];
+    }
+  });
+  rows.data.swap(data);
+  rows.hashes.swap(hashes);
+}
+
+bool HashJoinOperator::joinPartition(const std::size_t p, Chunk& chunk) {
+  const std::size_t buildFirst = build_rows_.starts[p];
+  const std::size_t buildCount = build_rows_.starts[p + 1] - buildFirst;
+  const std::size_t probeFirst = probe_rows_.starts[p];
+  const std::size_t probeEnd = probe_rows_.starts[p + 1];
+  if (buildCount == 0 || probeFirst == probeEnd) {
+    return true;
+  }
+
+  // A chained table over the build rows of the partition.  The low hash bits
+  // are the same for the whole partition, so buckets take the bits above.
+  std::size_t buckets = 1;
+  while (buckets < buildCount) {
+    buckets <<= 1;
+  }
+  const std::uint64_t mask = buckets - 1;
+  std::vector<std::uint32_t> heads(buckets, NO_ROW);
+  std::vector<std::uint32_t> chain(buildCount);
+  const std::uint64_t* buildHashes = &build_rows_.hashes[buildFirst];
+  for (std::size_t i = 0; i < buildCount; ++i) {
+    const std::uint64_t bucket = (buildHashes[i] >> radix_bits_) & mask;
+    chain[i] = heads[bucket];
+    heads[bucket] = static_cast<std::uint32_t>(i);
+  }
+
+  const ColumnType& key = build_rows_.schema[build_rows_.key];
+  const std::size_t buildKeyOffset = build_rows_.offsets[build_rows_.key];
+  const std::size_t probeKeyOffset = probe_rows_.offsets[probe_rows_.key];
+  const std::size_t width = build_rows_.width + probe_rows_.width;
+  const std::size_t chunkBytes = ColumnBatch::CAPACITY * width;
+  for (std::size_t j = probeFirst; j < probeEnd; ++j) {
+    const std::uint64_t hash = probe_rows_.hashes[j];
+    const char* probeRow = probe_rows_.row(j);
+    for (std::uint32_t i = heads[(hash >> radix_bits_) & mask]; i != NO_ROW;
+         i = chain[i]) {
+      const char* buildRow = build_rows_.row(buildFirst + i);
+      if (buildHashes[i] != hash ||
+          ScanPredicate::compare(key.type, buildRow + buildKeyOffset,
+                                 probeRow + probeKeyOffset, key.length) != 0) {
+        continue;
+      }
+      if (chunk.size() == chunkBytes && !deliver(chunk)) {
+        return false;
+      }
+      if (chunk.empty()) {
+        chunk.reserve(chunkBytes);
+      }
+      const std::size_t at = chunk.size();
+      chunk.resize(at + width);
+      std::memcpy(&chunk[at], buildRow, build_rows_.width);
+      std::memcpy(&chunk[at + build_rows_.width], probeRow, probe_rows_.width);
+    }
+  }
+  return true;
+}
+
+bool HashJoinOperator::deliver(Chunk& chunk) {
+  std::unique_lock<std::mutex> lock(latch_);
+  const std::size_t limit = CHUNKS_PER_THREAD * num_threads_;
+  changed_.wait(lock, [this, limit]() {
+    return stopping_ || chunks_.size() < limit;
+  });
+  if (stopping_) {
+    return false;
+  }
+  chunks_.push_back(Chunk());
+  chunks_.back().swap(chunk);
+  changed_.notify_all();
+  return true;
+}
+
+void HashJoinOperator::joinPartitions() {
+  try {
+    const std::size_t partitions = build_rows_.starts.size() - 1;
+    Chunk chunk;
+    bool open = true;
+    while (open) {
+      const std::size_t p = next_partition_++;
+      if (p >= partitions) {
+        break;
+      }
+      open = joinPartition(p, chunk);
+    }
+    if (open && !chunk.empty()) {
+      deliver(chunk);
+    }
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(latch_);
+    if (!error_) {
+      error_ = std::current_exception();
+    }
+    stopping_ = true;
+  }
+  std::lock_guard<std::mutex> lock(latch_);
+  --running_;
+  changed_.notify_all();
+}
+
+void HashJoinOperator::execute() {
+  materialize(*build_, build_rows_);
+  materialize(*probe_, probe_rows_);
+
+  // Enough partitions that a build partition fits in partition_bytes_.
+  radix_bits_ = 0;
+  while (radix_bits_ < MAX_RADIX_BITS &&
+         (build_rows_.data.size() >> radix_bits_) > partition_bytes_) {
+    ++radix_bits_;
+  }
+  partition(build_rows_);
+  partition(probe_rows_);
+
+  // Threads claim partitions until none are left, queueing joined rows for
+  // next() as they go.
+  executed_ = true;
+  for (std::size_t i = 0; i < num_threads_; ++i) {
+    std::lock_guard<std::mutex> lock(latch_);
+    try {
+      workers_.push_back(std::thread(&HashJoinOperator::joinPartitions, this));
+      ++running_;
+    } catch (...) {
+      error_ = std::current_exception();
+      stopping_ = true;
+      break;
+    }
+  }
+}
+
+bool HashJoinOperator::nextChunk() {
+  std::unique_lock<std::mutex> lock(latch_);
+  changed_.wait(lock, [this]() {
+    return !chunks_.empty() || running_ == 0 || error_;
+  });
+  if (error_) {
+    const std::exception_ptr error = error_;
+    lock.unlock();
+    stop();
+    std::rethrow_exception(error);
+  }
+  if (chunks_.empty()) {
+    lock.unlock();
+    stop();
+
+    // The inputs are no longer needed.
+    std::vector<char>().swap(build_rows_.data);
+    std::vector<std::uint64_t>().swap(build_rows_.hashes);
+    std::vector<char>().swap(probe_rows_.data);
+    std::vector<std::uint64_t>().swap(probe_rows_.hashes);
+    Chunk().swap(current_);
+    result_row_ = 0;
+    return false;
+  }
+  current_.swap(chunks_.front());
+  chunks_.pop_front();
+  result_row_ = 0;
+  changed_.notify_all();
+  return true;
+}
+
+void HashJoinOperator::stop() {
+  {
+    std::lock_guard<std::mutex> lock(latch_);
+    stopping_ = true;
+    changed_.notify_all();
+  }
+  for (std::size_t i = 0; i < workers_.size(); ++i) {
+    workers_[i].join();
+  }
+  workers_.clear();
+}
+
+bool HashJoinOperator::next(ColumnBatch& batch) {
+  if (!executed_) {
+    execute();
+  }
+
+  const std::size_t width = build_rows_.width + probe_rows_.width;
+  const std::size_t buildColumns = build_rows_.schema.size();
+  const std::size_t ridOffset = width - sizeof(RecordId);
+  std::size_t size = 0;
+  while (size < ColumnBatch::CAPACITY) {
+    const std::size_t available = current_.size() / width - result_row_;
+    if (available == 0) {
+      if (!nextChunk()) {
+        break;
+      }
+      continue;
+    }
+    const std::size_t count =
+        std::min(ColumnBatch::CAPACITY - size, available);
+    const char* first = &current_[result_row_ * width];
+
+    // A column at a time out of the joined rows.
+    for (std::size_t c = 0; c < schema_.size(); ++c) {
+      const std::size_t length = schema_[c].length;
+      const std::size_t offset = c < buildColumns
+          ? build_rows_.offsets[c]
+          : build_rows_.width + probe_rows_.offsets[c - buildColumns];
+      char* out = batch.column(c) + size * length;
+      for (std::size_t k = 0; k < count; ++k) {
+        std::memcpy(out + k * length, first + k * width + offset, length);
+      }
+    }
+    for (std::size_t k = 0; k < count; ++k) {
+      std::memcpy(&batch.rids()[size + k], first + k * width + ridOffset,
+                  sizeof(RecordId));
+    }
+    size += count;
+    result_row_ += count;
+  }
+  batch.setSize(size);
+  return size > 0;
+}
+
+}
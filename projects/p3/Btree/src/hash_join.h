@@ -0,0 +1,273 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "batch_operator.h"
+#include "column_batch.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Equi-join of two inputs with a radix-partitioned parallel hash
+ *        join.
+ *
+ * The first call to next() reads both inputs to the end and hashes their
+ * join keys.  Both are then split into 2^b partitions by the low b bits of
+ * the hash, with b picked so a partition of the build input fits in
+ * partition_bytes (about the size of a core's cache): each thread counts the
+ * rows of its share per partition, then copies them straight to their place.
+ * Finally threads claim partition pairs one at a time, build a hash table of
+ * the build partition and probe it with the probe partition, so every table
+ * lookup stays in cache.
+ *
+ * Joined rows are handed to next() in chunks of a batch as the threads
+ * produce them.  A thread that gets a few chunks ahead of the consumer waits,
+ * so the memory held beyond the inputs is bounded by the number of threads,
+ * not by the size of the output.
+ *
+ * The output has the build input's columns followed by the probe input's
+ * columns, with the record IDs of the probe rows.  Rows come out partition by
+ * partition, not in input order.
+ */
+class HashJoinOperator : public BatchOperator {
+ public:
+  /**
+   * Build partitions are cut to about this many bytes by default.
+   */
+  static const std::size_t PARTITION_BYTES = 256 * 1024;
+
+  /**
+   * Most radix bits used to partition.
+   */
+  static const int MAX_RADIX_BITS = 12;
+
+  /**
+   * Chunks each joining thread may have queued ahead of next().
+   */
+  static const std::size_t CHUNKS_PER_THREAD = 2;
+
+  /**
+   * Constructs a join of the rows of build and probe whose key columns are
+   * equal.  The key columns must have the same type, and the same length if
+   * they are strings.
+   *
+   * @param build           Input the hash tables are built on; the smaller
+   *                        input should be used.
+   * @param probe           Input probing the hash tables.
+   * @param build_key       Key column of build.
+   * @param probe_key       Key column of probe.
+   * @param num_threads     Number of threads partitioning and joining; 0 for
+   *                        one per core.
+   * @param partition_bytes Bytes of build rows a partition is cut to.
+   * @throws  KeyTypeMismatchException If the key columns differ in type or
+   *                                   length.
+   */
+  HashJoinOperator(std::unique_ptr<BatchOperator> build,
+                   std::unique_ptr<BatchOperator> probe,
+                   const std::size_t build_key, const std::size_t probe_key,
+                   const std::size_t num_threads = 0,
+                   const std::size_t partition_bytes = PARTITION_BYTES);
+
+  /**
+   * Stops the joining threads and waits for them.
+   */
+  virtual ~HashJoinOperator();
+
+  virtual const BatchSchema& schema() const { return schema_; }
+
+  virtual bool next(ColumnBatch& batch);
+
+  /**
+   * Returns the number of radix bits the inputs were partitioned by; valid
+   * after the first call to next().
+   */
+  int radix_bits() const { return radix_bits_; }
+
+ private:
+  /**
+   * Rows of an input, packed: the values of each column, then the record ID.
+   */
+  struct Rows {
+    /**
+     * Types of the columns and byte offset of each in a row.
+     */
+    BatchSchema schema;
+    std::vector<std::size_t> offsets;
+
+    /**
+     * Bytes of a row, record ID included.
+     */
+    std::size_t width;
+
+    /**
+     * Column holding the join key.
+     */
+    std::size_t key;
+
+    /**
+     * The rows, and the hash of the key of each.
+     */
+    std::vector<char> data;
+    std::vector<std::uint64_t> hashes;
+
+    /**
+     * Once partitioned, partition p holds rows starts[p] to starts[p + 1].
+     */
+    std::vector<std::size_t> starts;
+
+    std::size_t size() const { return hashes.size(); }
+    const char* row(const std::size_t i) const { return &data[i * width]; }
+  };
+
+  /**
+   * Sets up the row layout of an input.
+   */
+  static void layout(const BatchSchema& schema, const std::size_t key,
+                     Rows& rows);
+
+  /**
+   * Reads an input to the end into rows.
+   */
+  static void materialize(BatchOperator& input, Rows& rows);
+
+  /**
+   * Reorders rows by partition, the work split across the threads.
+   */
+  void partition(Rows& rows);
+
+  /**
+   * Joined rows, the build row then the probe row, at most a batch of them.
+   */
+  typedef std::vector<char> Chunk;
+
+  /**
+   * Appends the joined rows of build partition p and probe partition p to
+   * chunk, delivering it whenever it fills.  Returns false if the join was
+   * stopped.
+   */
+  bool joinPartition(const std::size_t p, Chunk& chunk);
+
+  /**
+   * Queues a full chunk for next(), first waiting for room in the queue.
+   * Returns false if the join was stopped instead.
+   */
+  bool deliver(Chunk& chunk);
+
+  /**
+   * Body of a joining thread: claims partitions until none are left.
+   */
+  void joinPartitions();
+
+  /**
+   * Reads and partitions the inputs, then starts the joining threads.
+   */
+  void execute();
+
+  /**
+   * Takes the next chunk off the queue into current_, waiting for one.
+   * Returns false once every partition is joined; rethrows the error of a
+   * joining thread.
+   */
+  bool nextChunk();
+
+  /**
+   * Stops the joining threads and waits for them to exit.
+   */
+  void stop();
+
+  /**
+   * Runs work(thread) on each of num_threads_ threads and rethrows the first
+   * exception any of them threw.
+   */
+  void runThreads(const std::function<void(std::size_t)>& work);
+
+  /**
+   * Inputs.
+   */
+  std::unique_ptr<BatchOperator> build_;
+  std::unique_ptr<BatchOperator> probe_;
+
+  /**
+   * Rows of the inputs.
+   */
+  Rows build_rows_;
+  Rows probe_rows_;
+
+  /**
+   * Output columns; build columns, then probe columns.
+   */
+  BatchSchema schema_;
+
+  /**
+   * Number of threads and partition size asked for.
+   */
+  std::size_t num_threads_;
+  std::size_t partition_bytes_;
+
+  /**
+   * Number of radix bits partitioned by.
+   */
+  int radix_bits_;
+
+  /**
+   * True once the inputs are partitioned and the joining threads started.
+   */
+  bool executed_;
+
+  /**
+   * Joining threads, and the next partition for one of them to claim.
+   */
+  std::vector<std::thread> workers_;
+  std::atomic<std::size_t> next_partition_;
+
+  /**
+   * Guards the fields below; changed_ is notified whenever one changes.
+   */
+  std::mutex latch_;
+  std::condition_variable changed_;
+
+  /**
+   * Full chunks waiting for next().
+   */
+  std::deque<Chunk> chunks_;
+
+  /**
+   * Number of joining threads still running.
+   */
+  std::size_t running_;
+
+  /**
+   * True once the joining threads are asked to stop.
+   */
+  bool stopping_;
+
+  /**
+   * First exception a joining thread threw.
+   */
+  std::exception_ptr error_;
+
+  /**
+   * Chunk next() copies from, and the row of it returned next.
+   */
+  Chunk current_;
+  std::size_t result_row_;
+};
+
+}
@@ -0,0 +1,265 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "log_manager.h"
+
+#include <cstring>
+#include <vector>
+
+#include "exceptions/bad_log_file_exception.h"
+#include "exceptions/invalid_page_exception.h"
+
+namespace badgerdb {
+
+const LogSequenceNumber LogManager::INVALID_LSN;
+const std::uint32_t LogManager::MAGIC;
+const std::uint16_t LogManager::FILE_RECORD;
+const std::uint16_t LogManager::CHANGE_RECORD;
+
+LogManager::LogManager(const std::string& filename)
+    : flushing_(false),
+      base_lsn_(0) {
+  if (!File::exists(filename)) {
+    handle_ = FileHandle::open(filename, true /* create_new */);
+    writeHeader(base_lsn_);
+    handle_->sync();
+    durable_lsn_ = end_lsn_ = base_lsn_ + sizeof(LogHeader);
+    return;
+  }
+
+  handle_ = FileHandle::open(filename, false /* create_new */);
+  const std::uint64_t size = handle_->size();
+  if (size < sizeof(LogHeader)) {
+    throw BadLogFileException(filename, "file is too short");
+  }
+  LogHeader header;
+  handle_->read(reinterpret_cast<char*>(&header), sizeof(LogHeader), 0);
+  if (header.magic != MAGIC) {
+    throw BadLogFileException(filename, "bad magic number");
+  }
+  base_lsn_ = header.base_lsn;
+
+  // Rebuild the file IDs from the records that made it to disk and drop a
+  // torn record at the end, so new records are appended after the last
+  // complete one.
+  std::vector<char> log(size - sizeof(LogHeader));
+  if (!log.empty()) {
+    handle_->read(&log[0], log.size(), sizeof(LogHeader));
+  }
+  const std::size_t end = scan(
+      log.data(), log.size(),
+      [this](const RecordHeader& record, const char* payload) {
+        if (record.type == FILE_RECORD) {
+          file_ids_[std::string(payload, record.length)] = record.file_id;
+        }
+      });
+  if (end < log.size()) {
+    handle_->truncate(sizeof(LogHeader) + end);
+    handle_->sync();
+  }
+  durable_lsn_ = end_lsn_ = base_lsn_ + sizeof(LogHeader) + end;
+}
+
+LogManager::~LogManager() {
+  // A destructor must not throw; records that cannot be written are lost as
+  // they would be in a crash.
+  try {
+    flush();
+  } catch (...) {
+  }
+}
+
+LogSequenceNumber LogManager::appendChange(const std::string& filename,
+                                           const PageId page_number,
+                                           const std::size_t offset,
+                                           const char* data,
+                                           const std::size_t length) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  std::map<std::string, std::uint16_t>::const_iterator found =
+      file_ids_.find(filename);
+  if (found == file_ids_.end()) {
+    RecordHeader file_record = {0 /* checksum */,
+                                static_cast<std::uint32_t>(filename.size()),
+                                FILE_RECORD,
+                                static_cast<std::uint16_t>(file_ids_.size()),
+                                0 /* page_number */, 0 /* offset */};
+    appendRecord(file_record, filename.data());
+    found = file_ids_.insert(
+        std::make_pair(filename, file_record.file_id)).first;
+  }
+
+  RecordHeader change_record = {0 /* checksum */,
+                                static_cast<std::uint32_t>(length),
+                                CHANGE_RECORD, found->second, page_number,
+                                static_cast<std::uint32_t>(offset)};
+  return appendRecord(change_record, data);
+}
+
+LogSequenceNumber LogManager::appendRecord(RecordHeader& header,
+                                           const char* payload) {
+  header.checksum = checksum(header, payload);
+  tail_.append(reinterpret_cast<const char*>(&header), sizeof(RecordHeader));
+  tail_.append(payload, header.length);
+  end_lsn_ += sizeof(RecordHeader) + header.length;
+  return end_lsn_;
+}
+
+void LogManager::flush(const LogSequenceNumber lsn) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (durable_lsn_ < lsn && durable_lsn_ < end_lsn_) {
+    if (flushing_) {
+      // The flush in progress may cover lsn; check again once it is done.
+      flushed_.wait(lock);
+      continue;
+    }
+
+    // Take everything appended so far, including the records of callers
+    // that will wait for this flush, and write it without holding the mutex
+    // so records can keep being appended meanwhile.
+    std::string batch;
+    batch.swap(tail_);
+    const std::uint64_t position = durable_lsn_ - base_lsn_;
+    const LogSequenceNumber batch_lsn = end_lsn_;
+    flushing_ = true;
+    lock.unlock();
+    try {
+      handle_->write(batch.data(), batch.size(), position);
+      handle_->sync();
+    } catch (...) {
+      lock.lock();
+      tail_.insert(0, batch);
+      flushing_ = false;
+      flushed_.notify_all();
+      throw;
+    }
+    lock.lock();
+    durable_lsn_ = batch_lsn;
+    flushing_ = false;
+    flushed_.notify_all();
+  }
+}
+
+LogSequenceNumber LogManager::lastLSN() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return end_lsn_;
+}
+
+LogSequenceNumber LogManager::durableLSN() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return durable_lsn_;
+}
+
+void LogManager::truncate() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (flushing_) {
+    flushed_.wait(lock);
+  }
+
+  // Cut the records off before moving the base, so a crash in between leaves
+  // an empty log rather than old records at new LSNs.
+  handle_->truncate(sizeof(LogHeader));
+  base_lsn_ = end_lsn_ - sizeof(LogHeader);
+  writeHeader(base_lsn_);
+  handle_->sync();
+  durable_lsn_ = end_lsn_;
+  tail_.clear();
+  file_ids_.clear();
+}
+
+std::size_t LogManager::redo(
+    const std::function<File*(const std::string&)>& open_file) {
+  flush();
+  std::lock_guard<std::mutex> guard(mutex_);
+
+  std::vector<char> log(durable_lsn_ - base_lsn_ - sizeof(LogHeader));
+  if (!log.empty()) {
+    handle_->read(&log[0], log.size(), sizeof(LogHeader));
+  }
+
+  // Consecutive changes usually hit the same page, so the page being changed
+  // is only written back once the log moves on to another page.
+  std::map<std::uint16_t, File*> files;
+  File* page_file = NULL;
+  PageId page_number = Page::INVALID_NUMBER;
+  Page page;
+  std::size_t applied = 0;
+  scan(log.data(), log.size(),
+       [&](const RecordHeader& record, const char* payload) {
+    if (record.type == FILE_RECORD) {
+      files[record.file_id] = open_file(std::string(payload, record.length));
+      return;
+    }
+    File* file = files[record.file_id];
+    if (file == NULL ||
+        record.offset + record.length > file->page_size()) {
+      return;
+    }
+    if (file != page_file || record.page_number != page_number) {
+      if (page_file != NULL) {
+        page_file->writePage(page_number, page);
+        page_file = NULL;
+      }
+      try {
+        page = file->readPage(record.page_number);
+      } catch (const InvalidPageException&) {
+        // The page was deleted after the change was logged.
+        return;
+      }
+      page_file = file;
+      page_number = record.page_number;
+    }
+    std::memcpy(reinterpret_cast<char*>(&page) + record.offset, payload,
+                record.length);
+    ++applied;
+  });
+  if (page_file != NULL) {
+    page_file->writePage(page_number, page);
+  }
+  return applied;
+}
+
+std::size_t LogManager::scan(
+    const char* log, const std::size_t length,
+    const std::function<void(const RecordHeader&, const char*)>& visit) {
+  std::size_t position = 0;
+  while (length - position >= sizeof(RecordHeader)) {
+    RecordHeader header;
+    std::memcpy(&header, log + position, sizeof(RecordHeader));
+    const char* payload = log + position + sizeof(RecordHeader);
+    if (header.length > length - position - sizeof(RecordHeader) ||
+        checksum(header, payload) != header.checksum) {
+      // A record cut short or scrambled by a crash during a flush.
+      break;
+    }
+    visit(header, payload);
+    position += sizeof(RecordHeader) + header.length;
+  }
+  return position;
+}
+
+std::uint32_t LogManager::checksum(const RecordHeader& header,
+                                   const char* payload) {
+  // 32-bit FNV-1a over the header (with the checksum cleared) and payload.
+  RecordHeader cleared = header;
+  cleared.checksum = 0;
+  std::uint32_t hash = 2166136261u;
+  const char* bytes = reinterpret_cast<const char*>(&cleared);
+  for (std::size_t i = 0; i < sizeof(RecordHeader); ++i) {
+    hash = (hash ^ static_cast<unsigned char>(bytes[i])) * 16777619u;
+  }
+  for (std::uint32_t i = 0; i < header.length; ++i) {
+    hash = (hash ^ static_cast<unsigned char>(payload[i])) * 16777619u;
+  }
+  return hash;
+}
+
+void LogManager::writeHeader(const LogSequenceNumber base_lsn) {
+  const LogHeader header = {MAGIC, 0 /* reserved */, base_lsn};
+  handle_->write(reinterpret_cast<const char*>(&header), sizeof(LogHeader), 0);
+}
+
+}
@@ -0,0 +1,288 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "file.h"
+#include "file_handle.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Identifies a position in the write-ahead log.
+ *
+ * The LSN of a log record is the log address just past its last byte, so a
+ * record is durable once the durable LSN of the log has reached its LSN.
+ * LSNs keep growing across truncations of the log.
+ */
+typedef std::uint64_t LogSequenceNumber;
+
+/**
+ * @brief Write-ahead log of changes made to pages.
+ *
+ * A change record holds the after-image of a byte range of a page, so a
+ * record costs the bytes that changed rather than the whole page.  Records
+ * are appended to an in-memory tail; flush() makes them durable with a single
+ * sequential write and sync.  Callers that flush concurrently share one write
+ * (group commit): the first caller writes the whole tail on behalf of every
+ * caller waiting behind it.
+ *
+ * After a crash, redo() replays the records in log order onto the files they
+ * were made to.  Recovery is redo-only: once changes to a page are logged,
+ * all of its changes must be for replay to bring it up to date, and the log
+ * can be truncated once the pages it covers are on disk (see
+ * BufMgr::checkpoint()).
+ *
+ * The log is not tied to a page file format; each file is named once in the
+ * log by a file record, and changes refer to it by a small file ID.
+ */
+class LogManager {
+ public:
+  /**
+   * LSN of a page with no logged changes.
+   */
+  static const LogSequenceNumber INVALID_LSN = 0;
+
+  /**
+   * Opens the log in the given file, creating it if it doesn't exist.  An
+   * incomplete record at the end of an existing log (left by a crash in the
+   * middle of a flush) is discarded.
+   *
+   * @param filename  Name of the log file.
+   * @throws  BadLogFileException   If the file exists and is not a log.
+   */
+  explicit LogManager(const std::string& filename);
+
+  /**
+   * Flushes the records still in memory and closes the log.
+   */
+  ~LogManager();
+
+  /**
+   * Appends a change record holding the given after-image of part of a page.
+   * The record is kept in memory until the next flush.
+   *
+   * @param filename      Name of the file the page is in.
+   * @param page_number   Number of the page.
+   * @param offset        Offset of the changed bytes in the page.
+   * @param data          New contents of the changed bytes.
+   * @param length        Number of changed bytes.
+   * @return  LSN of the record.
+   */
+  LogSequenceNumber appendChange(const std::string& filename,
+                                 const PageId page_number,
+                                 const std::size_t offset,
+                                 const char* data,
+                                 const std::size_t length);
+
+  /**
+   * Makes every record up to the given LSN durable.  Returns at once if they
+   * already are; otherwise either writes and syncs everything appended so
+   * far, or waits for a concurrent flush that covers the LSN.
+   *
+   * @param lsn   LSN to make durable.
+   */
+  void flush(const LogSequenceNumber lsn);
+
+  /**
+   * Makes every record appended so far durable.
+   */
+  void flush() { flush(lastLSN()); }
+
+  /**
+   * Returns the LSN of the last record appended.
+   */
+  LogSequenceNumber lastLSN() const;
+
+  /**
+   * Returns the LSN up to which the log is on stable storage.
+   */
+  LogSequenceNumber durableLSN() const;
+
+  /**
+   * Discards every record in the log.  The caller must have made the changes
+   * they hold durable in the files they were made to.
+   */
+  void truncate();
+
+  /**
+   * Replays the change records in the log, in order, onto their pages.  Pages
+   * that no longer exist are skipped.
+   *
+   * @param open_file   Returns the file with the given name, or NULL if the
+   *                    changes to it should be skipped.
+   * @return  Number of change records applied.
+   */
+  std::size_t redo(
+      const std::function<File*(const std::string&)>& open_file);
+
+  /**
+   * Returns the name of the log file.
+   */
+  const std::string& filename() const { return handle_->filename(); }
+
+ private:
+  /**
+   * @brief Header at the start of the log file.
+   */
+  struct LogHeader {
+    /**
+     * Marks the file as a log.
+     */
+    std::uint32_t magic;
+
+    /**
+     * Unused; keeps base_lsn aligned.
+     */
+    std::uint32_t reserved;
+
+    /**
+     * LSN of the first byte of the log file.
+     */
+    std::uint64_t base_lsn;
+  };
+
+  /**
+   * @brief Header of a record in the log.
+   */
+  struct RecordHeader {
+    /**
+     * Checksum of the record, computed with this field set to 0.
+     */
+    std::uint32_t checksum;
+
+    /**
+     * Number of payload bytes following the header.
+     */
+    std::uint32_t length;
+
+    /**
+     * Kind of record (FILE_RECORD or CHANGE_RECORD).
+     */
+    std::uint16_t type;
+
+    /**
+     * ID of the file the record refers to.
+     */
+    std::uint16_t file_id;
+
+    /**
+     * Number of the changed page (change records only).
+     */
+    PageId page_number;
+
+    /**
+     * Offset of the changed bytes in the page (change records only).
+     */
+    std::uint32_t offset;
+  };
+
+  /**
+   * Value of LogHeader::magic.
+   */
+  static const std::uint32_t MAGIC = 0x474c4442;
+
+  /**
+   * Record naming a file; its payload is the file name.
+   */
+  static const std::uint16_t FILE_RECORD = 1;
+
+  /**
+   * Record holding an after-image; its payload is the new bytes.
+   */
+  static const std::uint16_t CHANGE_RECORD = 2;
+
+  LogManager(const LogManager&) = delete;
+  LogManager& operator=(const LogManager&) = delete;
+
+  /**
+   * Appends a record to the in-memory tail.  The caller holds mutex_.
+   *
+   * @return  LSN of the record.
+   */
+  LogSequenceNumber appendRecord(RecordHeader& header, const char* payload);
+
+  /**
+   * Calls visit for each complete record in the given log image, in order.
+   *
+   * @param log     Log file contents.
+   * @param length  Length of log in bytes.
+   * @param visit   Called with the header and payload of each record.
+   * @return  Offset of the end of the last complete record.
+   */
+  static std::size_t scan(
+      const char* log, const std::size_t length,
+      const std::function<void(const RecordHeader&, const char*)>& visit);
+
+  /**
+   * Returns the checksum of a record.
+   */
+  static std::uint32_t checksum(const RecordHeader& header,
+                                const char* payload);
+
+  /**
+   * Writes a header with the given base LSN to the log file.
+   */
+  void writeHeader(const LogSequenceNumber base_lsn);
+
+  /**
+   * Handle of the log file.
+   */
+  std::shared_ptr<FileHandle> handle_;
+
+  /**
+   * Protects every member below.
+   */
+  mutable std::mutex mutex_;
+
+  /**
+   * Signalled when a flush finishes.
+   */
+  std::condition_variable flushed_;
+
+  /**
+   * True while a flush is writing the log.
+   */
+  bool flushing_;
+
+  /**
+   * LSN of the first byte of the log file.
+   */
+  LogSequenceNumber base_lsn_;
+
+  /**
+   * LSN up to which the log file is durable.
+   */
+  LogSequenceNumber durable_lsn_;
+
+  /**
+   * LSN of the last record appended.
+   */
+  LogSequenceNumber end_lsn_;
+
+  /**
+   * Records appended since the last flush started.
+   */
+  std::string tail_;
+
+  /**
+   * IDs given to the files named in the log.
+   */
+  std::map<std::string, std::uint16_t> file_ids_;
+};
+
+}
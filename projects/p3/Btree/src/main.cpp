@@ -12,18 +12,43 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <thread>
 #include <vector>
+#include <sys/stat.h>
 #include "btree.h"
 #include "page.h"
 #include "filescan.h"
+#include "parallel_filescan.h"
 #include "page_iterator.h"
 #include "file_iterator.h"
+#include "striped_file.h"
+#include "file_handle.h"
+#include "pax_page.h"
+#include "fixed_page.h"
+#include "relation_loader.h"
+#include "log_manager.h"
+#include "table_statistics.h"
+#include "sample_scan.h"
+#include "batch_operator.h"
+#include "hash_join.h"
+#include "external_sort.h"
+#include "hash_aggregate.h"
 #include "exceptions/insufficient_space_exception.h"
+#include "exceptions/invalid_record_exception.h"
+#include "exceptions/key_type_mismatch_exception.h"
 #include "exceptions/index_scan_completed_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/no_such_key_found_exception.h"
 #include "exceptions/bad_scanrange_exception.h"
 #include "exceptions/bad_opcodes_exception.h"
+#include "exceptions/bad_scan_param_exception.h"
+#include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/end_of_file_exception.h"
 
@@ -59,6 +84,14 @@ const std::string relationName = "relA";
 //during the scan, else tests will erroneously be reported to have failed.
 const int	relationSize = 5000;
 std::string intIndexName, doubleIndexName, stringIndexName;
+//Page size of the index files created by intTests/doubleTests/stringTests.
+std::size_t indexPageSize = Page::DEFAULT_SIZE;
+//Page size of the relation files created by createRelationForward/Backward/Random.
+std::size_t relationPageSize = Page::DEFAULT_SIZE;
+//Whether the index files created by intTests/doubleTests/stringTests are compressed.
+bool indexCompressed = false;
+//Whether createRelationForward/Backward/Random lay out the relation in PAX pages.
+bool relationPax = false;
 
 // This is the structure for tuples in the base relation
 
@@ -111,7 +144,38 @@ void test9(); // test delete
 void test10(); // test delete
 void test11(); // test delete
 void test12(); // test delete
+void test13(); // compressed index pages
+void test14(); // striped file
+void test15(); // PAX relation pages
+void test16(); // fixed-length record pages
+void test17(); // write-ahead log
+void test18(); // predicate pushdown
+int predicateScan(const ScanPredicate &predicate);
+void test19(); // parallel scan
+void test20(); // batched scan
+void test21(); // projected scan
+void test22(); // table statistics
+void test23(); // batch operators
+void test24(); // hash join
+void test25(); // external sort
+void test26(); // hash aggregation
+void test27(); // index nested-loop join
+void test28(); // freed page storage
+void test29(); // page slot directory
+void test30(); // page record updates
+void test31(); // large pages
+void test32(); // file handle registry
+void test33(); // record views
+void test34(); // deferred compaction
+void test35(); // one read per scanned page
+void test36(); // bulk record insertion
+void test37(); // used slot lists
+bool pageMatches(Page &page, const std::map<SlotId, std::string> &expected);
+std::uint64_t allocatedBytes(const std::string &filename);
+std::vector<PaxAttribute> relationAttributes();
+std::string readTuple(Page *page, const RecordId &rid);
 void errorTests();
+void removeIndexFiles();
 void deleteRelation();
 
 int main(int argc, char **argv)
@@ -208,6 +272,31 @@ int main(int argc, char **argv)
     test5(); // test split non-leaf file, small page
     test55(); // test split non-leaf file, large entries
     test6(); // test read existing but bad file
+    test13(); // test compressed index pages
+    test14(); // test striped file
+    test15(); // test PAX relation pages
+    test16(); // test fixed-length record pages
+    test17(); // test write-ahead log
+    test18(); // test predicate pushdown
+    test19(); // test parallel scan
+    test20(); // test batched scan
+    test21(); // test projected scan
+    test22(); // test table statistics
+    test23(); // test batch operators
+    test24(); // test hash join
+    test25(); // test external sort
+    test26(); // test hash aggregation
+    test27(); // test index nested-loop join
+    test28(); // test freed page storage
+    test29(); // test page slot directory
+    test30(); // test page record updates
+    test31(); // test large pages
+    test32(); // test file handle registry
+    test33(); // test record views
+    test34(); // test deferred compaction
+    test35(); // test one read per scanned page
+    test36(); // test bulk record insertion
+    test37(); // test used slot lists
 //     test7(); // test duplicate key // not working
   
     test8(); // test delete: delete an entry
@@ -298,7 +387,10 @@ void test4()
 void test5()
 {
 
-    const int size = 130000; // 340*340
+    // With the smallest page size non-leaf nodes hold only a few dozen keys,
+    // so relationSize tuples are enough to split them.
+    const int size = relationSize;
+    indexPageSize = Page::MIN_SIZE;
 
 	std::cout << std::endl;
 	std::cout << std::endl;
@@ -331,6 +423,8 @@ void test5()
 	createRelationRandom(size);
 	indexTests();
 	deleteRelation();
+
+    indexPageSize = Page::DEFAULT_SIZE;
 }
 
 void test55()
@@ -619,6 +713,31 @@ void createRelationLarge( std::string mode, int size )
 
 
 
+// -----------------------------------------------------------------------------
+// Relation page helpers
+// -----------------------------------------------------------------------------
+
+// Attributes of RECORD for PAX relation pages, or none if relationPax is not set.
+std::vector<PaxAttribute> relationAttributes()
+{
+  std::vector<PaxAttribute> attributes;
+  if (relationPax)
+  {
+    attributes.push_back({offsetof(RECORD, i), sizeof(record1.i)});
+    attributes.push_back({offsetof(RECORD, d), sizeof(record1.d)});
+    attributes.push_back({offsetof(RECORD, s), sizeof(record1.s)});
+  }
+  return attributes;
+}
+
+// Reads a tuple from a page of either layout.
+std::string readTuple(Page *page, const RecordId &rid)
+{
+  if (PaxPage::isFormatted(*page))
+    return PaxPage(page).getRecord(rid);
+  return page->getRecord(rid);
+}
+
 // -----------------------------------------------------------------------------
 // createRelationForward
 // -----------------------------------------------------------------------------
@@ -640,12 +759,11 @@ void createRelationForward(int size)
 	{
 	}
 
-  file1 = new PageFile(relationName, true);
+  file1 = new PageFile(relationName, true, relationPageSize);
 
   // initialize all of record1.s to keep purify happy
   memset(record1.s, ' ', sizeof(record1.s));
-  PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
+  std::vector<std::string> records;
 
   // Insert a bunch of tuples into the relation.
   for(int i = 0; i < size; i++ )
@@ -655,22 +773,11 @@ void createRelationForward(int size)
     record1.d = (double)i;
     std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
 
-		while(1)
-		{
-			try
-			{
-    		new_page.insertRecord(new_data);
-				break;
-			}
-            catch(InsufficientSpaceException e)
-            {
-              file1->writePage(new_page_number, new_page);
-              new_page = file1->allocatePage(new_page_number);
-            }
-		}
+		records.push_back(new_data);
   }
 
-	file1->writePage(new_page_number, new_page);
+  RelationLoader loader(file1, sizeof(RECORD), relationAttributes());
+  loader.insertRecords(records);
 }
 
 
@@ -693,12 +800,11 @@ void createRelationBackward(int size)
 	catch(FileNotFoundException e)
 	{
 	}
-  file1 = new PageFile(relationName, true);
+  file1 = new PageFile(relationName, true, relationPageSize);
 
   // initialize all of record1.s to keep purify happy
   memset(record1.s, ' ', sizeof(record1.s));
-	PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
+	std::vector<std::string> records;
 
   // Insert a bunch of tuples into the relation.
   for(int i = size - 1; i >= 0; i-- )
@@ -709,22 +815,11 @@ void createRelationBackward(int size)
 
     std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
 
-		while(1)
-		{
-			try
-			{
-    		new_page.insertRecord(new_data);
-				break;
-			}
-			catch(InsufficientSpaceException e)
-			{
-				file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
-			}
-		}
+		records.push_back(new_data);
   }
 
-	file1->writePage(new_page_number, new_page);
+  RelationLoader loader(file1, sizeof(RECORD), relationAttributes());
+  loader.insertRecords(records);
 }
 
 
@@ -748,12 +843,11 @@ void createRelationRandom(int size)
 	catch(FileNotFoundException e)
 	{
 	}
-  file1 = new PageFile(relationName, true);
+  file1 = new PageFile(relationName, true, relationPageSize);
 
   // initialize all of record1.s to keep purify happy
   memset(record1.s, ' ', sizeof(record1.s));
-	PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
+	std::vector<std::string> records;
 
   // insert records in random order
 
@@ -775,24 +869,16 @@ void createRelationRandom(int size)
 
     std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
 
-    while(1) {
-      try {
-        new_page.insertRecord(new_data);
-        break;
-      } catch(InsufficientSpaceException e)
-      {
-        file1->writePage(new_page_number, new_page);
-        new_page = file1->allocatePage(new_page_number);
-      }
-    }
+    records.push_back(new_data);
 
     int temp = intvec[size-1-i];
     intvec[size-1-i] = intvec[pos];
     intvec[pos] = temp;
     i++;
   }
-  
-	file1->writePage(new_page_number, new_page);
+
+  RelationLoader loader(file1, sizeof(RECORD), relationAttributes());
+  loader.insertRecords(records);
 }
 
 // -----------------------------------------------------------------------------
@@ -880,7 +966,7 @@ void indexTests2()
 void intTests()
 {
   std::cout << "Create a B+ Tree index on the integer field" << std::endl;
-  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+  BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER, indexPageSize, indexCompressed);
 
 #ifdef DEBUG
 // haiyun
@@ -977,7 +1063,7 @@ int intScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Operato
 #ifdef DEBUG
     std::cout<<" cal Page::getRecord at "<<__LINE__<<std::endl;
 #endif
-			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(readTuple(curPage, scanRid).data()));
 			bufMgr->unPinPage(file1, scanRid.page_number, false);
 
 			if( numResults < 5 )
@@ -1036,7 +1122,7 @@ void doubleTestsnonleaf()
 void doubleTests()
 {
   std::cout << "Create a B+ Tree index on the double field" << std::endl;
-  BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE);
+  BTreeIndex index(relationName, doubleIndexName, bufMgr, offsetof(tuple,d), DOUBLE, indexPageSize, indexCompressed);
 #ifdef DEBUG
   std::cout << "FINISHED CREATING INDEX FILE" << std::endl;
 #endif
@@ -1094,7 +1180,7 @@ int doubleScan(BTreeIndex * index, double lowVal, Operator lowOp, double highVal
   std::cout<<" scanRid.page_number is "<< scanRid.page_number<<std::endl;
 #endif
 			bufMgr->readPage(file1, scanRid.page_number, curPage);
-			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(readTuple(curPage, scanRid).data()));
 			bufMgr->unPinPage(file1, scanRid.page_number, false);
 
 			if( numResults < 5 )
@@ -1160,7 +1246,7 @@ std::cout<<" stringScan(&index,25,GT,40,LT); RESULT is "<<out<<std::endl;
 void stringTests()
 {
   std::cout << "Create a B+ Tree index on the string field" << std::endl;
-  BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING);
+  BTreeIndex index(relationName, stringIndexName, bufMgr, offsetof(tuple,s), STRING, indexPageSize, indexCompressed);
 
 	// run some tests
 #ifdef DEBUGSTRING
@@ -1239,7 +1325,7 @@ int stringScanLarge(BTreeIndex * index, int lowVal, Operator lowOp, int highVal,
   std::cout<<" scanRid.page_number is "<< scanRid.page_number<<std::endl;
 #endif
 			bufMgr->readPage(file1, scanRid.page_number, curPage);
-			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(readTuple(curPage, scanRid).data()));
 			bufMgr->unPinPage(file1, scanRid.page_number, false);
 
 			if( numResults < 5 )
@@ -1323,7 +1409,7 @@ int stringScan(BTreeIndex * index, int lowVal, Operator lowOp, int highVal, Oper
   std::cout<<" scanRid.page_number is "<< scanRid.page_number<<std::endl;
 #endif
 			bufMgr->readPage(file1, scanRid.page_number, curPage);
-			RECORD myRec = *(reinterpret_cast<const RECORD*>(curPage->getRecord(scanRid).data()));
+			RECORD myRec = *(reinterpret_cast<const RECORD*>(readTuple(curPage, scanRid).data()));
 			bufMgr->unPinPage(file1, scanRid.page_number, false);
 
 			if( numResults < 5 )
@@ -1473,6 +1559,18 @@ void errorTests()
 	deleteRelation();
 }
 
+void removeIndexFiles()
+{
+	const int offsets[] = {offsetof(tuple,i), offsetof(tuple,d), offsetof(tuple,s)};
+	for (int k = 0; k < 3; k++)
+	{
+		std::ostringstream name;
+		name << relationName << '.' << offsets[k];
+		if (File::exists(name.str()))
+			File::remove(name.str());
+	}
+}
+
 void deleteRelation()
 {
 	if(file1) {
@@ -1720,6 +1818,22 @@ void test11()
 //  	      checkPassFail(intScan(&index,0,GT,5000,LT), 4999-i)
         }
  	      checkPassFail(intScan(&index,0,GT,5000,LT), 4999-4800)
+        // merged pages were freed; inserting again must reuse them safely
+        {
+          FileScan fscan(relationName, bufMgr);
+          try {
+            RecordId rid;
+            while (1) {
+              fscan.scanNext(rid);
+              std::string recordStr = fscan.getRecord();
+              key = reinterpret_cast<const RECORD*>(recordStr.data())->i;
+              if ( key >= 1 && key <= end )
+                index.insertEntry((void*)(&key), rid);
+            }
+          } catch(EndOfFileException e) {
+          }
+        }
+ 	      checkPassFail(intScan(&index,0,GT,5000,LT), 4999)
 #ifdef DEBUGPRINTTREE
         index.printTree();
 #endif
@@ -1770,3 +1884,2335 @@ void test12()
     deleteRelation();
 }
 
+
+// compressed index pages
+
+void test13()
+{
+    indexCompressed = true;
+
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "-----------------------------" << std::endl;
+	std::cout << "- test compressed index pages -" << std::endl;
+	std::cout << "-----------------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+	// test55 leaves some index files behind; an index opened from one of them
+	// would not be compressed, or built on this relation
+	removeIndexFiles();
+
+	// Random order leaves many leaves half full after splits.
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationRandom" << std::endl;
+	createRelationRandom();
+	indexTests();
+	deleteRelation();
+
+    indexCompressed = false;
+}
+
+
+// striped file
+
+void test14()
+{
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "-----------------------" << std::endl;
+	std::cout << "- test striped file -" << std::endl;
+	std::cout << "-----------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+    const std::string stripedName = relationName + ".striped";
+    std::vector<std::string> stripes;
+    for (int i = 0; i < 3; ++i) {
+      std::ostringstream name;
+      name << stripedName << '.' << i;
+      stripes.push_back(name.str());
+    }
+    const int numPages = 20;
+
+    {
+      // two consecutive pages per stripe
+      StripedFile striped = StripedFile::create(stripedName, stripes, 2);
+      for (int i = 0; i < numPages; ++i) {
+        PageId pageNo;
+        Page page = striped.allocatePage(pageNo);
+        record1.i = pageNo;
+        std::string data(reinterpret_cast<char*>(&record1), sizeof(record1));
+        page.insertRecord(data);
+        striped.writePage(pageNo, page);
+      }
+    }
+
+    {
+      StripedFile striped = StripedFile::open(stripedName);
+      int found = 0;
+      for (PageId pageNo = 1; pageNo <= numPages; ++pageNo) {
+        Page page = striped.readPage(pageNo);
+        std::string data = *page.begin();
+        if (reinterpret_cast<const RECORD*>(data.data())->i == (int)pageNo)
+          found++;
+      }
+      checkPassFail(found, numPages)
+      checkPassFail((int)striped.stripeOf(5), 2)
+      checkPassFail((int)striped.stripeOf(7), 0)
+
+      // freeing the last pages shrinks the file, so numbering resumes
+      for (PageId pageNo = numPages; pageNo > 10; --pageNo)
+        striped.deletePage(pageNo);
+      PageId pageNo;
+      striped.allocatePage(pageNo);
+      checkPassFail((int)pageNo, 11)
+    }
+
+    File::remove(stripedName);
+    checkPassFail(File::exists(stripes[0]), false)
+
+    // an index built over stripes spreads its pages over all of them
+    std::cout << "---------------------" << std::endl;
+    std::cout << "createRelationForward" << std::endl;
+    createRelationForward();
+    std::string indexName;
+    {
+      BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple,i), INTEGER, Page::MIN_SIZE, false, stripes);
+      checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+    }
+    int used = 0;
+    for (std::size_t i = 0; i < stripes.size(); ++i)
+      if (allocatedBytes(stripes[i]) > 0)
+        used++;
+    checkPassFail(used, 3)
+    {
+      // reopened from the stripes it was built on
+      BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple,i), INTEGER);
+      checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+    }
+    File::remove(indexName);
+    checkPassFail(File::exists(stripes[2]), false)
+    deleteRelation();
+
+    // a header that is not a striped file's names no files to remove
+    {
+      std::vector<std::string> victim(1, stripes[0]);
+      StripedFile::create(stripedName, victim);
+    }
+    {
+      std::fstream damaged(stripedName.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+      const std::uint32_t badSize = 3;
+      damaged.seekp(offsetof(FileHeader, page_size));
+      damaged.write(reinterpret_cast<const char*>(&badSize), sizeof(badSize));
+    }
+    checkPassFail(StripedFile::stripeFilenames(stripedName).size(), 0)
+    File::remove(stripedName);
+    checkPassFail(File::exists(stripes[0]), true)
+    File::remove(stripes[0]);
+}
+
+
+// PAX relation pages
+
+void test15()
+{
+    relationPax = true;
+
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "----------------------------" << std::endl;
+	std::cout << "- test PAX relation pages -" << std::endl;
+	std::cout << "----------------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationRandom" << std::endl;
+	createRelationRandom();
+
+	{
+		// every tuple comes back whole from the mini-pages
+		FileScan fscan(relationName, bufMgr);
+		int found = 0;
+		try
+		{
+			RecordId scanRid;
+			while(1)
+			{
+				fscan.scanNext(scanRid);
+				const RECORD* tuple =
+				    reinterpret_cast<const RECORD*>(fscan.getRecordView().data);
+				int key = *((const int *)fscan.getAttribute(offsetof(RECORD, i), sizeof(int)));
+				if (key == tuple->i && tuple->d == (double)key &&
+				    atoi(tuple->s) == key)
+					found++;
+			}
+		}
+		catch(EndOfFileException e)
+		{
+		}
+		checkPassFail(found, relationSize)
+	}
+
+	indexTests();
+	deleteRelation();
+
+    relationPax = false;
+}
+
+
+// fixed-length record pages
+
+void test16()
+{
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "------------------------------------" << std::endl;
+	std::cout << "- test fixed-length record pages -" << std::endl;
+	std::cout << "------------------------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+
+	int capacity = 0;
+	{
+		PageFile file = PageFile::create(relationName);
+		PageId pageNo;
+		Page page = file.allocatePage(pageNo);
+
+		// without slot entries more records fit than in a slotted page
+		Page slotted = page;
+		std::string data(sizeof(RECORD), ' ');
+		int slottedCount = 0;
+		while (slotted.hasSpaceForRecord(data))
+		{
+			slotted.insertRecord(data);
+			slottedCount++;
+		}
+		FixedPage<sizeof(RECORD)> fixed = FixedPage<sizeof(RECORD)>::format(&page);
+		capacity = fixed.capacity();
+		bool denser = capacity > slottedCount;
+		checkPassFail(denser, true)
+
+		memset(record1.s, ' ', sizeof(record1.s));
+		std::vector<RecordId> rids;
+		for (int i = 0; fixed.hasSpaceForRecord(); i++)
+		{
+			sprintf(record1.s, "%05d string record", i);
+			record1.i = i;
+			record1.d = i;
+			rids.push_back(fixed.insertRecord(&record1));
+		}
+
+		// deleted slots are handed out again, lowest first
+		for (std::size_t k = 0; k < rids.size(); k += 2)
+			fixed.deleteRecord(rids[k]);
+		checkPassFail((int)fixed.num_records(), (int)(rids.size() / 2))
+		int reused = 0;
+		for (std::size_t k = 0; k < rids.size(); k += 2)
+		{
+			sprintf(record1.s, "%05d string record", (int)k);
+			record1.i = k;
+			record1.d = k;
+			RecordId rid = fixed.insertRecord(&record1);
+			if (rid.slot_number == rids[k].slot_number)
+				reused++;
+		}
+		checkPassFail(reused, (int)((rids.size() + 1) / 2))
+
+		int found = 0;
+		for (std::size_t k = 0; k < rids.size(); k++)
+		{
+			const RECORD* tuple = reinterpret_cast<const RECORD*>(fixed.getRecord(rids[k]));
+			if (tuple->i == (int)k && tuple->d == (double)k)
+				found++;
+		}
+		checkPassFail(found, capacity)
+		file.writePage(pageNo, page);
+	}
+
+	{
+		// the page reads back through the PAX path of a file scan
+		FileScan fscan(relationName, bufMgr);
+		int found = 0;
+		try
+		{
+			RecordId scanRid;
+			while(1)
+			{
+				fscan.scanNext(scanRid);
+				if (reinterpret_cast<const RECORD*>(fscan.getRecordView().data)->i == scanRid.slot_number - 1)
+					found++;
+			}
+		}
+		catch(EndOfFileException e)
+		{
+		}
+		checkPassFail(found, capacity)
+	}
+
+	File::remove(relationName);
+}
+
+void test17()
+{
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "------------------------------------" << std::endl;
+	std::cout << "- test write-ahead log -" << std::endl;
+	std::cout << "------------------------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+	const std::string logName = relationName + ".log";
+	try
+	{
+		File::remove(relationName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	std::remove(logName.c_str());
+
+	PageFile* file = new PageFile(relationName, true);
+	PageId pageNo;
+	RecordId rid;
+	{
+		LogManager log(logName);
+		bufMgr->attachLog(&log);
+
+		Page* page;
+		bufMgr->allocPage(file, pageNo, page);
+		memset(record1.s, ' ', sizeof(record1.s));
+		sprintf(record1.s, "%05d string record", 1);
+		record1.i = 1;
+		record1.d = 1;
+		rid = page->insertRecord(std::string(reinterpret_cast<char*>(&record1), sizeof(RECORD)));
+		bufMgr->logUpdate(file, pageNo, 0, file->page_size());
+
+		// change one field in place and log just its bytes
+		RECORD* tuple = reinterpret_cast<RECORD*>(const_cast<char*>(page->getRecordView(rid).data));
+		tuple->i = 42;
+		const std::size_t offset = reinterpret_cast<char*>(&tuple->i) - reinterpret_cast<char*>(page);
+		bufMgr->logUpdate(file, pageNo, offset, sizeof(tuple->i));
+		bufMgr->unPinPage(file, pageNo, false);
+
+		bufMgr->commit();
+		bool durable = log.durableLSN() == log.lastLSN();
+		checkPassFail(durable, true)
+
+		// the page itself is still only in the buffer pool
+		std::vector<SlotId> slots;
+		file->readPage(pageNo).getUsedSlots(slots);
+		checkPassFail((int)slots.size(), 0)
+		bufMgr->attachLog(NULL);
+	}
+
+	{
+		// reopening the log finds the committed records and replays them
+		LogManager log(logName);
+		PageFile recovered = PageFile::open(relationName);
+		std::function<File*(const std::string&)> openFile =
+			[&recovered](const std::string& name) -> File* { return name == relationName ? &recovered : NULL; };
+		checkPassFail((int)log.redo(openFile), 2)
+		Page page = recovered.readPage(pageNo);
+		checkPassFail(reinterpret_cast<const RECORD*>(page.getRecordView(rid).data)->i, 42)
+
+		// after a checkpoint there is nothing left to redo
+		bufMgr->attachLog(&log);
+		bufMgr->checkpoint();
+		bufMgr->attachLog(NULL);
+		checkPassFail((int)log.redo(openFile), 0)
+	}
+
+	bufMgr->flushFile(file);
+	delete file;
+	File::remove(relationName);
+	std::remove(logName.c_str());
+}
+
+
+// predicate pushdown
+
+void test18()
+{
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "------------------------------------" << std::endl;
+	std::cout << "- test predicate pushdown -" << std::endl;
+	std::cout << "------------------------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+	// the same answers from slotted pages and from PAX mini-pages
+	for (int pax = 0; pax < 2; pax++)
+	{
+		relationPax = pax != 0;
+		createRelationForward();
+
+		int intVal = 100;
+		checkPassFail(predicateScan(ScanPredicate(offsetof(RECORD, i), INTEGER, LT, &intVal)), 100)
+		intVal = 7;
+		checkPassFail(predicateScan(ScanPredicate(offsetof(RECORD, i), INTEGER, NE, &intVal)), relationSize - 1)
+		double doubleVal = relationSize - 10;
+		checkPassFail(predicateScan(ScanPredicate(offsetof(RECORD, d), DOUBLE, GTE, &doubleVal)), 10)
+		checkPassFail(predicateScan(ScanPredicate(offsetof(RECORD, s), STRING, EQ, "00042 string", STRINGSIZE)), 1)
+
+		{
+			// the record that passed is the one returned
+			FileScan fscan(relationName, bufMgr, ScanPredicate(offsetof(RECORD, s), STRING, EQ, "00042", 5));
+			RecordId scanRid;
+			fscan.scanNext(scanRid);
+			checkPassFail(reinterpret_cast<const RECORD*>(fscan.getRecordView().data)->i, 42)
+		}
+
+		deleteRelation();
+	}
+	relationPax = false;
+
+	{
+		// a string attribute needs a length
+		createRelationForward();
+		int refused = 0;
+		try
+		{
+			ScanPredicate predicate(offsetof(RECORD, s), STRING, EQ, "00042");
+		}
+		catch (const BadScanParamException &e)
+		{
+			refused++;
+		}
+		try
+		{
+			ScanOperator scan(relationName, bufMgr);
+			scan.addColumn(offsetof(RECORD, s), STRING);
+		}
+		catch (const BadScanParamException &e)
+		{
+			refused++;
+		}
+		try
+		{
+			TableStatistics statistics;
+			statistics.addAttribute(offsetof(RECORD, s), STRING);
+		}
+		catch (const BadScanParamException &e)
+		{
+			refused++;
+		}
+		checkPassFail(refused, 3)
+		deleteRelation();
+	}
+}
+
+int predicateScan(const ScanPredicate &predicate)
+{
+	FileScan fscan(relationName, bufMgr, predicate);
+	int found = 0;
+	try
+	{
+		RecordId scanRid;
+		while(1)
+		{
+			fscan.scanNext(scanRid);
+			found++;
+		}
+	}
+	catch(EndOfFileException e)
+	{
+	}
+	return found;
+}
+
+
+// parallel scan
+
+void test19()
+{
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "------------------------------------" << std::endl;
+	std::cout << "- test parallel scan -" << std::endl;
+	std::cout << "------------------------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+	createRelationForward();
+
+	// a free page in the middle of the relation is skipped
+	bufMgr->flushFile(file1);
+	file1->deletePage(2);
+
+	std::vector<RecordId> sequential;
+	{
+		FileScan fscan(relationName, bufMgr);
+		try
+		{
+			RecordId scanRid;
+			while(1)
+			{
+				fscan.scanNext(scanRid);
+				sequential.push_back(scanRid);
+			}
+		}
+		catch(EndOfFileException e)
+		{
+		}
+	}
+
+	{
+		// morsels taken in order give the records in scan order
+		ParallelFileScan pscan(relationName, bufMgr, 3);
+		std::vector<std::vector<RecordId> > morselRids(pscan.num_morsels());
+		pscan.run(4, [&morselRids](const std::size_t morsel, PageRecords& records)
+		{
+			for (std::size_t i = 0; i < records.size(); i++)
+				morselRids[morsel].push_back(records.recordId(i));
+		});
+		std::vector<RecordId> parallel;
+		for (std::size_t m = 0; m < morselRids.size(); m++)
+			parallel.insert(parallel.end(), morselRids[m].begin(), morselRids[m].end());
+		bool sameOrder = parallel == sequential;
+		checkPassFail(sameOrder, true)
+	}
+
+	{
+		// the workers test the predicate on their own pages
+		int intVal = 1000;
+		ParallelFileScan pscan(relationName, bufMgr, ScanPredicate(offsetof(RECORD, i), INTEGER, GTE, &intVal));
+		std::atomic<int> found(0);
+		pscan.run(0, [&found](const std::size_t, PageRecords& records)
+		{
+			for (std::size_t i = 0; i < records.size(); i++)
+				if (reinterpret_cast<const RECORD*>(records.view(i).data)->i >= 1000)
+					found++;
+		});
+		checkPassFail(found.load(), relationSize - 1000)
+	}
+
+	{
+		// a morsel whose scan fails is finished as not completed
+		ParallelFileScan pscan(relationName, bufMgr, 3);
+		std::vector<int> finished(pscan.num_morsels(), -1);
+		bool thrown = false;
+		try
+		{
+			pscan.run(1, [](const std::size_t morsel, PageRecords&)
+			{
+				if (morsel == 1)
+					throw std::runtime_error("scan failed");
+			},
+			[&finished](const std::size_t morsel, const bool completed)
+			{
+				finished[morsel] = completed ? 1 : 0;
+			});
+		}
+		catch(const std::runtime_error &e)
+		{
+			thrown = true;
+		}
+		checkPassFail(thrown, true)
+		checkPassFail(finished[0], 1)
+		checkPassFail(finished[1], 0)
+		checkPassFail(finished[2], -1)
+	}
+
+	{
+		// an index whose build fails leaves no index file behind
+		std::string indexName;
+		bool thrown = false;
+		try
+		{
+			BTreeIndex index(relationName + ".missing", indexName, bufMgr, offsetof(tuple,i), INTEGER);
+		}
+		catch(FileNotFoundException e)
+		{
+			thrown = true;
+		}
+		checkPassFail(thrown, true)
+		checkPassFail(File::exists(indexName), false)
+	}
+
+	deleteRelation();
+}
+
+
+// batched scan
+
+void test20()
+{
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "------------------------------------" << std::endl;
+	std::cout << "- test batched scan -" << std::endl;
+	std::cout << "------------------------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+	for (int pax = 0; pax < 2; pax++)
+	{
+		relationPax = pax != 0;
+		createRelationForward();
+
+		// batches come back in scan order, each record whole
+		const std::size_t batchSize = 7;
+		RecordId rids[batchSize];
+		RecordView views[batchSize];
+		int found = 0;
+		int next = 0;
+		{
+			FileScan fscan(relationName, bufMgr);
+			std::size_t count;
+			while ((count = fscan.scanNextBatch(rids, views, batchSize)) > 0)
+			{
+				for (std::size_t k = 0; k < count; k++, next++)
+				{
+					if (reinterpret_cast<const RECORD*>(views[k].data)->i == next)
+						found++;
+				}
+			}
+			// the end of the relation is not an error
+			checkPassFail((int)fscan.scanNextBatch(rids, views, batchSize), 0)
+		}
+		checkPassFail(found, relationSize)
+
+		{
+			// a selective scan, mixed with single records
+			int intVal = 10;
+			FileScan fscan(relationName, bufMgr, ScanPredicate(offsetof(RECORD, i), INTEGER, LT, &intVal));
+			RecordId scanRid;
+			fscan.scanNext(scanRid);
+			checkPassFail(reinterpret_cast<const RECORD*>(fscan.getRecordView().data)->i, 0)
+			checkPassFail((int)fscan.scanNextBatch(rids, NULL, batchSize), (int)batchSize)
+			checkPassFail((int)fscan.scanNextBatch(rids, views, batchSize), 2)
+			checkPassFail(reinterpret_cast<const RECORD*>(views[1].data)->i, 9)
+			checkPassFail((int)fscan.scanNextBatch(rids, views, batchSize), 0)
+		}
+
+		deleteRelation();
+	}
+	relationPax = false;
+}
+
+
+// projected scan
+
+void test21()
+{
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "------------------------------------" << std::endl;
+	std::cout << "- test projected scan -" << std::endl;
+	std::cout << "------------------------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+	// the double then the int of each record, 12 bytes a row
+	std::vector<PaxAttribute> attributes(2);
+	attributes[0].offset = offsetof(RECORD, d);
+	attributes[0].length = sizeof(double);
+	attributes[1].offset = offsetof(RECORD, i);
+	attributes[1].length = sizeof(int);
+	const std::size_t rowLength = sizeof(double) + sizeof(int);
+
+	for (int pax = 0; pax < 2; pax++)
+	{
+		relationPax = pax != 0;
+		createRelationForward();
+
+		{
+			FileScan fscan(relationName, bufMgr);
+			fscan.setProjection(attributes);
+			checkPassFail((int)fscan.projectedLength(), (int)rowLength)
+
+			const std::size_t batchSize = 32;
+			RecordId rids[batchSize];
+			char rows[batchSize * rowLength];
+			int found = 0;
+			int next = 0;
+			std::size_t count;
+			while ((count = fscan.scanNextProjected(rids, rows, batchSize)) > 0)
+			{
+				for (std::size_t k = 0; k < count; k++, next++)
+				{
+					double d;
+					int i;
+					memcpy(&d, rows + k * rowLength, sizeof(double));
+					memcpy(&i, rows + k * rowLength + sizeof(double), sizeof(int));
+					if (d == (double)next && i == next)
+						found++;
+				}
+			}
+			checkPassFail(found, relationSize)
+		}
+
+		deleteRelation();
+	}
+	relationPax = false;
+}
+
+
+// table statistics
+
+void test22()
+{
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "------------------------------------" << std::endl;
+	std::cout << "- test table statistics -" << std::endl;
+	std::cout << "------------------------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+	for (int pax = 0; pax < 2; pax++)
+	{
+		relationPax = pax != 0;
+		createRelationForward();
+
+		{
+			// sampling every page sees every record
+			TableStatistics stats;
+			stats.addAttribute(offsetof(RECORD, i), INTEGER);
+			stats.addAttribute(offsetof(RECORD, s), STRING, sizeof(record1.s));
+			stats.collect(relationName, bufMgr, 1.0);
+			checkPassFail((int)stats.row_count(), relationSize)
+			checkPassFail(stats.pages_sampled(), stats.num_pages())
+
+			const AttributeStatistics &ints = stats.attribute(0);
+			int minVal, maxVal;
+			memcpy(&minVal, ints.min.data(), sizeof(int));
+			memcpy(&maxVal, ints.max.data(), sizeof(int));
+			checkPassFail(minVal, 0)
+			checkPassFail(maxVal, relationSize - 1)
+			checkPassFail(stats.attribute(1).min.substr(0, 5), std::string("00000"))
+
+			// the sketch is within a few percent of the true distinct count
+			const bool distinctClose =
+					std::abs(ints.distinct_count - relationSize) < 0.1 * relationSize &&
+					std::abs(stats.attribute(1).distinct_count - relationSize) < 0.1 * relationSize;
+			checkPassFail(distinctClose, true)
+
+			// the histogram spreads the keys evenly
+			int intVal = relationSize / 5;
+			const bool rangeClose = std::abs(ints.selectivity(LT, &intVal) - 0.2) < 0.02 &&
+					std::abs(ints.selectivity(GTE, &intVal) - 0.8) < 0.02;
+			checkPassFail(rangeClose, true)
+			const bool pointClose = ints.selectivity(EQ, &intVal) * relationSize < 2;
+			checkPassFail(pointClose, true)
+			intVal = -1;
+			checkPassFail(ints.selectivity(LTE, &intVal), 0.0)
+			checkPassFail(ints.selectivity(EQ, &intVal), 0.0)
+
+			// the statistics survive a round trip through their file
+			stats.save(relationName);
+			TableStatistics loaded = TableStatistics::load(relationName);
+			checkPassFail((int)loaded.num_attributes(), 2)
+			checkPassFail(loaded.row_count(), stats.row_count())
+			checkPassFail(loaded.attribute(0).distinct_count, ints.distinct_count)
+			const bool sameHistogram = loaded.attribute(1).bounds == stats.attribute(1).bounds &&
+					loaded.attribute(0).sketch == ints.sketch;
+			checkPassFail(sameHistogram, true)
+			std::remove(TableStatistics::filename(relationName).c_str());
+		}
+
+		{
+			// distinct pages, in increasing order, as many as asked for
+			int wrong = 0;
+			for (std::uint32_t seed = 1; seed <= 8; seed++)
+			{
+				SampleScan sample(relationName, bufMgr, 0.3, seed);
+				const PageId expected = (PageId)std::ceil(0.3 * sample.num_pages());
+				if (sample.pages_sampled() != expected)
+					wrong++;
+				PageId last = 0;
+				sample.run([&](PageRecords &records)
+				{
+					const PageId page = records.page()->page_number();
+					if (page <= last || page > sample.num_pages())
+						wrong++;
+					last = page;
+				});
+			}
+			checkPassFail(wrong, 0)
+		}
+
+		{
+			// a fifth of the pages estimates the relation's size
+			TableStatistics stats;
+			stats.addAttribute(offsetof(RECORD, d), DOUBLE);
+			stats.collect(relationName, bufMgr, 0.2, 7);
+			const bool partial = stats.pages_sampled() < stats.num_pages();
+			checkPassFail(partial, true)
+			const bool rowsClose = std::abs(stats.row_count() - relationSize) < 0.15 * relationSize;
+			checkPassFail(rowsClose, true)
+			const bool distinctClose =
+					std::abs(stats.attribute(0).distinct_count - relationSize) < 0.2 * relationSize;
+			checkPassFail(distinctClose, true)
+		}
+
+		bool missing = false;
+		try
+		{
+			TableStatistics::load(relationName);
+		}
+		catch (const FileNotFoundException &e)
+		{
+			missing = true;
+		}
+		checkPassFail(missing, true)
+
+		deleteRelation();
+	}
+	relationPax = false;
+}
+
+
+// batch operators
+
+void test23()
+{
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "------------------------------------" << std::endl;
+	std::cout << "- test batch operators -" << std::endl;
+	std::cout << "------------------------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+	for (int pax = 0; pax < 2; pax++)
+	{
+		relationPax = pax != 0;
+		createRelationForward();
+
+		{
+			// aggregates over two filters of a scan
+			ScanOperator *scan = new ScanOperator(relationName, bufMgr);
+			scan->addColumn(offsetof(RECORD, i), INTEGER);
+			scan->addColumn(offsetof(RECORD, d), DOUBLE);
+			int intVal = 1000;
+			double doubleVal = 2000;
+			std::unique_ptr<BatchOperator> plan(scan);
+			plan.reset(new FilterOperator(std::move(plan), 0, GTE, &intVal));
+			plan.reset(new FilterOperator(std::move(plan), 1, LT, &doubleVal));
+			std::vector<Aggregate> aggregates(5);
+			aggregates[0].function = COUNT;
+			aggregates[1].function = SUM;
+			aggregates[1].column = 0;
+			aggregates[2].function = MIN;
+			aggregates[2].column = 1;
+			aggregates[3].function = MAX;
+			aggregates[3].column = 0;
+			aggregates[4].function = AVG;
+			aggregates[4].column = 1;
+			plan.reset(new AggregateOperator(std::move(plan), aggregates));
+
+			ColumnBatch batch(plan->schema());
+			checkPassFail(plan->next(batch), true)
+			checkPassFail((int)batch.count(), 1)
+			checkPassFail(batch.values<int>(0)[0], 1000)
+			checkPassFail(batch.values<double>(1)[0], 1499500.0)
+			checkPassFail(batch.values<double>(2)[0], 1000.0)
+			checkPassFail(batch.values<int>(3)[0], 1999)
+			checkPassFail(batch.values<double>(4)[0], 1499.5)
+			checkPassFail(plan->next(batch), false)
+		}
+
+		{
+			// a pushed-down predicate, a projection and a limit
+			int intVal = 10;
+			ScanOperator *scan = new ScanOperator(relationName, bufMgr,
+					ScanPredicate(offsetof(RECORD, i), INTEGER, LT, &intVal));
+			scan->addColumn(offsetof(RECORD, i), INTEGER);
+			scan->addColumn(offsetof(RECORD, s), STRING, sizeof(record1.s));
+			std::unique_ptr<BatchOperator> plan(scan);
+			std::vector<std::size_t> columns;
+			columns.push_back(1);
+			columns.push_back(0);
+			columns.push_back(0);
+			plan.reset(new ProjectOperator(std::move(plan), columns));
+			plan.reset(new LimitOperator(std::move(plan), 5, 3));
+
+			ColumnBatch batch(plan->schema());
+			int found = 0;
+			int next = 3;
+			while (plan->next(batch))
+			{
+				for (std::size_t k = 0; k < batch.count(); k++, next++)
+				{
+					const std::size_t row = batch.row(k);
+					if (atoi(batch.value(0, row)) == next &&
+							batch.values<int>(1)[row] == next &&
+							batch.values<int>(2)[row] == next)
+						found++;
+				}
+			}
+			checkPassFail(found, 5)
+		}
+
+		{
+			// an index scan returns the records in key order
+			BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+			int lowVal = 100;
+			int highVal = 2100;
+			{
+				IndexScanOperator *scan = new IndexScanOperator(&index, relationName, bufMgr,
+						&lowVal, GTE, &highVal, LT);
+				scan->addColumn(offsetof(RECORD, i), INTEGER);
+				scan->addColumn(offsetof(RECORD, s), STRING, sizeof(record1.s));
+				std::unique_ptr<BatchOperator> plan(scan);
+				ColumnBatch batch(plan->schema());
+				int found = 0;
+				int next = lowVal;
+				while (plan->next(batch))
+				{
+					for (std::size_t k = 0; k < batch.count(); k++, next++)
+					{
+						const std::size_t row = batch.row(k);
+						if (batch.values<int>(0)[row] == next && atoi(batch.value(1, row)) == next)
+							found++;
+					}
+				}
+				checkPassFail(found, highVal - lowVal)
+			}
+			{
+				IndexScanOperator *scan = new IndexScanOperator(&index, relationName, bufMgr,
+						&lowVal, GT, &highVal, LTE);
+				scan->addColumn(offsetof(RECORD, i), INTEGER);
+				std::unique_ptr<BatchOperator> plan(scan);
+				std::vector<Aggregate> aggregates(2);
+				aggregates[0].function = COUNT;
+				aggregates[1].function = MAX;
+				aggregates[1].column = 0;
+				plan.reset(new AggregateOperator(std::move(plan), aggregates));
+				ColumnBatch batch(plan->schema());
+				plan->next(batch);
+				checkPassFail(batch.values<int>(0)[0], highVal - lowVal)
+				checkPassFail(batch.values<int>(1)[0], highVal)
+			}
+		}
+		File::remove(intIndexName);
+
+		deleteRelation();
+	}
+	relationPax = false;
+}
+
+
+// hash join
+
+void test24()
+{
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "------------------------------------" << std::endl;
+	std::cout << "- test hash join -" << std::endl;
+	std::cout << "------------------------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+	for (int pax = 0; pax < 2; pax++)
+	{
+		relationPax = pax != 0;
+		createRelationForward();
+
+		// a second relation holding every fourth key of the first, twice
+		const std::string joinName = relationName + "join";
+		const int joinSize = 3000;
+		const int matches = 2 * ((relationSize + 3) / 4);
+		{
+			PageFile *joinFile = new PageFile(joinName, true);
+			std::vector<std::string> records;
+			for (int k = 0; k < joinSize; k++)
+			{
+				RECORD record;
+				memset(&record, ' ', sizeof(record));
+				record.i = (k % (joinSize / 2)) * 4;
+				record.d = (double)k;
+				sprintf(record.s, "%05d string record", record.i);
+				records.push_back(std::string(reinterpret_cast<char*>(&record), sizeof(record)));
+			}
+			{
+				RelationLoader loader(joinFile, sizeof(RECORD), relationAttributes());
+				loader.insertRecords(records);
+			}
+			delete joinFile;
+		}
+
+		for (int variant = 0; variant < 4; variant++)
+		{
+			// one and several threads, one and many partitions
+			const std::size_t threads = variant % 2 == 0 ? 1 : 4;
+			const std::size_t partitionBytes = variant < 2 ? HashJoinOperator::PARTITION_BYTES : 1024;
+
+			ScanOperator *build = new ScanOperator(joinName, bufMgr);
+			build->addColumn(offsetof(RECORD, i), INTEGER);
+			build->addColumn(offsetof(RECORD, d), DOUBLE);
+			ScanOperator *probe = new ScanOperator(relationName, bufMgr);
+			probe->addColumn(offsetof(RECORD, i), INTEGER);
+			probe->addColumn(offsetof(RECORD, s), STRING, sizeof(record1.s));
+			HashJoinOperator join(std::unique_ptr<BatchOperator>(build), std::unique_ptr<BatchOperator>(probe),
+					0, 0, threads, partitionBytes);
+			checkPassFail((int)join.schema().size(), 4)
+
+			ColumnBatch batch(join.schema());
+			int found = 0;
+			int wrong = 0;
+			while (join.next(batch))
+			{
+				for (std::size_t k = 0; k < batch.count(); k++)
+				{
+					const std::size_t row = batch.row(k);
+					const int key = batch.values<int>(0)[row];
+					if (key % 4 == 0 && batch.values<int>(2)[row] == key && atoi(batch.value(3, row)) == key)
+						found++;
+					else
+						wrong++;
+				}
+			}
+			checkPassFail(found, matches)
+			checkPassFail(wrong, 0)
+			const bool partitioned = (join.radix_bits() > 0) == (partitionBytes == 1024);
+			checkPassFail(partitioned, true)
+		}
+
+		{
+			// a string key
+			ScanOperator *build = new ScanOperator(joinName, bufMgr);
+			build->addColumn(offsetof(RECORD, s), STRING, sizeof(record1.s));
+			ScanOperator *probe = new ScanOperator(relationName, bufMgr);
+			probe->addColumn(offsetof(RECORD, i), INTEGER);
+			probe->addColumn(offsetof(RECORD, s), STRING, sizeof(record1.s));
+			HashJoinOperator join(std::unique_ptr<BatchOperator>(build), std::unique_ptr<BatchOperator>(probe),
+					0, 1, 2, 4096);
+			ColumnBatch batch(join.schema());
+			int found = 0;
+			while (join.next(batch))
+			{
+				for (std::size_t k = 0; k < batch.count(); k++)
+				{
+					const std::size_t row = batch.row(k);
+					if (atoi(batch.value(0, row)) == batch.values<int>(1)[row])
+						found++;
+				}
+			}
+			checkPassFail(found, matches)
+		}
+
+		{
+			// a join of the second relation with itself: each key matches four times
+			ScanOperator *build = new ScanOperator(joinName, bufMgr);
+			build->addColumn(offsetof(RECORD, i), INTEGER);
+			ScanOperator *probe = new ScanOperator(joinName, bufMgr);
+			probe->addColumn(offsetof(RECORD, i), INTEGER);
+			HashJoinOperator join(std::unique_ptr<BatchOperator>(build), std::unique_ptr<BatchOperator>(probe),
+					0, 0, 4, 1024);
+			ColumnBatch batch(join.schema());
+			int found = 0;
+			while (join.next(batch))
+			{
+				for (std::size_t k = 0; k < batch.count(); k++)
+				{
+					const std::size_t row = batch.row(k);
+					if (batch.values<int>(0)[row] == batch.values<int>(1)[row])
+						found++;
+				}
+			}
+			checkPassFail(found, 2 * joinSize)
+			const bool ended = !join.next(batch);
+			checkPassFail(ended, true)
+		}
+
+		{
+			// a join dropped after its first batch stops its threads
+			ScanOperator *build = new ScanOperator(joinName, bufMgr);
+			build->addColumn(offsetof(RECORD, i), INTEGER);
+			ScanOperator *probe = new ScanOperator(joinName, bufMgr);
+			probe->addColumn(offsetof(RECORD, i), INTEGER);
+			std::unique_ptr<HashJoinOperator> join(new HashJoinOperator(std::unique_ptr<BatchOperator>(build),
+					std::unique_ptr<BatchOperator>(probe), 0, 0, 4, 1024));
+			ColumnBatch batch(join->schema());
+			const bool first = join->next(batch);
+			checkPassFail(first, true)
+			join.reset();
+		}
+
+		{
+			// keys of different types or lengths are refused
+			for (int variant = 0; variant < 2; variant++)
+			{
+				ScanOperator *build = new ScanOperator(joinName, bufMgr);
+				ScanOperator *probe = new ScanOperator(relationName, bufMgr);
+				if (variant == 0)
+				{
+					build->addColumn(offsetof(RECORD, i), INTEGER);
+					probe->addColumn(offsetof(RECORD, d), DOUBLE);
+				}
+				else
+				{
+					build->addColumn(offsetof(RECORD, s), STRING, sizeof(record1.s));
+					probe->addColumn(offsetof(RECORD, s), STRING, 8);
+				}
+				bool refused = false;
+				try
+				{
+					HashJoinOperator join(std::unique_ptr<BatchOperator>(build), std::unique_ptr<BatchOperator>(probe), 0, 0);
+				}
+				catch (const KeyTypeMismatchException &e)
+				{
+					refused = true;
+				}
+				checkPassFail(refused, true)
+			}
+		}
+
+		File::remove(joinName);
+		deleteRelation();
+	}
+	relationPax = false;
+}
+
+
+// external sort
+
+void test25()
+{
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "------------------------------------" << std::endl;
+	std::cout << "- test external sort -" << std::endl;
+	std::cout << "------------------------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+	const std::string sortedName = relationName + "sorted";
+	for (int pax = 0; pax < 2; pax++)
+	{
+		relationPax = pax != 0;
+		createRelationBackward();
+
+		{
+			// a small budget makes many runs and an extra merge pass
+			ExternalSort sorter(bufMgr, offsetof(RECORD, i), INTEGER, 0, 8 * Page::DEFAULT_SIZE, 4);
+			sorter.sort(relationName, sortedName);
+			const bool manyRuns = sorter.num_runs() > sorter.fan_in();
+			checkPassFail(manyRuns, true)
+			checkPassFail((int)sorter.num_passes(), 2)
+			checkPassFail(File::exists(sortedName + ".run.0"), false)
+
+			int found = 0;
+			{
+				FileScan fscan(sortedName, bufMgr);
+				RecordId rids[16];
+				RecordView views[16];
+				std::size_t count;
+				while ((count = fscan.scanNextBatch(rids, views, 16)) > 0)
+				{
+					for (std::size_t k = 0; k < count; k++)
+					{
+						const RECORD* record = reinterpret_cast<const RECORD*>(views[k].data);
+						if (record->i == found && record->d == (double)found && atoi(record->s) == found)
+							found++;
+					}
+				}
+			}
+			checkPassFail(found, relationSize)
+			File::remove(sortedName);
+		}
+
+		{
+			// the buffer pool's frames, not only the budget, bound the fan-in;
+			// small chunks make more runs than frames allowed
+			ExternalSort sorter(bufMgr, offsetof(RECORD, i), INTEGER);
+			checkPassFail((int)sorter.fan_in(), 99)
+			ExternalSort narrow(bufMgr, offsetof(RECORD, i), INTEGER, 0, 64 * Page::DEFAULT_SIZE, 64, 8);
+			checkPassFail((int)narrow.fan_in(), 7)
+			narrow.sort(relationName, sortedName);
+			const bool manyPasses = narrow.num_runs() > 49 && narrow.num_passes() > 2;
+			checkPassFail(manyPasses, true)
+
+			int found = 0;
+			{
+				FileScan fscan(sortedName, bufMgr);
+				RecordId rids[16];
+				RecordView views[16];
+				std::size_t count;
+				while ((count = fscan.scanNextBatch(rids, views, 16)) > 0)
+				{
+					for (std::size_t k = 0; k < count; k++)
+					{
+						if (reinterpret_cast<const RECORD*>(views[k].data)->i == found)
+							found++;
+					}
+				}
+			}
+			checkPassFail(found, relationSize)
+			File::remove(sortedName);
+		}
+
+		{
+			// a final merge that fails leaves no partial output behind: with two
+			// frames the third run cannot be pinned
+			bool failed = false;
+			{
+				BufMgr tiny(2);
+				ExternalSort sorter(&tiny, offsetof(RECORD, i), INTEGER, 0, 16 * Page::DEFAULT_SIZE, 1, 16);
+				try
+				{
+					sorter.sort(relationName, sortedName);
+				}
+				catch (const BufferExceededException &e)
+				{
+					failed = true;
+				}
+				const bool oneMerge = sorter.num_runs() > 2 && sorter.num_runs() <= sorter.fan_in();
+				checkPassFail(oneMerge, true)
+			}
+			checkPassFail(failed, true)
+			checkPassFail(File::exists(sortedName), false)
+			checkPassFail(File::exists(sortedName + ".run.0"), false)
+
+			// so the sort can be run again
+			ExternalSort sorter(bufMgr, offsetof(RECORD, i), INTEGER, 0, 16 * Page::DEFAULT_SIZE, 1);
+			sorter.sort(relationName, sortedName);
+			checkPassFail(File::exists(sortedName), true)
+			File::remove(sortedName);
+		}
+
+		{
+			// equal keys keep their input order: sorting by the first two
+			// digits of s leaves each thousand in descending order
+			ExternalSort sorter(bufMgr, offsetof(RECORD, s), STRING, 2, 16 * Page::DEFAULT_SIZE);
+			sorter.sort(relationName, sortedName);
+			int found = 0;
+			int position = 0;
+			{
+				FileScan fscan(sortedName, bufMgr);
+				RecordId rids[16];
+				RecordView views[16];
+				std::size_t count;
+				while ((count = fscan.scanNextBatch(rids, views, 16)) > 0)
+				{
+					for (std::size_t k = 0; k < count; k++, position++)
+					{
+						const int expected = (position / 1000) * 1000 + 999 - position % 1000;
+						if (reinterpret_cast<const RECORD*>(views[k].data)->i == expected)
+							found++;
+					}
+				}
+			}
+			checkPassFail(found, relationSize)
+			File::remove(sortedName);
+		}
+
+		deleteRelation();
+	}
+	relationPax = false;
+}
+
+
+// hash aggregation
+
+void test26()
+{
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "------------------------------------" << std::endl;
+	std::cout << "- test hash aggregation -" << std::endl;
+	std::cout << "------------------------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+	// a thousand groups of five rows by i, and a hundred groups by s whose
+	// bytes past the string differ between rows of a group
+	const std::string groupName = relationName + "group";
+	const int groups = 1000;
+	for (int pax = 0; pax < 2; pax++)
+	{
+		relationPax = pax != 0;
+		{
+			PageFile *groupFile = new PageFile(groupName, true);
+			std::vector<std::string> records;
+			for (int k = 0; k < relationSize; k++)
+			{
+				RECORD record;
+				memset(&record, 'a' + k % 3, sizeof(record));
+				record.i = k % groups;
+				record.d = (double)k;
+				sprintf(record.s, "%05d string record", k % 100);
+				records.push_back(std::string(reinterpret_cast<char*>(&record), sizeof(record)));
+			}
+			{
+				RelationLoader loader(groupFile, sizeof(RECORD), relationAttributes());
+				loader.insertRecords(records);
+			}
+			delete groupFile;
+		}
+
+		std::vector<Aggregate> aggregates(5);
+		aggregates[0].function = COUNT;
+		aggregates[1].function = SUM;
+		aggregates[1].column = 1;
+		aggregates[2].function = MIN;
+		aggregates[2].column = 1;
+		aggregates[3].function = MAX;
+		aggregates[3].column = 1;
+		aggregates[4].function = AVG;
+		aggregates[4].column = 1;
+		std::vector<std::size_t> byInt(1, 0);
+
+		for (int variant = 0; variant < 2; variant++)
+		{
+			// the whole table in memory, then a budget of a few dozen groups
+			// that spills, and spills the spill files again
+			const std::size_t memory = variant == 0 ? HashAggregateOperator::DEFAULT_MEMORY : 2048;
+			ScanOperator *scan = new ScanOperator(groupName, bufMgr);
+			scan->addColumn(offsetof(RECORD, i), INTEGER);
+			scan->addColumn(offsetof(RECORD, d), DOUBLE);
+			HashAggregateOperator aggregate(std::unique_ptr<BatchOperator>(scan), byInt, aggregates,
+					bufMgr, groupName, memory);
+			checkPassFail((int)aggregate.schema().size(), 6)
+
+			ColumnBatch batch(aggregate.schema());
+			std::map<int, int> seen;
+			int right = 0;
+			while (aggregate.next(batch))
+			{
+				for (std::size_t k = 0; k < batch.count(); k++)
+				{
+					const std::size_t row = batch.row(k);
+					const int g = batch.values<int>(0)[row];
+					seen[g]++;
+					if (batch.values<int>(1)[row] == relationSize / groups &&
+							batch.values<double>(2)[row] == 5.0 * g + 10000 &&
+							batch.values<double>(3)[row] == (double)g &&
+							batch.values<double>(4)[row] == g + 4000.0 &&
+							batch.values<double>(5)[row] == g + 2000.0)
+						right++;
+				}
+			}
+			checkPassFail((int)seen.size(), groups)
+			checkPassFail(right, groups)
+			if (variant == 0)
+			{
+				checkPassFail((int)aggregate.num_spill_files(), 0)
+			}
+			else
+			{
+				const bool recursed = aggregate.num_spill_files() > HashAggregateOperator::SPILL_PARTITIONS;
+				checkPassFail(recursed, true)
+				checkPassFail(File::exists(groupName + ".spill.0"), false)
+			}
+		}
+
+		{
+			// a string key, with a budget that spills
+			ScanOperator *scan = new ScanOperator(groupName, bufMgr);
+			scan->addColumn(offsetof(RECORD, s), STRING, sizeof(record1.s));
+			HashAggregateOperator aggregate(std::unique_ptr<BatchOperator>(scan), byInt,
+					std::vector<Aggregate>(1, aggregates[0]), bufMgr, groupName, 4096);
+			ColumnBatch batch(aggregate.schema());
+			std::map<int, int> counts;
+			while (aggregate.next(batch))
+			{
+				for (std::size_t k = 0; k < batch.count(); k++)
+				{
+					const std::size_t row = batch.row(k);
+					counts[atoi(batch.value(0, row))] += batch.values<int>(1)[row];
+				}
+			}
+			const bool spilled = aggregate.num_spill_files() > 0;
+			checkPassFail(spilled, true)
+			checkPassFail((int)counts.size(), 100)
+			checkPassFail(counts[42], relationSize / 100)
+		}
+
+		{
+			// no group columns: a single group of every row
+			ScanOperator *scan = new ScanOperator(groupName, bufMgr);
+			scan->addColumn(offsetof(RECORD, i), INTEGER);
+			scan->addColumn(offsetof(RECORD, d), DOUBLE);
+			HashAggregateOperator aggregate(std::unique_ptr<BatchOperator>(scan), std::vector<std::size_t>(),
+					aggregates, bufMgr, groupName, 1);
+			ColumnBatch batch(aggregate.schema());
+			checkPassFail(aggregate.next(batch), true)
+			checkPassFail((int)batch.count(), 1)
+			checkPassFail(batch.values<int>(0)[0], relationSize)
+			checkPassFail(batch.values<double>(3)[0], relationSize - 1.0)
+			checkPassFail(aggregate.next(batch), false)
+			checkPassFail((int)aggregate.num_spill_files(), 0)
+		}
+
+		File::remove(groupName);
+	}
+	relationPax = false;
+}
+
+
+// index nested-loop join
+
+void test27()
+{
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "------------------------------------" << std::endl;
+	std::cout << "- test index nested-loop join -" << std::endl;
+	std::cout << "------------------------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+	for (int pax = 0; pax < 2; pax++)
+	{
+		relationPax = pax != 0;
+		createRelationForward();
+		BTreeIndex *index = new BTreeIndex(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+
+		{
+			// probes in ascending order mostly stay on the leaf level
+			std::vector<RecordId> rids;
+			int found = 0;
+			for (int key = 0; key < relationSize; key++)
+			{
+				if (index->probe(&key, rids) == 1)
+					found++;
+			}
+			checkPassFail(found, relationSize)
+			checkPassFail((int)rids.size(), relationSize)
+			const bool fewDescents = index->getProbeDescents() * 100 < (std::size_t)relationSize;
+			checkPassFail(fewDescents, true)
+
+			// keys out of order or missing still find the right entries
+			int key = relationSize;
+			checkPassFail((int)index->probe(&key, rids), 0)
+			key = 42;
+			rids.clear();
+			checkPassFail((int)index->probe(&key, rids), 1)
+			key = -1;
+			checkPassFail((int)index->probe(&key, rids), 0)
+			index->endProbe();
+		}
+
+		// an outer relation holding every fourth key, twice, out of order, and
+		// keys past the end of the inner relation
+		const std::string outerName = relationName + "outer";
+		const int outerSize = 3000;
+		const int matches = 2 * ((relationSize + 3) / 4);
+		{
+			PageFile *outerFile = new PageFile(outerName, true);
+			std::vector<std::string> records;
+			for (int k = 0; k < outerSize; k++)
+			{
+				RECORD record;
+				memset(&record, ' ', sizeof(record));
+				record.i = ((k * 7) % (outerSize / 2)) * 4;
+				record.d = (double)k;
+				sprintf(record.s, "%05d string record", record.i);
+				records.push_back(std::string(reinterpret_cast<char*>(&record), sizeof(record)));
+			}
+			{
+				RelationLoader loader(outerFile, sizeof(RECORD), relationAttributes());
+				loader.insertRecords(records);
+			}
+			delete outerFile;
+		}
+
+		{
+			const std::size_t descents = index->getProbeDescents();
+			ScanOperator *outer = new ScanOperator(outerName, bufMgr);
+			outer->addColumn(offsetof(RECORD, i), INTEGER);
+			outer->addColumn(offsetof(RECORD, d), DOUBLE);
+			IndexJoinOperator join(std::unique_ptr<BatchOperator>(outer), 0, index, relationName, bufMgr);
+			join.addColumn(offsetof(RECORD, i), INTEGER);
+			join.addColumn(offsetof(RECORD, s), STRING, sizeof(record1.s));
+			checkPassFail((int)join.schema().size(), 4)
+
+			ColumnBatch batch(join.schema());
+			int found = 0;
+			int wrong = 0;
+			while (join.next(batch))
+			{
+				for (std::size_t k = 0; k < batch.count(); k++)
+				{
+					const std::size_t row = batch.row(k);
+					const int key = batch.values<int>(0)[row];
+					if (key % 4 == 0 && batch.values<int>(2)[row] == key && atoi(batch.value(3, row)) == key)
+						found++;
+					else
+						wrong++;
+				}
+			}
+			checkPassFail(found, matches)
+			checkPassFail(wrong, 0)
+			const bool fewDescents = (index->getProbeDescents() - descents) * 10 < (std::size_t)outerSize / 2;
+			checkPassFail(fewDescents, true)
+		}
+
+		delete index;
+		File::remove(outerName);
+		File::remove(intIndexName);
+		deleteRelation();
+	}
+	relationPax = false;
+}
+
+
+// freed page storage
+
+std::uint64_t allocatedBytes(const std::string &filename)
+{
+	struct stat info;
+	if (::stat(filename.c_str(), &info) != 0)
+		return 0;
+	return (std::uint64_t)info.st_blocks * 512;
+}
+
+void test28()
+{
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "-------------------------------" << std::endl;
+	std::cout << "- test freed page storage -" << std::endl;
+	std::cout << "-------------------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+	const std::string freedName = relationName + ".freed";
+	const int numPages = 64;
+	const std::size_t sizes[] = {Page::SIZE, Page::DEFAULT_SIZE, 1024};
+	for (int s = 0; s < 3; s++)
+	{
+		const std::size_t pageSize = sizes[s];
+		{
+			PageFile file = PageFile::create(freedName, pageSize);
+			for (int i = 0; i < numPages; i++)
+			{
+				PageId pageNo;
+				Page page = file.allocatePage(pageNo);
+				record1.i = pageNo;
+				std::string data(reinterpret_cast<char*>(&record1), sizeof(record1));
+				page.insertRecord(data);
+				file.writePage(pageNo, page);
+			}
+			file.sync();
+			const std::uint64_t before = allocatedBytes(freedName);
+
+			// free every other page, keeping the last one so nothing is truncated
+			int freed = 0;
+			for (PageId pageNo = 2; pageNo < numPages; pageNo += 2, freed++)
+				file.deletePage(pageNo);
+			file.sync();
+			const std::uint64_t after = allocatedBytes(freedName);
+
+			// pages are block aligned, so all but the block with the link goes;
+			// the filesystem may spend a few blocks mapping the holes
+			const std::uint64_t expected = pageSize > File::BLOCK_SIZE ?
+			    (std::uint64_t)freed * (pageSize - File::BLOCK_SIZE) : 0;
+			const bool released = after + expected <= before + 4 * File::BLOCK_SIZE;
+			checkPassFail(released, true)
+
+			int found = 0;
+			for (FileIterator iter = file.begin(); iter != file.end(); ++iter)
+			{
+				Page page = *iter;
+				std::string data = *page.begin();
+				if (reinterpret_cast<const RECORD*>(data.data())->i == (int)page.page_number())
+					found++;
+			}
+			checkPassFail(found, numPages - freed)
+		}
+		File::remove(freedName);
+	}
+
+	std::vector<std::string> contents(numPages);
+	{
+		// compressed pages that keep growing and shrinking reuse the slots
+		// they leave behind instead of growing the file
+		BlobFile file = BlobFile::create(freedName, Page::DEFAULT_SIZE, true);
+		std::vector<PageId> pageNos;
+		Page blank;
+		for (int i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			blank = file.allocatePage(pageNo);
+			pageNos.push_back(pageNo);
+		}
+
+		unsigned int seed = 1;
+		std::uint64_t grownSize = 0;
+		for (int round = 0; round < 10; round++)
+		{
+			for (int i = 0; i < numPages; i++)
+			{
+				// incompressible bytes, many in odd rounds and few in even ones
+				const std::size_t length = round % 2 ?
+				    4000 + (i * 37 + round * 101) % 2000 : 100 + (i * 13) % 400;
+				contents[i].resize(length);
+				for (std::size_t k = 0; k < length; k++)
+				{
+					seed = seed * 1103515245 + 12345;
+					contents[i][k] = (char)(seed >> 16);
+				}
+				Page page = blank;
+				page.insertRecord(contents[i]);
+				file.writePage(pageNos[i], page);
+			}
+			struct stat info;
+			::stat(freedName.c_str(), &info);
+			if (round == 1)
+				grownSize = info.st_size;
+			if (round % 2 && round > 1)
+			{
+				const bool bounded = (std::uint64_t)info.st_size * 2 <= grownSize * 3;
+				checkPassFail(bounded, true)
+			}
+		}
+
+		int found = 0;
+		for (int i = 0; i < numPages; i++)
+		{
+			Page page = file.readPage(pageNos[i]);
+			if (*page.begin() == contents[i])
+				found++;
+		}
+		checkPassFail(found, numPages)
+	}
+	{
+		// a reopened file finds the free granules between its slots
+		BlobFile file = BlobFile::open(freedName);
+		struct stat info;
+		::stat(freedName.c_str(), &info);
+		const off_t before = info.st_size;
+		for (int i = 0; i < numPages; i += 2)
+			file.deletePage(i + 1);
+		PageId pageNo;
+		Page page = file.allocatePage(pageNo);
+		page.insertRecord(contents[0]);
+		file.writePage(pageNo, page);
+		::stat(freedName.c_str(), &info);
+		const bool reused = info.st_size <= before;
+		checkPassFail(reused, true)
+		const bool intact = *file.readPage(pageNo).begin() == contents[0] &&
+		    *file.readPage(2).begin() == contents[1];
+		checkPassFail(intact, true)
+	}
+	File::remove(freedName);
+}
+
+
+// page slot directory
+
+bool pageMatches(Page &page, const std::map<SlotId, std::string> &expected)
+{
+	// records by ID, by iteration, as views and as used slots all agree
+	std::vector<SlotId> slots;
+	page.getUsedSlots(slots);
+	std::vector<RecordView> views;
+	page.getRecordViews(views);
+	if (slots.size() != expected.size() || views.size() != expected.size())
+		return false;
+	std::size_t k = 0;
+	PageIterator iter = page.begin();
+	for (std::map<SlotId, std::string>::const_iterator it = expected.begin(); it != expected.end(); ++it, ++k, ++iter)
+	{
+		const RecordId rid = {page.page_number(), it->first};
+		if (iter == page.end() || iter.getCurrentRecord() != rid || *iter != it->second)
+			return false;
+		if (slots[k] != it->first || views[k].str() != it->second || page.getRecord(rid) != it->second)
+			return false;
+	}
+	return iter == page.end();
+}
+
+void test29()
+{
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "-------------------------------" << std::endl;
+	std::cout << "- test page slot directory -" << std::endl;
+	std::cout << "-------------------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+	Page page;
+	std::map<SlotId, std::string> expected;
+	const int numRecords = 300;
+	for (int i = 0; i < numRecords; i++)
+	{
+		std::ostringstream record;
+		record << "record " << i;
+		const RecordId rid = page.insertRecord(record.str());
+		expected[rid.slot_number] = record.str();
+	}
+	checkPassFail((int)expected.size(), numRecords)
+	checkPassFail(pageMatches(page, expected), true)
+
+	// free whole bitmap words as well as scattered slots
+	std::set<SlotId> freed;
+	for (SlotId slot = 1; slot < numRecords; slot++)
+	{
+		if ((slot > 64 && slot <= 128) || slot % 3 == 0)
+		{
+			page.deleteRecord({page.page_number(), slot});
+			expected.erase(slot);
+			freed.insert(slot);
+		}
+	}
+	checkPassFail(pageMatches(page, expected), true)
+	bool rejected = false;
+	try
+	{
+		page.getRecord({page.page_number(), 66});
+	}
+	catch (InvalidRecordException &e)
+	{
+		rejected = true;
+	}
+	checkPassFail(rejected, true)
+
+	// new records take the freed slots off the chain before adding any
+	std::set<SlotId> reused;
+	for (std::size_t i = 0; i < freed.size(); i++)
+	{
+		const RecordId rid = page.insertRecord("again");
+		reused.insert(rid.slot_number);
+		expected[rid.slot_number] = "again";
+	}
+	const bool fromChain = reused == freed;
+	checkPassFail(fromChain, true)
+	const SlotId added = page.insertRecord("new").slot_number;
+	checkPassFail(added, numRecords + 1)
+	expected[added] = "new";
+	checkPassFail(pageMatches(page, expected), true)
+
+	// freeing the last slots trims the directory, unlinking them from the chain
+	page.deleteRecord({page.page_number(), 150});
+	expected.erase(150);
+	for (SlotId slot = numRecords + 1; slot > 250; slot--)
+	{
+		page.deleteRecord({page.page_number(), slot});
+		expected.erase(slot);
+	}
+	const SlotId first = page.insertRecord("first").slot_number;
+	const SlotId second = page.insertRecord("second").slot_number;
+	checkPassFail(first, 150)
+	checkPassFail(second, 251)
+	expected[first] = "first";
+	expected[second] = "second";
+	checkPassFail(pageMatches(page, expected), true)
+}
+
+
+// page record updates
+
+void test30()
+{
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "-------------------------------" << std::endl;
+	std::cout << "- test page record updates -" << std::endl;
+	std::cout << "-------------------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+	{
+		Page page;
+		std::map<SlotId, std::string> expected;
+		const RecordId first = page.insertRecord(std::string(100, 'a'));
+		const RecordId second = page.insertRecord(std::string(100, 'b'));
+		expected[first.slot_number] = std::string(100, 'a');
+		expected[second.slot_number] = std::string(100, 'b');
+		const int freeSpace = page.getFreeSpace();
+
+		// shrinking leaves the tail as a hole that still counts as free
+		page.updateRecord(first, std::string(40, 'c'));
+		expected[first.slot_number] = std::string(40, 'c');
+		checkPassFail(page.getFreeSpace(), freeSpace + 60)
+		checkPassFail(pageMatches(page, expected), true)
+
+		// the last record borders the free space and grows into it
+		page.updateRecord(second, std::string(180, 'd'));
+		expected[second.slot_number] = std::string(180, 'd');
+		checkPassFail(page.getFreeSpace(), freeSpace - 20)
+		checkPassFail(pageMatches(page, expected), true)
+
+		// the first one has to move, its old bytes becoming a hole
+		page.updateRecord(first, std::string(120, 'e'));
+		expected[first.slot_number] = std::string(120, 'e');
+		checkPassFail(page.getFreeSpace(), freeSpace - 100)
+		checkPassFail(pageMatches(page, expected), true)
+
+		// after moving it borders the free space, so it shrinks and grows in place
+		page.updateRecord(first, std::string(10, 'f'));
+		page.updateRecord(first, std::string(120, 'g'));
+		expected[first.slot_number] = std::string(120, 'g');
+		checkPassFail(page.getFreeSpace(), freeSpace - 100)
+		checkPassFail(pageMatches(page, expected), true)
+	}
+
+	{
+		// random inserts, updates and deletes, with the page compacting itself
+		// whenever the holes are needed
+		Page page;
+		std::map<SlotId, std::string> expected;
+		unsigned int seed = 7;
+		int inserted = 0;
+		int updated = 0;
+		int deleted = 0;
+		int refused = 0;
+		bool matches = true;
+		for (int op = 0; op < 5000 && matches; op++)
+		{
+			seed = seed * 1103515245 + 12345;
+			const unsigned int choice = (seed >> 16) % 10;
+			seed = seed * 1103515245 + 12345;
+			const std::size_t length = (seed >> 16) % 300;
+			const std::string data(length, (char)('a' + op % 26));
+			seed = seed * 1103515245 + 12345;
+			std::map<SlotId, std::string>::iterator target = expected.begin();
+			if (!expected.empty())
+				std::advance(target, (seed >> 16) % expected.size());
+
+			if (choice < 4 || expected.empty())
+			{
+				if (page.hasSpaceForRecord(data))
+				{
+					const RecordId rid = page.insertRecord(data);
+					matches = expected.count(rid.slot_number) == 0;
+					expected[rid.slot_number] = data;
+					inserted++;
+				}
+				else
+					refused++;
+			}
+			else if (choice < 8)
+			{
+				const RecordId rid = {page.page_number(), target->first};
+				try
+				{
+					page.updateRecord(rid, data);
+					target->second = data;
+					updated++;
+				}
+				catch (InsufficientSpaceException &e)
+				{
+					refused++;
+				}
+			}
+			else
+			{
+				const RecordId rid = {page.page_number(), target->first};
+				page.deleteRecord(rid);
+				expected.erase(target);
+				deleted++;
+			}
+			matches = matches && pageMatches(page, expected);
+		}
+		checkPassFail(matches, true)
+		// every kind of operation happened, including ones that did not fit
+		const bool mixed = inserted > 500 && updated > 500 && deleted > 500 && refused > 0;
+		checkPassFail(mixed, true)
+	}
+}
+
+void test31()
+{
+    relationPageSize = Page::SIZE;
+    indexPageSize = Page::SIZE;
+
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "----------------------" << std::endl;
+	std::cout << "- test large pages -" << std::endl;
+	std::cout << "----------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+	// an index opened from a leftover file would keep that file's page size
+	removeIndexFiles();
+
+	std::cout << "--------------------" << std::endl;
+	std::cout << "createRelationRandom" << std::endl;
+	createRelationRandom();
+
+	{
+		// a page of the relation holds more tuples than a default-sized one could
+		FileScan fscan(relationName, bufMgr);
+		int found = 0;
+		int firstPageTuples = 0;
+		PageId firstPage = Page::INVALID_NUMBER;
+		try
+		{
+			RecordId scanRid;
+			while(1)
+			{
+				fscan.scanNext(scanRid);
+				if (firstPage == Page::INVALID_NUMBER)
+					firstPage = scanRid.page_number;
+				if (scanRid.page_number == firstPage)
+					firstPageTuples++;
+				const RECORD* tuple =
+				    reinterpret_cast<const RECORD*>(fscan.getRecordView().data);
+				if (atoi(tuple->s) == tuple->i && tuple->d == (double)tuple->i)
+					found++;
+			}
+		}
+		catch(EndOfFileException e)
+		{
+		}
+		checkPassFail(found, relationSize)
+		const bool large = firstPageTuples > (int)(Page::DEFAULT_SIZE / sizeof(RECORD));
+		checkPassFail(large, true)
+	}
+
+	{
+		// the index is created with the largest page size too
+		std::string indexName;
+		{
+			BTreeIndex index(relationName, indexName, bufMgr, offsetof(tuple,i), INTEGER, indexPageSize);
+		}
+		BlobFile index(indexName, false);
+		checkPassFail(index.page_size(), Page::SIZE)
+	}
+	removeIndexFiles();
+
+	indexTests();
+	deleteRelation();
+
+    relationPageSize = Page::DEFAULT_SIZE;
+    indexPageSize = Page::DEFAULT_SIZE;
+}
+
+
+// file handle registry
+
+void test32()
+{
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "-------------------------------" << std::endl;
+	std::cout << "- test file handle registry -" << std::endl;
+	std::cout << "-------------------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+	createRelationForward();
+	bufMgr->flushFile(file1);
+	delete file1;
+	file1 = NULL;
+
+	{
+		// files open under one name share a handle, closed with the last of them
+		checkPassFail(FileHandle::isOpen(relationName), false)
+		{
+			PageFile first(relationName, false);
+			const std::shared_ptr<FileHandle> handle = FileHandle::open(relationName, false);
+			const bool shared = FileHandle::open(relationName, false) == handle;
+			checkPassFail(shared, true)
+			checkPassFail(FileHandle::isOpen(relationName), true)
+		}
+		checkPassFail(FileHandle::isOpen(relationName), false)
+	}
+
+	{
+		// threads opening, reading and closing the relation at once all see
+		// every record; one file stays open throughout so handles are shared
+		PageFile held(relationName, false);
+		std::atomic<int> wrong(0);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 8; t++)
+		{
+			threads.push_back(std::thread([&wrong]()
+			{
+				for (int round = 0; round < 10; round++)
+				{
+					PageFile file(relationName, false);
+					int found = 0;
+					for (FileIterator iter = file.begin(); iter != file.end(); ++iter)
+					{
+						Page page = *iter;
+						for (PageIterator record = page.begin(); record != page.end(); ++record)
+						{
+							const std::string data = *record;
+							const RECORD* tuple = reinterpret_cast<const RECORD*>(data.data());
+							if (tuple->i == found && atoi(tuple->s) == found)
+								found++;
+						}
+					}
+					if (found != relationSize)
+						wrong++;
+				}
+			}));
+		}
+		for (std::size_t t = 0; t < threads.size(); t++)
+			threads[t].join();
+		checkPassFail(wrong.load(), 0)
+	}
+	checkPassFail(FileHandle::isOpen(relationName), false)
+
+	deleteRelation();
+}
+
+
+// record views
+
+void test33()
+{
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "-----------------------" << std::endl;
+	std::cout << "- test record views -" << std::endl;
+	std::cout << "-----------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+	{
+		// views point into the page itself, so they see an update in place
+		Page page;
+		std::vector<RecordId> rids;
+		for (int i = 0; i < 50; i++)
+			rids.push_back(page.insertRecord(std::string(i + 1, (char)('a' + i % 26))));
+		const char* first = reinterpret_cast<const char*>(&page);
+		const char* last = first + sizeof(Page);
+		int wrong = 0;
+		for (std::size_t k = 0; k < rids.size(); k++)
+		{
+			const RecordView view = page.getRecordView(rids[k]);
+			if (view.data < first || view.data + view.length > last || view.length != k + 1 ||
+			    view.str() != page.getRecord(rids[k]))
+				wrong++;
+		}
+		checkPassFail(wrong, 0)
+
+		const RecordView before = page.getRecordView(rids[9]);
+		page.updateRecord(rids[9], std::string(10, 'z'));
+		checkPassFail(before.str(), std::string(10, 'z'))
+
+		// an iterator's view is the record it dereferences to
+		int agreeing = 0;
+		for (PageIterator iter = page.begin(); iter != page.end(); ++iter)
+		{
+			const RecordView view = iter.view();
+			if (view.data == page.getRecordView(iter.getCurrentRecord()).data && view.str() == *iter)
+				agreeing++;
+		}
+		checkPassFail(agreeing, 50)
+	}
+
+	{
+		// a scan's view is the record it returns
+		createRelationForward();
+		FileScan fscan(relationName, bufMgr);
+		int agreeing = 0;
+		try
+		{
+			RecordId scanRid;
+			while(1)
+			{
+				fscan.scanNext(scanRid);
+				if (fscan.getRecordView().str() == fscan.getRecord())
+					agreeing++;
+			}
+		}
+		catch(EndOfFileException e)
+		{
+		}
+		checkPassFail(agreeing, relationSize)
+	}
+	deleteRelation();
+}
+
+
+// deferred compaction
+
+void test34()
+{
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "-------------------------------" << std::endl;
+	std::cout << "- test deferred compaction -" << std::endl;
+	std::cout << "-------------------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+	Page page;
+	std::map<SlotId, std::string> expected;
+	for (int i = 0; page.hasSpaceForRecord(std::string(100, ' ')); i++)
+	{
+		const std::string record(100, (char)('a' + i % 26));
+		expected[page.insertRecord(record).slot_number] = record;
+	}
+	const int numRecords = (int)expected.size();
+
+	// deleting leaves holes: no other record moves
+	std::map<SlotId, const char*> places;
+	for (std::map<SlotId, std::string>::const_iterator it = expected.begin(); it != expected.end(); ++it)
+	{
+		const RecordId rid = {page.page_number(), it->first};
+		places[it->first] = page.getRecordView(rid).data;
+	}
+	const std::uint16_t freeSpace = page.getFreeSpace();
+	for (SlotId slot = 2; slot < numRecords; slot += 2)
+	{
+		const RecordId rid = {page.page_number(), slot};
+		page.deleteRecord(rid);
+		expected.erase(slot);
+	}
+	int moved = 0;
+	for (std::map<SlotId, std::string>::const_iterator it = expected.begin(); it != expected.end(); ++it)
+	{
+		const RecordId rid = {page.page_number(), it->first};
+		if (page.getRecordView(rid).data != places[it->first])
+			moved++;
+	}
+	checkPassFail(moved, 0)
+	const bool holesFree = page.getFreeSpace() >= freeSpace + 100 * (numRecords / 2 - 1);
+	checkPassFail(holesFree, true)
+	checkPassFail(pageMatches(page, expected), true)
+
+	// a record larger than any hole makes the page compact itself
+	const std::string large(1000, 'L');
+	checkPassFail(page.hasSpaceForRecord(large), true)
+	expected[page.insertRecord(large).slot_number] = large;
+	checkPassFail(pageMatches(page, expected), true)
+
+	// and so does asking for it
+	const RecordId rid = {page.page_number(), 3};
+	page.deleteRecord(rid);
+	expected.erase(3);
+	const std::uint16_t beforeCompact = page.getFreeSpace();
+	page.compact();
+	checkPassFail(page.getFreeSpace(), beforeCompact)
+	checkPassFail(pageMatches(page, expected), true)
+}
+
+
+// one read per scanned page
+
+void test35()
+{
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "-------------------------------------" << std::endl;
+	std::cout << "- test one read per scanned page -" << std::endl;
+	std::cout << "-------------------------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+	createRelationForward();
+	bufMgr->flushFile(file1);
+	int numPages = 0;
+	for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter)
+		numPages++;
+
+	// a scan reads each page once: the next page's number comes from the
+	// pinned page, not from a second read of its header
+	bufMgr->clearBufStats();
+	int found = 0;
+	{
+		FileScan fscan(relationName, bufMgr);
+		try
+		{
+			RecordId scanRid;
+			while(1)
+			{
+				fscan.scanNext(scanRid);
+				found++;
+			}
+		}
+		catch(EndOfFileException e)
+		{
+		}
+	}
+	checkPassFail(found, relationSize)
+	checkPassFail(bufMgr->getBufStats().diskreads, numPages)
+	deleteRelation();
+}
+
+
+// bulk record insertion
+
+void test36()
+{
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "---------------------------------" << std::endl;
+	std::cout << "- test bulk record insertion -" << std::endl;
+	std::cout << "---------------------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+	std::vector<std::string> records;
+	for (int i = 0; i < 1000; i++)
+	{
+		char record[100];
+		memset(record, ' ', sizeof(record));
+		sprintf(record, "%05d", i);
+		records.push_back(std::string(record, sizeof(record)));
+	}
+
+	// a page takes as many records in one call as one at a time
+	int oneByOne = 0;
+	{
+		Page page;
+		try
+		{
+			while (1)
+			{
+				page.insertRecord(records[oneByOne]);
+				oneByOne++;
+			}
+		}
+		catch (const InsufficientSpaceException &e)
+		{
+		}
+	}
+	{
+		Page page;
+		std::vector<RecordId> rids;
+		const int inserted = (int)page.insertRecords(records, 10, &rids);
+		checkPassFail(inserted, oneByOne)
+		checkPassFail((int)rids.size(), inserted)
+		checkPassFail(page.hasSpaceForRecord(records[10 + inserted]), false)
+		int matching = 0;
+		for (int k = 0; k < inserted; k++)
+			if (page.getRecord(rids[k]) == records[10 + k])
+				matching++;
+		checkPassFail(matching, inserted)
+	}
+
+	// a loaded relation has full pages, but for the last, and its records in order
+	const std::string loadedName = relationName + "loaded";
+	try
+	{
+		File::remove(loadedName);
+	}
+	catch(FileNotFoundException e)
+	{
+	}
+	{
+		PageFile file(loadedName, true);
+		std::vector<RecordId> rids;
+		{
+			RelationLoader loader(&file);
+			loader.insertRecords(records, &rids);
+			loader.flush();
+			const int pages = (int)loader.num_pages();
+			checkPassFail(pages, ((int)records.size() + oneByOne - 1) / oneByOne)
+		}
+		checkPassFail(rids.size(), records.size())
+
+		int full = 0;
+		int pages = 0;
+		std::size_t next = 0;
+		bool ordered = true;
+		for (FileIterator iter = file.begin(); iter != file.end(); ++iter, pages++)
+		{
+			Page page = *iter;
+			if (!page.hasSpaceForRecord(records[0]))
+				full++;
+			for (PageIterator record = page.begin(); record != page.end(); ++record, next++)
+			{
+				const RecordId rid = record.getCurrentRecord();
+				if (next >= records.size() || *record != records[next] ||
+				    rid.page_number != rids[next].page_number || rid.slot_number != rids[next].slot_number)
+					ordered = false;
+			}
+		}
+		checkPassFail(full, pages - 1)
+		checkPassFail(next, records.size())
+		checkPassFail(ordered, true)
+
+		// a record too large for any page is refused
+		bool refused = false;
+		try
+		{
+			RelationLoader loader(&file);
+			loader.insertRecords(std::vector<std::string>(1, std::string(Page::DEFAULT_SIZE, 'x')));
+		}
+		catch (const InsufficientSpaceException &e)
+		{
+			refused = true;
+		}
+		checkPassFail(refused, true)
+	}
+	File::remove(loadedName);
+}
+
+
+// used slot lists
+
+void test37()
+{
+	std::cout << std::endl;
+	std::cout << std::endl;
+	std::cout << "---------------------------" << std::endl;
+	std::cout << "- test used slot lists -" << std::endl;
+	std::cout << "---------------------------" << std::endl;
+	std::cout << std::endl;
+	std::cout << std::endl;
+
+	RECORD record;
+	memset(&record, ' ', sizeof(record));
+	const std::string recordData(reinterpret_cast<char*>(&record), sizeof(record));
+	relationPax = true;
+	const std::vector<PaxAttribute> attributes = relationAttributes();
+	relationPax = false;
+
+	// pages with every slot used, runs of free slots across bitmap words,
+	// scattered free slots and no used slots
+	int wrong = 0;
+	for (int pattern = 0; pattern < 4; pattern++)
+	{
+		Page slotted;
+		Page paxPage;
+		PaxPage pax = PaxPage::format(&paxPage, sizeof(RECORD), attributes);
+		std::vector<RecordId> slottedRids;
+		std::vector<RecordId> paxRids;
+		while (slotted.hasSpaceForRecord(recordData))
+			slottedRids.push_back(slotted.insertRecord(recordData));
+		while (pax.hasSpaceForRecord())
+			paxRids.push_back(pax.insertRecord(recordData));
+
+		for (std::size_t k = 0; k < slottedRids.size(); k++)
+		{
+			const bool drop = (pattern == 1 && k % 128 >= 60 && k % 128 < 70) ||
+			    (pattern == 2 && (k * 7) % 5 == 1) || pattern == 3;
+			if (drop)
+				slotted.deleteRecord(slottedRids[k]);
+		}
+		for (std::size_t k = 0; k < paxRids.size(); k++)
+		{
+			const bool drop = (pattern == 1 && k % 16 >= 6 && k % 16 < 10) ||
+			    (pattern == 2 && (k * 7) % 5 == 1) || pattern == 3;
+			if (drop)
+				pax.deleteRecord(paxRids[k]);
+		}
+
+		// one call returns what walking the slots one at a time finds
+		std::vector<SlotId> slots;
+		slotted.getUsedSlots(slots);
+		std::vector<SlotId> walked;
+		for (PageIterator iter = slotted.begin(); iter != slotted.end(); ++iter)
+			walked.push_back(iter.getCurrentRecord().slot_number);
+		if (slots != walked)
+			wrong++;
+
+		pax.getUsedSlots(slots);
+		walked.clear();
+		for (SlotId slot = pax.getNextUsedSlot(Page::INVALID_SLOT); slot != Page::INVALID_SLOT;
+		     slot = pax.getNextUsedSlot(slot))
+			walked.push_back(slot);
+		if (slots != walked)
+			wrong++;
+		if ((pattern == 3) != walked.empty())
+			wrong++;
+	}
+	checkPassFail(wrong, 0)
+}
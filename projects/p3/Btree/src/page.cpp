@@ -10,9 +10,11 @@
 
 
 
+#include <algorithm>
 #include <cassert>
 
 #include <iostream>
+#include <vector>
 #include "exceptions/insufficient_space_exception.h"
 #include "exceptions/invalid_record_exception.h"
 #include "exceptions/invalid_slot_exception.h"
@@ -23,19 +25,37 @@
 
 namespace badgerdb {
 
+const std::size_t Page::DEFAULT_SIZE;
+const std::size_t Page::SLOT_GROUP;
+const std::size_t Page::SLOT_GROUP_SIZE;
+
 Page::Page() {
   initialize();
 }
 
+PageBuffer Page::allocate(const std::size_t page_size) {
+  assert(isValidSize(page_size));
+  PageBuffer page(static_cast<Page*>(::operator new(page_size)));
+  page->initialize(page_size);
+  return page;
+}
+
 void Page::initialize() {
+  initialize(DEFAULT_SIZE);
+}
+
+void Page::initialize(const std::size_t page_size) {
+  assert(isValidSize(page_size));
   header_.free_space_lower_bound = 0;
-  header_.free_space_upper_bound = DATA_SIZE;
+  header_.free_space_upper_bound = page_size - sizeof(PageHeader);
+  header_.fragmented_bytes = 0;
   header_.num_slots = 0;
   header_.num_free_slots = 0;
+  header_.first_free_slot = INVALID_SLOT;
   header_.current_page_number = INVALID_NUMBER;
   header_.next_page_number = INVALID_NUMBER;
   //data_.assign(DATA_SIZE, char());
-	memset(data_, '\0', DATA_SIZE);
+	memset(data_, '\0', page_size - sizeof(PageHeader));
 }
 
 RecordId Page::insertRecord(const std::string& record_data) {
@@ -43,21 +63,83 @@ RecordId Page::insertRecord(const std::string& record_data) {
     throw InsufficientSpaceException(
         page_number(), record_data.length(), getFreeSpace());
   }
+  // A new slot may need to grow the slot array too, so make room for both
+  // before taking the slot.
+  if (record_data.length() + newSlotSize() > getContiguousFreeSpace()) {
+    compact();
+  }
   const SlotId slot_number = getAvailableSlot();
   insertRecordInSlot(slot_number, record_data);
   return {page_number(), slot_number};
 }
 
+std::size_t Page::insertRecords(const std::vector<std::string>& records,
+                                const std::size_t first,
+                                std::vector<RecordId>* record_ids) {
+  std::size_t index = first;
+  while (index < records.size() && hasSpaceForRecord(records[index])) {
+    const RecordId record_id = insertRecord(records[index]);
+    if (record_ids != NULL) {
+      record_ids->push_back(record_id);
+    }
+    ++index;
+  }
+  return index - first;
+}
+
 std::string Page::getRecord(const RecordId& record_id) const {
+  return getRecordView(record_id).str();
+}
+
+RecordView Page::getRecordView(const RecordId& record_id) const {
 // haiyun 
 #ifdef DEBUG
   std::cout<< "call validate at "<<__LINE__  <<std::endl;
 #endif
   validateRecordId(record_id);
   const PageSlot& slot = getSlot(record_id.slot_number);
-	std::string retStr = std::string(data_, DATA_SIZE).substr(slot.item_offset, slot.item_length);
+  const RecordView view = {&data_[slot.item_offset], slot.item_length};
+  return view;
+}
+
+void Page::getUsedSlots(std::vector<SlotId>& slots) const {
+  const SlotId num_slots = header_.num_slots;
+  slots.resize(num_slots - header_.num_free_slots);
+  if (header_.num_free_slots == 0) {
+    // Densely packed: every slot is used.
+    for (SlotId i = 1; i <= num_slots; ++i) {
+      slots[i - 1] = i;
+    }
+    return;
+  }
+  const std::size_t num_groups = (num_slots + SLOT_GROUP - 1) / SLOT_GROUP;
+  std::size_t count = 0;
+  for (std::size_t group = 0; group < num_groups; ++group) {
+    // Peel off the set bits of the word, lowest first.
+    std::uint64_t bits = getUsedSlotBits(group);
+    while (bits != 0) {
+      slots[count++] = group * SLOT_GROUP + __builtin_ctzll(bits) + 1;
+      bits &= bits - 1;
+    }
+  }
+}
 
-	return retStr;
+void Page::getRecordViews(std::vector<RecordView>& records) const {
+  const SlotId num_slots = header_.num_slots;
+  records.resize(num_slots - header_.num_free_slots);
+  const std::size_t num_groups = (num_slots + SLOT_GROUP - 1) / SLOT_GROUP;
+  std::size_t count = 0;
+  for (std::size_t group = 0; group < num_groups; ++group) {
+    std::uint64_t bits = getUsedSlotBits(group);
+    while (bits != 0) {
+      const PageSlot& slot =
+          getSlot(group * SLOT_GROUP + __builtin_ctzll(bits) + 1);
+      records[count].data = &data_[slot.item_offset];
+      records[count].length = slot.item_length;
+      ++count;
+      bits &= bits - 1;
+    }
+  }
 }
 
 void Page::updateRecord(const RecordId& record_id,
@@ -67,7 +149,27 @@ void Page::updateRecord(const RecordId& record_id,
   std::cout<< "call validate at "<<__LINE__  <<std::endl;
 #endif
   validateRecordId(record_id);
-  const PageSlot* slot = getSlot(record_id.slot_number);
+  PageSlot* slot = getSlot(record_id.slot_number);
+  const std::uint16_t new_length = record_data.length();
+  if (record_data.length() <= slot->item_length) {
+    // Shrinks or keeps its size: overwrite in place and leave any tail that is
+    // no longer used as a hole.
+    const std::uint16_t freed = slot->item_length - new_length;
+    memcpy(&data_[slot->item_offset], record_data.data(), new_length);
+    memset(&data_[slot->item_offset + new_length], '\0', freed);
+    slot->item_length = new_length;
+    header_.fragmented_bytes += freed;
+    return;
+  }
+  if (slot->item_offset == header_.free_space_upper_bound &&
+      record_data.length() - slot->item_length <= getContiguousFreeSpace()) {
+    // The record borders the free space, so it can grow downwards into it.
+    slot->item_offset -= new_length - slot->item_length;
+    slot->item_length = new_length;
+    header_.free_space_upper_bound = slot->item_offset;
+    memcpy(&data_[slot->item_offset], record_data.data(), new_length);
+    return;
+  }
   const std::size_t free_space_after_delete =
       getFreeSpace() + slot->item_length;
   if (record_data.length() > free_space_after_delete) {
@@ -99,46 +201,28 @@ void Page::deleteRecord(const RecordId& record_id,
 
   //data_.replace(slot->item_offset, slot->item_length, slot->item_length, '\0');
 
-  // Compact the data by removing the hole left by this record (if necessary).
-  std::uint16_t move_offset = slot->item_offset; 
-  std::size_t move_bytes = 0;
-  for (SlotId i = 1; i <= header_.num_slots; ++i) {
-    PageSlot* other_slot = getSlot(i);
-    if (other_slot->used && other_slot->item_offset < slot->item_offset) {
-      if (other_slot->item_offset < move_offset) {
-        move_offset = other_slot->item_offset;
-      }
-      move_bytes += other_slot->item_length;
-      // Update the slot for the other data to reflect the soon-to-be-new
-      // location.
-      other_slot->item_offset += slot->item_length;
-    }
-  }
-  // If we have data to move, shift it to the right.
-  if (move_bytes > 0) {
-    const std::string& data_to_move = std::string(data_, DATA_SIZE).substr(move_offset, move_bytes);
-
-		for(std::uint16_t i = 0; i < move_bytes; i++)
-			data_[i + move_offset + slot->item_length] = data_to_move[i];
-
-    //data_.replace(move_offset + slot->item_length, move_bytes, data_to_move);
+  // The first record after the free space can be given back right away;
+  // anything else stays a hole until the page is compacted.
+  if (slot->item_offset == header_.free_space_upper_bound) {
+    header_.free_space_upper_bound += slot->item_length;
+  } else {
+    header_.fragmented_bytes += slot->item_length;
   }
-  header_.free_space_upper_bound += slot->item_length;
 
   // Mark slot as unused.
-  slot->used = false;
-  slot->item_offset = 0;
-  slot->item_length = 0;
+  setSlotUsed(record_id.slot_number, false);
+  linkFreeSlot(record_id.slot_number);
   ++header_.num_free_slots;
 
   if (allow_slot_compaction && record_id.slot_number == header_.num_slots) {
     // Last slot in the list, so we need to free any unused slots that are at
     // the end of the slot list.
+    unlinkFreeSlot(record_id.slot_number);
     int num_slots_to_delete = 1;
     for (SlotId i = 1; i < header_.num_slots; ++i) {
       // Traverse list backwards, looking for unused slots.
-      const PageSlot* other_slot = getSlot(header_.num_slots - i);
-      if (!other_slot->used) {
+      if (!isSlotUsed(header_.num_slots - i)) {
+        unlinkFreeSlot(header_.num_slots - i);
         ++num_slots_to_delete;
       } else {
         // Stop at the first used slot we find, since we can't move used slots
@@ -148,45 +232,148 @@ void Page::deleteRecord(const RecordId& record_id,
     }
     header_.num_slots -= num_slots_to_delete;
     header_.num_free_slots -= num_slots_to_delete;
-    header_.free_space_lower_bound -= sizeof(PageSlot) * num_slots_to_delete;
+    header_.free_space_lower_bound = slotArraySize(header_.num_slots);
+  }
+}
+
+void Page::compact() {
+  if (header_.fragmented_bytes == 0) {
+    return;
   }
+
+  // Records are packed towards the end of the page, highest offset first, so
+  // each one only ever moves up over holes and records already moved.
+  std::vector<SlotId> used_slots;
+  getUsedSlots(used_slots);
+  std::uint16_t data_end = header_.free_space_upper_bound +
+      header_.fragmented_bytes;
+  for (std::vector<SlotId>::const_iterator it = used_slots.begin();
+       it != used_slots.end(); ++it) {
+    data_end += getSlot(*it)->item_length;
+  }
+  std::sort(used_slots.begin(), used_slots.end(),
+            [this](const SlotId a, const SlotId b) {
+              return getSlot(a)->item_offset > getSlot(b)->item_offset;
+            });
+
+  for (std::vector<SlotId>::const_iterator it = used_slots.begin();
+       it != used_slots.end(); ++it) {
+    PageSlot* slot = getSlot(*it);
+    data_end -= slot->item_length;
+    if (slot->item_offset != data_end) {
+      memmove(&data_[data_end], &data_[slot->item_offset], slot->item_length);
+      slot->item_offset = data_end;
+    }
+  }
+  memset(&data_[header_.free_space_upper_bound], '\0',
+         data_end - header_.free_space_upper_bound);
+  header_.free_space_upper_bound = data_end;
+  header_.fragmented_bytes = 0;
 }
 
 bool Page::hasSpaceForRecord(const std::string& record_data) const {
   std::size_t record_size = record_data.length();
   if (header_.num_free_slots == 0) {
-    record_size += sizeof(PageSlot);
+    record_size += newSlotSize();
   }
   return record_size <= getFreeSpace();
 }
 
+std::uint64_t Page::getUsedSlotBits(const std::size_t group) const {
+  // The words are not aligned within the page, so copy them out.
+  std::uint64_t bits;
+  memcpy(&bits, &data_[group * SLOT_GROUP_SIZE], sizeof(bits));
+  return bits;
+}
+
+void Page::setSlotUsed(const SlotId slot_number, const bool used) {
+  const std::size_t group = (slot_number - 1) / SLOT_GROUP;
+  const std::uint64_t bit = std::uint64_t(1) << ((slot_number - 1) % SLOT_GROUP);
+  std::uint64_t bits = getUsedSlotBits(group);
+  bits = used ? bits | bit : bits & ~bit;
+  memcpy(&data_[group * SLOT_GROUP_SIZE], &bits, sizeof(bits));
+}
+
+SlotId Page::getNextUsedSlot(const SlotId start) const {
+  const std::size_t num_slots = header_.num_slots;
+  if (header_.num_free_slots == 0) {
+    // Every allocated slot is in use.
+    return start < num_slots ? start + 1 : INVALID_SLOT;
+  }
+  // Slot start + 1 has bit index start.
+  std::size_t index = start;
+  while (index < num_slots) {
+    const std::uint64_t bits =
+        getUsedSlotBits(index / SLOT_GROUP) >> (index % SLOT_GROUP);
+    if (bits != 0) {
+      return index + __builtin_ctzll(bits) + 1;
+    }
+    // Nothing used in the rest of this word.
+    index = (index / SLOT_GROUP + 1) * SLOT_GROUP;
+  }
+  return INVALID_SLOT;
+}
+
 PageSlot* Page::getSlot(const SlotId slot_number) {
-  return reinterpret_cast<PageSlot*>(&data_[(slot_number - 1) * sizeof(PageSlot)]);
+  const std::size_t index = slot_number - 1;
+  return reinterpret_cast<PageSlot*>(
+      &data_[index / SLOT_GROUP * SLOT_GROUP_SIZE + sizeof(std::uint64_t) +
+             index % SLOT_GROUP * sizeof(PageSlot)]);
 }
 
 const PageSlot& Page::getSlot(const SlotId slot_number) const {
-  return *reinterpret_cast<const PageSlot*>(&data_[(slot_number - 1) * sizeof(PageSlot)]);
+  const std::size_t index = slot_number - 1;
+  return *reinterpret_cast<const PageSlot*>(
+      &data_[index / SLOT_GROUP * SLOT_GROUP_SIZE + sizeof(std::uint64_t) +
+             index % SLOT_GROUP * sizeof(PageSlot)]);
+}
+
+void Page::linkFreeSlot(const SlotId slot_number) {
+  PageSlot* slot = getSlot(slot_number);
+  slot->item_offset = header_.first_free_slot;
+  slot->item_length = INVALID_SLOT;
+  if (header_.first_free_slot != INVALID_SLOT) {
+    getSlot(header_.first_free_slot)->item_length = slot_number;
+  }
+  header_.first_free_slot = slot_number;
+}
+
+void Page::unlinkFreeSlot(const SlotId slot_number) {
+  PageSlot* slot = getSlot(slot_number);
+  const SlotId next = slot->item_offset;
+  const SlotId prev = slot->item_length;
+  if (prev != INVALID_SLOT) {
+    getSlot(prev)->item_offset = next;
+  } else {
+    header_.first_free_slot = next;
+  }
+  if (next != INVALID_SLOT) {
+    getSlot(next)->item_length = prev;
+  }
+  slot->item_offset = 0;
+  slot->item_length = 0;
 }
 
 SlotId Page::getAvailableSlot() {
   SlotId slot_number = INVALID_SLOT;
   if (header_.num_free_slots > 0) {
-    // Have an allocated but unused slot that we can reuse.
-    for (SlotId i = 1; i <= header_.num_slots; ++i) {
-      const PageSlot* slot = getSlot(i);
-      if (!slot->used) {
-        // We don't decrement the number of free slots until someone actually
-        // puts data in the slot.
-        slot_number = i;
-        break;
-      }
-    }
+    // Have an allocated but unused slot that we can reuse.  We don't take it
+    // off the chain or decrement the number of free slots until someone
+    // actually puts data in the slot.
+    slot_number = header_.first_free_slot;
   } else {
-    // Have to allocate a new slot.
+    // Have to allocate a new slot, and with it a new bitmap word if it
+    // starts a group.
     slot_number = header_.num_slots + 1;
+    if ((slot_number - 1) % SLOT_GROUP == 0) {
+      memset(&data_[(slot_number - 1) / SLOT_GROUP * SLOT_GROUP_SIZE], '\0',
+             sizeof(std::uint64_t));
+    }
     ++header_.num_slots;
     ++header_.num_free_slots;
-    header_.free_space_lower_bound = sizeof(PageSlot) * header_.num_slots;
+    header_.free_space_lower_bound = slotArraySize(header_.num_slots);
+    setSlotUsed(slot_number, false);
+    linkFreeSlot(slot_number);
   }
   assert(slot_number != INVALID_SLOT);
   return static_cast<SlotId>(slot_number);
@@ -199,11 +386,15 @@ void Page::insertRecordInSlot(const SlotId slot_number,
     throw InvalidSlotException(page_number(), slot_number);
   }
   PageSlot* slot = getSlot(slot_number);
-  if (slot->used) {
+  if (isSlotUsed(slot_number)) {
     throw SlotInUseException(page_number(), slot_number);
   }
   const int record_length = record_data.length();
-  slot->used = true;
+  if (record_length > getContiguousFreeSpace()) {
+    compact();
+  }
+  unlinkFreeSlot(slot_number);
+  setSlotUsed(slot_number, true);
   slot->item_length = record_length;
   slot->item_offset = header_.free_space_upper_bound - record_length;
   header_.free_space_upper_bound = slot->item_offset;
@@ -223,8 +414,9 @@ std::cout<<"page number not match"<<std::endl;
 #endif
     throw InvalidRecordException(record_id, page_number());
   }
-  const PageSlot& slot = getSlot(record_id.slot_number);
-  if (!slot.used) {
+  if (record_id.slot_number == INVALID_SLOT ||
+      record_id.slot_number > header_.num_slots ||
+      !isSlotUsed(record_id.slot_number)) {
 // haiyun
 #ifdef DEBUG
 std::cout<<"slot not used"<<std::endl;
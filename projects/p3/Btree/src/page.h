@@ -11,6 +11,7 @@
 #include <stdint.h>
 #include <memory>
 #include <string>
+#include <vector>
 
 //#include <gtest/gtest.h>
 #include "types.h"
@@ -36,6 +37,13 @@ struct PageHeader {
    */
   std::uint16_t free_space_upper_bound;
 
+  /**
+   * Bytes of deleted records left as holes between the free space and the
+   * end of the page.  They count as free space but are only made contiguous
+   * when the page is compacted.
+   */
+  std::uint16_t fragmented_bytes;
+
   /**
    * Number of slots currently allocated.  This number may include slots which
    * are unused but are in the middle of the slot array (due to record
@@ -48,6 +56,12 @@ struct PageHeader {
    */
   SlotId num_free_slots;
 
+  /**
+   * First slot of the chain linking all allocated but unused slots, or
+   * Page::INVALID_SLOT if there are none.
+   */
+  SlotId first_free_slot;
+
   /**
    * Number of the page within the file.
    */
@@ -74,27 +88,63 @@ struct PageHeader {
 
 /**
  * @brief Slot metadata that tracks where a record is in the data space.
+ *
+ * Whether a slot currently holds data is kept apart from the slot, in the
+ * used-slot bitmap of the page's slot directory.
  */
 struct PageSlot {
   /**
-   * Whether the slot currently holds data.  May be false if this slot's
-   * record has been deleted after insertion.
+   * Offset of the data item in the page.  For an unused slot, the next slot
+   * in the page's free-slot chain.
    */
-  bool used;
+  std::uint16_t item_offset;
 
   /**
-   * Offset of the data item in the page.
+   * Length of the data item in this slot.  For an unused slot, the previous
+   * slot in the page's free-slot chain.
    */
-  std::uint16_t item_offset;
+  std::uint16_t item_length;
+};
+
+/**
+ * @brief Non-owning view of a record's bytes inside a page.
+ *
+ * A view points straight into the page it was taken from; it is only valid
+ * while that page stays in memory (e.g. pinned in the buffer pool) and the
+ * record is not updated or deleted.
+ */
+struct RecordView {
+  /**
+   * First byte of the record.
+   */
+  const char* data;
 
   /**
-   * Length of the data item in this slot.
+   * Length of the record in bytes.
    */
-  std::uint16_t item_length;
+  std::size_t length;
+
+  /**
+   * Returns a copy of the record's bytes.
+   */
+  std::string str() const { return std::string(data, length); }
 };
 
+class Page;
 class PageIterator;
 
+/**
+ * @brief Frees the storage of a page made by Page::allocate().
+ */
+struct PageDeleter {
+  void operator()(Page* page) const { ::operator delete(page); }
+};
+
+/**
+ * Page of a given size, owning storage for just that many bytes.
+ */
+typedef std::unique_ptr<Page, PageDeleter> PageBuffer;
+
 /**
  * @brief Class which represents a fixed-size database page containing records.
  *
@@ -108,18 +158,29 @@ class PageIterator;
 class Page {
  public:
   /**
-   * Page size in bytes.  If this is changed, database files created with a
-   * different page size value will be unreadable by the resulting binaries.
+   * Largest page size in bytes, and the size of a Page object.  Files may use
+   * any smaller power-of-two page size down to MIN_SIZE; the size chosen is
+   * recorded in the file header.  Buffer pool frames only take the page size
+   * of the file they hold (see allocate()).  If this is changed, database
+   * files created with a larger page size value will be unreadable by the
+   * resulting binaries.  Offsets within a page are kept in 16 bits, so it may
+   * not grow past 64KB.
    */
-  static const std::size_t SIZE = 8192;
-
-  // haiyun 
-//   static const std::size_t SIZE = 512;
+  static const std::size_t SIZE = 65536;
 
+  /**
+   * Page size in bytes of files created without choosing one.  Large pages
+   * suit relations that are mostly scanned; this suits point lookups.
+   */
+  static const std::size_t DEFAULT_SIZE = 8192;
 
+  /**
+   * Smallest page size in bytes a file may be created with.
+   */
+  static const std::size_t MIN_SIZE = 512;
 
   /**
-   * Size of page free space area in bytes.
+   * Size of page free space area in bytes for a page of the largest size.
    */
   static const std::size_t DATA_SIZE = SIZE - sizeof(PageHeader);
 
@@ -138,6 +199,29 @@ class Page {
    */
   Page();
 
+  /**
+   * Allocates a new, empty page with storage for only page_size bytes, for
+   * holding pages of a file with that page size.  Such a page must only be
+   * used through pointers, never copied or assigned as a whole Page; it is
+   * filled by File::readPageInto().
+   *
+   * @param page_size   Page size in bytes; a valid size.
+   * @return  The page.
+   */
+  static PageBuffer allocate(const std::size_t page_size);
+
+  /**
+   * Returns true if pages of the given size can be stored in a file, i.e. the
+   * size is a power of two between MIN_SIZE and SIZE.
+   *
+   * @param page_size   Page size in bytes.
+   * @return  Whether the page size is supported.
+   */
+  static bool isValidSize(const std::size_t page_size) {
+    return page_size >= MIN_SIZE && page_size <= SIZE &&
+        (page_size & (page_size - 1)) == 0;
+  }
+
   /**
    * Inserts a new record into the page.
    *
@@ -146,6 +230,19 @@ class Page {
    */
   RecordId insertRecord(const std::string& record_data);
 
+  /**
+   * Inserts records into the page, starting at records[first], until one does
+   * not fit or all have been inserted.
+   *
+   * @param records     Records to insert.
+   * @param first       Index of the first record to insert.
+   * @param record_ids  If not NULL, receives the IDs of the inserted records.
+   * @return  Number of records inserted.
+   */
+  std::size_t insertRecords(const std::vector<std::string>& records,
+                            const std::size_t first = 0,
+                            std::vector<RecordId>* record_ids = NULL);
+
   /**
    * Returns the record with the given ID.  Returned data is a copy of what is
    * stored on the page; use updateRecord to change it.
@@ -156,10 +253,40 @@ class Page {
    */
   std::string getRecord(const RecordId& record_id) const;
 
+  /**
+   * Returns a view of the record with the given ID without copying it.
+   *
+   * @see RecordView
+   * @param record_id  ID of the record to return.
+   * @return  View of the record's bytes in this page.
+   */
+  RecordView getRecordView(const RecordId& record_id) const;
+
+  /**
+   * Returns the numbers of all used slots of the page in one pass over the
+   * slot directory.
+   *
+   * @param slots   Receives the used slot numbers in ascending order; its
+   *                previous contents are replaced.
+   */
+  void getUsedSlots(std::vector<SlotId>& slots) const;
+
+  /**
+   * Returns views of all records of the page in one pass over the slot
+   * directory.
+   *
+   * @see RecordView
+   * @param records   Receives the views in slot order; its previous contents
+   *                  are replaced.
+   */
+  void getRecordViews(std::vector<RecordView>& records) const;
+
   /**
    * Updates the record with the given ID, replacing its data with a new
    * version.  This is equivalent to deleting the old record and inserting a
-   * new one, with the exception that the record ID will not change.
+   * new one, with the exception that the record ID will not change.  Data that
+   * fits in the record's current space, or that can grow into free space next
+   * to it, is written in place.
    *
    * @param record_id   ID of record to update.
    * @param record_data Updated bytes that compose the record.
@@ -167,14 +294,24 @@ class Page {
   void updateRecord(const RecordId& record_id, const std::string& record_data);
 
   /**
-   * Deletes the record with the given ID.  Page is compacted upon delete to
-   * ensure that data of all records is contiguous.  Slot array is compacted if
-   * the slot deleted is at the end of the slot array.
+   * Deletes the record with the given ID.  The record's bytes are left as a
+   * hole that is reclaimed the next time the page is compacted, so deleting
+   * several records from a page does not move the others each time.  Slot
+   * array is compacted if the slot deleted is at the end of the slot array.
    *
+   * @see compact
    * @param record_id   ID of the record to delete.
    */
   void deleteRecord(const RecordId& record_id);
 
+  /**
+   * Moves all records to the end of the page so that the holes left by
+   * deleted records become part of the contiguous free space.  Inserts and
+   * updates call this on their own when they need the space; record IDs are
+   * not affected.
+   */
+  void compact();
+
   /**
    * Returns true if the page has enough free space to hold the given data.
    *
@@ -184,12 +321,13 @@ class Page {
   bool hasSpaceForRecord(const std::string& record_data) const;
 
   /**
-   * Returns this page's free space in bytes.
+   * Returns this page's free space in bytes, including holes left by deleted
+   * records.
    *
    * @return  Free space in bytes.
    */
-  std::uint16_t getFreeSpace() const { return header_.free_space_upper_bound -
-                                              header_.free_space_lower_bound; }
+  std::uint16_t getFreeSpace() const { return getContiguousFreeSpace() +
+                                              header_.fragmented_bytes; }
 
   /**
    * Returns this page's number in its file.
@@ -222,10 +360,21 @@ class Page {
 
  private:
   /**
-   * Initializes this page as a new page with no header information or data.
+   * Initializes this page as a new page with no header information or data,
+   * sized for a file of DEFAULT_SIZE pages.
    */
   void initialize();
 
+  /**
+   * Initializes this page as a new, empty page of the given size.  Only the
+   * first <page_size> bytes of the page (header included) are used for
+   * records, so the page can be stored in a file with that page size.
+   *
+   * @param page_size   Size in bytes of the pages of the file this page
+   *                    belongs to.
+   */
+  void initialize(const std::size_t page_size);
+
   /**
    * Sets this page's number in its file.
    *
@@ -245,8 +394,8 @@ class Page {
   }
 
   /**
-   * Deletes the record with the given ID.  Page is compacted upon delete to
-   * ensure that data of all records is contiguous.  Slot array is compacted if
+   * Deletes the record with the given ID, leaving its bytes as a hole unless
+   * it is the first record after the free space.  Slot array is compacted if
    * the slot deleted is at the end of the slot array and
    * <allow_slot_compaction> is set.
    *
@@ -257,6 +406,86 @@ class Page {
   void deleteRecord(const RecordId& record_id,
                     const bool allow_slot_compaction);
 
+  /**
+   * Returns the free space between the slot array and the first record, i.e.
+   * the space usable without compacting the page.
+   *
+   * @return  Contiguous free space in bytes.
+   */
+  std::uint16_t getContiguousFreeSpace() const {
+    return header_.free_space_upper_bound - header_.free_space_lower_bound;
+  }
+
+  /**
+   * Number of slots that share one word of the used-slot bitmap.  The slot
+   * directory is a sequence of groups, each a 64-bit word whose bit i tells
+   * whether the group's slot i is used, followed by that many PageSlots.
+   */
+  static const std::size_t SLOT_GROUP = 64;
+
+  /**
+   * Size in bytes of one group of the slot directory.
+   */
+  static const std::size_t SLOT_GROUP_SIZE =
+      sizeof(std::uint64_t) + SLOT_GROUP * sizeof(PageSlot);
+
+  /**
+   * Returns the size in bytes of a slot directory with the given number of
+   * slots.
+   *
+   * @param num_slots   Number of slots.
+   * @return  Size of the slot directory.
+   */
+  static std::size_t slotArraySize(const std::size_t num_slots) {
+    return (num_slots + SLOT_GROUP - 1) / SLOT_GROUP * sizeof(std::uint64_t) +
+        num_slots * sizeof(PageSlot);
+  }
+
+  /**
+   * Returns the number of bytes the slot directory grows by when a slot is
+   * added to it.
+   */
+  std::size_t newSlotSize() const {
+    return slotArraySize(header_.num_slots + 1) -
+        slotArraySize(header_.num_slots);
+  }
+
+  /**
+   * Returns the word of the used-slot bitmap for a group of slots.
+   *
+   * @param group   Index of the group; slot n is in group (n - 1) / SLOT_GROUP.
+   * @return  Used bits of the group's slots.
+   */
+  std::uint64_t getUsedSlotBits(const std::size_t group) const;
+
+  /**
+   * Returns true if the slot with the given number holds a record.
+   *
+   * @param slot_number   Number of an allocated slot.
+   */
+  bool isSlotUsed(const SlotId slot_number) const {
+    return (getUsedSlotBits((slot_number - 1) / SLOT_GROUP) >>
+            ((slot_number - 1) % SLOT_GROUP)) & 1;
+  }
+
+  /**
+   * Marks the slot with the given number as holding a record or not.
+   *
+   * @param slot_number   Number of an allocated slot.
+   * @param used          Whether the slot holds a record.
+   */
+  void setSlotUsed(const SlotId slot_number, const bool used);
+
+  /**
+   * Returns the first used slot after the given one, found by scanning the
+   * used-slot bitmap a word at a time.
+   *
+   * @param start   Slot to start after; Page::INVALID_SLOT to start at the
+   *                first slot.
+   * @return  Next used slot or Page::INVALID_SLOT if there is none.
+   */
+  SlotId getNextUsedSlot(const SlotId start) const;
+
   /**
    * Returns the slot with the given number.  This method will return
    * unallocated slots if requested; it is up to the caller to ensure they
@@ -278,8 +507,23 @@ class Page {
   const PageSlot& getSlot(const SlotId slot_number) const;
 
   /**
-   * Returns the slot number of an available slot.  If no slots are available
-   * to be reused, allocates a new slot.  Updates available slot count in the
+   * Adds an unused slot to the front of the free-slot chain.
+   *
+   * @param slot_number   Number of slot to add.
+   */
+  void linkFreeSlot(const SlotId slot_number);
+
+  /**
+   * Removes an unused slot from the free-slot chain.
+   *
+   * @param slot_number   Number of slot to remove.
+   */
+  void unlinkFreeSlot(const SlotId slot_number);
+
+  /**
+   * Returns the slot number of an available slot, taken from the head of the
+   * free-slot chain.  If no slots are available to be reused, allocates a new
+   * slot.  Updates available slot count in the
    * header metadata, but does not mark returned slot as used.  If a new slot is
    * allocated, updates the free space lower bound.
    *
@@ -298,7 +542,8 @@ class Page {
    * in use.  <slot_number> must be less than <header_.num_slots>.
    *
    * Callers are responsible for making sure there is enough space to hold the
-   * record before calling this method.
+   * record before calling this method; the page is compacted if that space is
+   * not contiguous.
    *
    * @param slot_number   Number of slot to insert record into.
    * @param record_data   Bytes that compose the record.
@@ -341,6 +586,8 @@ class Page {
   friend class File;
   friend class PageFile;
   friend class BlobFile;
+  friend class StripedFile;
+  friend class PaxPage;
   friend class PageIterator;
 };
 
@@ -348,5 +595,12 @@ static_assert(Page::SIZE > sizeof(PageHeader),
               "Page size must be large enough to hold header and data.");
 static_assert(Page::DATA_SIZE > 0,
               "Page must have some space to hold data.");
+static_assert(Page::MIN_SIZE > sizeof(PageHeader) && Page::MIN_SIZE <= Page::SIZE,
+              "Smallest page size must hold a header and fit in a frame.");
+static_assert(Page::DATA_SIZE <= UINT16_MAX,
+              "Offsets within the largest page must fit in 16 bits.");
+static_assert(Page::DEFAULT_SIZE >= Page::MIN_SIZE &&
+              Page::DEFAULT_SIZE <= Page::SIZE,
+              "Default page size must be one a file may be created with.");
 
 }
@@ -0,0 +1,221 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "page_codec.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Shortest back reference worth encoding.
+ */
+const std::size_t MIN_MATCH = 4;
+
+/**
+ * Bytes at the end of the input that are always emitted as literals, so the
+ * match finder can read four bytes without checking the bound.
+ */
+const std::size_t LAST_LITERALS = 5;
+
+/**
+ * Longest distance a back reference can reach.
+ */
+const std::size_t MAX_OFFSET = 0xFFFF;
+
+const int HASH_BITS = 12;
+
+inline std::uint32_t read32(const char* p) {
+  std::uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+inline std::size_t hash(const std::uint32_t sequence) {
+  return (sequence * 2654435761U) >> (32 - HASH_BITS);
+}
+
+/**
+ * Appends an extended length (the part beyond the 4-bit token field).
+ */
+inline bool putLength(std::size_t length, char*& op, const char* end) {
+  while (length >= 255) {
+    if (op == end) {
+      return false;
+    }
+    *op++ = static_cast<char>(255);
+    length -= 255;
+  }
+  if (op == end) {
+    return false;
+  }
+  *op++ = static_cast<char>(length);
+  return true;
+}
+
+/**
+ * Reads an extended length into length.
+ */
+inline bool getLength(std::size_t& length, const unsigned char*& ip,
+                      const unsigned char* end) {
+  unsigned char byte;
+  do {
+    if (ip == end) {
+      return false;
+    }
+    byte = *ip++;
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+/**
+ * Appends one sequence: a literal run, optionally followed by a match.
+ */
+bool putSequence(const char* literals, const std::size_t literal_length,
+                 const std::size_t offset, const std::size_t match_length,
+                 char*& op, const char* end) {
+  if (op == end) {
+    return false;
+  }
+  char* token = op++;
+  unsigned char value = 0;
+  if (literal_length >= 15) {
+    value = 15 << 4;
+    if (!putLength(literal_length - 15, op, end)) {
+      return false;
+    }
+  } else {
+    value = static_cast<unsigned char>(literal_length << 4);
+  }
+  if (static_cast<std::size_t>(end - op) < literal_length) {
+    return false;
+  }
+  std::memcpy(op, literals, literal_length);
+  op += literal_length;
+
+  if (match_length > 0) {
+    if (end - op < 2) {
+      return false;
+    }
+    *op++ = static_cast<char>(offset & 0xFF);
+    *op++ = static_cast<char>(offset >> 8);
+    const std::size_t extra = match_length - MIN_MATCH;
+    if (extra >= 15) {
+      value |= 15;
+      if (!putLength(extra - 15, op, end)) {
+        return false;
+      }
+    } else {
+      value |= static_cast<unsigned char>(extra);
+    }
+  }
+  *token = static_cast<char>(value);
+  return true;
+}
+
+}
+
+std::size_t PageCodec::compress(const char* src, const std::size_t length,
+                                char* dst, const std::size_t capacity) {
+  char* op = dst;
+  const char* const op_end = dst + capacity;
+  std::size_t anchor = 0;
+
+  if (length > MIN_MATCH + LAST_LITERALS) {
+    // Positions of the last occurrence of each hashed four-byte sequence,
+    // offset by one so that zero means empty.
+    std::uint32_t table[1 << HASH_BITS];
+    std::memset(table, 0, sizeof(table));
+
+    const std::size_t match_limit = length - LAST_LITERALS;
+    std::size_t ip = 0;
+    while (ip + MIN_MATCH <= match_limit) {
+      const std::uint32_t sequence = read32(src + ip);
+      const std::size_t slot = hash(sequence);
+      const std::size_t candidate = table[slot];
+      table[slot] = static_cast<std::uint32_t>(ip + 1);
+      if (candidate == 0 || ip - (candidate - 1) > MAX_OFFSET ||
+          read32(src + candidate - 1) != sequence) {
+        ++ip;
+        continue;
+      }
+
+      const std::size_t ref = candidate - 1;
+      std::size_t match_length = MIN_MATCH;
+      while (ip + match_length < match_limit &&
+             src[ref + match_length] == src[ip + match_length]) {
+        ++match_length;
+      }
+      if (!putSequence(src + anchor, ip - anchor, ip - ref, match_length,
+                       op, op_end)) {
+        return 0;
+      }
+      ip += match_length;
+      anchor = ip;
+    }
+  }
+
+  if (!putSequence(src + anchor, length - anchor, 0, 0, op, op_end)) {
+    return 0;
+  }
+  return op - dst;
+}
+
+bool PageCodec::decompress(const char* src, const std::size_t length,
+                           char* dst, const std::size_t capacity) {
+  const unsigned char* ip = reinterpret_cast<const unsigned char*>(src);
+  const unsigned char* const ip_end = ip + length;
+  std::size_t out = 0;
+
+  while (ip < ip_end) {
+    const unsigned char token = *ip++;
+
+    std::size_t literal_length = token >> 4;
+    if (literal_length == 15 && !getLength(literal_length, ip, ip_end)) {
+      return false;
+    }
+    if (static_cast<std::size_t>(ip_end - ip) < literal_length ||
+        capacity - out < literal_length) {
+      return false;
+    }
+    std::memcpy(dst + out, ip, literal_length);
+    ip += literal_length;
+    out += literal_length;
+
+    if (ip == ip_end) {
+      // The last sequence carries literals only.
+      break;
+    }
+
+    if (ip_end - ip < 2) {
+      return false;
+    }
+    const std::size_t offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    std::size_t match_length = token & 15;
+    if (match_length == 15 && !getLength(match_length, ip, ip_end)) {
+      return false;
+    }
+    match_length += MIN_MATCH;
+    if (offset == 0 || offset > out || capacity - out < match_length) {
+      return false;
+    }
+    // Byte by byte, as the reference may overlap the bytes being produced.
+    const char* ref = dst + out - offset;
+    for (std::size_t i = 0; i < match_length; ++i) {
+      dst[out + i] = ref[i];
+    }
+    out += match_length;
+  }
+  return out == capacity;
+}
+
+}
@@ -0,0 +1,50 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace badgerdb {
+
+/**
+ * @brief Fast byte-oriented LZ77 codec for page images.
+ *
+ * The compressed form is a sequence of (literal run, back reference) pairs
+ * with 16-bit offsets, in the spirit of LZ4.  It is tuned for the zero-filled
+ * tails and repetitive record ids of half-full B-tree nodes, trading ratio
+ * for speed so that compressing a page costs less than writing it.
+ */
+class PageCodec {
+ public:
+  /**
+   * Compresses a buffer.
+   *
+   * @param src       Bytes to compress.
+   * @param length    Number of bytes to compress; at most 64 KB.
+   * @param dst       Buffer to receive the compressed bytes.
+   * @param capacity  Size of dst.
+   * @return  Number of compressed bytes, or 0 if they do not fit in capacity.
+   */
+  static std::size_t compress(const char* src, const std::size_t length,
+                              char* dst, const std::size_t capacity);
+
+  /**
+   * Decompresses a buffer produced by compress().
+   *
+   * @param src       Compressed bytes.
+   * @param length    Number of compressed bytes.
+   * @param dst       Buffer to receive the original bytes.
+   * @param capacity  Expected number of original bytes.
+   * @return  True if the input was well formed and decoded to exactly
+   *          capacity bytes.
+   */
+  static bool decompress(const char* src, const std::size_t length,
+                         char* dst, const std::size_t capacity);
+};
+
+}
@@ -0,0 +1,132 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "parallel_filescan.h"
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
+
+#include "exceptions/invalid_page_exception.h"
+
+namespace badgerdb {
+
+const std::size_t ParallelFileScan::DEFAULT_MORSEL_PAGES;
+
+ParallelFileScan::ParallelFileScan(const std::string& name, BufMgr* bufMgr,
+                                   const std::size_t morsel_pages)
+    : file_(new PageFile(name, false /* create_new */)),
+      buf_mgr_(bufMgr),
+      predicate_(NULL),
+      num_pages_(file_->getNumPages()),
+      morsel_pages_(std::max<std::size_t>(morsel_pages, 1)),
+      next_morsel_(0) {
+}
+
+ParallelFileScan::ParallelFileScan(const std::string& name, BufMgr* bufMgr,
+                                   const ScanPredicate& predicate,
+                                   const std::size_t morsel_pages)
+    : file_(new PageFile(name, false /* create_new */)),
+      buf_mgr_(bufMgr),
+      predicate_(new ScanPredicate(predicate)),
+      num_pages_(file_->getNumPages()),
+      morsel_pages_(std::max<std::size_t>(morsel_pages, 1)),
+      next_morsel_(0) {
+}
+
+ParallelFileScan::~ParallelFileScan() {
+  buf_mgr_->flushFile(file_);
+  delete file_;
+  delete predicate_;
+}
+
+void ParallelFileScan::run(std::size_t num_threads,
+                           const PageVisitor& visit,
+                           const MorselVisitor& finish) {
+  next_morsel_ = 0;
+  if (num_threads == 0) {
+    num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  if (num_threads == 1) {
+    work(visit, finish);
+    return;
+  }
+
+  std::vector<std::exception_ptr> errors(num_threads);
+  std::vector<std::thread> workers;
+  for (std::size_t i = 0; i < num_threads; ++i) {
+    workers.push_back(std::thread([this, &visit, &finish, &errors, i]() {
+      try {
+        work(visit, finish);
+      } catch (...) {
+        errors[i] = std::current_exception();
+        // Leave no morsels for the other workers.
+        next_morsel_ = num_morsels();
+      }
+    }));
+  }
+  for (std::size_t i = 0; i < workers.size(); ++i) {
+    workers[i].join();
+  }
+  for (std::size_t i = 0; i < errors.size(); ++i) {
+    if (errors[i]) {
+      std::rethrow_exception(errors[i]);
+    }
+  }
+}
+
+void ParallelFileScan::work(const PageVisitor& visit,
+                            const MorselVisitor& finish) {
+  PageRecords records(predicate_);
+  for (;;) {
+    const std::size_t morsel = next_morsel_++;
+    if (morsel >= num_morsels()) {
+      return;
+    }
+    try {
+      scanMorsel(morsel, records, visit);
+    } catch (...) {
+      if (finish) {
+        finish(morsel, false /* completed */);
+      }
+      throw;
+    }
+    if (finish) {
+      finish(morsel, true /* completed */);
+    }
+  }
+}
+
+void ParallelFileScan::scanMorsel(const std::size_t morsel,
+                                  PageRecords& records,
+                                  const PageVisitor& visit) {
+  const PageId first = 1 + morsel * morsel_pages_;
+  const PageId last =
+      std::min<std::size_t>(first + morsel_pages_, num_pages_);
+  for (PageId page_number = first; page_number < last; ++page_number) {
+    Page* page;
+    try {
+      buf_mgr_->readPage(file_, page_number, page);
+    } catch (const InvalidPageException&) {
+      // A free page; it is not on the relation's page list.
+      continue;
+    }
+    try {
+      records.load(page);
+      if (records.size() > 0) {
+        visit(morsel, records);
+      }
+    } catch (...) {
+      buf_mgr_->unPinPage(file_, page_number, false);
+      throw;
+    }
+    buf_mgr_->unPinPage(file_, page_number, false);
+  }
+}
+
+}
@@ -0,0 +1,165 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <string>
+
+#include "buffer.h"
+#include "file.h"
+#include "filescan.h"
+#include "scan_predicate.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Scans the records of a relation with several threads.
+ *
+ * The pages of the relation are split into morsels of consecutive page
+ * numbers, which worker threads claim one at a time from a shared counter,
+ * so a thread that gets through its pages quickly simply takes more morsels.
+ * Each worker pins pages through the shared BufMgr and collects their records
+ * in its own PageRecords; free pages in a morsel are skipped.  The used pages
+ * of a file are kept in page number order, so taking the morsels in order
+ * visits the records in the order a FileScan returns them.
+ *
+ * The relation must not be modified during the scan.
+ */
+class ParallelFileScan {
+ public:
+  /**
+   * Called by a worker for each page with records to return; the page stays
+   * pinned until the call returns.
+   *
+   * @param morsel    Number of the morsel the page belongs to.
+   * @param records   Records of the page that satisfy the predicate.
+   */
+  typedef std::function<void(const std::size_t morsel, PageRecords& records)>
+      PageVisitor;
+
+  /**
+   * Called by a worker once it is done with a morsel: after its last page,
+   * or after a failure scanning it, which run() then reports.  Only some of
+   * the pages of a failed morsel may have been visited.
+   *
+   * @param morsel      Number of the morsel.
+   * @param completed   Whether every page of the morsel was visited.
+   */
+  typedef std::function<void(const std::size_t morsel, const bool completed)>
+      MorselVisitor;
+
+  /**
+   * Default number of pages in a morsel.
+   */
+  static const std::size_t DEFAULT_MORSEL_PAGES = 16;
+
+  /**
+   * Opens a parallel scan of every record of the given relation.
+   *
+   * @param name          Name of relation file.
+   * @param bufMgr        Buffer manager the workers share.
+   * @param morsel_pages  Number of pages in a morsel.
+   */
+  ParallelFileScan(const std::string& name, BufMgr* bufMgr,
+                   const std::size_t morsel_pages = DEFAULT_MORSEL_PAGES);
+
+  /**
+   * Opens a parallel scan of the records of the given relation that satisfy
+   * a predicate.
+   *
+   * @param name          Name of relation file.
+   * @param bufMgr        Buffer manager the workers share.
+   * @param predicate     Predicate the records satisfy.
+   * @param morsel_pages  Number of pages in a morsel.
+   */
+  ParallelFileScan(const std::string& name, BufMgr* bufMgr,
+                   const ScanPredicate& predicate,
+                   const std::size_t morsel_pages = DEFAULT_MORSEL_PAGES);
+
+  /**
+   * Flushes the relation's pages from the buffer pool and closes it.
+   */
+  ~ParallelFileScan();
+
+  /**
+   * Returns the number of morsels the relation is split into.
+   */
+  std::size_t num_morsels() const {
+    return (num_pages_ - 1 + morsel_pages_ - 1) / morsel_pages_;
+  }
+
+  /**
+   * Runs the scan, calling visit from the worker threads (concurrently) for
+   * every page with records to return.  Returns once every morsel has been
+   * scanned.  If a worker throws, the remaining morsels are abandoned and the
+   * exception is rethrown here.
+   *
+   * @param num_threads   Number of worker threads; 0 for one per core.
+   * @param visit         Called for each page.
+   * @param finish        If set, called for each morsel claimed once the
+   *                      worker is done with it.
+   */
+  void run(std::size_t num_threads, const PageVisitor& visit,
+           const MorselVisitor& finish = MorselVisitor());
+
+  /**
+   * Makes the workers of a running scan claim no more morsels; those being
+   * scanned are finished.  May be called from any thread.
+   */
+  void stop() { next_morsel_ = num_morsels(); }
+
+ private:
+  ParallelFileScan(const ParallelFileScan&) = delete;
+  ParallelFileScan& operator=(const ParallelFileScan&) = delete;
+
+  /**
+   * Claims and scans morsels until there are none left.
+   */
+  void work(const PageVisitor& visit, const MorselVisitor& finish);
+
+  /**
+   * Visits the pages of a morsel.
+   */
+  void scanMorsel(const std::size_t morsel, PageRecords& records,
+                  const PageVisitor& visit);
+
+  /**
+   * File being scanned; shared by the workers so they share its frames.
+   */
+  PageFile* file_;
+
+  /**
+   * Buffer manager the pages are pinned through.
+   */
+  BufMgr* buf_mgr_;
+
+  /**
+   * Predicate the records satisfy; NULL for all of them.
+   */
+  ScanPredicate* predicate_;
+
+  /**
+   * Number of pages in the file when the scan was opened.
+   */
+  PageId num_pages_;
+
+  /**
+   * Number of pages in a morsel.
+   */
+  std::size_t morsel_pages_;
+
+  /**
+   * Next morsel to hand out.
+   */
+  std::atomic<std::size_t> next_morsel_;
+};
+
+}
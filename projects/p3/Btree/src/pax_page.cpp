@@ -0,0 +1,327 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "pax_page.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "exceptions/bad_page_format_exception.h"
+#include "exceptions/insufficient_space_exception.h"
+#include "exceptions/invalid_record_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Returns <offset> rounded up so that it is aligned to <alignment> relative
+ * to the start of the page rather than of its data area.
+ */
+std::size_t alignInPage(const std::size_t offset, const std::size_t alignment) {
+  const std::size_t in_page = offset + sizeof(PageHeader);
+  return (in_page + alignment - 1) / alignment * alignment - sizeof(PageHeader);
+}
+
+bool byOffset(const PaxAttribute& a, const PaxAttribute& b) {
+  return a.offset < b.offset;
+}
+
+}
+
+PaxPage PaxPage::format(Page* page, const std::uint16_t record_length,
+                        const std::vector<PaxAttribute>& attributes) {
+  const PageId page_number = page->page_number();
+  if (page->header_.num_slots != 0) {
+    throw BadPageFormatException(page_number, "page already holds records");
+  }
+  if (attributes.empty()) {
+    throw BadPageFormatException(page_number, "no attributes given");
+  }
+  std::vector<PaxAttribute> sorted(attributes);
+  std::sort(sorted.begin(), sorted.end(), byOffset);
+  std::size_t attribute_end = 0;
+  std::size_t stored_length = 0;
+  for (std::vector<PaxAttribute>::const_iterator it = sorted.begin();
+       it != sorted.end(); ++it) {
+    if (it->length == 0 || it->offset < attribute_end ||
+        it->offset + it->length > record_length) {
+      throw BadPageFormatException(
+          page_number, "attributes overlap or lie outside the record");
+    }
+    attribute_end = it->offset + it->length;
+    stored_length += it->length;
+  }
+
+  // Start from the capacity the data alone would allow and give up records
+  // until the metadata and alignment padding fit as well.
+  const std::size_t available = page->header_.free_space_upper_bound;
+  std::size_t capacity = available * 8 / (stored_length * 8 + 1);
+  capacity = std::min<std::size_t>(capacity, UINT16_MAX);
+  while (capacity > 0 && layoutSize(attributes, capacity, available) == 0) {
+    --capacity;
+  }
+  if (capacity == 0) {
+    throw BadPageFormatException(page_number, "no record fits in the page");
+  }
+
+  memset(page->data_, '\0', available);
+  Header* header = reinterpret_cast<Header*>(&page->data_[0]);
+  header->magic = MAGIC;
+  header->record_length = record_length;
+  header->num_attributes = attributes.size();
+  header->capacity = capacity;
+  header->num_slots = 0;
+  header->num_records = 0;
+
+  ColumnEntry* columns =
+      reinterpret_cast<ColumnEntry*>(&page->data_[sizeof(Header)]);
+  std::size_t offset = sizeof(Header) + attributes.size() * sizeof(ColumnEntry) +
+      (capacity + 7) / 8;
+  for (std::size_t i = 0; i < attributes.size(); ++i) {
+    offset = alignInPage(offset, COLUMN_ALIGNMENT);
+    columns[i].attribute = attributes[i];
+    columns[i].column_offset = offset;
+    offset += capacity * attributes[i].length;
+  }
+
+  // Leave no room for slotted records so the page reads as full and empty.
+  page->header_.free_space_lower_bound = page->header_.free_space_upper_bound;
+  page->header_.fragmented_bytes = 0;
+  page->header_.num_free_slots = 0;
+  page->header_.first_free_slot = Page::INVALID_SLOT;
+  return PaxPage(page);
+}
+
+bool PaxPage::isFormatted(const Page& page) {
+  const Header* header = reinterpret_cast<const Header*>(&page.data_[0]);
+  return page.header_.num_slots == 0 &&
+      page.header_.free_space_lower_bound ==
+          page.header_.free_space_upper_bound &&
+      page.header_.free_space_upper_bound >= sizeof(Header) &&
+      header->magic == MAGIC;
+}
+
+PaxPage::PaxPage(Page* page)
+    : page_(page) {
+  if (!isFormatted(*page_)) {
+    throw BadPageFormatException(page_->page_number(), "not a PAX page");
+  }
+}
+
+RecordId PaxPage::insertRecord(const std::string& record_data) {
+  if (record_data.length() != record_length()) {
+    throw BadPageFormatException(page_->page_number(),
+                                 "record length does not match the page");
+  }
+  if (!hasSpaceForRecord()) {
+    throw InsufficientSpaceException(page_->page_number(),
+                                     record_data.length(), 0);
+  }
+  const SlotId slot_number = takeSlot();
+  storeRecord(slot_number, record_data);
+  return {page_->page_number(), slot_number};
+}
+
+std::string PaxPage::getRecord(const RecordId& record_id) const {
+  std::string record(record_length(), '\0');
+  getRecord(record_id, &record[0]);
+  return record;
+}
+
+void PaxPage::getRecord(const RecordId& record_id, char* out) const {
+  validateRecordId(record_id);
+  memset(out, '\0', record_length());
+  const ColumnEntry* entries = columns();
+  for (std::uint16_t i = 0; i < num_attributes(); ++i) {
+    const PaxAttribute& attr = entries[i].attribute;
+    memcpy(out + attr.offset,
+           &page_->data_[entries[i].column_offset +
+                         (record_id.slot_number - 1) * attr.length],
+           attr.length);
+  }
+}
+
+void PaxPage::updateRecord(const RecordId& record_id,
+                           const std::string& record_data) {
+  validateRecordId(record_id);
+  if (record_data.length() != record_length()) {
+    throw BadPageFormatException(page_->page_number(),
+                                 "record length does not match the page");
+  }
+  storeRecord(record_id.slot_number, record_data);
+}
+
+void PaxPage::deleteRecord(const RecordId& record_id) {
+  validateRecordId(record_id);
+  const SlotId index = record_id.slot_number - 1;
+  const ColumnEntry* entries = columns();
+  for (std::uint16_t i = 0; i < num_attributes(); ++i) {
+    const std::uint16_t length = entries[i].attribute.length;
+    memset(&page_->data_[entries[i].column_offset + index * length], '\0',
+           length);
+  }
+  releaseSlot(record_id.slot_number);
+}
+
+bool PaxPage::hasSpaceForRecord() const {
+  return num_records() < capacity();
+}
+
+SlotId PaxPage::getNextUsedSlot(const SlotId start) const {
+  const unsigned char* used = bitmap();
+  const std::size_t num_slots = header()->num_slots;
+  std::size_t index = start;
+  while (index < num_slots) {
+    const unsigned char bits = used[index / 8] >> (index % 8);
+    if (bits == 0) {
+      // Nothing used in the rest of this byte.
+      index = (index / 8 + 1) * 8;
+      continue;
+    }
+    if (bits & 1) {
+      return index + 1;
+    }
+    ++index;
+  }
+  return Page::INVALID_SLOT;
+}
+
+void PaxPage::getUsedSlots(std::vector<SlotId>& slots) const {
+  const unsigned char* used = bitmap();
+  const std::size_t num_bytes = (header()->num_slots + 7) / 8;
+  slots.resize(num_records());
+  std::size_t count = 0;
+  for (std::size_t byte = 0; byte < num_bytes; ++byte) {
+    // Peel off the set bits of the byte, lowest first.
+    unsigned int bits = used[byte];
+    while (bits != 0) {
+      slots[count++] = byte * 8 + __builtin_ctz(bits) + 1;
+      bits &= bits - 1;
+    }
+  }
+}
+
+int PaxPage::findAttribute(const std::size_t offset,
+                           const std::size_t length) const {
+  const ColumnEntry* entries = columns();
+  for (std::uint16_t i = 0; i < num_attributes(); ++i) {
+    const PaxAttribute& attr = entries[i].attribute;
+    if (offset >= attr.offset && offset + length <= attr.offset + attr.length) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+const char* PaxPage::column(const std::size_t attribute) const {
+  return &page_->data_[columns()[attribute].column_offset];
+}
+
+const char* PaxPage::getField(const RecordId& record_id,
+                              const std::size_t offset,
+                              const std::size_t length) const {
+  validateRecordId(record_id);
+  const int index = findAttribute(offset, length);
+  if (index < 0) {
+    return NULL;
+  }
+  const PaxAttribute& attr = columns()[index].attribute;
+  return column(index) + (record_id.slot_number - 1) * attr.length +
+      (offset - attr.offset);
+}
+
+PaxAttribute PaxPage::attribute(const std::size_t attribute) const {
+  return columns()[attribute].attribute;
+}
+
+std::size_t PaxPage::layoutSize(const std::vector<PaxAttribute>& attributes,
+                                const std::size_t capacity,
+                                const std::size_t available) {
+  std::size_t size = sizeof(Header) + attributes.size() * sizeof(ColumnEntry) +
+      (capacity + 7) / 8;
+  for (std::vector<PaxAttribute>::const_iterator it = attributes.begin();
+       it != attributes.end(); ++it) {
+    size = alignInPage(size, COLUMN_ALIGNMENT) + capacity * it->length;
+  }
+  return size <= available ? size : 0;
+}
+
+const unsigned char* PaxPage::bitmap() const {
+  return reinterpret_cast<const unsigned char*>(
+      &page_->data_[sizeof(Header) + num_attributes() * sizeof(ColumnEntry)]);
+}
+
+unsigned char* PaxPage::bitmap() {
+  return reinterpret_cast<unsigned char*>(
+      &page_->data_[sizeof(Header) + num_attributes() * sizeof(ColumnEntry)]);
+}
+
+bool PaxPage::isUsed(const SlotId slot_number) const {
+  const SlotId index = slot_number - 1;
+  return (bitmap()[index / 8] >> (index % 8)) & 1;
+}
+
+void PaxPage::validateRecordId(const RecordId& record_id) const {
+  if (record_id.page_number != page_->page_number() ||
+      record_id.slot_number == Page::INVALID_SLOT ||
+      record_id.slot_number > header()->num_slots ||
+      !isUsed(record_id.slot_number)) {
+    throw InvalidRecordException(record_id, page_->page_number());
+  }
+}
+
+SlotId PaxPage::takeSlot() {
+  Header* page_header = header();
+  SlotId slot_number = Page::INVALID_SLOT;
+  if (page_header->num_records < page_header->num_slots) {
+    // Reuse the first hole, skipping full bytes of the bitmap at once.
+    const unsigned char* used = bitmap();
+    std::size_t byte = 0;
+    while (used[byte] == 0xFF) {
+      ++byte;
+    }
+    std::size_t bit = 0;
+    while (used[byte] & (1 << bit)) {
+      ++bit;
+    }
+    slot_number = byte * 8 + bit + 1;
+  } else {
+    slot_number = ++page_header->num_slots;
+  }
+  bitmap()[(slot_number - 1) / 8] |= 1 << ((slot_number - 1) % 8);
+  ++page_header->num_records;
+  return slot_number;
+}
+
+void PaxPage::releaseSlot(const SlotId slot_number) {
+  Header* page_header = header();
+  const SlotId index = slot_number - 1;
+  bitmap()[index / 8] &= ~(1 << (index % 8));
+  --page_header->num_records;
+
+  // Trim unused slots from the end so inserts append again.
+  while (page_header->num_slots > 0 && !isUsed(page_header->num_slots)) {
+    --page_header->num_slots;
+  }
+}
+
+void PaxPage::storeRecord(const SlotId slot_number,
+                          const std::string& record_data) {
+  const ColumnEntry* entries = columns();
+  for (std::uint16_t i = 0; i < num_attributes(); ++i) {
+    const PaxAttribute& attr = entries[i].attribute;
+    memcpy(&page_->data_[entries[i].column_offset +
+                         (slot_number - 1) * attr.length],
+           record_data.data() + attr.offset, attr.length);
+  }
+}
+
+}
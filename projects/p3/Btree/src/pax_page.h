@@ -0,0 +1,319 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Fixed-length field of the records stored in a PAX page.  Also names
+ * the fields a scan projects (see FileScan::setProjection()).
+ */
+struct PaxAttribute {
+  /**
+   * Offset of the field in the record.
+   */
+  std::uint16_t offset;
+
+  /**
+   * Length of the field in bytes.
+   */
+  std::uint16_t length;
+};
+
+/**
+ * @brief PAX (partition attributes across) view of a page.
+ *
+ * A PAX page holds fixed-length records like a slotted page, but stores each
+ * attribute of its records in its own mini-page: the values of one attribute
+ * for all records of the page are contiguous.  A scan that needs a single
+ * attribute therefore reads one run of memory instead of striding over whole
+ * records.  Bytes of a record not covered by any attribute (e.g. struct
+ * padding) are not stored and read back as zeros.
+ *
+ * The layout lives in the data area of an ordinary Page, so PAX pages are
+ * stored in a PageFile and cached by the buffer manager like any other page.
+ * The page describes itself, so a file may mix PAX and slotted pages.  To
+ * the slotted Page interface a PAX page looks empty and full.  Record IDs
+ * keep the page's number and use the record's index in the page, starting at
+ * 1, as the slot number.
+ *
+ * A PaxPage only points to the page it was made from; it does not own it.
+ *
+ * @warning This class is not threadsafe.
+ */
+class PaxPage {
+ public:
+  /**
+   * Lays out an empty page as a PAX page for records of the given format.
+   * The page must be freshly allocated, i.e. hold no records.
+   *
+   * @param page            Page to format.
+   * @param record_length   Length of every record in bytes.
+   * @param attributes      Fields to store; they must lie within the record
+   *                        and must not overlap.
+   * @return  View of the formatted page.
+   * @throws  BadPageFormatException  If the page holds records, the
+   *                                  attributes are invalid or not even one
+   *                                  record fits.
+   */
+  static PaxPage format(Page* page, const std::uint16_t record_length,
+                        const std::vector<PaxAttribute>& attributes);
+
+  /**
+   * Returns true if the page has been formatted as a PAX page.
+   *
+   * @param page  Page to check.
+   * @return  Whether the page is a PAX page.
+   */
+  static bool isFormatted(const Page& page);
+
+  /**
+   * Constructs a view of a page already formatted as a PAX page.
+   *
+   * @param page  PAX page.
+   * @throws  BadPageFormatException  If the page is not a PAX page.
+   */
+  explicit PaxPage(Page* page);
+
+  /**
+   * Inserts a new record into the page.
+   *
+   * @param record_data  Bytes that compose the record.
+   * @return  ID of the newly inserted record.
+   * @throws  BadPageFormatException      If the record has the wrong length.
+   * @throws  InsufficientSpaceException  If the page is full.
+   */
+  RecordId insertRecord(const std::string& record_data);
+
+  /**
+   * Returns a copy of the record with the given ID, reassembled from its
+   * attributes.
+   *
+   * @param record_id  ID of the record to return.
+   * @return  The record.
+   * @throws  InvalidRecordException  If the ID has a bad page or slot number.
+   */
+  std::string getRecord(const RecordId& record_id) const;
+
+  /**
+   * Reassembles the record with the given ID into a caller-provided buffer
+   * of record_length() bytes.
+   *
+   * @param record_id  ID of the record to return.
+   * @param out        Buffer receiving the record.
+   * @throws  InvalidRecordException  If the ID has a bad page or slot number.
+   */
+  void getRecord(const RecordId& record_id, char* out) const;
+
+  /**
+   * Replaces the data of the record with the given ID in place.
+   *
+   * @param record_id   ID of record to update.
+   * @param record_data Updated bytes that compose the record.
+   * @throws  InvalidRecordException  If the ID has a bad page or slot number.
+   * @throws  BadPageFormatException  If the record has the wrong length.
+   */
+  void updateRecord(const RecordId& record_id, const std::string& record_data);
+
+  /**
+   * Deletes the record with the given ID.  Its slot can be reused by a later
+   * insert; the other records do not move.
+   *
+   * @param record_id   ID of the record to delete.
+   * @throws  InvalidRecordException  If the ID has a bad page or slot number.
+   */
+  void deleteRecord(const RecordId& record_id);
+
+  /**
+   * Returns true if the page has room for another record.
+   *
+   * @return  Whether the page can hold another record.
+   */
+  bool hasSpaceForRecord() const;
+
+  /**
+   * Returns the next used slot in the page after the given slot or
+   * Page::INVALID_SLOT if no slots are used after the given slot.
+   *
+   * @param start   Slot to start search at; Page::INVALID_SLOT starts at the
+   *                first slot.
+   * @return  Next used slot after given slot or Page::INVALID_SLOT.
+   */
+  SlotId getNextUsedSlot(const SlotId start) const;
+
+  /**
+   * Returns the numbers of all used slots of the page, read from the bitmap
+   * a byte at a time.
+   *
+   * @param slots   Receives the used slot numbers in ascending order; its
+   *                previous contents are replaced.
+   */
+  void getUsedSlots(std::vector<SlotId>& slots) const;
+
+  /**
+   * Returns the attribute stored at the given offset of a record, i.e. the
+   * attribute whose bytes contain [offset, offset + length).
+   *
+   * @param offset  Offset of the bytes in the record.
+   * @param length  Number of bytes.
+   * @return  Index of the attribute, or -1 if no attribute holds the bytes.
+   */
+  int findAttribute(const std::size_t offset, const std::size_t length) const;
+
+  /**
+   * Returns the mini-page of an attribute.  The value of the record in slot s
+   * starts at column(attribute) + (s - 1) * attribute(attribute).length; only
+   * values of used slots are meaningful.
+   *
+   * @param attribute   Index of the attribute.
+   * @return  First byte of the attribute's values.
+   */
+  const char* column(const std::size_t attribute) const;
+
+  /**
+   * Returns the bytes of a record starting at the given offset of the record
+   * without reassembling it, if one attribute holds all requested bytes.
+   *
+   * @param record_id  ID of the record.
+   * @param offset     Offset of the bytes in the record.
+   * @param length     Number of bytes.
+   * @return  Pointer to the bytes in the page, or NULL if they are not held
+   *          by a single attribute.
+   * @throws  InvalidRecordException  If the ID has a bad page or slot number.
+   */
+  const char* getField(const RecordId& record_id, const std::size_t offset,
+                       const std::size_t length) const;
+
+  /**
+   * Returns the length of the records of the page.
+   */
+  std::uint16_t record_length() const { return header()->record_length; }
+
+  /**
+   * Returns the number of attributes stored per record.
+   */
+  std::uint16_t num_attributes() const { return header()->num_attributes; }
+
+  /**
+   * Returns the attribute with the given index.
+   */
+  PaxAttribute attribute(const std::size_t attribute) const;
+
+  /**
+   * Returns the number of records the page can hold.
+   */
+  std::uint16_t capacity() const { return header()->capacity; }
+
+  /**
+   * Returns the number of records in the page.
+   */
+  std::uint16_t num_records() const { return header()->num_records; }
+
+ private:
+  /**
+   * Layout metadata at the start of the page's data area.  It is followed by
+   * one ColumnEntry per attribute, the bitmap of used slots and the
+   * mini-pages.
+   */
+  struct Header {
+    std::uint16_t magic;
+    std::uint16_t record_length;
+    std::uint16_t num_attributes;
+    std::uint16_t capacity;
+    std::uint16_t num_slots;
+    std::uint16_t num_records;
+  };
+
+  /**
+   * Attribute of the records and where its mini-page starts.
+   */
+  struct ColumnEntry {
+    PaxAttribute attribute;
+    std::uint16_t column_offset;
+  };
+
+  /**
+   * Marks a page's data area as a PAX page.
+   */
+  static const std::uint16_t MAGIC = 0x5850;
+
+  /**
+   * Alignment of the mini-pages in the page.
+   */
+  static const std::size_t COLUMN_ALIGNMENT = 8;
+
+  /**
+   * Returns the number of bytes the layout of a page with the given
+   * attributes and capacity takes, or 0 if it exceeds <available>.
+   */
+  static std::size_t layoutSize(const std::vector<PaxAttribute>& attributes,
+                                const std::size_t capacity,
+                                const std::size_t available);
+
+  const Header* header() const {
+    return reinterpret_cast<const Header*>(&page_->data_[0]);
+  }
+  Header* header() { return reinterpret_cast<Header*>(&page_->data_[0]); }
+
+  const ColumnEntry* columns() const {
+    return reinterpret_cast<const ColumnEntry*>(&page_->data_[sizeof(Header)]);
+  }
+
+  /**
+   * Returns the mini-page of an attribute for writing.
+   */
+  char* columnData(const std::size_t attribute) {
+    return &page_->data_[columns()[attribute].column_offset];
+  }
+
+  const unsigned char* bitmap() const;
+  unsigned char* bitmap();
+
+  bool isUsed(const SlotId slot_number) const;
+
+  /**
+   * Throws an exception if the given record ID does not name a record of
+   * this page.
+   *
+   * @throws  InvalidRecordException  If the ID has a bad page or slot number.
+   */
+  void validateRecordId(const RecordId& record_id) const;
+
+  /**
+   * Marks the first unused slot used and returns it.  The page must have
+   * space for another record.
+   */
+  SlotId takeSlot();
+
+  /**
+   * Marks a used slot unused.
+   */
+  void releaseSlot(const SlotId slot_number);
+
+  /**
+   * Copies the attributes of a record into the mini-pages at a slot.
+   */
+  void storeRecord(const SlotId slot_number, const std::string& record_data);
+
+  /**
+   * Page being viewed.
+   */
+  Page* page_;
+
+  template <std::size_t RECORD_SIZE> friend class FixedPage;
+};
+
+}
@@ -0,0 +1,104 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "relation_loader.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace badgerdb {
+
+RelationLoader::RelationLoader(PageFile* file,
+                               const std::uint16_t record_length,
+                               const std::vector<PaxAttribute>& attributes)
+    : file_(file),
+      record_length_(record_length),
+      attributes_(attributes),
+      page_(Page::allocate(file->page_size())),
+      page_number_(Page::INVALID_NUMBER),
+      dirty_(false),
+      num_pages_(0) {
+}
+
+RelationLoader::~RelationLoader() {
+  try {
+    flush();
+  } catch (...) {
+  }
+}
+
+RecordId RelationLoader::insertRecord(const std::string& record_data) {
+  if (!fits(record_data)) {
+    nextPage();
+  }
+  dirty_ = true;
+  if (!attributes_.empty()) {
+    return PaxPage(page_.get()).insertRecord(record_data);
+  }
+  // Throws if the record does not fit even in the empty page.
+  return page_->insertRecord(record_data);
+}
+
+void RelationLoader::insertRecords(const std::vector<std::string>& records,
+                                   std::vector<RecordId>* record_ids) {
+  if (!attributes_.empty()) {
+    for (std::vector<std::string>::const_iterator it = records.begin();
+         it != records.end(); ++it) {
+      const RecordId record_id = insertRecord(*it);
+      if (record_ids != NULL) {
+        record_ids->push_back(record_id);
+      }
+    }
+    return;
+  }
+
+  std::size_t next = 0;
+  while (next < records.size()) {
+    if (!fits(records[next])) {
+      nextPage();
+    }
+    const std::size_t inserted =
+        page_->insertRecords(records, next, record_ids);
+    if (inserted == 0) {
+      // Not even an empty page holds the record; let the page say so.
+      page_->insertRecord(records[next]);
+    }
+    dirty_ = true;
+    next += inserted;
+  }
+}
+
+void RelationLoader::flush() {
+  if (dirty_) {
+    file_->writePage(page_number_, *page_);
+    dirty_ = false;
+  }
+}
+
+bool RelationLoader::fits(const std::string& record_data) {
+  if (page_number_ == Page::INVALID_NUMBER) {
+    return false;
+  }
+  if (!attributes_.empty()) {
+    return PaxPage(page_.get()).hasSpaceForRecord();
+  }
+  return page_->hasSpaceForRecord(record_data);
+}
+
+void RelationLoader::nextPage() {
+  flush();
+  // Only the file's page size bytes of the new page are copied.
+  const Page page = file_->allocatePage(page_number_);
+  memcpy(page_.get(), &page, file_->page_size());
+  ++num_pages_;
+  if (!attributes_.empty()) {
+    PaxPage::format(page_.get(), record_length_, attributes_);
+  }
+}
+
+}
@@ -0,0 +1,132 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "file.h"
+#include "page.h"
+#include "pax_page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Appends records to a relation file, filling each page before
+ *        allocating the next.
+ *
+ * The loader keeps the page being filled in memory and writes it to the file
+ * once it is full, on flush() or when the loader is destroyed.  A destructor
+ * cannot report a failed write, so callers call flush() after the last
+ * record to see write errors.  Whether a record fits is checked up front, so
+ * loading needs no exception handling per page.  Pages are written straight
+ * to the file, bypassing the buffer manager, so the relation should not be
+ * cached while it is loaded.
+ *
+ * By default pages are slotted pages; given attributes, the loader formats
+ * every page it allocates as a PAX page (see PaxPage) instead.
+ */
+class RelationLoader {
+ public:
+  /**
+   * Constructs a loader appending to the given file.
+   *
+   * @param file            File to append records to.
+   * @param record_length   Length of every record if pages are PAX pages.
+   * @param attributes      Attributes of the records for PAX pages; if empty,
+   *                        slotted pages are used.
+   */
+  RelationLoader(PageFile* file, const std::uint16_t record_length = 0,
+                 const std::vector<PaxAttribute>& attributes =
+                     std::vector<PaxAttribute>());
+
+  /**
+   * Writes the page being filled to the file if flush() has not, dropping any
+   * error.
+   */
+  ~RelationLoader();
+
+  /**
+   * Appends a record to the relation.
+   *
+   * @param record_data  Bytes that compose the record.
+   * @return  ID of the inserted record.
+   * @throws  InsufficientSpaceException  If the record does not fit even in
+   *                                      an empty page.
+   */
+  RecordId insertRecord(const std::string& record_data);
+
+  /**
+   * Appends records to the relation, packing each page with as many of them
+   * as fit.
+   *
+   * @param records     Records to insert.
+   * @param record_ids  If not NULL, receives the IDs of the inserted records.
+   * @throws  InsufficientSpaceException  If a record does not fit even in an
+   *                                      empty page.
+   */
+  void insertRecords(const std::vector<std::string>& records,
+                     std::vector<RecordId>* record_ids = NULL);
+
+  /**
+   * Writes the page being filled to the file.  Later records still go to the
+   * same page while it has space.
+   *
+   * @throws  FileIOException  If the page cannot be written.
+   */
+  void flush();
+
+  /**
+   * Returns the number of pages the loader has allocated.
+   */
+  std::uint32_t num_pages() const { return num_pages_; }
+
+ private:
+  RelationLoader(const RelationLoader&);
+  RelationLoader& operator=(const RelationLoader&);
+
+  /**
+   * Returns true if a page is being filled and the record fits in it.
+   */
+  bool fits(const std::string& record_data);
+
+  /**
+   * Writes out the page being filled and allocates the next one.
+   */
+  void nextPage();
+
+  /**
+   * File records are appended to.
+   */
+  PageFile* file_;
+
+  /**
+   * Record length and attributes for PAX pages; no attributes for slotted
+   * pages.
+   */
+  std::uint16_t record_length_;
+  std::vector<PaxAttribute> attributes_;
+
+  /**
+   * Page being filled, its number, and whether it has records not yet
+   * written to the file.
+   */
+  PageBuffer page_;
+  PageId page_number_;
+  bool dirty_;
+
+  /**
+   * Number of pages allocated so far.
+   */
+  std::uint32_t num_pages_;
+};
+
+}
@@ -0,0 +1,72 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "sample_scan.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+
+#include "exceptions/invalid_page_exception.h"
+
+namespace badgerdb {
+
+SampleScan::SampleScan(const std::string& name, BufMgr* bufMgr,
+                       const double fraction, const std::uint32_t seed)
+    : file_(new PageFile(name, false /* create_new */)),
+      buf_mgr_(bufMgr),
+      num_pages_(file_->getNumPages() - 1) {
+  if (num_pages_ == 0) {
+    return;
+  }
+  PageId sample_size = static_cast<PageId>(std::ceil(fraction * num_pages_));
+  sample_size = std::min(std::max<PageId>(sample_size, 1), num_pages_);
+
+  // Floyd's algorithm draws sample_size distinct page numbers uniformly in
+  // as many steps, without listing every page of the file: step j adds a
+  // number from 1..j, or j itself if the pick was drawn before.
+  std::set<PageId> drawn;
+  std::mt19937 random(seed);
+  for (PageId j = num_pages_ - sample_size + 1; j <= num_pages_; ++j) {
+    std::uniform_int_distribution<PageId> pick(1, j);
+    if (!drawn.insert(pick(random)).second) {
+      drawn.insert(j);
+    }
+  }
+  pages_.assign(drawn.begin(), drawn.end());
+}
+
+SampleScan::~SampleScan() {
+  buf_mgr_->flushFile(file_);
+  delete file_;
+}
+
+void SampleScan::run(const PageVisitor& visit) {
+  PageRecords records;
+  for (std::size_t i = 0; i < pages_.size(); ++i) {
+    Page* page;
+    try {
+      buf_mgr_->readPage(file_, pages_[i], page);
+    } catch (const InvalidPageException&) {
+      // A free page; it holds no records.
+      continue;
+    }
+    try {
+      records.load(page);
+      if (records.size() > 0) {
+        visit(records);
+      }
+    } catch (...) {
+      buf_mgr_->unPinPage(file_, pages_[i], false);
+      throw;
+    }
+    buf_mgr_->unPinPage(file_, pages_[i], false);
+  }
+}
+
+}
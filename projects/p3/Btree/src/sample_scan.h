@@ -0,0 +1,105 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "buffer.h"
+#include "file.h"
+#include "filescan.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Scans the records of a random subset of the pages of a relation.
+ *
+ * Page numbers are drawn uniformly without replacement from the whole file
+ * and read in increasing order through the buffer manager, so a sample of a
+ * few pages costs a few reads however large the relation is.  Every record of
+ * a sampled page is returned (block sampling).  A number drawn for a free
+ * page yields no records, so scaling the records seen by
+ * num_pages() / pages_sampled() estimates the records in the relation.
+ *
+ * The relation must not be modified during the scan.
+ */
+class SampleScan {
+ public:
+  /**
+   * Called for each sampled page with records; the page stays pinned until
+   * the call returns.
+   *
+   * @param records   Records of the page.
+   */
+  typedef std::function<void(PageRecords& records)> PageVisitor;
+
+  /**
+   * Draws a sample of the pages of the given relation.
+   *
+   * @param name      Name of relation file.
+   * @param bufMgr    Buffer manager to read pages through.
+   * @param fraction  Fraction of the pages to sample; at least one page is
+   *                  sampled from a non-empty file, and 1 reads every page.
+   * @param seed      Seed of the random page choice.
+   */
+  SampleScan(const std::string& name, BufMgr* bufMgr, const double fraction,
+             const std::uint32_t seed = 1);
+
+  /**
+   * Flushes the relation's pages from the buffer pool and closes it.
+   */
+  ~SampleScan();
+
+  /**
+   * Calls visit for each sampled page with records, in page number order.
+   *
+   * @param visit   Called for each page.
+   */
+  void run(const PageVisitor& visit);
+
+  /**
+   * Returns the number of page numbers the sample was drawn from.
+   */
+  PageId num_pages() const { return num_pages_; }
+
+  /**
+   * Returns the number of page numbers drawn.
+   */
+  PageId pages_sampled() const {
+    return static_cast<PageId>(pages_.size());
+  }
+
+ private:
+  SampleScan(const SampleScan&) = delete;
+  SampleScan& operator=(const SampleScan&) = delete;
+
+  /**
+   * File being scanned.
+   */
+  PageFile* file_;
+
+  /**
+   * Buffer manager the pages are pinned through.
+   */
+  BufMgr* buf_mgr_;
+
+  /**
+   * Number of pages in the file, not counting the header page.
+   */
+  PageId num_pages_;
+
+  /**
+   * Page numbers drawn, in increasing order.
+   */
+  std::vector<PageId> pages_;
+};
+
+}
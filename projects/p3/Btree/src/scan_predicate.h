@@ -0,0 +1,208 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "exceptions/bad_scan_param_exception.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Comparison of one attribute of a record with a constant.
+ *
+ * The attribute is given by its byte offset in the record and its type, and
+ * the comparison is made on the attribute's bytes where they lie, so a
+ * FileScan can test records on the pinned page without copying them.
+ * Integers and doubles are compared by value; strings are compared like
+ * strncmp() over the attribute length.
+ */
+class ScanPredicate {
+ public:
+  /**
+   * Constructs a predicate testing <attribute> <op> <value>.
+   *
+   * @param offset  Byte offset of the attribute in the record.
+   * @param type    Type of the attribute.
+   * @param op      Comparison to make.
+   * @param value   Constant to compare with; an int, a double or a string of
+   *                at most <length> characters, depending on type.
+   * @param length  Length of a STRING attribute; ignored for other types.
+   * @throws  BadScanParamException If type is STRING and length is 0.
+   */
+  ScanPredicate(const std::size_t offset, const Datatype type,
+                const Operator op, const void* value,
+                const std::size_t length = 0)
+      : offset_(offset),
+        type_(type),
+        op_(op) {
+    switch (type_) {
+      case INTEGER:
+        length_ = sizeof(int);
+        value_.assign(static_cast<const char*>(value), length_);
+        break;
+      case DOUBLE:
+        length_ = sizeof(double);
+        value_.assign(static_cast<const char*>(value), length_);
+        break;
+      default:
+        if (length == 0) {
+          throw BadScanParamException();
+        }
+        // The string may be shorter than the attribute; pad it with NULs.
+        length_ = length;
+        value_.assign(length_, '\0');
+        strncpy(&value_[0], static_cast<const char*>(value), length_);
+        break;
+    }
+  }
+
+  /**
+   * Returns true if the attribute starting at the given bytes satisfies the
+   * predicate.
+   *
+   * @param attribute   First byte of the attribute; need not be aligned.
+   */
+  bool matches(const char* attribute) const {
+    const int cmp = compare(type_, attribute, value_.data(), length_);
+    switch (op_) {
+      case LT:
+        return cmp < 0;
+      case LTE:
+        return cmp <= 0;
+      case GTE:
+        return cmp >= 0;
+      case GT:
+        return cmp > 0;
+      case EQ:
+        return cmp == 0;
+      default:
+        return cmp != 0;
+    }
+  }
+
+  /**
+   * Compares two attribute values the way a predicate does.
+   *
+   * @param type    Type of the values.
+   * @param lhs     First byte of the first value; need not be aligned.
+   * @param rhs     First byte of the second value; need not be aligned.
+   * @param length  Length of STRING values; ignored for other types.
+   * @return  Negative, zero or positive as lhs is less than, equal to or
+   *          greater than rhs.
+   */
+  static int compare(const Datatype type, const char* lhs, const char* rhs,
+                     const std::size_t length) {
+    switch (type) {
+      case INTEGER: {
+        int a, b;
+        std::memcpy(&a, lhs, sizeof(int));
+        std::memcpy(&b, rhs, sizeof(int));
+        return (a > b) - (a < b);
+      }
+      case DOUBLE: {
+        double a, b;
+        std::memcpy(&a, lhs, sizeof(double));
+        std::memcpy(&b, rhs, sizeof(double));
+        return (a > b) - (a < b);
+      }
+      default:
+        return strncmp(lhs, rhs, length);
+    }
+  }
+
+  /**
+   * Returns a 64-bit hash of an attribute value that agrees with compare():
+   * values that compare equal hash equal.  Strings are hashed up to their
+   * first NUL.
+   *
+   * @param type    Type of the value.
+   * @param value   First byte of the value; need not be aligned.
+   * @param length  Length of a STRING value; ignored for other types.
+   */
+  static std::uint64_t hash(const Datatype type, const char* value,
+                            std::size_t length) {
+    double zero = 0;
+    switch (type) {
+      case INTEGER:
+        length = sizeof(int);
+        break;
+      case DOUBLE: {
+        // -0.0 equals 0.0, so both hash as 0.0.
+        double v;
+        std::memcpy(&v, value, sizeof(double));
+        if (v == 0) {
+          value = reinterpret_cast<const char*>(&zero);
+        }
+        length = sizeof(double);
+        break;
+      }
+      default: {
+        const void* end = std::memchr(value, '\0', length);
+        if (end != NULL) {
+          length = static_cast<const char*>(end) - value;
+        }
+        break;
+      }
+    }
+    // FNV-1a, then a finalizer so every bit depends on every byte.
+    std::uint64_t h = 14695981039346656037ULL;
+    for (std::size_t i = 0; i < length; ++i) {
+      h ^= static_cast<unsigned char>(value[i]);
+      h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  /**
+   * Returns the byte offset of the attribute in the record.
+   */
+  std::size_t offset() const { return offset_; }
+
+  /**
+   * Returns the length in bytes of the attribute.
+   */
+  std::size_t length() const { return length_; }
+
+ private:
+  /**
+   * Byte offset of the attribute in the record.
+   */
+  std::size_t offset_;
+
+  /**
+   * Length in bytes of the attribute.
+   */
+  std::size_t length_;
+
+  /**
+   * Type of the attribute.
+   */
+  Datatype type_;
+
+  /**
+   * Comparison made.
+   */
+  Operator op_;
+
+  /**
+   * Bytes of the constant compared with.
+   */
+  std::string value_;
+};
+
+}
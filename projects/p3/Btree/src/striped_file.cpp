@@ -0,0 +1,318 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "striped_file.h"
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "exceptions/bad_stripe_layout_exception.h"
+#include "exceptions/invalid_page_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Upper bounds guarding against reading a damaged directory.
+ */
+const std::uint32_t MAX_STRIPES = 1024;
+const std::uint32_t MAX_STRIPE_NAME = 4096;
+
+}
+
+StripedFile StripedFile::create(const std::string& filename,
+                                const std::vector<std::string>& stripes,
+                                const std::uint32_t extent_pages,
+                                const std::size_t page_size) {
+  return StripedFile(filename, true /* create_new */, stripes, extent_pages,
+                     page_size);
+}
+
+StripedFile StripedFile::open(const std::string& filename) {
+  return StripedFile(filename, false /* create_new */);
+}
+
+std::vector<std::string> StripedFile::stripeFilenames(
+    const std::string& filename) {
+  std::vector<std::string> names;
+  std::uint32_t extent_pages;
+  std::shared_ptr<FileHandle> handle = FileHandle::open(filename, false);
+  readDirectory(*handle, names, extent_pages);
+  return names;
+}
+
+const std::string& StripedFile::checkLayout(
+    const std::string& name, const bool create_new,
+    const std::vector<std::string>& stripes, const std::uint32_t extent_pages) {
+  if (create_new) {
+    if (stripes.empty() || stripes.size() > MAX_STRIPES) {
+      throw BadStripeLayoutException(name, "unsupported number of stripes");
+    }
+    if (extent_pages == 0) {
+      throw BadStripeLayoutException(name, "extents must hold at least a page");
+    }
+  }
+  return name;
+}
+
+StripedFile::StripedFile(const std::string& name, const bool create_new,
+                         const std::vector<std::string>& stripes,
+                         const std::uint32_t extent_pages,
+                         const std::size_t page_size)
+    : File(checkLayout(name, create_new, stripes, extent_pages), create_new,
+           page_size),
+      extent_pages_(extent_pages) {
+  if (create_new) {
+    createStripes(stripes);
+  } else {
+    openStripes();
+  }
+}
+
+StripedFile::StripedFile(const StripedFile& other)
+    : File(other.filename_, false /* create_new */),
+      extent_pages_(other.extent_pages_),
+      stripes_(other.stripes_) {
+}
+
+StripedFile& StripedFile::operator=(const StripedFile& rhs) {
+  // This accounts for self-assignment and assignment of a File object for the
+  // same file.
+  close();
+  filename_ = rhs.filename_;
+  page_size_ = rhs.page_size_;
+  extent_pages_ = rhs.extent_pages_;
+  stripes_ = rhs.stripes_;
+  openIfNeeded(false /* create_new */);
+  return *this;
+}
+
+StripedFile::~StripedFile() {
+}
+
+void StripedFile::createStripes(const std::vector<std::string>& stripes) {
+  FileHeader header = readHeader();
+  header.flags |= FileHeader::STRIPED;
+  writeHeader(header);
+
+  const StripeDirectory directory = {
+      static_cast<std::uint32_t>(stripes.size()), extent_pages_};
+  std::uint64_t position = sizeof(FileHeader);
+  handle_->write(reinterpret_cast<const char*>(&directory),
+                 sizeof(StripeDirectory), position);
+  position += sizeof(StripeDirectory);
+  for (std::size_t i = 0; i < stripes.size(); ++i) {
+    const std::uint32_t length = static_cast<std::uint32_t>(stripes[i].size());
+    handle_->write(reinterpret_cast<const char*>(&length), sizeof(length),
+                   position);
+    position += sizeof(length);
+    handle_->write(stripes[i].data(), length, position);
+    position += length;
+  }
+
+  try {
+    for (std::size_t i = 0; i < stripes.size(); ++i) {
+      stripes_.push_back(FileHandle::open(stripes[i], true /* create_new */));
+    }
+  } catch (...) {
+    // Leave nothing behind from the failed creation.
+    const std::size_t created = stripes_.size();
+    stripes_.clear();
+    for (std::size_t i = 0; i < created; ++i) {
+      std::remove(stripes[i].c_str());
+    }
+    close();
+    std::remove(filename_.c_str());
+    throw;
+  }
+}
+
+void StripedFile::openStripes() {
+  std::vector<std::string> names;
+  try {
+    if (!readDirectory(*handle_, names, extent_pages_)) {
+      throw BadStripeLayoutException(filename_, "not a striped file");
+    }
+    for (std::size_t i = 0; i < names.size(); ++i) {
+      stripes_.push_back(FileHandle::open(names[i], false /* create_new */));
+    }
+  } catch (...) {
+    stripes_.clear();
+    close();
+    throw;
+  }
+}
+
+bool StripedFile::readDirectory(const FileHandle& handle,
+                                std::vector<std::string>& names,
+                                std::uint32_t& extent_pages) {
+  // Only a well-formed header of a striped file is trusted to name stripe
+  // files; File::remove() deletes whatever files it names.
+  const std::uint64_t size = handle.size();
+  if (size < sizeof(FileHeader) + sizeof(StripeDirectory)) {
+    return false;
+  }
+  FileHeader header;
+  handle.read(reinterpret_cast<char*>(&header), sizeof(FileHeader),
+              0 /* offset */);
+  if (header.flags != FileHeader::STRIPED ||
+      !Page::isValidSize(header.page_size) ||
+      header.num_pages == Page::INVALID_NUMBER ||
+      header.num_free_pages >= header.num_pages) {
+    return false;
+  }
+
+  StripeDirectory directory;
+  std::uint64_t position = sizeof(FileHeader);
+  handle.read(reinterpret_cast<char*>(&directory), sizeof(StripeDirectory),
+              position);
+  position += sizeof(StripeDirectory);
+  if (directory.stripe_count == 0 || directory.stripe_count > MAX_STRIPES ||
+      directory.extent_pages == 0) {
+    throw BadStripeLayoutException(handle.filename(), "damaged directory");
+  }
+
+  names.clear();
+  for (std::uint32_t i = 0; i < directory.stripe_count; ++i) {
+    std::uint32_t length;
+    handle.read(reinterpret_cast<char*>(&length), sizeof(length), position);
+    position += sizeof(length);
+    if (length == 0 || length > MAX_STRIPE_NAME || position + length > size) {
+      throw BadStripeLayoutException(handle.filename(), "damaged directory");
+    }
+    std::string name(length, '\0');
+    handle.read(&name[0], length, position);
+    position += length;
+    if (name.find('\0') != std::string::npos) {
+      throw BadStripeLayoutException(handle.filename(), "damaged directory");
+    }
+    names.push_back(name);
+  }
+  extent_pages = directory.extent_pages;
+  return true;
+}
+
+std::size_t StripedFile::stripeOf(const PageId page_number) const {
+  const std::uint64_t extent = (page_number - 1) / extent_pages_;
+  return extent % stripes_.size();
+}
+
+std::uint64_t StripedFile::stripePosition(const PageId page_number) const {
+  const std::uint64_t index = page_number - 1;
+  const std::uint64_t extent = index / extent_pages_;
+  const std::uint64_t local_index =
+      (extent / stripes_.size()) * extent_pages_ + index % extent_pages_;
+  return local_index * page_size_;
+}
+
+std::uint64_t StripedFile::pagesOnStripe(const std::size_t stripe,
+                                         const PageId num_pages) const {
+  // Page numbers start at 1; num_pages counts the header as well.
+  const std::uint64_t pages = num_pages - 1;
+  const std::uint64_t full_extents = pages / extent_pages_;
+  const std::uint64_t count = stripes_.size();
+  std::uint64_t result = (full_extents / count) * extent_pages_;
+  if (stripe < full_extents % count) {
+    result += extent_pages_;
+  } else if (stripe == full_extents % count) {
+    result += pages % extent_pages_;
+  }
+  return result;
+}
+
+FileHandle& StripedFile::stripeHandle(const PageId page_number) const {
+  if (page_number == Page::INVALID_NUMBER) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  return *stripes_[stripeOf(page_number)];
+}
+
+Page StripedFile::allocatePage(PageId &new_page_number) {
+  std::lock_guard<FileHandle> guard(*handle_);
+  FileHeader header = readHeader();
+  Page new_page;
+
+  if (header.num_free_pages > 0) {
+    // Reuse the most recently deleted page.
+    new_page_number = header.first_free_page;
+    header.first_free_page = nextFreePage(new_page_number);
+    --header.num_free_pages;
+  } else {
+    new_page_number = header.num_pages;
+    ++header.num_pages;
+  }
+  new_page.initialize(page_size_);
+
+  if (header.first_used_page == Page::INVALID_NUMBER) {
+    header.first_used_page = new_page_number;
+  }
+
+  new_page.set_page_number(new_page_number);
+  writePage(new_page_number, new_page);
+  writeHeader(header);
+
+  return new_page;
+}
+
+void StripedFile::readPageInto(const PageId page_number, Page* page) const {
+  stripeHandle(page_number).read(reinterpret_cast<char*>(page), page_size_,
+                                 stripePosition(page_number));
+}
+
+void StripedFile::writePage(const PageId page_number, const Page& new_page) {
+  stripeHandle(page_number).write(reinterpret_cast<const char*>(&new_page),
+                                  page_size_, stripePosition(page_number));
+}
+
+void StripedFile::deletePage(const PageId page_number) {
+  std::lock_guard<FileHandle> guard(*handle_);
+  FileHeader header = readHeader();
+  if (page_number == Page::INVALID_NUMBER || page_number >= header.num_pages) {
+    throw InvalidPageException(page_number, filename_);
+  }
+
+  // Push the page onto the free list and drop everything but the link.
+  setNextFreePage(page_number, header.first_free_page);
+  header.first_free_page = page_number;
+  ++header.num_free_pages;
+  stripeHandle(page_number).punchHole(stripePosition(page_number) + sizeof(PageId),
+                                      page_size_ - sizeof(PageId));
+  if (page_number == header.num_pages - 1) {
+    releaseFreeTail(header);
+  }
+  writeHeader(header);
+}
+
+PageId StripedFile::nextFreePage(const PageId page_number) const {
+  PageId next;
+  stripeHandle(page_number).read(reinterpret_cast<char*>(&next),
+                                 sizeof(PageId), stripePosition(page_number));
+  return next;
+}
+
+void StripedFile::setNextFreePage(const PageId page_number, const PageId next) {
+  stripeHandle(page_number).write(reinterpret_cast<const char*>(&next),
+                                  sizeof(PageId), stripePosition(page_number));
+}
+
+void StripedFile::sync() {
+  File::sync();
+  for (std::size_t i = 0; i < stripes_.size(); ++i) {
+    stripes_[i]->sync();
+  }
+}
+
+void StripedFile::truncatePages(const PageId num_pages) {
+  for (std::size_t i = 0; i < stripes_.size(); ++i) {
+    stripes_[i]->truncate(pagesOnStripe(i, num_pages) * page_size_);
+  }
+}
+
+}
@@ -0,0 +1,268 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "file.h"
+#include "file_handle.h"
+
+namespace badgerdb {
+
+/**
+ * @brief File of raw page images spread over several stripe files.
+ *
+ * A striped file presents one PageId space, like a BlobFile, but stores its
+ * pages in N stripe files that may live on different devices.  Pages are
+ * dealt out in extents of extent_pages() consecutive pages: extent k goes to
+ * stripe k mod N.  An extent of one page gives plain round-robin striping.
+ *
+ * The file named by filename() holds only the file header and the stripe
+ * directory (the extent size and the stripe file names); the stripe files
+ * hold nothing but pages.  File::remove() deletes the stripe files along with
+ * the directory file.  Every stripe has its own FileHandle, so concurrent
+ * readers and writers of different stripes do not share an I/O queue.
+ */
+class StripedFile : public File {
+ public:
+  /**
+   * Creates a new striped file.
+   *
+   * @param filename      Name of the directory file.
+   * @param stripes       Names of the stripe files to create.
+   * @param extent_pages  Number of consecutive pages placed on a stripe
+   *                      before moving on to the next one.
+   * @param page_size     Size in bytes of the pages of the file.
+   * @throws  FileExistsException       If the file or a stripe file already
+   *                                    exists.
+   * @throws  BadStripeLayoutException  If no stripes are given or
+   *                                    extent_pages is zero.
+   * @throws  BadPageSizeException      If the page size is not supported.
+   */
+  static StripedFile create(const std::string& filename,
+                            const std::vector<std::string>& stripes,
+                            const std::uint32_t extent_pages = 1,
+                            const std::size_t page_size = Page::DEFAULT_SIZE);
+
+  /**
+   * Opens an existing striped file and all of its stripes.
+   *
+   * @param filename  Name of the directory file.
+   * @throws  FileNotFoundException     If the file or a stripe file doesn't
+   *                                    exist.
+   * @throws  BadStripeLayoutException  If the file is not a striped file.
+   */
+  static StripedFile open(const std::string& filename);
+
+  /**
+   * Returns the names of the stripe files of a striped file, or nothing if
+   * the file is not striped.
+   *
+   * @param filename  Name of the file.
+   * @return  Names of the stripe files.
+   */
+  static std::vector<std::string> stripeFilenames(const std::string& filename);
+
+  /**
+   * Constructs a file object representing a striped file on the filesystem.
+   *
+   * @param name          Name of the directory file.
+   * @param create_new    Whether to create a new file.
+   * @param stripes       Names of the stripe files if the file is created.
+   * @param extent_pages  Extent size in pages if the file is created.
+   * @param page_size     Page size of the file if it is created.
+   * @throws  FileExistsException       If the underlying file exists and
+   *                                    create_new is true.
+   * @throws  FileNotFoundException     If the underlying file doesn't exist
+   *                                    and create_new is false.
+   * @throws  BadStripeLayoutException  If the layout is unusable.
+   */
+  StripedFile(const std::string& name, const bool create_new,
+              const std::vector<std::string>& stripes =
+                  std::vector<std::string>(),
+              const std::uint32_t extent_pages = 1,
+              const std::size_t page_size = Page::DEFAULT_SIZE);
+
+  /**
+   * Copy constructor.
+   *
+   * @param other File object to copy.
+   * @return      A copy of the File object.
+   */
+  StripedFile(const StripedFile& other);
+
+  /**
+   * Assignment operator.
+   *
+   * @param rhs File object to assign.
+   * @return    Newly assigned file object.
+   */
+  StripedFile& operator=(const StripedFile& rhs);
+
+  /**
+   * Destructor that automatically closes the underlying files if no other
+   * File objects are using them.
+   */
+  ~StripedFile();
+
+  /**
+   * Allocates a new page in the file.
+   *
+   * @return The new page.
+   */
+  Page allocatePage(PageId &new_page_number);
+
+  /**
+   * Reads an existing page from the file straight into the given page.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Page to read into.
+   * @throws  InvalidPageException  If the page number is invalid.
+   */
+  void readPageInto(const PageId page_number, Page* page) const;
+
+  /**
+   * Writes a page into the file at the given page number.
+   * No bounds checking is performed.
+   *
+   * @param page_number Number of page whose contents to replace.
+   * @param new_page    Page to write.
+   */
+  void writePage(const PageId page_number, const Page& new_page);
+
+  /**
+   * Deletes a page from the file.  The page number is reused by a later
+   * allocatePage().
+   *
+   * @param page_number   Number of page to delete.
+   * @throws  InvalidPageException  If the page doesn't exist in the file.
+   */
+  void deletePage(const PageId page_number);
+
+  /**
+   * Forces the directory and every stripe to stable storage.
+   */
+  void sync();
+
+  /**
+   * Returns the number of stripes the pages are spread over.
+   */
+  std::size_t stripe_count() const { return stripes_.size(); }
+
+  /**
+   * Returns the number of consecutive pages placed on one stripe.
+   */
+  std::uint32_t extent_pages() const { return extent_pages_; }
+
+  /**
+   * Returns the stripe holding the given page.
+   *
+   * @param page_number   Number of page.
+   * @return  Index of the stripe, in the order the stripes were given.
+   */
+  std::size_t stripeOf(const PageId page_number) const;
+
+ private:
+  /**
+   * @brief Stripe directory stored after the file header.
+   */
+  struct StripeDirectory {
+    /**
+     * Number of stripe files; their names follow, each as a 32-bit length
+     * and the characters of the name.
+     */
+    std::uint32_t stripe_count;
+
+    /**
+     * Number of consecutive pages placed on one stripe.
+     */
+    std::uint32_t extent_pages;
+  };
+
+  /**
+   * Reads the stripe directory and opens the stripe files.
+   */
+  void openStripes();
+
+  /**
+   * Writes the stripe directory and creates the stripe files.  If a stripe
+   * file cannot be created, the files created so far are removed again.
+   *
+   * @param stripes   Names of the stripe files.
+   */
+  void createStripes(const std::vector<std::string>& stripes);
+
+  /**
+   * Reads the stripe file names and the extent size from a directory file.
+   *
+   * @param handle        Handle of the directory file.
+   * @param names         Receives the stripe file names.
+   * @param extent_pages  Receives the extent size.
+   * @return  False if the file is not a striped file.
+   * @throws  BadStripeLayoutException  If the directory is damaged.
+   */
+  static bool readDirectory(const FileHandle& handle,
+                            std::vector<std::string>& names,
+                            std::uint32_t& extent_pages);
+
+  /**
+   * Checks the layout requested for a new striped file.
+   *
+   * @return  The name of the file.
+   * @throws  BadStripeLayoutException  If the layout is unusable.
+   */
+  static const std::string& checkLayout(const std::string& name,
+                                        const bool create_new,
+                                        const std::vector<std::string>& stripes,
+                                        const std::uint32_t extent_pages);
+
+  /**
+   * Returns the position of a page within its stripe file.
+   *
+   * @param page_number   Number of page.
+   * @return  Offset of the page from the beginning of its stripe file.
+   */
+  std::uint64_t stripePosition(const PageId page_number) const;
+
+  /**
+   * Returns the number of pages of a file of num_pages pages (including the
+   * header) that live on the given stripe.
+   */
+  std::uint64_t pagesOnStripe(const std::size_t stripe,
+                              const PageId num_pages) const;
+
+  /**
+   * Returns the handle of the stripe holding the given page.
+   *
+   * @param page_number   Number of page.
+   * @throws  InvalidPageException  If the page number is invalid.
+   */
+  FileHandle& stripeHandle(const PageId page_number) const;
+
+  /**
+   * Free pages store the number of the next free page in their first bytes.
+   */
+  PageId nextFreePage(const PageId page_number) const;
+  void setNextFreePage(const PageId page_number, const PageId next);
+  void truncatePages(const PageId num_pages);
+
+  /**
+   * Number of consecutive pages placed on one stripe.
+   */
+  std::uint32_t extent_pages_;
+
+  /**
+   * Handles of the stripe files.
+   */
+  std::vector<std::shared_ptr<FileHandle> > stripes_;
+};
+
+}
@@ -0,0 +1,410 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "table_statistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "exceptions/bad_scan_param_exception.h"
+#include "exceptions/bad_statistics_file_exception.h"
+#include "file.h"
+#include "file_handle.h"
+#include "pax_page.h"
+#include "sample_scan.h"
+#include "scan_predicate.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Magic number at the start of a statistics file.
+ */
+const std::uint32_t STATISTICS_MAGIC = 0x41545342;
+
+/**
+ * Number of hash bits choosing the sketch register.
+ */
+const int SKETCH_INDEX_BITS = 10;
+
+/**
+ * Returns the length in bytes of an attribute of the given type.
+ */
+std::size_t attributeLength(const Datatype type, const std::size_t length) {
+  switch (type) {
+    case INTEGER:
+      return sizeof(int);
+    case DOUBLE:
+      return sizeof(double);
+    default:
+      return length;
+  }
+}
+
+/**
+ * Returns a numeric attribute value as a double.
+ */
+double toDouble(const Datatype type, const char* value) {
+  if (type == INTEGER) {
+    int v;
+    std::memcpy(&v, value, sizeof(int));
+    return v;
+  }
+  double v;
+  std::memcpy(&v, value, sizeof(double));
+  return v;
+}
+
+/**
+ * Appends the bytes of a value to a buffer.
+ */
+template <typename T>
+void append(std::string& buffer, const T& value) {
+  buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+/**
+ * Reads values from the bytes of a statistics file, throwing if it ends early.
+ */
+class StatisticsReader {
+ public:
+  StatisticsReader(const std::string& filename, const std::string& bytes)
+      : filename_(filename),
+        bytes_(bytes),
+        position_(0) {}
+
+  template <typename T>
+  T read() {
+    T value;
+    std::memcpy(&value, take(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  std::string readBytes(const std::size_t length) {
+    return std::string(take(length), length);
+  }
+
+  bool atEnd() const { return position_ == bytes_.size(); }
+
+ private:
+  const char* take(const std::size_t length) {
+    if (bytes_.size() - position_ < length) {
+      throw BadStatisticsFileException(filename_, "file is too short");
+    }
+    const char* data = bytes_.data() + position_;
+    position_ += length;
+    return data;
+  }
+
+  const std::string& filename_;
+  const std::string& bytes_;
+  std::size_t position_;
+};
+
+}
+
+double AttributeStatistics::fractionBelow(const char* value) const {
+  if (bounds.empty() ||
+      ScanPredicate::compare(type, value, bounds.front().data(), length) <= 0) {
+    return 0;
+  }
+  const std::size_t buckets = bounds.size() - 1;
+  for (std::size_t i = 0; i < buckets; ++i) {
+    if (ScanPredicate::compare(type, value, bounds[i + 1].data(), length) > 0) {
+      continue;
+    }
+    // bounds[i] < value <= bounds[i + 1]; numbers are assumed spread evenly
+    // over the bucket, strings are put in its middle.
+    double within = 0.5;
+    if (type != STRING) {
+      const double low = toDouble(type, bounds[i].data());
+      const double high = toDouble(type, bounds[i + 1].data());
+      within = (toDouble(type, value) - low) / (high - low);
+    }
+    return (i + within) / buckets;
+  }
+  return 1;
+}
+
+double AttributeStatistics::selectivity(const Operator op,
+                                        const void* value) const {
+  if (bounds.empty()) {
+    return 0;
+  }
+  // The constant as attribute bytes; a string is padded like a predicate's.
+  std::string key(length, '\0');
+  if (type == STRING) {
+    strncpy(&key[0], static_cast<const char*>(value), length);
+  } else {
+    std::memcpy(&key[0], value, length);
+  }
+
+  double equal = 0;
+  if (ScanPredicate::compare(type, key.data(), min.data(), length) >= 0 &&
+      ScanPredicate::compare(type, key.data(), max.data(), length) <= 0) {
+    equal = 1 / std::max(distinct_count, 1.0);
+  }
+  const double below = fractionBelow(key.data());
+
+  double fraction;
+  switch (op) {
+    case LT:
+      fraction = below;
+      break;
+    case LTE:
+      fraction = below + equal;
+      break;
+    case GTE:
+      fraction = 1 - below;
+      break;
+    case GT:
+      fraction = 1 - below - equal;
+      break;
+    case EQ:
+      fraction = equal;
+      break;
+    default:
+      fraction = 1 - equal;
+      break;
+  }
+  return std::min(std::max(fraction, 0.0), 1.0);
+}
+
+const std::size_t TableStatistics::HISTOGRAM_BUCKETS;
+const std::size_t TableStatistics::SKETCH_REGISTERS;
+
+TableStatistics::TableStatistics()
+    : row_count_(0),
+      sample_rows_(0),
+      num_pages_(0),
+      pages_sampled_(0) {}
+
+void TableStatistics::addAttribute(const std::size_t offset,
+                                   const Datatype type,
+                                   const std::size_t length) {
+  if (type == STRING && length == 0) {
+    throw BadScanParamException();
+  }
+  AttributeStatistics attribute;
+  attribute.type = type;
+  attribute.offset = static_cast<std::uint16_t>(offset);
+  attribute.length =
+      static_cast<std::uint16_t>(attributeLength(type, length));
+  attribute.distinct_count = 0;
+  attributes_.push_back(attribute);
+}
+
+void TableStatistics::collect(const std::string& relation, BufMgr* bufMgr,
+                              const double fraction,
+                              const std::uint32_t seed) {
+  std::vector<PaxAttribute> projection;
+  std::size_t width = 0;
+  for (std::size_t a = 0; a < attributes_.size(); ++a) {
+    const PaxAttribute wanted = {attributes_[a].offset, attributes_[a].length};
+    projection.push_back(wanted);
+    width += wanted.length;
+  }
+
+  // The sampled values of each attribute, packed, and their sketches.
+  std::vector<std::string> values(attributes_.size());
+  std::vector<std::vector<std::uint8_t> > sketches(
+      attributes_.size(), std::vector<std::uint8_t>(SKETCH_REGISTERS, 0));
+  std::uint64_t rows = 0;
+  std::vector<char> rowBuffer;
+
+  SampleScan scan(relation, bufMgr, fraction, seed);
+  scan.run([&](PageRecords& records) {
+    const std::size_t count = records.size();
+    rowBuffer.resize(count * width);
+    records.project(0, count, projection, rowBuffer.data());
+    for (std::size_t k = 0; k < count; ++k) {
+      const char* row = rowBuffer.data() + k * width;
+      for (std::size_t a = 0; a < attributes_.size(); ++a) {
+        const AttributeStatistics& attribute = attributes_[a];
+        values[a].append(row, attribute.length);
+        const std::uint64_t hash =
+            ScanPredicate::hash(attribute.type, row, attribute.length);
+        const std::uint64_t rest = hash << SKETCH_INDEX_BITS;
+        const std::uint8_t rank = static_cast<std::uint8_t>(
+            rest == 0 ? 64 - SKETCH_INDEX_BITS + 1 : __builtin_clzll(rest) + 1);
+        std::uint8_t& reg = sketches[a][hash >> (64 - SKETCH_INDEX_BITS)];
+        reg = std::max(reg, rank);
+        row += attribute.length;
+      }
+    }
+    rows += count;
+  });
+
+  num_pages_ = scan.num_pages();
+  pages_sampled_ = scan.pages_sampled();
+  sample_rows_ = rows;
+  row_count_ = pages_sampled_ == 0
+      ? 0
+      : static_cast<double>(rows) * num_pages_ / pages_sampled_;
+
+  for (std::size_t a = 0; a < attributes_.size(); ++a) {
+    AttributeStatistics& attribute = attributes_[a];
+    attribute.sketch = sketches[a];
+    attribute.min.clear();
+    attribute.max.clear();
+    attribute.bounds.clear();
+    attribute.distinct_count = 0;
+    if (rows == 0) {
+      continue;
+    }
+
+    // Sort the sampled values through an index, comparing them in place.
+    const std::size_t length = attribute.length;
+    const char* data = values[a].data();
+    std::vector<std::uint32_t> order(rows);
+    for (std::size_t i = 0; i < rows; ++i) {
+      order[i] = static_cast<std::uint32_t>(i);
+    }
+    std::sort(order.begin(), order.end(),
+              [&](const std::uint32_t x, const std::uint32_t y) {
+                return ScanPredicate::compare(attribute.type, data + x * length,
+                                              data + y * length, length) < 0;
+              });
+    attribute.min.assign(data + order.front() * length, length);
+    attribute.max.assign(data + order.back() * length, length);
+
+    // Equi-depth: the bounds are the values at evenly spaced ranks.
+    const std::size_t buckets =
+        std::min<std::size_t>(HISTOGRAM_BUCKETS, static_cast<std::size_t>(rows));
+    for (std::size_t b = 0; b <= buckets; ++b) {
+      const std::size_t rank =
+          std::min<std::size_t>(b * rows / buckets, rows - 1);
+      attribute.bounds.push_back(
+          std::string(data + order[rank] * length, length));
+    }
+
+    // A sample where (almost) every value is distinct suggests a key, whose
+    // distinct values grow with the relation; otherwise the values seen are
+    // taken to be most of those there are.
+    double distinct = estimateDistinct(attribute.sketch);
+    distinct = std::min(distinct, static_cast<double>(rows));
+    if (distinct >= 0.95 * rows) {
+      distinct *= row_count_ / rows;
+    }
+    attribute.distinct_count = std::max(distinct, 1.0);
+  }
+}
+
+double TableStatistics::estimateDistinct(
+    const std::vector<std::uint8_t>& sketch) {
+  const double m = static_cast<double>(sketch.size());
+  double sum = 0;
+  std::size_t zeros = 0;
+  for (std::size_t i = 0; i < sketch.size(); ++i) {
+    sum += std::ldexp(1.0, -sketch[i]);
+    if (sketch[i] == 0) {
+      ++zeros;
+    }
+  }
+  const double alpha = 0.7213 / (1 + 1.079 / m);
+  const double estimate = alpha * m * m / sum;
+  // Linear counting is more accurate while many registers are still empty.
+  if (estimate <= 2.5 * m && zeros > 0) {
+    return m * std::log(m / zeros);
+  }
+  return estimate;
+}
+
+void TableStatistics::save(const std::string& relation) const {
+  std::string buffer;
+  append(buffer, STATISTICS_MAGIC);
+  append(buffer, static_cast<std::uint32_t>(attributes_.size()));
+  append(buffer, row_count_);
+  append(buffer, sample_rows_);
+  append(buffer, num_pages_);
+  append(buffer, pages_sampled_);
+  for (std::size_t a = 0; a < attributes_.size(); ++a) {
+    const AttributeStatistics& attribute = attributes_[a];
+    append(buffer, static_cast<std::uint32_t>(attribute.type));
+    append(buffer, attribute.offset);
+    append(buffer, attribute.length);
+    append(buffer, attribute.distinct_count);
+    append(buffer, static_cast<std::uint32_t>(attribute.bounds.size()));
+    if (!attribute.bounds.empty()) {
+      buffer += attribute.min;
+      buffer += attribute.max;
+      for (std::size_t b = 0; b < attribute.bounds.size(); ++b) {
+        buffer += attribute.bounds[b];
+      }
+    }
+    buffer.append(reinterpret_cast<const char*>(attribute.sketch.data()),
+                  attribute.sketch.size());
+  }
+
+  const std::string name = filename(relation);
+  if (File::exists(name)) {
+    File::remove(name);
+  }
+  std::shared_ptr<FileHandle> handle =
+      FileHandle::open(name, true /* create_new */);
+  handle->write(buffer.data(), buffer.size(), 0);
+  handle->sync();
+}
+
+TableStatistics TableStatistics::load(const std::string& relation) {
+  const std::string name = filename(relation);
+  std::shared_ptr<FileHandle> handle =
+      FileHandle::open(name, false /* create_new */);
+  std::string bytes(handle->size(), '\0');
+  if (!bytes.empty()) {
+    handle->read(&bytes[0], bytes.size(), 0);
+  }
+
+  StatisticsReader reader(name, bytes);
+  if (reader.read<std::uint32_t>() != STATISTICS_MAGIC) {
+    throw BadStatisticsFileException(name, "bad magic number");
+  }
+  TableStatistics statistics;
+  const std::uint32_t numAttributes = reader.read<std::uint32_t>();
+  statistics.row_count_ = reader.read<double>();
+  statistics.sample_rows_ = reader.read<std::uint64_t>();
+  statistics.num_pages_ = reader.read<PageId>();
+  statistics.pages_sampled_ = reader.read<PageId>();
+  for (std::uint32_t a = 0; a < numAttributes; ++a) {
+    AttributeStatistics attribute;
+    const std::uint32_t type = reader.read<std::uint32_t>();
+    if (type > STRING) {
+      throw BadStatisticsFileException(name, "bad attribute type");
+    }
+    attribute.type = static_cast<Datatype>(type);
+    attribute.offset = reader.read<std::uint16_t>();
+    attribute.length = reader.read<std::uint16_t>();
+    if (attribute.length == 0 ||
+        attribute.length !=
+            attributeLength(attribute.type, attribute.length)) {
+      throw BadStatisticsFileException(name, "bad attribute length");
+    }
+    attribute.distinct_count = reader.read<double>();
+    const std::uint32_t numBounds = reader.read<std::uint32_t>();
+    if (numBounds == 1 || numBounds > HISTOGRAM_BUCKETS + 1) {
+      throw BadStatisticsFileException(name, "bad histogram");
+    }
+    if (numBounds > 0) {
+      attribute.min = reader.readBytes(attribute.length);
+      attribute.max = reader.readBytes(attribute.length);
+      for (std::uint32_t b = 0; b < numBounds; ++b) {
+        attribute.bounds.push_back(reader.readBytes(attribute.length));
+      }
+    }
+    const std::string sketch = reader.readBytes(SKETCH_REGISTERS);
+    attribute.sketch.assign(sketch.begin(), sketch.end());
+    statistics.attributes_.push_back(attribute);
+  }
+  if (!reader.atEnd()) {
+    throw BadStatisticsFileException(name, "trailing bytes");
+  }
+  return statistics;
+}
+
+}
@@ -0,0 +1,216 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "buffer.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Statistics of one attribute of a relation, estimated from a sample.
+ *
+ * Values (min, max and histogram bounds) are kept as the raw bytes of the
+ * attribute and compared like ScanPredicate compares them.
+ */
+struct AttributeStatistics {
+  /**
+   * Type of the attribute.
+   */
+  Datatype type;
+
+  /**
+   * Byte offset of the attribute in the record.
+   */
+  std::uint16_t offset;
+
+  /**
+   * Length in bytes of the attribute.
+   */
+  std::uint16_t length;
+
+  /**
+   * Estimated number of distinct values in the relation.
+   */
+  double distinct_count;
+
+  /**
+   * Smallest and largest value sampled; empty if no records were sampled.
+   */
+  std::string min;
+  std::string max;
+
+  /**
+   * Bounds of an equi-depth histogram of the sampled values: bucket i holds
+   * about the same share of the values, those between bounds[i] and
+   * bounds[i + 1].  Empty if no records were sampled.
+   */
+  std::vector<std::string> bounds;
+
+  /**
+   * HyperLogLog registers of the sampled values; sketches of several samples
+   * of the same attribute can be merged by taking the larger register.
+   */
+  std::vector<std::uint8_t> sketch;
+
+  /**
+   * Estimates the fraction of the records whose attribute satisfies
+   * <attribute> <op> <value>.
+   *
+   * @param op      Comparison.
+   * @param value   Constant compared with, as for ScanPredicate.
+   * @return  Fraction between 0 and 1.
+   */
+  double selectivity(const Operator op, const void* value) const;
+
+  /**
+   * Returns the estimated fraction of the records whose attribute is less
+   * than the given value (raw attribute bytes).
+   */
+  double fractionBelow(const char* value) const;
+};
+
+/**
+ * @brief Statistics of a relation estimated from a block sample.
+ *
+ * The attributes to describe are added with addAttribute(), then collect()
+ * samples pages of the relation with a SampleScan and estimates, for each
+ * attribute, the number of distinct values (with a HyperLogLog sketch), the
+ * smallest and largest value, and an equi-depth histogram.  The statistics
+ * are kept next to the relation in <relation>.stats by save() and read back
+ * by load(), so an access path can be chosen without scanning the relation.
+ */
+class TableStatistics {
+ public:
+  /**
+   * Number of buckets of a histogram.
+   */
+  static const std::size_t HISTOGRAM_BUCKETS = 32;
+
+  /**
+   * Number of registers of a distinct-count sketch.
+   */
+  static const std::size_t SKETCH_REGISTERS = 1024;
+
+  /**
+   * Constructs statistics with no attributes.
+   */
+  TableStatistics();
+
+  /**
+   * Adds an attribute to describe.
+   *
+   * @param offset  Byte offset of the attribute in the record.
+   * @param type    Type of the attribute.
+   * @param length  Length of a STRING attribute; ignored for other types.
+   * @throws  BadScanParamException If type is STRING and length is 0.
+   */
+  void addAttribute(const std::size_t offset, const Datatype type,
+                    const std::size_t length = 0);
+
+  /**
+   * Estimates the statistics of the added attributes from a sample of the
+   * pages of the given relation.
+   *
+   * @param relation  Name of relation file.
+   * @param bufMgr    Buffer manager to read pages through.
+   * @param fraction  Fraction of the pages to sample.
+   * @param seed      Seed of the random page choice.
+   */
+  void collect(const std::string& relation, BufMgr* bufMgr,
+               const double fraction, const std::uint32_t seed = 1);
+
+  /**
+   * Writes the statistics to the statistics file of the given relation,
+   * replacing any there.
+   *
+   * @param relation  Name of relation file.
+   */
+  void save(const std::string& relation) const;
+
+  /**
+   * Reads the statistics of the given relation.
+   *
+   * @param relation  Name of relation file.
+   * @return  The statistics.
+   * @throws  FileNotFoundException       If no statistics were saved.
+   * @throws  BadStatisticsFileException  If the file does not hold them.
+   */
+  static TableStatistics load(const std::string& relation);
+
+  /**
+   * Returns the name of the statistics file of the given relation.
+   */
+  static std::string filename(const std::string& relation) {
+    return relation + ".stats";
+  }
+
+  /**
+   * Returns the estimated number of records in the relation.
+   */
+  double row_count() const { return row_count_; }
+
+  /**
+   * Returns the number of records sampled.
+   */
+  std::uint64_t sample_rows() const { return sample_rows_; }
+
+  /**
+   * Returns the number of pages of the relation and the number sampled.
+   */
+  PageId num_pages() const { return num_pages_; }
+  PageId pages_sampled() const { return pages_sampled_; }
+
+  /**
+   * Returns the number of attributes described.
+   */
+  std::size_t num_attributes() const { return attributes_.size(); }
+
+  /**
+   * Returns the statistics of the given attribute, in the order added.
+   */
+  const AttributeStatistics& attribute(const std::size_t i) const {
+    return attributes_[i];
+  }
+
+ private:
+  /**
+   * Returns the HyperLogLog estimate of the number of distinct values added
+   * to the given sketch.
+   */
+  static double estimateDistinct(const std::vector<std::uint8_t>& sketch);
+
+  /**
+   * Estimated number of records in the relation.
+   */
+  double row_count_;
+
+  /**
+   * Number of records sampled.
+   */
+  std::uint64_t sample_rows_;
+
+  /**
+   * Number of pages of the relation (not counting the header) and number of
+   * them sampled.
+   */
+  PageId num_pages_;
+  PageId pages_sampled_;
+
+  /**
+   * Statistics of each attribute.
+   */
+  std::vector<AttributeStatistics> attributes_;
+};
+
+}
@@ -24,6 +24,30 @@ typedef std::uint16_t SlotId;
  */
 typedef std::uint32_t FrameId;
 
+/**
+ * @brief Datatype enumeration type.
+ */
+enum Datatype
+{
+	INTEGER = 0,
+	DOUBLE = 1,
+	STRING = 2
+};
+
+/**
+ * @brief Comparison operations enumeration. BTreeIndex::startScan() takes the
+ * range operators; a ScanPredicate takes any of them.
+ */
+enum Operator
+{ 
+	LT, 	/* Less Than */
+	LTE,	/* Less Than or Equal to */
+	GTE,	/* Greater Than or Equal to */
+	GT,		/* Greater Than */
+	EQ,		/* Equal to */
+	NE		/* Not Equal to */
+};
+
 /**
  * @brief Identifier for a record in a page.
  */